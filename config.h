@@ -121,6 +121,57 @@
 #define NTP_SYNC_TX_COUNT 100
 #define SEND_DATA_TIMEOUT_IN_SEC (5 * 60)  // 5 minutes
 
+// Upload Scheduling Configuration
+#define UPLOAD_JITTER_WINDOW_SEC 45        // per-device upload offset is spread over [0, window) - keep below the shortest (1 min) cycle
+#define SERVER_BACKOFF_DEFAULT_SEC 60      // backoff applied on 429/503 when the server gives no Retry-After
+#define SERVER_BACKOFF_MAX_SEC (15 * 60)   // upper bound for server-advertised backoff hints
+
+// Record Sequence Configuration
+#define RECORD_SEQ_NVS_NAMESPACE "msp_net"
+#define RECORD_SEQ_NVS_KEY "rec_seq"
+#define RECORD_SEQ_RESERVE_BLOCK 64        // sequence numbers reserved per NVS write
+
+// Parsed Configuration Cache
+#define CONFIG_CACHE_NVS_NAMESPACE "msp_cfg"
+#define CONFIG_CACHE_NVS_KEY "cfg"
+#define CONFIG_RELOAD_CHECK_INTERVAL_MS (60 * 1000) // how often the SD config file is re-hashed for changes
+
+// Firmware Download Resume
+#define FW_RESUME_NVS_NAMESPACE "msp_fw"
+#define FW_RESUME_NVS_KEY "dl_ckpt"
+#define FW_RESUME_CHUNK_SIZE (64 * 1024)             // checkpoint granularity, a multiple of the 4 KB flash sector
+#define FW_RESUME_MAX_ATTEMPTS 5                     // connections per update check before giving up
+#define FW_RESUME_RETRY_DELAY_MS 5000                // first reconnect delay, grows linearly
+#define FW_RESUME_RECHECK_INTERVAL_MS (15 * 60 * 1000) // next update check after an interrupted download
+#define FW_RELEASE_ETAG_NVS_KEY "rel_etag"          // ETag of the last release JSON that needed no update
+#define FW_RELEASE_VER_NVS_KEY "rel_ver"            // firmware version that ETag was checked against
+#define FW_BAD_PATCH_NVS_KEY "bad_patch"            // URL of the last delta patch whose image failed verification
+
+// ===== SD Log Configuration =====
+
+// Daily log formats, any combination: CSV text (/YYYY/MM/DD.csv) and/or
+// fixed-width binary records (/YYYY/MM/DD.bin, ~4.5x smaller, see tools/msplog2csv)
+#define SD_LOG_FORMAT_CSV 0x01
+#define SD_LOG_FORMAT_BINARY 0x02
+#define SD_LOG_FORMATS (SD_LOG_FORMAT_CSV)
+#define SD_LOG_EXPORT_REQUEST_PATH "/export_csv" // create on the card to convert .bin days without a .csv at boot
+
+// SD card health telemetry: one row per day with per-operation latency percentiles
+#define SD_HEALTH_PATH "/sd_health.csv"
+#define SD_HEALTH_OLD_PATH "/sd_health.old.csv" // previous file after the columns changed
+#define SD_HEALTH_SLOW_WRITE_P95_US (200UL * 1000UL) // slow card alarm: block write p95 above this
+#define SD_HEALTH_SLOW_MIN_SAMPLES 20                // writes in the day before the alarm is evaluated
+#define SD_HEALTH_UPLOAD_INTERVAL_SEC (60 * 60)      // attach the health block to one upload per interval
+
+// ===== Flash Fallback Store Configuration =====
+
+// Records go to a LittleFS ring on the "spiffs" partition while no card is present
+#define FLASH_STORE_PARTITION_LABEL "spiffs"
+#define FLASH_STORE_SEGMENT_SIZE (16 * 1024)       // bytes per ring segment file
+#define FLASH_STORE_MAX_SEGMENTS 48                // ring capacity, ~770 KB
+#define FLASH_STORE_DAILY_BUDGET (2 * 1024 * 1024) // estimated flash bytes programmed per day before records are dropped
+#define FLASH_STORE_DRAIN_SEGMENTS_PER_CALL 4      // segments moved to SD per periodic check
+
 // ===== Version Information =====
 
 #ifndef VERSION_STRING
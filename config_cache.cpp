@@ -0,0 +1,127 @@
+/************************************************************************************************
+ * @file    config_cache.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   NVS cache of the parsed SD card configuration for the Milano Smart Park project
+ * @version 0.1
+ * @date    2025-09-10
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ************************************************************************************************/
+
+// -- includes --
+#include <Preferences.h>
+#include "mbedtls/sha256.h"
+
+#include "config.h"
+#include "config_cache.h"
+
+#define CONFIG_HASH_CHUNK 512
+
+/********************************************************
+ * @brief SHA-256 of a file
+ *
+ * @param fl
+ * @param hash
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalConfigCache_hashFile(File &fl, uint8_t *hash)
+{
+  uint8_t chunk[CONFIG_HASH_CHUNK];
+  mbedtls_sha256_context ctx;
+  size_t remaining = fl.size();
+
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0); // 0 for SHA256 (not SHA224)
+
+  fl.seek(0);
+  while (remaining > 0)
+  {
+    size_t want = (remaining > sizeof(chunk)) ? sizeof(chunk) : remaining;
+    size_t got = fl.read(chunk, want);
+    if (got == 0)
+    {
+      log_e("Read error while hashing %s", fl.path());
+      mbedtls_sha256_free(&ctx);
+      return false;
+    }
+    mbedtls_sha256_update(&ctx, chunk, got);
+    remaining -= got;
+  }
+
+  mbedtls_sha256_finish(&ctx, hash);
+  mbedtls_sha256_free(&ctx);
+  fl.seek(0);
+  return true;
+}
+
+/********************************************************
+ * @brief load the cached configuration for a file hash
+ *
+ * @param hash
+ * @param cfg
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalConfigCache_load(const uint8_t *hash, msp_config_t *cfg)
+{
+  Preferences prefs;
+  bool hit = false;
+
+  if (!prefs.begin(CONFIG_CACHE_NVS_NAMESPACE, true))
+  {
+    return false; // namespace not created yet: first boot
+  }
+
+  if (prefs.getBytesLength(CONFIG_CACHE_NVS_KEY) == sizeof(msp_config_t))
+  {
+    prefs.getBytes(CONFIG_CACHE_NVS_KEY, cfg, sizeof(msp_config_t));
+    if ((cfg->version != CONFIG_CACHE_VERSION) || (cfg->size != sizeof(msp_config_t)))
+    {
+      log_i("Config cache layout changed, re-parsing");
+    }
+    else if (memcmp(cfg->fileHash, hash, CONFIG_CACHE_HASH_LEN) != 0)
+    {
+      log_i("Config file changed, re-parsing");
+    }
+    else
+    {
+      hit = true;
+    }
+  }
+  prefs.end();
+
+  return hit;
+}
+
+/********************************************************
+ * @brief persist a parsed configuration
+ *
+ * @param cfg
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalConfigCache_store(msp_config_t *cfg)
+{
+  Preferences prefs;
+
+  cfg->version = CONFIG_CACHE_VERSION;
+  cfg->size = sizeof(msp_config_t);
+
+  if (!prefs.begin(CONFIG_CACHE_NVS_NAMESPACE, false))
+  {
+    log_e("Failed to open NVS namespace %s", CONFIG_CACHE_NVS_NAMESPACE);
+    return false;
+  }
+  bool ok = (prefs.putBytes(CONFIG_CACHE_NVS_KEY, cfg, sizeof(msp_config_t)) == sizeof(msp_config_t));
+  prefs.end();
+
+  if (!ok)
+  {
+    log_e("Failed to store config cache");
+  }
+  return ok;
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,97 @@
+/******************************************************************************************************
+ * @file    config_cache.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   NVS cache of the parsed SD card configuration for the Milano Smart Park project
+ * @details The validated content of config_v4.json is kept in NVS as a fixed-layout blob,
+ *          tagged with the SHA-256 of the file it came from. Boots with an unchanged file
+ *          only hash it and skip the JSON parse.
+ * @version 0.1
+ * @date    2025-09-10
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *****************************************************************************************************/
+
+#ifndef CONFIG_CACHE_H
+#define CONFIG_CACHE_H
+
+// -- includes --
+#include <Arduino.h>
+#include <FS.h>
+
+#define CONFIG_CACHE_VERSION 1 /*!< bump on any msp_config_t layout change */
+#define CONFIG_CACHE_HASH_LEN 32
+
+#define CONFIG_SSID_LEN 33
+#define CONFIG_PASSW_LEN 65
+#define CONFIG_DEVICEID_LEN 65
+#define CONFIG_APN_LEN 65
+#define CONFIG_SERVER_LEN 129
+#define CONFIG_NTP_SERVER_LEN 65
+#define CONFIG_TIMEZONE_LEN 65
+
+#define CONFIG_MICS_RED 0
+#define CONFIG_MICS_OX 1
+#define CONFIG_MICS_NH3 2
+#define CONFIG_MICS_CHANNELS 3
+
+typedef struct __MSP_CONFIG__
+{
+  uint16_t version;                         /*!< CONFIG_CACHE_VERSION */
+  uint16_t size;                            /*!< sizeof(msp_config_t) */
+  uint8_t fileHash[CONFIG_CACHE_HASH_LEN];  /*!< SHA-256 of the source file */
+  uint8_t parsed;                           /*!< config section found, fields below are meaningful */
+  uint8_t valid;                            /*!< parse outcome (all mandatory keys ok) */
+  uint32_t parseUs;                         /*!< JSON parse time of the source file */
+  char ssid[CONFIG_SSID_LEN];               /*!< empty: not configured */
+  char passw[CONFIG_PASSW_LEN];
+  char deviceid[CONFIG_DEVICEID_LEN];
+  char apn[CONFIG_APN_LEN];
+  char server[CONFIG_SERVER_LEN];           /*!< empty: compile time API_SERVER */
+  char ntpServer[CONFIG_NTP_SERVER_LEN];
+  char timezone[CONFIG_TIMEZONE_LEN];       /*!< empty: keep default */
+  int32_t wifiPower;                        /*!< wifi_power_t */
+  int32_t o3ZeroOffset;
+  int32_t avgMeasurements;
+  int32_t avgDelay;
+  float seaLevelAltitude;
+  uint16_t micsR0[CONFIG_MICS_CHANNELS];
+  int16_t micsOffset[CONFIG_MICS_CHANNELS];
+  float compHumidity;
+  float compTemperature;
+  float compPressure;
+  uint8_t useModem;
+  uint8_t fwAutoUpgrade;
+} msp_config_t;
+
+/********************************************************
+ * @brief SHA-256 of a file, read in sector-sized chunks;
+ *        the file is rewound afterwards
+ *
+ * @param fl   open file
+ * @param hash output, CONFIG_CACHE_HASH_LEN bytes
+ * @return true  file hashed
+ * @return false read error
+ ********************************************************/
+bool bHalConfigCache_hashFile(File &fl, uint8_t *hash);
+
+/********************************************************
+ * @brief load the cached configuration for a file hash
+ *
+ * @param hash SHA-256 of the current config file
+ * @param cfg  filled on a hit
+ * @return true  cache hit with matching version, layout and hash
+ * @return false miss: parse the file and store the result
+ ********************************************************/
+bool bHalConfigCache_load(const uint8_t *hash, msp_config_t *cfg);
+
+/********************************************************
+ * @brief persist a parsed configuration
+ *
+ * @param cfg configuration with fileHash set
+ * @return true  stored
+ * @return false NVS error
+ ********************************************************/
+bool bHalConfigCache_store(msp_config_t *cfg);
+
+#endif
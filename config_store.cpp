@@ -0,0 +1,336 @@
+/************************************************************************************************
+ * @file    config_store.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Versioned configuration store with change subscribers for the Milano Smart Park project
+ * @version 0.1
+ * @date    2025-09-11
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ************************************************************************************************/
+
+// -- includes --
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "config_store.h"
+
+typedef struct __CONFIG_SUBSCRIBER__
+{
+  bool used;
+  uint32_t interest;
+  uint32_t pending;     /*!< groups changed since the last take */
+  uint32_t seenVersion; /*!< version of the last take */
+  config_notify_cb_t notify;
+  void *ctx;
+} config_subscriber_state_t;
+
+static SemaphoreHandle_t configStoreMutex = NULL;
+static StaticSemaphore_t configStoreMutexBuffer;
+
+static msp_config_t activeConfig;
+static uint32_t activeVersion = 0;
+static config_subscriber_state_t subscribers[CONFIG_STORE_MAX_SUBSCRIBERS];
+
+static void vConfigStore_lock(void)
+{
+  if (configStoreMutex != NULL)
+  {
+    xSemaphoreTake(configStoreMutex, portMAX_DELAY);
+  }
+}
+
+static void vConfigStore_unlock(void)
+{
+  if (configStoreMutex != NULL)
+  {
+    xSemaphoreGive(configStoreMutex);
+  }
+}
+
+/**************************************************************
+ * @brief groups whose settings differ between two configs
+ *************************************************************/
+static uint32_t ulConfigStore_diff(const msp_config_t *a, const msp_config_t *b)
+{
+  uint32_t changed = 0;
+
+  if ((strcmp(a->ssid, b->ssid) != 0) || (strcmp(a->passw, b->passw) != 0) || (a->wifiPower != b->wifiPower))
+  {
+    changed |= CONFIG_CHANGED_WIFI;
+  }
+  if ((a->useModem != b->useModem) || (strcmp(a->apn, b->apn) != 0))
+  {
+    changed |= CONFIG_CHANGED_MODEM;
+  }
+  if (strcmp(a->server, b->server) != 0)
+  {
+    changed |= CONFIG_CHANGED_SERVER;
+  }
+  if (strcmp(a->deviceid, b->deviceid) != 0)
+  {
+    changed |= CONFIG_CHANGED_IDENTITY;
+  }
+  if ((strcmp(a->ntpServer, b->ntpServer) != 0) || (strcmp(a->timezone, b->timezone) != 0))
+  {
+    changed |= CONFIG_CHANGED_TIME;
+  }
+  if ((a->avgMeasurements != b->avgMeasurements) || (a->avgDelay != b->avgDelay))
+  {
+    changed |= CONFIG_CHANGED_SCHEDULE;
+  }
+  if ((a->o3ZeroOffset != b->o3ZeroOffset) || (a->seaLevelAltitude != b->seaLevelAltitude) ||
+      (memcmp(a->micsR0, b->micsR0, sizeof(a->micsR0)) != 0) ||
+      (memcmp(a->micsOffset, b->micsOffset, sizeof(a->micsOffset)) != 0) ||
+      (a->compHumidity != b->compHumidity) || (a->compTemperature != b->compTemperature) ||
+      (a->compPressure != b->compPressure))
+  {
+    changed |= CONFIG_CHANGED_SENSORS;
+  }
+  if (a->fwAutoUpgrade != b->fwAutoUpgrade)
+  {
+    changed |= CONFIG_CHANGED_FIRMWARE;
+  }
+
+  return changed;
+}
+
+/********************************************************
+ * @brief initialize the store
+ ********************************************************/
+void vHalConfigStore_init(void)
+{
+  if (configStoreMutex == NULL)
+  {
+    configStoreMutex = xSemaphoreCreateMutexStatic(&configStoreMutexBuffer);
+  }
+}
+
+/********************************************************
+ * @brief register a subscriber
+ *
+ * @param interest
+ * @param notify
+ * @param ctx
+ * @return config_subscriber_t
+ ********************************************************/
+config_subscriber_t tHalConfigStore_subscribe(uint32_t interest, config_notify_cb_t notify, void *ctx)
+{
+  config_subscriber_t handle = CONFIG_STORE_INVALID_SUBSCRIBER;
+
+  vConfigStore_lock();
+  for (int8_t i = 0; i < CONFIG_STORE_MAX_SUBSCRIBERS; i++)
+  {
+    if (!subscribers[i].used)
+    {
+      subscribers[i].used = true;
+      subscribers[i].interest = interest;
+      subscribers[i].pending = (activeVersion > 0) ? interest : 0;
+      subscribers[i].seenVersion = 0;
+      subscribers[i].notify = notify;
+      subscribers[i].ctx = ctx;
+      handle = i;
+      break;
+    }
+  }
+  vConfigStore_unlock();
+
+  if (handle == CONFIG_STORE_INVALID_SUBSCRIBER)
+  {
+    log_e("Config store subscriber table full");
+  }
+  return handle;
+}
+
+/********************************************************
+ * @brief replace the active configuration
+ *
+ * @param cfg
+ * @return uint32_t
+ ********************************************************/
+uint32_t ulHalConfigStore_publish(const msp_config_t *cfg)
+{
+  config_notify_cb_t toNotify[CONFIG_STORE_MAX_SUBSCRIBERS] = {};
+  void *notifyCtx[CONFIG_STORE_MAX_SUBSCRIBERS] = {};
+  uint32_t changed;
+
+  vConfigStore_lock();
+  changed = (activeVersion == 0) ? CONFIG_CHANGED_ALL : ulConfigStore_diff(&activeConfig, cfg);
+  if (changed != 0)
+  {
+    activeConfig = *cfg;
+    activeVersion++;
+    for (int i = 0; i < CONFIG_STORE_MAX_SUBSCRIBERS; i++)
+    {
+      if (subscribers[i].used && (subscribers[i].interest & changed))
+      {
+        subscribers[i].pending |= subscribers[i].interest & changed;
+        toNotify[i] = subscribers[i].notify;
+        notifyCtx[i] = subscribers[i].ctx;
+      }
+    }
+  }
+  uint32_t version = activeVersion;
+  vConfigStore_unlock();
+
+  if (changed == 0)
+  {
+    log_i("Config unchanged (version %lu)", (unsigned long)version);
+    return 0;
+  }
+
+  log_i("Config version %lu published, changed groups 0x%02lX", (unsigned long)version, (unsigned long)changed);
+
+  // Outside the lock: a callback may wake a task that takes right away
+  for (int i = 0; i < CONFIG_STORE_MAX_SUBSCRIBERS; i++)
+  {
+    if (toNotify[i] != NULL)
+    {
+      toNotify[i](notifyCtx[i]);
+    }
+  }
+  return changed;
+}
+
+/********************************************************
+ * @brief take the current config and the pending diff
+ *
+ * @param sub
+ * @param cfg
+ * @param diff
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalConfigStore_take(config_subscriber_t sub, msp_config_t *cfg, config_diff_t *diff)
+{
+  bool pending = false;
+
+  if ((sub < 0) || (sub >= CONFIG_STORE_MAX_SUBSCRIBERS))
+  {
+    return false;
+  }
+
+  vConfigStore_lock();
+  config_subscriber_state_t *s = &subscribers[sub];
+  if (s->used && (s->pending != 0))
+  {
+    *cfg = activeConfig;
+    diff->fromVersion = s->seenVersion;
+    diff->toVersion = activeVersion;
+    diff->changed = s->pending;
+    s->pending = 0;
+    s->seenVersion = activeVersion;
+    pending = true;
+  }
+  vConfigStore_unlock();
+
+  return pending;
+}
+
+/********************************************************
+ * @brief current version
+ *
+ * @return uint32_t
+ ********************************************************/
+uint32_t ulHalConfigStore_version(void)
+{
+  vConfigStore_lock();
+  uint32_t version = activeVersion;
+  vConfigStore_unlock();
+  return version;
+}
+
+/********************************************************
+ * @brief copy the selected groups into runtime structures
+ *
+ * @param cfg
+ * @param groups
+ * @param p_tDev
+ * @param p_tData
+ * @param pDev
+ * @param sysStat
+ * @param p_tSysData
+ ********************************************************/
+void vHalConfigStore_apply(const msp_config_t *cfg, uint32_t groups, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData,
+                           deviceMeasurement_t *pDev, systemStatus_t *sysStat, systemData_t *p_tSysData)
+{
+  if (p_tDev != NULL)
+  {
+    if (groups & CONFIG_CHANGED_WIFI)
+    {
+      if (cfg->ssid[0] != '\0')
+      {
+        p_tDev->ssid = cfg->ssid;
+      }
+      if (cfg->passw[0] != '\0')
+      {
+        p_tDev->passw = cfg->passw;
+      }
+      p_tDev->wifipow = (wifi_power_t)cfg->wifiPower;
+    }
+    if ((groups & CONFIG_CHANGED_MODEM) && (cfg->apn[0] != '\0'))
+    {
+      p_tDev->apn = cfg->apn;
+    }
+    if ((groups & CONFIG_CHANGED_IDENTITY) && (cfg->deviceid[0] != '\0'))
+    {
+      p_tDev->deviceid = cfg->deviceid;
+    }
+  }
+
+  if ((p_tData != NULL) && (groups & CONFIG_CHANGED_SENSORS))
+  {
+    p_tData->ozoneData.o3ZeroOffset = cfg->o3ZeroOffset;
+    p_tData->gasData.seaLevelAltitude = cfg->seaLevelAltitude;
+    p_tData->pollutionData.sensingResInAir.redSensor = cfg->micsR0[CONFIG_MICS_RED];
+    p_tData->pollutionData.sensingResInAir.oxSensor = cfg->micsR0[CONFIG_MICS_OX];
+    p_tData->pollutionData.sensingResInAir.nh3Sensor = cfg->micsR0[CONFIG_MICS_NH3];
+    p_tData->pollutionData.sensingResInAirOffset.redSensor = cfg->micsOffset[CONFIG_MICS_RED];
+    p_tData->pollutionData.sensingResInAirOffset.oxSensor = cfg->micsOffset[CONFIG_MICS_OX];
+    p_tData->pollutionData.sensingResInAirOffset.nh3Sensor = cfg->micsOffset[CONFIG_MICS_NH3];
+    p_tData->compParams.currentHumidity = cfg->compHumidity;
+    p_tData->compParams.currentTemperature = cfg->compTemperature;
+    p_tData->compParams.currentPressure = cfg->compPressure;
+  }
+
+  if ((pDev != NULL) && (groups & CONFIG_CHANGED_SCHEDULE))
+  {
+    pDev->avg_measurements = cfg->avgMeasurements;
+    pDev->avg_delay = cfg->avgDelay;
+  }
+
+  if (sysStat != NULL)
+  {
+    if (groups & CONFIG_CHANGED_MODEM)
+    {
+      sysStat->use_modem = cfg->useModem;
+    }
+    if ((groups & CONFIG_CHANGED_SERVER) && (cfg->server[0] != '\0'))
+    {
+      sysStat->server_ok = true;
+    }
+    if (groups & CONFIG_CHANGED_FIRMWARE)
+    {
+      sysStat->fwAutoUpgrade = cfg->fwAutoUpgrade;
+    }
+  }
+
+  if (p_tSysData != NULL)
+  {
+    if ((groups & CONFIG_CHANGED_SERVER) && (cfg->server[0] != '\0'))
+    {
+      p_tSysData->server = cfg->server;
+      p_tSysData->server_ok = true;
+    }
+    if (groups & CONFIG_CHANGED_TIME)
+    {
+      p_tSysData->ntp_server = cfg->ntpServer;
+      if (cfg->timezone[0] != '\0')
+      {
+        p_tSysData->timezone = cfg->timezone;
+      }
+    }
+  }
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,109 @@
+/******************************************************************************************************
+ * @file    config_store.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Versioned configuration store with change subscribers for the Milano Smart Park project
+ * @details Single owner of the active msp_config_t. Every publish bumps the version and records,
+ *          per subscriber, which groups of settings changed. Tasks pull the current config and
+ *          their accumulated diff in their own context and apply only the changed groups.
+ * @version 0.1
+ * @date    2025-09-11
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *****************************************************************************************************/
+
+#ifndef CONFIG_STORE_H
+#define CONFIG_STORE_H
+
+// -- includes --
+#include "config_cache.h"
+#include "shared_values.h"
+
+// Change groups
+#define CONFIG_CHANGED_WIFI (1 << 0)     /*!< ssid, password, wifi power */
+#define CONFIG_CHANGED_MODEM (1 << 1)    /*!< use_modem, APN */
+#define CONFIG_CHANGED_SERVER (1 << 2)   /*!< upload server */
+#define CONFIG_CHANGED_IDENTITY (1 << 3) /*!< device id */
+#define CONFIG_CHANGED_TIME (1 << 4)     /*!< NTP server, timezone */
+#define CONFIG_CHANGED_SCHEDULE (1 << 5) /*!< average_measurements, average_delay_seconds */
+#define CONFIG_CHANGED_SENSORS (1 << 6)  /*!< O3 zero, altitude, MICS calibration, compensation */
+#define CONFIG_CHANGED_FIRMWARE (1 << 7) /*!< fw_auto_upgrade */
+#define CONFIG_CHANGED_ALL (0xFF)
+
+#define CONFIG_STORE_MAX_SUBSCRIBERS 4
+#define CONFIG_STORE_INVALID_SUBSCRIBER (-1)
+
+typedef struct __CONFIG_DIFF__
+{
+  uint32_t fromVersion; /*!< version the subscriber last took, 0 for none */
+  uint32_t toVersion;   /*!< version of the returned config */
+  uint32_t changed;     /*!< CONFIG_CHANGED_* groups, filtered by the subscriber interest */
+} config_diff_t;
+
+/********************************************************
+ * @brief called from the publisher's context when a new
+ *        version touches the subscriber's interest; must
+ *        only wake the subscriber (set a bit, give a sem)
+ ********************************************************/
+typedef void (*config_notify_cb_t)(void *ctx);
+
+typedef int8_t config_subscriber_t;
+
+/********************************************************
+ * @brief initialize the store
+ ********************************************************/
+void vHalConfigStore_init(void);
+
+/********************************************************
+ * @brief register a subscriber; if a config is already
+ *        published all groups are pending for it
+ *
+ * @param interest CONFIG_CHANGED_* groups of interest
+ * @param notify   wake-up callback, NULL for polling
+ * @param ctx      callback context
+ * @return handle, CONFIG_STORE_INVALID_SUBSCRIBER if full
+ ********************************************************/
+config_subscriber_t tHalConfigStore_subscribe(uint32_t interest, config_notify_cb_t notify, void *ctx);
+
+/********************************************************
+ * @brief replace the active configuration
+ *
+ * @param cfg new configuration
+ * @return uint32_t CONFIG_CHANGED_* groups that differ
+ ********************************************************/
+uint32_t ulHalConfigStore_publish(const msp_config_t *cfg);
+
+/********************************************************
+ * @brief take the current config and the changes since
+ *        the subscriber's last take
+ *
+ * @param sub  subscriber handle
+ * @param cfg  current configuration (copied on true)
+ * @param diff accumulated diff
+ * @return true  groups of interest changed
+ * @return false nothing new for this subscriber
+ ********************************************************/
+bool bHalConfigStore_take(config_subscriber_t sub, msp_config_t *cfg, config_diff_t *diff);
+
+/********************************************************
+ * @brief current version, 0 before the first publish
+ ********************************************************/
+uint32_t ulHalConfigStore_version(void);
+
+/********************************************************
+ * @brief copy the selected groups of a configuration into
+ *        runtime structures; NULL structures are skipped,
+ *        empty strings keep the compiled-in defaults
+ *
+ * @param cfg        configuration
+ * @param groups     CONFIG_CHANGED_* groups to apply
+ * @param p_tDev     network info (WIFI, MODEM, IDENTITY)
+ * @param p_tData    sensor data (SENSORS)
+ * @param pDev       measurement settings (SCHEDULE)
+ * @param sysStat    system status (MODEM, SERVER, FIRMWARE)
+ * @param p_tSysData system data (SERVER, TIME)
+ ********************************************************/
+void vHalConfigStore_apply(const msp_config_t *cfg, uint32_t groups, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData,
+                           deviceMeasurement_t *pDev, systemStatus_t *sysStat, systemData_t *p_tSysData);
+
+#endif
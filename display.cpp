@@ -78,7 +78,15 @@
 #define MEAS_DISP_Y_OFFSET_L4     61
 
 #define SENSOR_DATA_STR_FMT_LEN   16
-#define COUNT_DOWN_STR_FMT_LEN    17
+#define COUNT_DOWN_STR_FMT_LEN    19 // "WAIT -546:-07 sec." for any short
+
+// frame buffer geometry: 8 rows of 16 tiles, a tile is 8 bytes of 8 vertical pixels
+#define DISP_TILE_ROWS            8
+#define DISP_TILE_COLS            16
+#define DISP_TILE_BYTES           8
+#define DISP_FRAME_BYTES          (DISP_TILE_ROWS * DISP_TILE_COLS * DISP_TILE_BYTES)
+#define DISP_ROW_CMD_BYTES        3     // SH1106 page and column address commands per row sent
+#define DISP_STATS_PERIOD_MS      60000
 
 
 #define STR_FIRST_NAME        "Milano"
@@ -95,8 +103,18 @@
 static U8G2_SH1106_128X64_NONAME_F_HW_I2C u8g2(U8G2_R0, U8X8_PIN_NONE, I2C_SCL_PIN, I2C_SDA_PIN); // ESP32 Thing, HW I2C with pin remapping
 
 
+// -- copy of what the panel shows, to send only the tiles that changed
+static uint8_t shownFrame[DISP_FRAME_BYTES];
+static bool shownFrameValid = false;
+
+// -- I2C payload sent to the panel in the current period, and what full frames would have cost
+static uint32_t i2cBytes = 0;
+static uint32_t i2cFullFrameBytes = 0;
+static unsigned long i2cStatsStart = 0;
+
 // -------------------------------local function prototype -------------------------------
-static void vHal_displayDrawScrHead(systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr);
+static void vHal_displayDrawScrHead(const displaySnapshot_t *snap);
+static void vHal_displaySendDirty(void);
 static short sHalDisplay_getLineHOffset(const char string[]);
 
 // ------------------------------- functions declerations---------------------------------
@@ -111,7 +129,9 @@ void vHalDisplay_initSerialAndI2c(void)
   Serial.begin(115200);
   delay(2000); // give time to serial to initialize properly
   Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
+  vMspOs_takeI2cBus(I2C_DEV_DISPLAY);
   u8g2.begin();
+  vMspOs_giveI2cBus(I2C_DEV_DISPLAY);
 }
 
 /******************************************************
@@ -119,9 +139,8 @@ void vHalDisplay_initSerialAndI2c(void)
  * 
  * @param fwver 
  *****************************************************/
- void vHalDisplay_DrawBoot(String *fwver) 
+ void vHalDisplay_DrawBoot(const char *fwver) 
  { 
-  u8g2.firstPage();
   u8g2.clearBuffer();
   u8g2.drawXBM(XBM_X_POS_MSPICON,XBM_Y_POS_MSPICON,XBM__MSPICON_W,XMB__MSPICON_H,icons.msp_icon64x64);
   u8g2.setFont(u8g2_font_6x13B_tf);
@@ -130,35 +149,34 @@ void vHalDisplay_initSerialAndI2c(void)
   u8g2.drawStr(DRAW_STR_X_POS,DRAW_STR_Y_POS_LAST_NAME,STR_LAST_NAME);
   u8g2.setFont(u8g2_font_6x13_mf);
   u8g2.setCursor(SET_CRSR_X_POS_AUTHOR,SET_CRSR_Y_POS_AUTHOR); u8g2.print(STR_AUTHOR);
-  u8g2.setCursor(SET_CRSR_X_POS_FWVER,SET_CRSR_Y_POS_FWVER); u8g2.print(*fwver);
-  u8g2.sendBuffer();
+  u8g2.setCursor(SET_CRSR_X_POS_FWVER,SET_CRSR_Y_POS_FWVER); u8g2.print(fwver);
+  vHal_displaySendDirty();
 }
 
 /***********************************************************************
  * @brief function to draw the screen header on the U8G2 display
  * 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  **********************************************************************/
-static void vHal_displayDrawScrHead(systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr)
+static void vHal_displayDrawScrHead(const displaySnapshot_t *snap)
 { 
   u8g2.clearBuffer();
   u8g2.setFont(u8g2_font_6x13_tf);
 
   // system state
-  u8g2.setCursor(POS_X_DEVICE_ID,POS_Y_DEVICE_ID); u8g2.print("#" + devinfoPtr->deviceid + "#");
+  u8g2.setCursor(POS_X_DEVICE_ID,POS_Y_DEVICE_ID); u8g2.print("#"); u8g2.print(snap->deviceId); u8g2.print("#");
 
-  if (statPtr->sdCard) 
+  if (snap->sdCard) 
   {
     u8g2.drawXBMP(XBM_X_POS_SDICON, XBM_Y_POS_SDICON, XBM_SDICON_W, XMB_SDICON_H, icons.sd_icon16x16);
   }
-  if (statPtr->datetime) 
+  if (snap->datetime) 
   {
     u8g2.drawXBMP(XBM_X_POS_CLKICON, XBM_Y_POS_CLKICON, XBM_CLKICON_W, XMB_CLKICON_H, icons.clock_icon16x16);
   }
-  if (statPtr->connection) 
+  if (snap->connection) 
   {
-    if (statPtr->use_modem) 
+    if (snap->useModem) 
     {
       u8g2.drawXBMP(XBM_X_POS_MOBICON, XBM_Y_POS_MOBICON, XBM_MOBICON_W, XMB_MOBICON_H, icons.mobile_icon16x16);
     } 
@@ -176,6 +194,60 @@ static void vHal_displayDrawScrHead(systemStatus_t *statPtr, deviceNetworkInfo_t
 
 }
 
+/******************************************************************************
+ * @brief send the tiles of the frame buffer that differ from the panel,
+ *        one area per tile row spanning its first to last changed tile.
+ *        The header is redrawn identically on every screen, so it goes
+ *        out only when an icon changes. Each row is its own bus
+ *        transaction, so a waiting sensor gets the bus between rows.
+ * 
+ ******************************************************************************/
+static void vHal_displaySendDirty(void)
+{
+  uint8_t *frame = u8g2.getBufferPtr();
+
+  for (uint8_t ty = 0; ty < DISP_TILE_ROWS; ty++)
+  {
+    uint8_t *row = frame + ty * DISP_TILE_COLS * DISP_TILE_BYTES;
+    uint8_t *shownRow = shownFrame + ty * DISP_TILE_COLS * DISP_TILE_BYTES;
+    int first = -1;
+    int last = -1;
+    for (uint8_t tx = 0; tx < DISP_TILE_COLS; tx++)
+    {
+      // the first frame after boot goes out whole to sync the copy
+      if ((!shownFrameValid) || (memcmp(row + tx * DISP_TILE_BYTES, shownRow + tx * DISP_TILE_BYTES, DISP_TILE_BYTES) != 0))
+      {
+        if (first < 0)
+        {
+          first = tx;
+        }
+        last = tx;
+      }
+    }
+    if (first >= 0)
+    {
+      uint8_t width = last - first + 1;
+      vMspOs_takeI2cBus(I2C_DEV_DISPLAY);
+      u8g2.updateDisplayArea(first, ty, width, 1);
+      vMspOs_giveI2cBus(I2C_DEV_DISPLAY);
+      memcpy(shownRow + first * DISP_TILE_BYTES, row + first * DISP_TILE_BYTES, width * DISP_TILE_BYTES);
+      i2cBytes += DISP_ROW_CMD_BYTES + width * DISP_TILE_BYTES;
+    }
+  }
+  shownFrameValid = true;
+  i2cFullFrameBytes += DISP_TILE_ROWS * (DISP_ROW_CMD_BYTES + DISP_TILE_COLS * DISP_TILE_BYTES);
+
+  unsigned long elapsed = millis() - i2cStatsStart;
+  if (elapsed >= DISP_STATS_PERIOD_MS)
+  {
+    log_d("Display I2C: %lu bytes in %lu s, %lu with full frames", (unsigned long)i2cBytes, elapsed / 1000,
+          (unsigned long)i2cFullFrameBytes);
+    i2cBytes = 0;
+    i2cFullFrameBytes = 0;
+    i2cStatsStart = millis();
+  }
+}
+
 /******************************************************************************
  * @brief get the proper horizontal offset of a string for the U8G2 display
  * 
@@ -197,17 +269,14 @@ static short sHalDisplay_getLineHOffset(const char string[])
 * @brief draws a text line on the U8G2 display
 * 
 * @param message 
-* @param secdelay 
-* @param statPtr 
-* @param devinfoPtr 
+* @param snap
 *******************************************************/
-void vHalDisplay_drawLine(const char message[], short secdelay,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr)
+void vHalDisplay_drawLine(const char message[], const displaySnapshot_t *snap)
 {
   short offset = sHalDisplay_getLineHOffset(message);
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
+  vHal_displayDrawScrHead(snap);
   u8g2.setCursor(offset, DRAW_LINE_Y_OFFSET); u8g2.print(message);
-  u8g2.sendBuffer();
-  delay(secdelay * 1000);
+  vHal_displaySendDirty();
 }
 
 
@@ -216,77 +285,68 @@ void vHalDisplay_drawLine(const char message[], short secdelay,systemStatus_t *s
  * 
  * @param message1 
  * @param message2 
- * @param secdelay 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ********************************************************/
-void vHalDisplay_drawTwoLines(const char message1[], const char message2[], short secdelay,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr) 
+void vHalDisplay_drawTwoLines(const char message1[], const char message2[], const displaySnapshot_t *snap) 
 {
   short offset1 = sHalDisplay_getLineHOffset(message1);
   short offset2 = sHalDisplay_getLineHOffset(message2);
 
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
+  vHal_displayDrawScrHead(snap);
   u8g2.setCursor(offset1,DRAW_TWO_LINE_Y_OFFSET_L1); u8g2.print(message1);
   u8g2.setCursor(offset2,DRAW_TWO_LINE_Y_OFFSET_L2); u8g2.print(message2);
-  u8g2.sendBuffer();
-  delay(secdelay * 1000);
+  vHal_displaySendDirty();
 }
 
 /*******************************************************
- * @brief draws a countdown on the U8G2 display
+ * @brief draws one tick of a countdown on the U8G2 display
  * 
- * @param startsec 
+ * @param remainsec 
  * @param message 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *******************************************************/
-void vHalDisplay_drawCountdown(short startsec, const char message[],systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr)
+void vHalDisplay_drawCountdown(short remainsec, const char message[], const displaySnapshot_t *snap)
 {
-  for (short i = startsec; i >= 0; i--) 
-  {
-    char output[COUNT_DOWN_STR_FMT_LEN] = {0};
+  char output[COUNT_DOWN_STR_FMT_LEN] = {0};
 
-    sprintf(output, "WAIT %02d:%02d sec.", i / 60, i % 60);
+  snprintf(output, sizeof(output), "WAIT %02d:%02d sec.", remainsec / 60, remainsec % 60);
 
-    vHalDisplay_drawTwoLines(message,output,1,statPtr,devinfoPtr);
-  }
+  vHalDisplay_drawTwoLines(message,output,snap);
 }
 
 /*********************************************************************************
  * @brief function to draw the BME680 gas sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ********************************************************************************/
-void vHalDisplay_drawBme680GasSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay)
+void vHalDisplay_drawBme680GasSensorData(const displaySnapshot_t *snap)
 {
   //log_d("Printing BME680Sensor data on display...");
   char sensorStringData[SENSOR_DATA_STR_FMT_LEN] = {0};
 
   // page 1
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  if (p_tData->status.BME680Sensor)
+  vHal_displayDrawScrHead(snap);
+  if (snap->sensorStat.BME680Sensor)
   {
-    vGeneric_dspFloatToComma(p_tData->gasData.temperature,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->temperature,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L1); 
     u8g2.print("Temp:  ");
     u8g2.print(sensorStringData);
     u8g2.print(" C");
 
-    vGeneric_dspFloatToComma(p_tData->gasData.humidity,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->humidity,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
     u8g2.print("Hum:  ");
     u8g2.print(sensorStringData);
     u8g2.print(" %");
 
-    vGeneric_dspFloatToComma(p_tData->gasData.pressure,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->pressure,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L3);
     u8g2.print("Pre:  ");
     u8g2.print(sensorStringData);
     u8g2.print("hPa");
 
-    vGeneric_dspFloatToComma(p_tData->gasData.volatileOrganicCompounds,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->voc,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L4);
     u8g2.print("VOC:  ");
     u8g2.print(sensorStringData);
@@ -307,39 +367,36 @@ void vHalDisplay_drawBme680GasSensorData(sensorData_t *p_tData,systemStatus_t *s
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L4);
     u8g2.print("VOC: --");
   }  
-  u8g2.sendBuffer();
-  delay(secdelay * 1000);  
+  vHal_displaySendDirty();
 }
 
 /*********************************************************************************
  * @brief function to draw the PMS5003 air quality sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *********************************************************************************/
-void vHalDisplay_drawPMS5003AirQualitySensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay)
+void vHalDisplay_drawPMS5003AirQualitySensorData(const displaySnapshot_t *snap)
 {
   //log_d("Printing PMS5003Sensor data on display...");
   char sensorStringData[SENSOR_DATA_STR_FMT_LEN] = {0};
 
   // page 2
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  if (p_tData->status.PMS5003Sensor)
+  vHal_displayDrawScrHead(snap);
+  if (snap->sensorStat.PMS5003Sensor)
   {
-    vGeneric_dspFloatToComma(p_tData->airQualityData.particleMicron1,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->pm1,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L1);
     u8g2.print("PM1:  ");
     u8g2.print(sensorStringData);
     u8g2.print("ug/m3");
 
-    vGeneric_dspFloatToComma(p_tData->airQualityData.particleMicron25,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->pm25,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
     u8g2.print("PM2,5:  ");
     u8g2.print(sensorStringData);
     u8g2.print("ug/m3");
 
-    vGeneric_dspFloatToComma(p_tData->airQualityData.particleMicron10,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->pm10,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L3);
     u8g2.print("PM10:  ");
     u8g2.print(sensorStringData);
@@ -356,38 +413,35 @@ void vHalDisplay_drawPMS5003AirQualitySensorData(sensorData_t *p_tData,systemSta
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L3);
     u8g2.print("PM10:--");
   }
-  u8g2.sendBuffer();
-  delay(secdelay * 1000);
+  vHal_displaySendDirty();
 }
 
 /*******************************************************************************************
  * @brief function to draw the MICS6814 pollution sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ******************************************************************************************/
-void vHalDisplay_drawMICS6814PollutionSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay)
+void vHalDisplay_drawMICS6814PollutionSensorData(const displaySnapshot_t *snap)
 {
   //log_d("Printing MICS6814Sensor data on display...");
   char sensorStringData[SENSOR_DATA_STR_FMT_LEN] = {0};
 
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  if (p_tData->status.MICS6814Sensor)
+  vHal_displayDrawScrHead(snap);
+  if (snap->sensorStat.MICS6814Sensor)
   {
-    vGeneric_dspFloatToComma(p_tData->pollutionData.data.carbonMonoxide,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->co,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L1);
     u8g2.print("CO:  ");
     u8g2.print(sensorStringData);
     u8g2.print("ug/m3");
 
-    vGeneric_dspFloatToComma(p_tData->pollutionData.data.nitrogenDioxide,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->no2,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
     u8g2.print("NOx:  ");
     u8g2.print(sensorStringData);
     u8g2.print("ug/m3");
 
-    vGeneric_dspFloatToComma(p_tData->pollutionData.data.ammonia,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->nh3,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L3);
     u8g2.print("NH3:  ");
     u8g2.print(sensorStringData);
@@ -404,27 +458,24 @@ void vHalDisplay_drawMICS6814PollutionSensorData(sensorData_t *p_tData,systemSta
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L3);
     u8g2.print("NH3:--");
   }
-  u8g2.sendBuffer();
-  delay(secdelay * 1000);
+  vHal_displaySendDirty();
 }
 
 /******************************************************************************************
  * @brief function to draw the Ozone sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *****************************************************************************************/
-void vHalDisplay_drawOzoneSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay)
+void vHalDisplay_drawOzoneSensorData(const displaySnapshot_t *snap)
 {
   //log_d("Printing OzoneSensor data on display...");
   char sensorStringData[SENSOR_DATA_STR_FMT_LEN] = {0};
 
   // page 4
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  if (p_tData->status.O3Sensor)
+  vHal_displayDrawScrHead(snap);
+  if (snap->sensorStat.O3Sensor)
   {
-    vGeneric_dspFloatToComma(p_tData->ozoneData.ozone,sensorStringData,sizeof(sensorStringData));
+    vGeneric_dspFloatToComma(snap->ozone,sensorStringData,sizeof(sensorStringData));
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
     u8g2.print("O3:  ");
     u8g2.print(sensorStringData);
@@ -435,59 +486,31 @@ void vHalDisplay_drawOzoneSensorData(sensorData_t *p_tData,systemStatus_t *statP
     u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
     u8g2.print("O3:--");
   }
-  u8g2.sendBuffer();
-  delay(secdelay * 1000); 
+  vHal_displaySendDirty();
 }
 
 
 /************************************************************************************
  * @brief function to draw the MSP index data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
- * @param secdelay 
+ * @param snap
  ************************************************************************************/
-void vHalDisplay_drawMspIndexData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay)
+void vHalDisplay_drawMspIndexData(const displaySnapshot_t *snap)
 {
   //log_d("Printing OzoneSensor data on display...");
   char sensorStringData[SENSOR_DATA_STR_FMT_LEN] = {0};
 
   // page 4
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  vGeneric_dspFloatToComma(p_tData->MSP,sensorStringData,sizeof(sensorStringData));
+  vHal_displayDrawScrHead(snap);
+  vGeneric_dspFloatToComma(snap->msp,sensorStringData,sizeof(sensorStringData));
   u8g2.setCursor(MEAS_DISP_X_OFFSET, MEAS_DISP_Y_OFFSET_L2);
   u8g2.print("MSP:  ");
   u8g2.print(sensorStringData);
-  u8g2.sendBuffer();
-  delay(secdelay * 1000); 
+  vHal_displaySendDirty();
 }
 
 
 
-/*********************************************************************************
- * @brief function to draw the MICS6814 sensor values on the display.
- * 
- * @param redval 
- * @param oxval 
- * @param nh3val 
- * @param statPtr 
- * @param devinfoPtr 
- *********************************************************************************/
-void vHalDisplay_drawMicsValues(uint16_t redval, uint16_t oxval, uint16_t nh3val,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr)
-{
-  //log_d("MICS6814 stored base resistance values:");
-  //log_d("RED: %d | OX: %d | NH3: %d\n", redval, oxval, nh3val);
-  vHal_displayDrawScrHead(statPtr,devinfoPtr);
-  u8g2.setCursor(2, 28); u8g2.print("MICS6814 Res0 values:");
-  u8g2.setCursor(30, 39); u8g2.print("RED: " + String(redval));
-  u8g2.setCursor(30, 50); u8g2.print("OX: " + String(oxval));
-  u8g2.setCursor(30, 61); u8g2.print("NH3: " + String(nh3val));
-  u8g2.sendBuffer();
-  delay(5000);
-
-}
-
 /******************************************************************************************
  * @brief Update display status with network events
  * 
@@ -503,15 +526,9 @@ void updateDisplayStatus(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus
         return;
     }
 
-    displayData_t localDisplayData = {};
-    localDisplayData.currentEvent = event;
+    vTaskDisplay_publishStatus(sysStatus, devInfo);
 
-    vMspOs_takeDataAccessMutex();
-    localDisplayData.devInfo = *devInfo;
-    localDisplayData.sysStat = *sysStatus;
-    vMspOs_giveDataAccessMutex();
-
-    tTaskDisplay_sendEvent(&localDisplayData);
+    tTaskDisplay_sendEvent(event);
 }
 
 /******************************************************************************************
@@ -531,23 +548,14 @@ void vMsp_updateDataAndSendEvent(displayEvents_t event,
                                 systemData_t *sysData,
                                 systemStatus_t *sysStat)
 {
-  displayData_t localDisplayData = {};
-  localDisplayData.currentEvent = event;
-
-  vMspOs_takeDataAccessMutex();
-
   if (event == DISP_EVENT_SHOW_MEAS_DATA)
   {
-    localDisplayData.sensorData = *sensorData;
+    vTaskDisplay_publishSensors(sensorData);
   }
-  localDisplayData.devInfo = *devInfo;
-  localDisplayData.measStat = *measStat;
-  localDisplayData.sysData = *sysData;
-  localDisplayData.sysStat = *sysStat;
-
-  vMspOs_giveDataAccessMutex();
+  vTaskDisplay_publishStatus(sysStat, devInfo);
+  vTaskDisplay_publishSystem(sysData, measStat);
 
-  tTaskDisplay_sendEvent(&localDisplayData);
+  tTaskDisplay_sendEvent(event);
 }
 
 //************************************** EOF **************************************
\ No newline at end of file
@@ -32,17 +32,15 @@ void vHalDisplay_initSerialAndI2c(void);
  * 
  * @param fwver 
  *****************************************************/
-void vHalDisplay_DrawBoot(String *fwver);
+void vHalDisplay_DrawBoot(const char *fwver);
 
 /*******************************************************
 * @brief draws a text line on the U8G2 display
 * 
 * @param message 
-* @param secdelay 
-* @param statPtr 
-* @param devinfoPtr 
+* @param snap
 *******************************************************/
-void vHalDisplay_drawLine(const char message[], short secdelay,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr);
+void vHalDisplay_drawLine(const char message[], const displaySnapshot_t *snap);
 
 
 /********************************************************
@@ -50,78 +48,53 @@ void vHalDisplay_drawLine(const char message[], short secdelay,systemStatus_t *s
  * 
  * @param message1 
  * @param message2 
- * @param secdelay 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ********************************************************/
-void vHalDisplay_drawTwoLines(const char message1[], const char message2[], short secdelay, systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr);
+void vHalDisplay_drawTwoLines(const char message1[], const char message2[], const displaySnapshot_t *snap);
 
 /*******************************************************
- * @brief draws a countdown on the U8G2 display
+ * @brief draws one tick of a countdown on the U8G2 display
  * 
- * @param startsec 
+ * @param remainsec 
  * @param message 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *******************************************************/
-void vHalDisplay_drawCountdown(short startsec, const char message[],systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr);
-
-/*********************************************************************************
- * @brief function to draw the MICS6814 sensor values on the display.
- * 
- * @param redval 
- * @param oxval 
- * @param nh3val 
- * @param statPtr 
- * @param devinfoPtr 
- *********************************************************************************/
-void vHalDisplay_drawMicsValues(uint16_t redval, uint16_t oxval, uint16_t nh3val,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr);
+void vHalDisplay_drawCountdown(short remainsec, const char message[], const displaySnapshot_t *snap);
 
 /*********************************************************************************
  * @brief function to draw the BME680 gas sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ********************************************************************************/
-void vHalDisplay_drawBme680GasSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay);
+void vHalDisplay_drawBme680GasSensorData(const displaySnapshot_t *snap);
 
 /*********************************************************************************
  * @brief function to draw the PMS5003 air quality sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *********************************************************************************/
-void vHalDisplay_drawPMS5003AirQualitySensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay);
+void vHalDisplay_drawPMS5003AirQualitySensorData(const displaySnapshot_t *snap);
 
 /*******************************************************************************************
  * @brief function to draw the MICS6814 pollution sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  ******************************************************************************************/
-void vHalDisplay_drawMICS6814PollutionSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay);
+void vHalDisplay_drawMICS6814PollutionSensorData(const displaySnapshot_t *snap);
 
 /******************************************************************************************
  * @brief function to draw the Ozone sensor data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
+ * @param snap
  *****************************************************************************************/
-void vHalDisplay_drawOzoneSensorData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay);
+void vHalDisplay_drawOzoneSensorData(const displaySnapshot_t *snap);
 
 /******************************************************************************************
  * @brief draws the MSP index data on the display.
  * 
- * @param p_tData 
- * @param statPtr 
- * @param devinfoPtr 
- * @param secdelay 
+ * @param snap
  ******************************************************************************************/
-void vHalDisplay_drawMspIndexData(sensorData_t *p_tData,systemStatus_t *statPtr, deviceNetworkInfo_t *devinfoPtr, short secdelay);
+void vHalDisplay_drawMspIndexData(const displaySnapshot_t *snap);
 
 /******************************************************************************************
  * @brief Update display status with network events
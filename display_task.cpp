@@ -13,10 +13,11 @@
 #include "config.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/queue.h"
 #include "freertos/event_groups.h"
+#include "freertos/semphr.h"
 #include "display_task.h"
 #include "display.h"
+#include "shared_state.h"
 
 //--------------------------------------------------------------------------------------------------
 //------------------ DISPLAY TASK SECTION ----------------------------------------------------------
@@ -24,65 +25,661 @@
 
 // -- defines --
 // Task configuration - public values defined in display_task.h
-#define DISP_QUEUE_LENGTH 5  // Internal queue configuration
-#define DISP_QUEUE_ITEM_SIZE sizeof(displayData_t)
-#define DISP_QUEUE_SIZE (DISP_QUEUE_LENGTH * DISP_QUEUE_ITEM_SIZE)
+#define DISP_MIN_FRAME_MS 50 // a full SH1106 frame takes ~25 ms on the 400 kHz bus
+
+// -- screen classes: a newer event of a class supersedes the pending one
+typedef enum _DISP_CLASS_
+{
+  DISP_CLASS_BOOT = 0,
+  DISP_CLASS_SD_CARD,
+  DISP_CLASS_CONFIG,
+  DISP_CLASS_BME680,
+  DISP_CLASS_PMS5003,
+  DISP_CLASS_MICS6814,
+  DISP_CLASS_O3,
+  DISP_CLASS_NETWORK,
+  DISP_CLASS_DATETIME,
+  DISP_CLASS_PROGRESS,
+  DISP_CLASS_MEAS_DATA,
+  DISP_CLASS_SYSTEM_ERROR,
+  DISP_CLASS_NUM
+} displayClass_t;
 
 // Static task variables
 StackType_t displayTaskStack[DISPLAY_TASK_STACK_SIZE];
 StaticTask_t displayTaskBuffer;
 TaskHandle_t displayTaskHandle = NULL;
 
-// -- queue handle --
-static QueueHandle_t displayTaskQueue; /*!< DISPLAY Task Events queue */
+// -- newest pending event per screen class, DISP_EVENT_WAIT_FOR_EVENT when none --
+static portMUX_TYPE pendingMux = portMUX_INITIALIZER_UNLOCKED;
+static displayEvents_t pendingEvent[DISP_CLASS_NUM];
+static uint32_t pendingOrder[DISP_CLASS_NUM]; // arrival stamp, the oldest class is drawn first
+static uint32_t arrivals = 0;
+static uint32_t coalescedEvents = 0;
 
 // -- finite state machine --
 state_machine_t dispFSM;
 
-// -- display data instance --
-static displayData_t data{};
+// -- latest published state, written by the main and network tasks without waiting on the display --
+static displaySnapshot_t snapshotSlots[2]{};
+static sharedState_t snapshotState = SHARED_STATE_INITIALIZER("display snapshot", snapshotSlots[0], snapshotSlots[1]);
+
+// -- display task copy of the state --
+static displaySnapshot_t data{};
+static uint32_t dataSeq = 0;
 
 #define EVENT_WAIT_TIMEOUT 1000
 #define RESET_TIMEOUT 10
 #define GENERIC_DISP_TIMEOUT 1
+#define MS_IN_SEC 1000
 #define FIRST_ROW_LEN 17
 #define SECOND_ROW_LEN 22
 #define SECONDS_IN_MIN 60
 #define MEAS_DATA_TIMEOUT 3
+#define MEAS_PAGE_NUM 5
+
+// -- measurement carousel, one page per MEAS_DATA_TIMEOUT --
+static void (*const measPages[MEAS_PAGE_NUM])(const displaySnapshot_t *) = {
+    vHalDisplay_drawBme680GasSensorData,
+    vHalDisplay_drawPMS5003AirQualitySensorData,
+    vHalDisplay_drawMICS6814PollutionSensorData,
+    vHalDisplay_drawOzoneSensorData,
+    vHalDisplay_drawMspIndexData,
+};
+
+// -- countdown text on screen, empty when another screen is --
+static char shownRows[FIRST_ROW_LEN + SECOND_ROW_LEN] = {0};
 
 /*********************************************************
- * @brief function to initialize the display task queue.
+ * @brief function to initialize the display task mailbox.
  *
  *********************************************************/
 void vTaskDisplay_initDataQueue(void)
 {
-  if (displayTaskQueue == NULL)
+  log_i("Display mailbox: %u classes x %u bytes, snapshot %u bytes", (unsigned)DISP_CLASS_NUM,
+        (unsigned)(sizeof(displayEvents_t) + sizeof(uint32_t)), (unsigned)sizeof(displaySnapshot_t));
+}
+
+/******************************************************************
+ * @brief publish the header state and network texts
+ *
+ * @param sysStat
+ * @param devInfo
+ ******************************************************************/
+void vTaskDisplay_publishStatus(const systemStatus_t *sysStat, const deviceNetworkInfo_t *devInfo)
+{
+  displaySnapshot_t &latest = *(displaySnapshot_t *)pvSharedState_beginWrite(&snapshotState);
+  latest.sdCard = sysStat->sdCard;
+  latest.datetime = sysStat->datetime;
+  latest.connection = sysStat->connection;
+  latest.useModem = sysStat->use_modem;
+  strlcpy(latest.deviceId, devInfo->deviceid.c_str(), sizeof(latest.deviceId));
+  strlcpy(latest.baseMac, devInfo->baseMacChr, sizeof(latest.baseMac));
+  strlcpy(latest.noNet, devInfo->noNet.c_str(), sizeof(latest.noNet));
+  strlcpy(latest.remain, devInfo->remain.c_str(), sizeof(latest.remain));
+  vSharedState_endWrite(&snapshotState);
+}
+
+/******************************************************************
+ * @brief publish the firmware version, date/time and measurement
+ *        countdown
+ *
+ * @param sysData
+ * @param measStat
+ ******************************************************************/
+void vTaskDisplay_publishSystem(const systemData_t *sysData, const deviceMeasurement_t *measStat)
+{
+  displaySnapshot_t &latest = *(displaySnapshot_t *)pvSharedState_beginWrite(&snapshotState);
+  strlcpy(latest.fwVersion, sysData->ver.c_str(), sizeof(latest.fwVersion));
+  strlcpy(latest.dateTime, sysData->currentDataTime.c_str(), sizeof(latest.dateTime));
+  latest.measurementCount = measStat->measurement_count;
+  latest.maxMeasurements = measStat->max_measurements;
+  latest.delayBetweenMeasurements = measStat->delay_between_measurements;
+  latest.timeoutSeconds = measStat->timeout_seconds;
+  vSharedState_endWrite(&snapshotState);
+}
+
+/******************************************************************
+ * @brief publish the values of the measurement pages
+ *
+ * @param sensorData
+ ******************************************************************/
+void vTaskDisplay_publishSensors(const sensorData_t *sensorData)
+{
+  displaySnapshot_t &latest = *(displaySnapshot_t *)pvSharedState_beginWrite(&snapshotState);
+  latest.sensorStat = sensorData->status;
+  latest.temperature = sensorData->gasData.temperature;
+  latest.humidity = sensorData->gasData.humidity;
+  latest.pressure = sensorData->gasData.pressure;
+  latest.voc = sensorData->gasData.volatileOrganicCompounds;
+  latest.pm1 = sensorData->airQualityData.particleMicron1;
+  latest.pm25 = sensorData->airQualityData.particleMicron25;
+  latest.pm10 = sensorData->airQualityData.particleMicron10;
+  latest.co = sensorData->pollutionData.data.carbonMonoxide;
+  latest.no2 = sensorData->pollutionData.data.nitrogenDioxide;
+  latest.nh3 = sensorData->pollutionData.data.ammonia;
+  latest.ozone = sensorData->ozoneData.ozone;
+  latest.msp = sensorData->MSP;
+  vSharedState_endWrite(&snapshotState);
+}
+
+/******************************************************************
+ * @brief copy the latest state if it changed since @p seq
+ *
+ * @param snap  destination
+ * @param seq   sequence of the copy in @p snap, updated
+ * @return true a newer state was copied
+ ******************************************************************/
+bool bTaskDisplay_readSnapshot(displaySnapshot_t *snap, uint32_t *seq)
+{
+  return bSharedState_readIfChanged(&snapshotState, snap, seq);
+}
+
+/******************************************************************
+ * @brief map a display event to its screen class
+ *
+ * @param event
+ * @return uint8_t
+ ******************************************************************/
+static uint8_t uTaskDisplay_classOf(displayEvents_t event)
+{
+  switch (event)
+  {
+  case DISP_EVENT_DEVICE_BOOT:
+  case DISP_EVENT_WIFI_MAC_ADDR:
+    return DISP_CLASS_BOOT;
+  case DISP_EVENT_SD_CARD_INIT:
+  case DISP_EVENT_SD_CARD_NOT_PRESENT:
+  case DISP_EVENT_SD_CARD_FORMAT:
+  case DISP_EVENT_SD_CARD_LOG_ERROR:
+  case DISP_EVENT_SD_CARD_WRITE_DATA:
+  case DISP_EVENT_SD_CARD_SLOW:
+    return DISP_CLASS_SD_CARD;
+  case DISP_EVENT_CONFIG_READ:
+  case DISP_EVENT_URL_UPLOAD_STAT:
+  case DISP_EVENT_SD_CARD_CONFIG_CREATE:
+  case DISP_EVENT_SD_CARD_CONFIG_ERROR:
+  case DISP_EVENT_SD_CARD_CONFIG_INS_DATA:
+    return DISP_CLASS_CONFIG;
+  case DISP_EVENT_BME680_SENSOR_INIT:
+  case DISP_EVENT_BME680_SENSOR_OKAY:
+  case DISP_EVENT_BME680_SENSOR_ERR:
+    return DISP_CLASS_BME680;
+  case DISP_EVENT_PMS5003_SENSOR_INIT:
+  case DISP_EVENT_PMS5003_SENSOR_OKAY:
+  case DISP_EVENT_PMS5003_SENSOR_ERR:
+    return DISP_CLASS_PMS5003;
+  case DISP_EVENT_MICS6814_SENSOR_INIT:
+  case DISP_EVENT_MICS6814_SENSOR_OKAY:
+  case DISP_EVENT_MICS6814_VALUES_OKAY:
+  case DISP_EVENT_MICS6814_DEF_SETTING:
+  case DISP_EVENT_MICS6814_DONE:
+  case DISP_EVENT_MICS6814_SENSOR_ERR:
+    return DISP_CLASS_MICS6814;
+  case DISP_EVENT_O3_SENSOR_INIT:
+  case DISP_EVENT_O3_SENSOR_OKAY:
+  case DISP_EVENT_O3_SENSOR_ERR:
+    return DISP_CLASS_O3;
+  case DISP_EVENT_RETREIVE_DATETIME:
+  case DISP_EVENT_DATETIME_OK:
+  case DISP_EVENT_DATETIME:
+  case DISP_EVENT_DATETIME_ERR:
+    return DISP_CLASS_DATETIME;
+  case DISP_EVENT_WAIT_FOR_TIMEOUT:
+  case DISP_EVENT_READING_SENSORS:
+  case DISP_EVENT_PREHEAT_STAT:
+  case DISP_EVENT_MEAS_IN_PROGRESS:
+  case DISP_EVENT_SENDING_MEAS:
+    return DISP_CLASS_PROGRESS;
+  case DISP_EVENT_SHOW_MEAS_DATA:
+    return DISP_CLASS_MEAS_DATA;
+  case DISP_EVENT_SYSTEM_ERROR:
+    return DISP_CLASS_SYSTEM_ERROR;
+  default: // wifi, modem and connection states
+    return DISP_CLASS_NETWORK;
+  }
+}
+
+/******************************************************************
+ * @brief events shown as soon as they are sent, replacing a held
+ *        screen; the others wait for the hold to end, which for
+ *        the measurement carousel is the end of the current page
+ *
+ * @param event
+ * @return true
+ * @return false
+ ******************************************************************/
+static bool bTaskDisplay_isUrgent(displayEvents_t event)
+{
+  switch (event)
   {
-    displayTaskQueue = xQueueCreate(DISP_QUEUE_LENGTH, DISP_QUEUE_ITEM_SIZE);
+  case DISP_EVENT_SD_CARD_NOT_PRESENT:
+  case DISP_EVENT_SD_CARD_LOG_ERROR:
+  case DISP_EVENT_SD_CARD_WRITE_DATA:
+  case DISP_EVENT_NETWORK_CONN_FAIL:
+  case DISP_EVENT_WIFI_DISCONNECTED:
+  case DISP_EVENT_NO_INTERNET:
+  case DISP_EVENT_SIM_ERROR:
+  case DISP_EVENT_NETWORK_ERROR:
+  case DISP_EVENT_GPRS_ERROR:
+  case DISP_EVENT_SYSTEM_ERROR:
+    return true;
+  default:
+    return false;
   }
 }
 
 /******************************************************************
- * @brief function to send display events and data to the queue.
+ * @brief function to send display events to the task; the data
+ *        to show is published beforehand. Never blocks: an event
+ *        replaces a still pending one of the same screen class.
  *
- * @param data
+ * @param event
  * @return BaseType_t
  ******************************************************************/
-BaseType_t tTaskDisplay_sendEvent(displayData_t *data)
+BaseType_t tTaskDisplay_sendEvent(displayEvents_t event)
+{
+  if (event == DISP_EVENT_WAIT_FOR_EVENT)
+  {
+    return pdFALSE;
+  }
+
+  uint8_t cls = uTaskDisplay_classOf(event);
+
+  portENTER_CRITICAL(&pendingMux);
+  if (pendingEvent[cls] == DISP_EVENT_WAIT_FOR_EVENT)
+  {
+    pendingOrder[cls] = arrivals++;
+  }
+  else
+  {
+    coalescedEvents++;
+  }
+  pendingEvent[cls] = event;
+  portEXIT_CRITICAL(&pendingMux);
+
+  if (displayTaskHandle != NULL) // events sent before the task starts wait in the mailbox
+  {
+    xTaskNotifyGive(displayTaskHandle);
+  }
+  return pdTRUE;
+}
+
+/**********************************************************************
+ * @brief take the pending event to draw next: urgent ones first, then
+ *        the oldest screen class
+ *
+ * @param event
+ * @param urgentOnly leave non urgent events pending
+ * @return true an event was taken
+ **********************************************************************/
+static bool bTaskDisplay_takePending(displayEvents_t *event, bool urgentOnly)
 {
-  return (BaseType_t)xQueueSend(displayTaskQueue, data, 0);
+  int best = -1;
+  bool bestUrgent = false;
+
+  portENTER_CRITICAL(&pendingMux);
+  for (int cls = 0; cls < DISP_CLASS_NUM; cls++)
+  {
+    if (pendingEvent[cls] == DISP_EVENT_WAIT_FOR_EVENT)
+    {
+      continue;
+    }
+    bool urgent = bTaskDisplay_isUrgent(pendingEvent[cls]);
+    if ((urgentOnly && !urgent) || (bestUrgent && !urgent))
+    {
+      continue;
+    }
+    // unsigned difference keeps the order across the stamp wrap
+    if ((best < 0) || (urgent && !bestUrgent) || ((int32_t)(pendingOrder[cls] - pendingOrder[best]) < 0))
+    {
+      best = cls;
+      bestUrgent = urgent;
+    }
+  }
+  if (best >= 0)
+  {
+    *event = pendingEvent[best];
+    pendingEvent[best] = DISP_EVENT_WAIT_FOR_EVENT;
+  }
+  portEXIT_CRITICAL(&pendingMux);
+  return (best >= 0);
 }
 
 /**********************************************************************
- * @brief function to receive display events and data from the queue.
+ * @brief function to receive display events, urgent ones first, then
+ *        the oldest screen class, each with the newest event sent
+ *        for it.
  *
- * @param data
+ * @param event
  * @param xTicksToWait
+ * @param urgentOnly leave non urgent events pending
  * @return BaseType_t
  **********************************************************************/
-BaseType_t tTaskDisplay_receiveEvent(displayData_t *data, TickType_t xTicksToWait)
+BaseType_t tTaskDisplay_receiveEvent(displayEvents_t *event, TickType_t xTicksToWait, bool urgentOnly)
 {
-  return xQueueReceive(displayTaskQueue, data, xTicksToWait);
+  TickType_t start = xTaskGetTickCount();
+  while (!bTaskDisplay_takePending(event, urgentOnly))
+  {
+    TickType_t waited = xTaskGetTickCount() - start;
+    if (waited >= xTicksToWait)
+    {
+      return pdFALSE;
+    }
+    ulTaskNotifyTake(pdTRUE, xTicksToWait - waited);
+  }
+  return pdTRUE;
+}
+
+/******************************************************************
+ * @brief draw the screen of a display event
+ *
+ * @param event
+ * @param snap      state to draw
+ * @param measPage  next measurement carousel page, advanced by SHOW_MEAS_DATA
+ * @return uint32_t how long the screen stays up in ms, 0 when it may
+ *         be replaced at once
+ ******************************************************************/
+uint32_t uTaskDisplay_drawScreen(displayEvents_t event, const displaySnapshot_t *snap, uint8_t *measPage)
+{
+  uint32_t holdMs = GENERIC_DISP_TIMEOUT * MS_IN_SEC;
+
+  if (event != DISP_EVENT_WAIT_FOR_TIMEOUT)
+  {
+    shownRows[0] = '\0';
+  }
+
+  switch (event)
+  {
+  // set up cases
+  case DISP_EVENT_DEVICE_BOOT:
+  {
+    vHalDisplay_DrawBoot(snap->fwVersion);
+    holdMs = 0;
+    break;
+  }
+  case DISP_EVENT_WIFI_MAC_ADDR:
+  {
+    vHalDisplay_drawTwoLines("WIFI MAC ADDRESS:", snap->baseMac, snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_INIT:
+  {
+    vHalDisplay_drawTwoLines("Initializing", "SD Card...", snap);
+    break;
+  }
+  case DISP_EVENT_CONFIG_READ:
+  {
+    vHalDisplay_drawTwoLines("SD Card ok!", "Reading config...", snap);
+    break;
+  }
+  case DISP_EVENT_URL_UPLOAD_STAT:
+  {
+    vHalDisplay_drawTwoLines("No URL defined!", "No upload!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_NOT_PRESENT:
+  {
+    vHalDisplay_drawTwoLines("No SD Card!", "No web!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_FORMAT:
+  {
+    vHalDisplay_drawTwoLines("SD Card format!", "No web!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_LOG_ERROR:
+  {
+    vHalDisplay_drawTwoLines("SD Card log", "error!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_CONFIG_CREATE:
+  {
+    vHalDisplay_drawTwoLines("No cfg found!", "Creating...", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_CONFIG_ERROR:
+  {
+    vHalDisplay_drawTwoLines("Cfg error!", "No web!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_CONFIG_INS_DATA:
+  {
+    vHalDisplay_drawTwoLines("Done! Please", "insert data!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_WRITE_DATA:
+  {
+    vHalDisplay_drawTwoLines("Error while", "writing SD Card!", snap);
+    break;
+  }
+  case DISP_EVENT_SD_CARD_SLOW:
+  {
+    vHalDisplay_drawTwoLines("SD Card slow!", "Replace card", snap);
+    break;
+  }
+  case DISP_EVENT_BME680_SENSOR_INIT:
+  {
+    vHalDisplay_drawTwoLines("Detecting BME680...", "", snap);
+    break;
+  }
+  case DISP_EVENT_BME680_SENSOR_OKAY:
+  {
+    vHalDisplay_drawTwoLines("Detecting BME680...", "BME680 -> Ok!", snap);
+    break;
+  }
+  case DISP_EVENT_BME680_SENSOR_ERR:
+  {
+    vHalDisplay_drawTwoLines("Detecting BME680...", "BME680 -> Err!", snap);
+    break;
+  }
+  case DISP_EVENT_PMS5003_SENSOR_INIT:
+  {
+    vHalDisplay_drawTwoLines("Detecting PMS5003...", "", snap);
+    break;
+  }
+  case DISP_EVENT_PMS5003_SENSOR_OKAY:
+  {
+    vHalDisplay_drawTwoLines("Detecting PMS5003...", "PMS5003 -> Ok!", snap);
+    break;
+  }
+  case DISP_EVENT_PMS5003_SENSOR_ERR:
+  {
+    vHalDisplay_drawTwoLines("Detecting PMS5003...", "PMS5003 -> Err!", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_SENSOR_INIT:
+  {
+    vHalDisplay_drawTwoLines("Detecting MICS6814...", "", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_SENSOR_OKAY:
+  {
+    vHalDisplay_drawTwoLines("Detecting MICS6814...", "MICS6814 -> Ok!", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_VALUES_OKAY:
+  {
+    vHalDisplay_drawLine("MICS6814 values OK!", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_DEF_SETTING:
+  {
+    vHalDisplay_drawLine("Setting MICS6814...", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_DONE:
+  {
+    vHalDisplay_drawLine("Done!", snap);
+    break;
+  }
+  case DISP_EVENT_MICS6814_SENSOR_ERR:
+  {
+    vHalDisplay_drawTwoLines("Detecting MICS6814...", "MICS6814 -> Err!", snap);
+    break;
+  }
+  case DISP_EVENT_O3_SENSOR_INIT:
+  {
+    vHalDisplay_drawTwoLines("Detecting O3...", "", snap);
+    break;
+  }
+  case DISP_EVENT_O3_SENSOR_OKAY:
+  {
+    vHalDisplay_drawTwoLines("Detecting O3...", "O3 -> Ok!", snap);
+    break;
+  }
+  case DISP_EVENT_O3_SENSOR_ERR:
+  {
+    vHalDisplay_drawTwoLines("Detecting O3...", "O3 -> Err!", snap);
+    break;
+  }
+  // loop cases
+  case DISP_EVENT_WAIT_FOR_NETWORK_CONN:
+  {
+    vHalDisplay_drawTwoLines("Network", "Wait for connection", snap);
+    break;
+  }
+  case DISP_EVENT_NETWORK_CONN_FAIL:
+  {
+    vHalDisplay_drawTwoLines("Network Error", "Failed to connect", snap);
+    break;
+  }
+  case DISP_EVENT_READING_SENSORS:
+  {
+    vHalDisplay_drawTwoLines("Timeout Expired", "Reading Sensors", snap);
+    break;
+  }
+  case DISP_EVENT_WAIT_FOR_TIMEOUT:
+  {
+    char firstRow[FIRST_ROW_LEN] = {0};
+    char secondRow[SECOND_ROW_LEN] = {0};
+    sprintf(firstRow, "meas:%d of %d", snap->measurementCount, snap->maxMeasurements);
+    sprintf(secondRow, "WAIT %02d:%02d sec", (snap->delayBetweenMeasurements - snap->timeoutSeconds) / SECONDS_IN_MIN, (snap->delayBetweenMeasurements - snap->timeoutSeconds) % SECONDS_IN_MIN);
+    char rows[sizeof(shownRows)];
+    snprintf(rows, sizeof(rows), "%s\n%s", firstRow, secondRow);
+    holdMs = 0;
+    if (strcmp(rows, shownRows) != 0) // same text as on screen: skip the frame
+    {
+      vHalDisplay_drawTwoLines(firstRow, secondRow, snap);
+      strlcpy(shownRows, rows, sizeof(shownRows));
+      holdMs = DISP_MIN_FRAME_MS; // pace frames to what the panel can show, events sent meanwhile coalesce
+    }
+    break;
+  }
+  case DISP_EVENT_PREHEAT_STAT:
+  {
+    // vHalDisplay_drawCountdown(PMS_PREHEAT_TIME_IN_SEC, "Preheating PMS5003...",snap);
+    holdMs = 0;
+    break;
+  }
+  case DISP_EVENT_MEAS_IN_PROGRESS:
+  {
+    vHalDisplay_drawTwoLines("Measurements", "in progress...", snap);
+    break;
+  }
+  case DISP_EVENT_SENDING_MEAS:
+  {
+    vHalDisplay_drawTwoLines("All measurements", "obtained, sending...", snap);
+    break;
+  }
+  case DISP_EVENT_SYSTEM_ERROR:
+  {
+    vHalDisplay_drawTwoLines("System in error!", "Waiting for reset...", snap);
+    holdMs = RESET_TIMEOUT * MS_IN_SEC;
+    break;
+  }
+  // network cases
+  case DISP_EVENT_CONN_TO_WIFI:
+  {
+    vHalDisplay_drawTwoLines("Connecting to", "WiFi...", snap);
+    break;
+  }
+  case DISP_EVENT_CONN_TO_GPRS:
+  {
+    vHalDisplay_drawTwoLines("Connecting to", "GPRS...", snap);
+    break;
+  }
+  case DISP_EVENT_RETREIVE_DATETIME:
+  {
+    vHalDisplay_drawTwoLines("Getting date&time...", "Please wait...", snap);
+    break;
+  }
+  case DISP_EVENT_DATETIME_OK:
+  {
+    vHalDisplay_drawTwoLines("Getting date&time...", "OK!", snap);
+    break;
+  }
+  case DISP_EVENT_DATETIME:
+  {
+    vHalDisplay_drawTwoLines("Date & Time:", snap->dateTime, snap);
+    break;
+  }
+  case DISP_EVENT_DATETIME_ERR:
+  {
+    vHalDisplay_drawTwoLines("Date & time err!", "Is internet ok?", snap);
+    break;
+  }
+  case DISP_EVENT_WIFI_CONNECTED:
+  {
+    holdMs = 0;
+    break;
+  }
+  case DISP_EVENT_WIFI_DISCONNECTED:
+  {
+    vHalDisplay_drawLine("WiFi connect err!", snap);
+    break;
+  }
+  case DISP_EVENT_SSID_NOT_FOUND:
+  {
+    vHalDisplay_drawLine(snap->noNet, snap);
+    break;
+  }
+  case DISP_EVENT_NO_NETWORKS_FOUND:
+  {
+    vHalDisplay_drawLine("No networks found!", snap);
+    break;
+  }
+  case DISP_EVENT_CONN_RETRY:
+  {
+    vHalDisplay_drawTwoLines("Retrying...", snap->remain, snap);
+    break;
+  }
+  case DISP_EVENT_NO_INTERNET:
+  {
+    vHalDisplay_drawLine("No internet!", snap);
+    break;
+  }
+
+  // modem
+  case DISP_EVENT_SIM_ERROR:
+  {
+    vHalDisplay_drawTwoLines("ERROR:", "NO SIM!", snap);
+    break;
+  }
+  case DISP_EVENT_NETWORK_ERROR:
+  {
+    vHalDisplay_drawTwoLines("ERROR:", "NO NETWORK!", snap);
+    break;
+  }
+  case DISP_EVENT_GPRS_ERROR:
+  {
+    vHalDisplay_drawTwoLines("ERROR:", "NO GPRS!", snap);
+    break;
+  }
+  // measurement data
+  case DISP_EVENT_SHOW_MEAS_DATA:
+  {
+    // one page per pass, the next one follows when its hold expires
+    measPages[*measPage](snap);
+    *measPage = (*measPage + 1) % MEAS_PAGE_NUM;
+    holdMs = MEAS_DATA_TIMEOUT * MS_IN_SEC;
+    break;
+  }
+  default:
+    holdMs = 0;
+    break;
+  }
+  return holdMs;
 }
 
 /*********************************************************************
@@ -93,6 +690,8 @@ BaseType_t tTaskDisplay_receiveEvent(displayData_t *data, TickType_t xTicksToWai
  *********************************************************************/
 void displayTask(void *pvParameters)
 {
+  (void)pvParameters;
+
   // init finite state machine
   dispFSM.current_state = DISP_EVENT_WAIT_FOR_EVENT;
   dispFSM.next_state = DISP_EVENT_WAIT_FOR_EVENT;
@@ -100,16 +699,60 @@ void displayTask(void *pvParameters)
   dispFSM.isFirstTransition = true;
 
   TickType_t eventWaitTimeout = pdMS_TO_TICKS(EVENT_WAIT_TIMEOUT); // 1 second timeout for waiting events
+  TickType_t holdUntil = xTaskGetTickCount(); // the screen on display stays up at least until then
+  uint8_t measPage = 0;                       // next carousel page, 0 when the carousel is not running
   displayEvents_t displayEvents = DISP_EVENT_WAIT_FOR_EVENT;
 
   while (1)
   {
+    uint32_t holdMs = 0; // how long a screen drawn in this pass stays up
+
     switch (dispFSM.current_state)
     {
     case DISP_EVENT_WAIT_FOR_EVENT:
     {
-      if (pdTRUE != tTaskDisplay_receiveEvent(&data, eventWaitTimeout))
+      BaseType_t received;
+      TickType_t now = xTaskGetTickCount();
+      if ((int32_t)(holdUntil - now) > 0)
+      {
+        // screen on hold: only urgent events replace it, the others keep coalescing
+        received = tTaskDisplay_receiveEvent(&displayEvents, holdUntil - now, true);
+        if (pdTRUE != received)
+        {
+          dispFSM.next_state = DISP_EVENT_WAIT_FOR_EVENT;
+          break;
+        }
+        measPage = 0; // a preempted carousel starts over
+      }
+      else if (measPage != 0)
+      {
+        // page hold over: a pending event takes over the carousel, otherwise the next page follows
+        received = tTaskDisplay_receiveEvent(&displayEvents, 0, false);
+        if (pdTRUE != received)
+        {
+          bTaskDisplay_readSnapshot(&data, &dataSeq);
+          dispFSM.next_state = DISP_EVENT_SHOW_MEAS_DATA;
+          break;
+        }
+        if (displayEvents != DISP_EVENT_SHOW_MEAS_DATA)
+        {
+          measPage = 0; // an interrupted carousel starts over
+        }
+      }
+      else
+      {
+        received = tTaskDisplay_receiveEvent(&displayEvents, eventWaitTimeout, false);
+      }
+      bTaskDisplay_readSnapshot(&data, &dataSeq); // screens draw the state as of now, not as of the send
+
+      if (pdTRUE != received)
       {
+        static uint32_t loggedCoalesced = 0;
+        if (coalescedEvents != loggedCoalesced)
+        {
+          loggedCoalesced = coalescedEvents;
+          log_d("Display: %lu events superseded before drawing", (unsigned long)loggedCoalesced);
+        }
         // check if we have received the first data
         if (!dispFSM.isFirstTransition)
         {
@@ -122,7 +765,6 @@ void displayTask(void *pvParameters)
       }
       else
       {
-        displayEvents = data.currentEvent;
         dispFSM.next_state = displayEvents;
         if (displayEvents == DISP_EVENT_SHOW_MEAS_DATA)
         {
@@ -131,328 +773,15 @@ void displayTask(void *pvParameters)
       }
       break;
     }
-    // set up cases
-    case DISP_EVENT_DEVICE_BOOT:
-    {
-      vHalDisplay_DrawBoot(&data.sysData.ver);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_WIFI_MAC_ADDR:
-    {
-      vHalDisplay_drawTwoLines("WIFI MAC ADDRESS:", data.devInfo.baseMacChr, GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_INIT:
-    {
-      vHalDisplay_drawTwoLines("Initializing", "SD Card...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_CONFIG_READ:
-    {
-      vHalDisplay_drawTwoLines("SD Card ok!", "Reading config...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_URL_UPLOAD_STAT:
-    {
-      vHalDisplay_drawTwoLines("No URL defined!", "No upload!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_NOT_PRESENT:
-    {
-      vHalDisplay_drawTwoLines("No SD Card!", "No web!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_FORMAT:
-    {
-      vHalDisplay_drawTwoLines("SD Card format!", "No web!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_LOG_ERROR:
-    {
-      vHalDisplay_drawTwoLines("SD Card log", "error!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_CONFIG_CREATE:
-    {
-      vHalDisplay_drawTwoLines("No cfg found!", "Creating...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_CONFIG_ERROR:
-    {
-      vHalDisplay_drawTwoLines("Cfg error!", "No web!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_CONFIG_INS_DATA:
-    {
-      vHalDisplay_drawTwoLines("Done! Please", "insert data!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SD_CARD_WRITE_DATA:
-    {
-      vHalDisplay_drawTwoLines("Error while", "writing SD Card!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_BME680_SENSOR_INIT:
-    {
-      vHalDisplay_drawTwoLines("Detecting BME680...", "", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_BME680_SENSOR_OKAY:
-    {
-      vHalDisplay_drawTwoLines("Detecting BME680...", "BME680 -> Ok!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_BME680_SENSOR_ERR:
-    {
-      vHalDisplay_drawTwoLines("Detecting BME680...", "BME680 -> Err!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_PMS5003_SENSOR_INIT:
-    {
-      vHalDisplay_drawTwoLines("Detecting PMS5003...", "", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_PMS5003_SENSOR_OKAY:
-    {
-      vHalDisplay_drawTwoLines("Detecting PMS5003...", "PMS5003 -> Ok!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_PMS5003_SENSOR_ERR:
-    {
-      vHalDisplay_drawTwoLines("Detecting PMS5003...", "PMS5003 -> Err!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_SENSOR_INIT:
-    {
-      vHalDisplay_drawTwoLines("Detecting MICS6814...", "", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_SENSOR_OKAY:
-    {
-      vHalDisplay_drawTwoLines("Detecting MICS6814...", "MICS6814 -> Ok!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_VALUES_OKAY:
-    {
-      vHalDisplay_drawLine("MICS6814 values OK!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_DEF_SETTING:
-    {
-      vHalDisplay_drawLine("Setting MICS6814...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_DONE:
-    {
-      vHalDisplay_drawLine("Done!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MICS6814_SENSOR_ERR:
-    {
-      vHalDisplay_drawTwoLines("Detecting MICS6814...", "MICS6814 -> Err!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_O3_SENSOR_INIT:
-    {
-      vHalDisplay_drawTwoLines("Detecting O3...", "", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_O3_SENSOR_OKAY:
-    {
-      vHalDisplay_drawTwoLines("Detecting O3...", "O3 -> Ok!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_O3_SENSOR_ERR:
-    {
-      vHalDisplay_drawTwoLines("Detecting O3...", "O3 -> Err!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    // loop cases
-    case DISP_EVENT_WAIT_FOR_NETWORK_CONN:
-    {
-      vHalDisplay_drawTwoLines("Network", "Wait for connection", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_NETWORK_CONN_FAIL:
-    {
-      vHalDisplay_drawTwoLines("Network Error", "Failed to connect", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_READING_SENSORS:
-    {
-      vHalDisplay_drawTwoLines("Timeout Expired", "Reading Sensors", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_WAIT_FOR_TIMEOUT:
-    {
-      char firstRow[FIRST_ROW_LEN] = {0};
-      char secondRow[SECOND_ROW_LEN] = {0};
-      sprintf(firstRow, "meas:%d of %d", data.measStat.measurement_count, data.measStat.max_measurements);
-      sprintf(secondRow, "WAIT %02d:%02d sec", (data.measStat.delay_between_measurements - data.measStat.timeout_seconds) / SECONDS_IN_MIN, (data.measStat.delay_between_measurements - data.measStat.timeout_seconds) % SECONDS_IN_MIN);
-      vHalDisplay_drawTwoLines(firstRow, secondRow, 0, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_PREHEAT_STAT:
-    {
-      // vHalDisplay_drawCountdown(PMS_PREHEAT_TIME_IN_SEC, "Preheating PMS5003...",&data.sysStat,&data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_MEAS_IN_PROGRESS:
-    {
-      vHalDisplay_drawTwoLines("Measurements", "in progress...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SENDING_MEAS:
-    {
-      vHalDisplay_drawTwoLines("All measurements", "obtained, sending...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SYSTEM_ERROR:
-    {
-      vHalDisplay_drawTwoLines("System in error!", "Waiting for reset...", RESET_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    // network cases
-    case DISP_EVENT_CONN_TO_WIFI:
-    {
-      vHalDisplay_drawTwoLines("Connecting to", "WiFi...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_CONN_TO_GPRS:
-    {
-      vHalDisplay_drawTwoLines("Connecting to", "GPRS...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_RETREIVE_DATETIME:
-    {
-      vHalDisplay_drawTwoLines("Getting date&time...", "Please wait...", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_DATETIME_OK:
-    {
-      vHalDisplay_drawTwoLines("Getting date&time...", "OK!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_DATETIME:
-    {
-      vHalDisplay_drawTwoLines("Date & Time:", data.sysData.currentDataTime.c_str(), GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_DATETIME_ERR:
-    {
-      vHalDisplay_drawTwoLines("Date & time err!", "Is internet ok?", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_WIFI_CONNECTED:
-    {
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_WIFI_DISCONNECTED:
-    {
-      vHalDisplay_drawLine("WiFi connect err!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_SSID_NOT_FOUND:
-    {
-      vHalDisplay_drawLine(data.devInfo.noNet.c_str(), GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_NO_NETWORKS_FOUND:
-    {
-      vHalDisplay_drawLine("No networks found!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_CONN_RETRY:
-    {
-      vHalDisplay_drawTwoLines("Retrying...", data.devInfo.remain.c_str(), GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_NO_INTERNET:
-    {
-      vHalDisplay_drawLine("No internet!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-
-    // modem
-    case DISP_EVENT_SIM_ERROR:
-    {
-      vHalDisplay_drawTwoLines("ERROR:", "NO SIM!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_NETWORK_ERROR:
-    {
-      vHalDisplay_drawTwoLines("ERROR:", "NO NETWORK!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    case DISP_EVENT_GPRS_ERROR:
-    {
-      vHalDisplay_drawTwoLines("ERROR:", "NO GPRS!", GENERIC_DISP_TIMEOUT, &data.sysStat, &data.devInfo);
+    // screens
+    default:
+      holdMs = uTaskDisplay_drawScreen((displayEvents_t)dispFSM.current_state, &data, &measPage);
       dispFSM.next_state = dispFSM.return_state;
       break;
     }
-    // measurement data
-    case DISP_EVENT_SHOW_MEAS_DATA:
+    if (holdMs != 0)
     {
-      vHalDisplay_drawBme680GasSensorData(&data.sensorData, &data.sysStat, &data.devInfo, MEAS_DATA_TIMEOUT);
-      vHalDisplay_drawPMS5003AirQualitySensorData(&data.sensorData, &data.sysStat, &data.devInfo, MEAS_DATA_TIMEOUT);
-      vHalDisplay_drawMICS6814PollutionSensorData(&data.sensorData, &data.sysStat, &data.devInfo, MEAS_DATA_TIMEOUT);
-      vHalDisplay_drawOzoneSensorData(&data.sensorData, &data.sysStat, &data.devInfo, MEAS_DATA_TIMEOUT);
-      vHalDisplay_drawMspIndexData(&data.sensorData, &data.sysStat, &data.devInfo, MEAS_DATA_TIMEOUT);
-      dispFSM.next_state = dispFSM.return_state;
-      break;
-    }
-    // default case
-    default:
-      dispFSM.current_state = dispFSM.next_state = dispFSM.return_state;
+      holdUntil = xTaskGetTickCount() + pdMS_TO_TICKS(holdMs);
     }
     dispFSM.current_state = dispFSM.next_state;
   }
@@ -35,6 +35,7 @@ typedef enum _DISPLAY_EVENTS_
   DISP_EVENT_SD_CARD_CONFIG_ERROR,
   DISP_EVENT_SD_CARD_CONFIG_INS_DATA,
   DISP_EVENT_SD_CARD_WRITE_DATA,
+  DISP_EVENT_SD_CARD_SLOW,
 
   DISP_EVENT_BME680_SENSOR_INIT,
   DISP_EVENT_BME680_SENSOR_OKAY,
@@ -88,19 +89,51 @@ typedef enum _DISPLAY_EVENTS_
 
 } displayEvents_t;
 
-// -- display task queue data
-typedef struct _DISP_TASK_DATA_
+// -- display snapshot text sizes (incl. terminator, a 6x13 row holds 21 characters)
+#define DISP_TEXT_LEN 24
+#define DISP_MAC_LEN 18
+
+// -- latest state shown by the screens: trivially copyable, only the fields they draw
+typedef struct _DISP_SNAPSHOT_
 {
-  displayEvents_t currentEvent; /*!< Current event to be displayed */
-  sensorData_t sensorData;      /*!< Sensor data to be displayed */
-  systemStatus_t sysStat;       /*!< System status to be displayed */
-  deviceNetworkInfo_t devInfo;  /*!< Device network information to be displayed */
-  systemData_t sysData;         /*!< System data to be displayed */
-  deviceMeasurement_t measStat; /*!< Device measurement status to be displayed */
-} displayData_t;
+  // screen header
+  char deviceId[DISP_TEXT_LEN];
+  uint8_t sdCard;
+  uint8_t datetime;
+  uint8_t connection;
+  uint8_t useModem;
+
+  // text screens
+  char fwVersion[DISP_TEXT_LEN];
+  char baseMac[DISP_MAC_LEN];
+  char dateTime[DISP_TEXT_LEN];
+  char noNet[DISP_TEXT_LEN];
+  char remain[DISP_TEXT_LEN];
+
+  // measurement countdown
+  int32_t measurementCount;
+  int32_t maxMeasurements;
+  int32_t delayBetweenMeasurements;
+  uint32_t timeoutSeconds;
+
+  // measurement pages
+  peripheralStatus_t sensorStat;
+  float temperature;
+  float humidity;
+  float pressure;
+  float voc;
+  int32_t pm1;
+  int32_t pm25;
+  int32_t pm10;
+  float co;
+  float no2;
+  float nh3;
+  float ozone;
+  int8_t msp;
+} displaySnapshot_t;
 
 /*********************************************************
- * @brief function to initialize the display task queue.
+ * @brief function to initialize the display task mailbox.
  *
  *********************************************************/
 void vTaskDisplay_initDataQueue(void);
@@ -112,21 +145,70 @@ void vTaskDisplay_initDataQueue(void);
 void vTaskDisplay_createTask(void);
 
 /******************************************************************
- * @brief function to send display events and data to the queue.
+ * @brief publish the header state and network texts
+ *
+ * @param sysStat
+ * @param devInfo
+ ******************************************************************/
+void vTaskDisplay_publishStatus(const systemStatus_t *sysStat, const deviceNetworkInfo_t *devInfo);
+
+/******************************************************************
+ * @brief publish the firmware version, date/time and measurement
+ *        countdown
  *
- * @param data
+ * @param sysData
+ * @param measStat
+ ******************************************************************/
+void vTaskDisplay_publishSystem(const systemData_t *sysData, const deviceMeasurement_t *measStat);
+
+/******************************************************************
+ * @brief publish the values of the measurement pages
+ *
+ * @param sensorData
+ ******************************************************************/
+void vTaskDisplay_publishSensors(const sensorData_t *sensorData);
+
+/******************************************************************
+ * @brief copy the latest state if it changed since @p seq
+ *
+ * @param snap  destination
+ * @param seq   sequence of the copy in @p snap, updated
+ * @return true a newer state was copied
+ ******************************************************************/
+bool bTaskDisplay_readSnapshot(displaySnapshot_t *snap, uint32_t *seq);
+
+/******************************************************************
+ * @brief function to send display events to the task; the data
+ *        to show is published beforehand. Never blocks: an event
+ *        replaces a still pending one of the same screen class.
+ *
+ * @param event
  * @return BaseType_t
  ******************************************************************/
-BaseType_t tTaskDisplay_sendEvent(displayData_t *data);
+BaseType_t tTaskDisplay_sendEvent(displayEvents_t event);
 
 /**********************************************************************
- * @brief function to receive display events and data from the queue.
+ * @brief function to receive display events, urgent ones first, then
+ *        the oldest screen class, each with the newest event sent
+ *        for it.
  *
- * @param data
+ * @param event
  * @param xTicksToWait
+ * @param urgentOnly leave non urgent events pending
  * @return BaseType_t
  **********************************************************************/
-BaseType_t tTaskDisplay_receiveEvent(displayData_t *data, TickType_t xTicksToWait);
+BaseType_t tTaskDisplay_receiveEvent(displayEvents_t *event, TickType_t xTicksToWait, bool urgentOnly);
+
+/******************************************************************
+ * @brief draw the screen of a display event
+ *
+ * @param event
+ * @param snap      state to draw
+ * @param measPage  next measurement carousel page, advanced by SHOW_MEAS_DATA
+ * @return uint32_t how long the screen stays up in ms, 0 when it may
+ *         be replaced at once
+ ******************************************************************/
+uint32_t uTaskDisplay_drawScreen(displayEvents_t event, const displaySnapshot_t *snap, uint8_t *measPage);
 
 // ===== Configuration Macros =====
 
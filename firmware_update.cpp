@@ -14,10 +14,13 @@
 #include "display_task.h"
 #include "config.h"
 #include "mspOs.h"
+#include "log_journal.h"
+#include "ota_delta.h"
 #include <WiFi.h>
 #include <HTTPClient.h>
 #include <ArduinoJson.h>
 #include <SD.h>
+#include <Preferences.h>
 #include "esp32-hal-log.h"
 
 // ESP-IDF OTA includes
@@ -26,20 +29,20 @@
 #include "esp_heap_caps.h"
 #include "esp_system.h"
 #include "esp_app_format.h"
+#include "mbedtls/sha256.h"
+#include "esp32/rom/miniz.h"
 
 #ifdef ENABLE_ENHANCED_SECURITY
 #include "esp_secure_boot.h"
 #include "esp_flash_encrypt.h"
 #include "esp_efuse.h"
-#include "mbedtls/sha256.h"
 #include "mbedtls/rsa.h"
 #include "mbedtls/pk.h"
+#endif
 
 #define HASH_LENGTH 32
 #define FIRMWARE_MIN_VALID_LEN 1024
 
-#endif
-
 // GitHub API constants
 #define GITHUB_API_URL "https://api.github.com/repos/A-A-Milano-Smart-Park/msp-firmware/releases/latest"
 
@@ -51,15 +54,128 @@
 
 #define FIRMWARE_UPDATE_TIMEOUT_MS 60000
 #define DOWNLOAD_BUFFER_SIZE 2048 // Reduced from 8192 to prevent stack overflow
+#define DOWNLOAD_NO_DATA_TIMEOUT_MS 30000
+#define DOWNLOAD_MIN_FREE_HEAP 50000
+#define DOWNLOAD_PROGRESS_STEP (64 * 1024)
+#define SD_INSTALL_BLOCK_SIZE (16 * 1024) // card read / flash write unit of an SD install
+#define SD_INSTALL_BUFFERS 2
+#define SD_INSTALL_END 0xFF              // writer task exit marker
+#define SD_INSTALL_WRITER_STACK_SIZE 4096
+
+#define FIRMWARE_STAGED_PATH "/firmware.bin" // installed from the card at boot
+#define FIRMWARE_HASH_SUFFIX ".sha256"       // release asset next to update_<tag>.bin
+#define FIRMWARE_DELTA_SUFFIX ".patch"       // update_<tag>_from_<running tag>.patch
+#define FIRMWARE_SECTOR_SIZE 4096            // flash erase unit
+#define FW_RESUME_VERSION 1
+#define FW_RESUME_MAX_CHUNKS 64              // 4 MB of image in FW_RESUME_CHUNK_SIZE chunks
+
+// -- state of a firmware image being streamed into the next OTA partition
+typedef struct
+{
+    const esp_partition_t *partition;
+    esp_ota_handle_t handle;
+    mbedtls_sha256_context sha;
+    esp_image_header_t header; // first bytes of the image, checked once complete
+    size_t headerLen;
+    size_t written;                         // bytes flashed, always a multiple of FIRMWARE_SECTOR_SIZE until the tail
+    size_t pending;                         // bytes in sector not flashed yet
+    uint32_t chunkCrc;                      // CRC of the current chunk so far
+    uint8_t sector[FIRMWARE_SECTOR_SIZE];
+} otaStream_t;
+
+// -- interrupted download, kept in NVS at each completed chunk
+typedef struct
+{
+    uint16_t version;
+    uint16_t size;
+    char url[192];
+    char etag[64];             // validator sent back in If-Range
+    uint32_t partitionAddress;
+    uint32_t totalSize;        // 0 while unknown
+    uint32_t committed;        // bytes flashed and covered by chunkCrc
+    uint32_t resumes;
+    uint32_t bytesTransferred; // over all attempts, for the throughput log
+    uint32_t msTransferring;
+    uint32_t chunkCrc[FW_RESUME_MAX_CHUNKS];
+} fwResumeCheckpoint_t;
+
+// -- delta patch being inflated and applied into an otaStream_t
+typedef struct
+{
+    tinfl_decompressor inflator;
+    uint8_t dict[TINFL_LZ_DICT_SIZE]; // inflate output ring, also the LZ window
+    size_t dictOfs;
+    ota_delta_apply_t apply;
+    const esp_partition_t *running;   // image the patch applies to
+    otaStream_t *ota;
+    fwResumeCheckpoint_t *ckpt;
+} deltaPatch_t;
+
+// -- SD image install shared between the card reader and the flash writer task
+typedef struct
+{
+    esp_ota_handle_t handle;
+    QueueHandle_t filled; // buffer indexes ready to flash, then SD_INSTALL_END
+    QueueHandle_t free;   // buffer indexes ready to read into
+    uint8_t *buf[SD_INSTALL_BUFFERS];
+    size_t len[SD_INSTALL_BUFFERS];
+    esp_err_t err;        // first write error, later buffers are skipped
+    unsigned long writeUs;
+    TaskHandle_t reader;  // notified when the writer exits
+} sdInstall_t;
+
+// -- ArduinoJson reader counting the bytes pulled from the response body
+struct countingReader_t
+{
+    Stream &in;
+    size_t count;
+
+    int read()
+    {
+        int c = in.read();
+        if (c >= 0)
+        {
+            count++;
+        }
+        return c;
+    }
+
+    size_t readBytes(char *buffer, size_t length)
+    {
+        size_t n = in.readBytes(buffer, length);
+        count += n;
+        return n;
+    }
+};
+
+static uint8_t downloadBuffer[DOWNLOAD_BUFFER_SIZE]; // Static to avoid stack allocation
+static bool downloadResumable = false;   // last download failed with a checkpoint worth resuming
+static unsigned long resumeNotBeforeMs = 0;
 
 static String extractVersionFromTag(const String &tag);
+static String loadReleaseEtag(const String &version);
+static void storeReleaseEtag(const String &version, const String &etag);
+static bool isDeltaPatchRejected(const String &patchUrl);
+static void rejectDeltaPatch(const String &patchUrl);
 static bool downloadFile(const String &url, const String &filepath);
+static int openDownload(HTTPClient &http, const String &url, WiFiClientSecure **secureClient, bool *usedSpiram,
+                        uint32_t rangeStart = 0, const String &ifRange = "");
+static void freeSecureClient(WiFiClientSecure *secureClient, bool usedSpiram);
+static String fetchExpectedHash(const String &hashUrl);
+static bool streamFirmwareToOta(const String &url, const String &expectedHash, const String &patchUrl);
+static bool flashImageFromFile(File &file, size_t size, esp_ota_handle_t handle);
 
 /**
  * @brief Check for firmware updates on GitHub
  */
 bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo)
 {
+    // An interrupted download is picked up on a later pass, not on every call
+    if (downloadResumable && ((long)(millis() - resumeNotBeforeMs) < 0))
+    {
+        return false;
+    }
+
     log_i("Checking for firmware updates...");
 
     // Ensure we have internet connection
@@ -72,6 +188,7 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
 
     HTTPClient http;
     http.setTimeout(FIRMWARE_UPDATE_TIMEOUT_MS);
+    http.useHTTP10(true); // plain body without chunk framing, so it can be parsed straight off the socket
 
     if (!http.begin(GITHUB_API_URL))
     {
@@ -82,8 +199,25 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
     http.addHeader("User-Agent", "MilanoSmartPark-ESP32");
     http.addHeader("Accept", "application/vnd.github.v3+json");
 
+    // Unchanged release JSON already checked against this version: GitHub answers 304 with no body
+    String cachedEtag = loadReleaseEtag(sysData->ver);
+    if (!cachedEtag.isEmpty())
+    {
+        http.addHeader("If-None-Match", cachedEtag);
+    }
+    const char *responseHeaders[] = {"ETag"};
+    http.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+
+    size_t heapBefore = ESP.getFreeHeap();
     int httpCode = http.GET();
 
+    if (httpCode == HTTP_CODE_NOT_MODIFIED)
+    {
+        log_i("Latest release unchanged since the last check, current version is up to date");
+        http.end();
+        return true;
+    }
+
     if (httpCode != HTTP_CODE_OK)
     {
         log_e("GitHub API request failed with code: %d", httpCode);
@@ -91,14 +225,25 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
         return false;
     }
 
-    String payload = http.getString();
-    http.end();
+    String etag = http.header("ETag");
 
-    log_d("GitHub API response: %s", payload.substring(0, 200).c_str());
+    // Parse the release JSON as it arrives, keeping only the fields used below
+    JsonDocument filter;
+    filter["tag_name"] = true;
+    filter["assets"][0]["name"] = true;
+    filter["assets"][0]["browser_download_url"] = true;
 
-    // Parse JSON response
-    DynamicJsonDocument doc(8192);
-    DeserializationError error = deserializeJson(doc, payload);
+    JsonDocument doc;
+    countingReader_t body = {http.getStream(), 0};
+    size_t heapBeforeParse = ESP.getFreeHeap();
+    DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(filter));
+    size_t heapAfterParse = ESP.getFreeHeap();
+    int contentLength = http.getSize();
+    http.end();
+
+    log_i("Release JSON: %u bytes read (Content-Length %d), filtered document %d bytes, free heap %u before the request, %u after the parse",
+          (unsigned)body.count, contentLength, (int)(heapBeforeParse - heapAfterParse), (unsigned)heapBefore,
+          (unsigned)heapAfterParse);
 
     if (error)
     {
@@ -114,6 +259,8 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
     // Look for the direct binary file (update_vX.X.X.bin)
     JsonArray assets = doc["assets"];
     String binaryFileName = "update_" + latestTag + ".bin";
+    String patchUrl = "";
+    String patchFileName = "update_" + latestTag + "_from_" + sysData->ver + FIRMWARE_DELTA_SUFFIX;
 
     for (JsonObject asset : assets)
     {
@@ -124,13 +271,24 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
         {
             downloadUrl = url;
             log_i("Found application binary: %s", name.c_str());
-            break;
         }
+        else if (name == patchFileName)
+        {
+            patchUrl = url;
+            log_i("Found delta patch: %s", name.c_str());
+        }
+    }
+
+    if (!patchUrl.isEmpty() && isDeltaPatchRejected(patchUrl))
+    {
+        log_w("Skipping delta patch %s: its image failed verification before", patchFileName.c_str());
+        patchUrl = "";
     }
 
     if (downloadUrl.isEmpty())
     {
         log_e("No application binary (%s) found in release assets", binaryFileName.c_str());
+        storeReleaseEtag(sysData->ver, etag);
         return true;
     }
 
@@ -142,11 +300,17 @@ bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStat
     if (bHalFirmware_compareVersions(sysData->ver, latestVersion))
     {
         log_i("New firmware version available, starting download and update process...");
-        bHalFirmware_downloadBinaryFirmware(downloadUrl, sysData, sysStatus, devInfo);
+        if (!bHalFirmware_downloadBinaryFirmware(downloadUrl, sysData, sysStatus, devInfo, patchUrl) && downloadResumable)
+        {
+            resumeNotBeforeMs = millis() + FW_RESUME_RECHECK_INTERVAL_MS;
+            log_i("Firmware download will be resumed in %d minutes", FW_RESUME_RECHECK_INTERVAL_MS / 60000);
+            return false;
+        }
     }
     else
     {
         log_i("No firmware update needed, current version is up to date");
+        storeReleaseEtag(sysData->ver, etag);
     }
 
     return true;
@@ -235,185 +399,54 @@ bool bHalFirmware_compareVersions(const String &currentVersion, const String &re
 }
 
 /**
- * @brief Download firmware binary file directly
+ * @brief Download firmware binary straight into the next OTA partition
+ * @details The HTTP body is written to flash as it arrives while its SHA-256
+ *          is updated and the image header checked. The partition is made
+ *          bootable only after esp_ota_set_boot_partition() validated the image and the hash
+ *          matched the release's update_<tag>.bin.sha256 asset, when there is one.
+ *          No SD card is needed.
  */
-bool bHalFirmware_downloadBinaryFirmware(const String &downloadUrl, systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo)
+bool bHalFirmware_downloadBinaryFirmware(const String &downloadUrl, systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo,
+                                         const String &patchUrl)
 {
     log_i("Downloading firmware binary from: %s", downloadUrl.c_str());
 
-    String firmwarePath = "/firmware.bin";
-
-    // Check if firmware file already exists and delete it to ensure clean download
-    if (SD.exists(firmwarePath.c_str()))
+    // An image staged on the card would be installed over this one at the next boot
+    if (sysStatus->sdCard && SD.exists(FIRMWARE_STAGED_PATH))
     {
-        log_i("Existing firmware file found, deleting: %s", firmwarePath.c_str());
-        if (SD.remove(firmwarePath.c_str()))
+        log_i("Removing staged firmware file: %s", FIRMWARE_STAGED_PATH);
+        if (!SD.remove(FIRMWARE_STAGED_PATH))
         {
-            log_i("Successfully deleted existing firmware file");
-        }
-        else
-        {
-            log_e("Failed to delete existing firmware file");
+            log_e("Failed to delete staged firmware file");
             return false;
         }
     }
 
-    if (!downloadFile(downloadUrl, firmwarePath))
-    {
-        log_e("Failed to download firmware binary file");
-        return false;
-    }
-
-    log_i("Firmware binary downloaded successfully to: %s", firmwarePath.c_str());
-
-    // Allow SD card to settle after large file operation
-    delay(100);
-
-    // Verify the downloaded file exists and has reasonable size
-    File firmwareFile = SD.open(firmwarePath.c_str(), FILE_READ);
-    if (!firmwareFile)
-    {
-        log_e("Failed to open downloaded firmware file");
-        log_e("Firmware download may have failed - performing controlled reboot...");
-        
-        // Remove potentially corrupted firmware file
-        if (SD.exists(firmwarePath.c_str()))
-        {
-            SD.remove(firmwarePath.c_str());
-            log_i("Removed inaccessible firmware file: %s", firmwarePath.c_str());
-        }
-        
-        // Brief delay before reboot to ensure logs are written
-        delay(2000);
-        
-        // Perform controlled reboot instead of returning false
-        esp_restart();
-        
-        return false; // Will never reach here due to restart
-    }
-
-    size_t fileSize = firmwareFile.size();
-    firmwareFile.close();
-
-    if (fileSize < 1000000 || fileSize > 2000000) // Reasonable firmware size range
-    {
-        log_w("Firmware file size (%zu bytes) seems unusual", fileSize);
-        // Don't fail, just warn - size limits may vary
-    }
-
-    // Basic firmware validation (always enabled)
-    log_i("Starting basic firmware validation...");
-
-    // Always perform basic size and format validation
-    if (fileSize < 1024)
+    String expectedHash = fetchExpectedHash(downloadUrl + FIRMWARE_HASH_SUFFIX);
+    if (expectedHash.isEmpty())
     {
-        firmwareFile.close();
-        log_e("Firmware file too small to be valid ESP32 firmware");
-        log_e("Invalid firmware size detected - performing controlled reboot...");
-        SD.remove(firmwarePath.c_str());
-        
-        // Brief delay before reboot to ensure logs are written
-        delay(2000);
-        
-        // Perform controlled reboot instead of returning false
-        esp_restart();
-        
-        return false; // Will never reach here due to restart
+        log_w("No %s asset for this release - relying on image validation only", FIRMWARE_HASH_SUFFIX);
     }
 
 #ifdef ENABLE_ENHANCED_SECURITY
-    log_i("Enhanced security features enabled - performing cryptographic verification...");
-
-    // Step 1: Verify firmware signature and format
-    if (!bHalFirmware_verifyFirmwareSignature(firmwarePath))
-    {
-        log_e("Firmware signature verification failed - aborting update");
-        SD.remove(firmwarePath.c_str()); // Remove potentially malicious file
-        return false;
-    }
-
-    // Step 2: Calculate firmware hash for integrity verification
-    if (!bHalFirmware_verifyFirmwareHash(firmwarePath))
-    {
-        log_e("Firmware hash calculation failed - aborting update");
-        SD.remove(firmwarePath.c_str()); // Remove potentially corrupted file
-        return false;
-    }
-
-    // Step 3: Check for and verify detached signature file (if available)
-    String signatureFilePath = firmwarePath + ".sig";
-    if (SD.exists(signatureFilePath.c_str()))
-    {
-        log_i("Detached signature found, performing additional verification...");
-        if (!bHalFirmware_verifyDetachedSignature(firmwarePath, signatureFilePath))
-        {
-            log_e("Detached signature verification failed - aborting update");
-            SD.remove(firmwarePath.c_str());
-            SD.remove(signatureFilePath.c_str());
-            return false;
-        }
-        log_i("Detached signature verification passed");
-    }
-    else
-    {
-        log_w("No detached signature file found - relying on embedded verification");
-    }
-
-    log_i("Enhanced security verification completed successfully");
+    log_i("Enhanced security features enabled - checking chip compatibility and secure boot signature");
 #else
     log_i("Enhanced security features disabled - using basic validation only");
     log_w("For production deployment, enable ENABLE_ENHANCED_SECURITY in config.h");
+#endif
 
-    // Reopen the firmware file for basic validation
-    firmwareFile = SD.open(firmwarePath.c_str(), FILE_READ);
-
-    if (firmwareFile)
-    {
-        // Read first few bytes to verify ESP32 BIN file format
-        uint8_t header[4];
-        if (firmwareFile.readBytes((char *)header, 4) == 4)
-        {
-            // ESP32 firmware binary header should start with 0xE9 (ESP_IMAGE_HEADER_MAGIC)
-            if (header[0] == 0xE9)
-            {
-                log_i("PASS: Valid ESP32 BIN file header detected");
-
-                firmwareFile.close();
-
-                // Perform detailed OTA update test
-                log_i("DETAILED TEST: OTA analysis");
-
-                bool updateSuccess = bHalFirmware_performOTAUpdate(firmwarePath);
-
-                if (updateSuccess == false)
-                {
-                    log_e("FAIL: OTA process failed");
-                }
-            }
-            else
-            {
-                log_e("FAIL: Invalid ESP32 BIN file format - Header: 0x%02X%02X%02X%02X",
-                      header[0], header[1], header[2], header[3]);
-                log_e("Expected ESP32 firmware to start with 0xE9 magic byte");
-            }
-        }
-        else
-        {
-            log_e("FAIL: Could not read BIN file header");
-        }
-
-        firmwareFile.close();
-    }
-    else
+    if (!streamFirmwareToOta(downloadUrl, expectedHash, patchUrl))
     {
-        log_e("FAIL: Could not open downloaded BIN file");
+        log_e("Streaming firmware update failed - running firmware left in place");
+        return false;
     }
 
-#endif
+    log_i("OTA update completed successfully!");
+    log_i("System will restart to apply the new firmware...");
+    delay(2000);
+    esp_restart();
 
-    log_i("Security verification completed successfully");
-    log_i("Firmware binary ready for OTA update: %zu bytes", fileSize);
-    return true;
+    return true; // Will never reach here due to restart
 }
 
 /**
@@ -492,9 +525,9 @@ bool bHalFirmware_performOTAUpdate(const String &firmwarePath)
         return false; // Will never reach here due to restart
     }
 
-    // Begin OTA update process
+    // Begin OTA update process; sectors are erased as the copy reaches them
     esp_ota_handle_t ota_handle = 0;
-    esp_err_t err = esp_ota_begin(update_partition, firmwareSize, &ota_handle);
+    esp_err_t err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
     if (err != ESP_OK)
     {
         log_e("Failed to begin OTA update: %s", esp_err_to_name(err));
@@ -504,48 +537,7 @@ bool bHalFirmware_performOTAUpdate(const String &firmwarePath)
 
     log_i("OTA update started successfully");
 
-    // Write firmware data in chunks
-    static uint8_t buffer[DOWNLOAD_BUFFER_SIZE]; // Static to avoid stack allocation
-    size_t bytesWritten = 0;
-    bool ota_success = true;
-    int loopCount = 0;
-
-    while (firmwareFile.available() && ota_success)
-    {
-        size_t bytesRead = firmwareFile.readBytes((char *)buffer, DOWNLOAD_BUFFER_SIZE);
-        if (bytesRead > 0)
-        {
-            err = esp_ota_write(ota_handle, buffer, bytesRead);
-            if (err != ESP_OK)
-            {
-                log_e("OTA write failed: %s", esp_err_to_name(err));
-                ota_success = false;
-                break;
-            }
-
-            bytesWritten += bytesRead;
-
-            // Progress logging every 32KB (reduced frequency)
-            if (bytesWritten % (32 * 1024) == 0)
-            {
-                log_i("OTA progress: %d/%d bytes (%.1f%%)",
-                      bytesWritten, firmwareSize,
-                      (float)bytesWritten / firmwareSize * 100);
-            }
-
-            // Yield more frequently to prevent stack overflow
-            if (++loopCount % 5 == 0)
-            {
-                yield();  // Give other tasks a chance
-                delay(1); // Small delay to prevent watchdog reset
-            }
-        }
-        else
-        {
-            break; // End of file
-        }
-    }
-
+    bool ota_success = flashImageFromFile(firmwareFile, firmwareSize, ota_handle);
     firmwareFile.close();
 
     if (!ota_success)
@@ -555,7 +547,7 @@ bool bHalFirmware_performOTAUpdate(const String &firmwarePath)
         return false;
     }
 
-    log_i("Firmware written successfully: %d bytes", bytesWritten);
+    log_i("Firmware written successfully: %d bytes", firmwareSize);
 
     // Finalize the OTA update
     err = esp_ota_end(ota_handle);
@@ -618,7 +610,7 @@ static bool downloadFile(const String &url, const String &filepath)
     size_t freeHeap = ESP.getFreeHeap();
     log_i("Free heap before download: %zu bytes", freeHeap);
 
-    if (freeHeap < 50000)
+    if (freeHeap < DOWNLOAD_MIN_FREE_HEAP)
     { // Require at least 50KB free heap
         log_e("Insufficient memory for download (need 50KB, have %zu bytes)", freeHeap);
         clearFirmwareDownloadInProgress();
@@ -626,203 +618,34 @@ static bool downloadFile(const String &url, const String &filepath)
     }
 
     HTTPClient http;
-    http.setTimeout(FIRMWARE_UPDATE_TIMEOUT_MS);
-
-    // Handle both HTTP and HTTPS URLs with proper client setup
     WiFiClientSecure *secureClient = nullptr;
     bool usedSpiram = false;
 
-    if (url.startsWith("https://"))
-    {
-        // Use SPIRAM for WiFiClientSecure allocation to avoid heap issues
-        secureClient = (WiFiClientSecure *)heap_caps_malloc(sizeof(WiFiClientSecure), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-        if (!secureClient)
-        {
-            log_w("SPIRAM allocation failed, trying regular heap");
-            secureClient = new (std::nothrow) WiFiClientSecure();
-            if (!secureClient)
-            {
-                log_e("Failed to allocate WiFiClientSecure - insufficient memory");
-                clearFirmwareDownloadInProgress();
-                return false;
-            }
-        }
-        else
-        {
-            // Construct the object in the SPIRAM memory
-            new (secureClient) WiFiClientSecure();
-            usedSpiram = true;
-            log_i("WiFiClientSecure allocated in SPIRAM");
-        }
-
-        secureClient->setInsecure();              // Accept all certificates for simplicity
-        secureClient->setTimeout(60000);          // 60 second timeout for large downloads
-        secureClient->setHandshakeTimeout(30000); // 30 second handshake timeout
-
-        if (!http.begin(*secureClient, url))
-        {
-            log_e("Failed to initialize HTTPS client for download");
-            if (usedSpiram)
-            {
-                secureClient->~WiFiClientSecure();
-                heap_caps_free(secureClient);
-            }
-            else
-            {
-                delete secureClient;
-            }
-            clearFirmwareDownloadInProgress();
-            return false;
-        }
-
-        log_i("HTTPS client initialized successfully");
-    }
-    else
+    int httpCode = openDownload(http, url, &secureClient, &usedSpiram);
+    if (httpCode != HTTP_CODE_OK)
     {
-        if (!http.begin(url))
-        {
-            log_e("Failed to initialize HTTP client for download");
-            clearFirmwareDownloadInProgress();
-            return false;
-        }
-        log_i("HTTP client initialized successfully");
+        log_e("Download request failed with code: %d", httpCode);
+        http.end();
+        freeSecureClient(secureClient, usedSpiram);
+        clearFirmwareDownloadInProgress();
+        return false;
     }
 
-    // Attempt GET request with retry logic for connection issues
-    int httpCode = -1;
-    int retryCount = 0;
-    const int maxRetries = 3;
-
-    while (retryCount < maxRetries)
-    {
-        log_i("Attempting HTTP GET (attempt %d/%d)", retryCount + 1, maxRetries);
-
-        // Add User-Agent header for better compatibility with GitHub
-        http.addHeader("User-Agent", "MSP-Firmware-Downloader/1.0");
-        http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS); // Enable redirect following
-
-        httpCode = http.GET();
-
-        if (httpCode > 0)
-        {
-            break; // Success or HTTP error (not connection error)
-        }
-
-        // Connection error (negative code), retry
-        log_w("Connection error %d, retrying in 2 seconds...", httpCode);
-        retryCount++;
-
-        if (retryCount < maxRetries)
-        {
-            delay(2000); // Wait 2 seconds before retry
-        }
-    }
+    int totalLength = http.getSize();
+    int originalFileSize = totalLength; // Store original size for validation
+    log_i("Starting download, file size: %d bytes", totalLength);
 
-    if (httpCode < 0)
+    log_i("Attempting to open SD card file: %s", filepath.c_str());
+    File file = SD.open(filepath.c_str(), FILE_WRITE);
+    if (!file)
     {
-        log_e("Connection failed after %d attempts with error: %d", maxRetries, httpCode);
+        log_e("Failed to create download file: %s", filepath.c_str());
         http.end();
-        if (secureClient)
-        {
-            if (usedSpiram)
-            {
-                secureClient->~WiFiClientSecure();
-                heap_caps_free(secureClient);
-            }
-            else
-            {
-                delete secureClient;
-            }
-        }
+        freeSecureClient(secureClient, usedSpiram);
+        clearFirmwareDownloadInProgress();
         return false;
     }
-
-    // Handle redirects (GitHub often returns 302 redirects)
-    int redirectCount = 0;
-    const int maxRedirects = 5;
-
-    while ((httpCode == HTTP_CODE_MOVED_PERMANENTLY || httpCode == HTTP_CODE_FOUND) && redirectCount < maxRedirects)
-    {
-        String newLocation = http.getLocation();
-        log_i("HTTP %d redirect to: %s", httpCode, newLocation.c_str());
-
-        if (newLocation.length() == 0)
-        {
-            log_e("Redirect location is empty");
-            break;
-        }
-
-        http.end();
-
-        // Follow the redirect
-        if (!http.begin(newLocation))
-        {
-            log_e("Failed to begin HTTP client for redirect URL");
-            if (secureClient)
-            {
-                if (usedSpiram)
-                {
-                    secureClient->~WiFiClientSecure();
-                    heap_caps_free(secureClient);
-                }
-                else
-                {
-                    delete secureClient;
-                }
-            }
-            return false;
-        }
-
-        httpCode = http.GET();
-        redirectCount++;
-    }
-
-    if (httpCode != HTTP_CODE_OK)
-    {
-        log_e("Download request failed with code: %d after %d redirects", httpCode, redirectCount);
-        http.end();
-        if (secureClient)
-        {
-            if (usedSpiram)
-            {
-                secureClient->~WiFiClientSecure();
-                heap_caps_free(secureClient);
-            }
-            else
-            {
-                delete secureClient;
-            }
-        }
-        return false;
-    }
-
-    log_i("Download successful after %d redirects", redirectCount);
-
-    int totalLength = http.getSize();
-    int originalFileSize = totalLength; // Store original size for validation
-    log_i("Starting download, file size: %d bytes", totalLength);
-
-    log_i("Attempting to open SD card file: %s", filepath.c_str());
-    File file = SD.open(filepath.c_str(), FILE_WRITE);
-    if (!file)
-    {
-        log_e("Failed to create download file: %s", filepath.c_str());
-        http.end();
-        if (secureClient)
-        {
-            if (usedSpiram)
-            {
-                secureClient->~WiFiClientSecure();
-                heap_caps_free(secureClient);
-            }
-            else
-            {
-                delete secureClient;
-            }
-        }
-        return false;
-    }
-    log_i("SD card file opened successfully");
+    log_i("SD card file opened successfully");
 
     log_i("Getting HTTP stream pointer...");
     WiFiClient *stream = http.getStreamPtr();
@@ -859,6 +682,7 @@ static bool downloadFile(const String &url, const String &filepath)
                     log_e("SD card write failed: wrote %d of %d bytes", bytesWrittenToFile, bytesRead);
                     file.close();
                     http.end();
+                    freeSecureClient(secureClient, usedSpiram);
                     clearFirmwareDownloadInProgress();
                     return false;
                 }
@@ -869,189 +693,1465 @@ static bool downloadFile(const String &url, const String &filepath)
                 {
                     totalLength -= bytesRead;
 
-                    // Enhanced progress logging with connection status and more frequent flushing
-                    if (bytesWritten % (16 * 1024) == 0) // Reduced from 32KB to 16KB for more frequent updates
-                    {
-                        float progress = ((float)(bytesWritten) / (float)(bytesWritten + totalLength)) * 100.0;
-                        log_i("Download progress: %d bytes (%.1f%%) - connection: %s", 
-                              bytesWritten, progress, http.connected() ? "OK" : "LOST");
-                        
-                        // Force file flush more frequently
-                        file.flush();
-                        
-                        // Additional SD card health check
-                        if (!SD.exists(filepath.c_str())) 
-                        {
-                            log_e("SD card file disappeared during download!");
-                            break;
-                        }
-                    }
-                }
-                
-                // Flush every 64KB to prevent SD card buffer issues
-                if (bytesWritten % (64 * 1024) == 0)
-                {
-                    file.flush();
-                    log_d("Periodic flush completed at %d bytes", bytesWritten);
-                }
-            }
-            else
+                    // Enhanced progress logging with connection status and more frequent flushing
+                    if (bytesWritten % (16 * 1024) == 0) // Reduced from 32KB to 16KB for more frequent updates
+                    {
+                        float progress = ((float)(bytesWritten) / (float)(bytesWritten + totalLength)) * 100.0;
+                        log_i("Download progress: %d bytes (%.1f%%) - connection: %s", 
+                              bytesWritten, progress, http.connected() ? "OK" : "LOST");
+                        
+                        // Force file flush more frequently
+                        file.flush();
+                        
+                        // Additional SD card health check
+                        if (!SD.exists(filepath.c_str())) 
+                        {
+                            log_e("SD card file disappeared during download!");
+                            break;
+                        }
+                    }
+                }
+                
+                // Flush every 64KB to prevent SD card buffer issues
+                if (bytesWritten % (64 * 1024) == 0)
+                {
+                    file.flush();
+                    log_d("Periodic flush completed at %d bytes", bytesWritten);
+                }
+            }
+            else
+            {
+                // No data was read
+                if (availableBytes > 0) {
+                    log_w("Stream readBytes returned 0 despite available data: %d", availableBytes);
+                } else {
+                    log_d("No data available and no data read, attempt: %d", consecutiveNoDataCount);
+                }
+            }
+
+            // Yield more frequently to prevent stack overflow
+            if (++loopCount % 5 == 0) // Increased frequency
+            {
+                yield();  // Give other tasks a chance
+                delay(1); // Small delay to prevent watchdog reset
+            }
+        }
+        else
+        {
+            // No data available - implement timeout and retry logic
+            consecutiveNoDataCount++;
+            
+            // Check for timeout
+            if ((millis() - lastDataTime) > noDataTimeout)
+            {
+                log_e("Download timeout: no data received for %lu ms", millis() - lastDataTime);
+                log_e("Connection status: %s, Total downloaded: %d bytes", 
+                      http.connected() ? "connected" : "disconnected", bytesWritten);
+                break;
+            }
+            
+            // Check for too many consecutive no-data attempts (reduced threshold)
+            if (consecutiveNoDataCount > 50) // Reduced from 100 to 50 for faster failure detection
+            {
+                log_e("Too many consecutive no-data attempts (%d), connection may be stalled", consecutiveNoDataCount);
+                log_e("Possible causes: SD card issues, network congestion, or server problems");
+                
+                // Final SD card check before giving up
+                if (!SD.exists(filepath.c_str())) 
+                {
+                    log_e("Downloaded file is missing - SD card failure detected!");
+                } else {
+                    log_i("Downloaded file still exists, likely network/server issue");
+                }
+                break;
+            }
+            
+            // Log periodic status when waiting for data (more frequent for better debugging)
+            if (consecutiveNoDataCount % 25 == 0)
+            {
+                log_d("Waiting for data... attempts: %d, connected: %s, downloaded: %d bytes", 
+                      consecutiveNoDataCount, http.connected() ? "yes" : "no", bytesWritten);
+                      
+                // Periodic SD card health check during long waits
+                if (!SD.exists("/"))
+                {
+                    log_w("SD card root directory check failed during wait");
+                }
+            }
+            
+            delay(10);
+            yield(); // Yield when waiting
+        }
+        
+        // Additional safety check - if connection is lost, break
+        if (!http.connected())
+        {
+            log_w("HTTP connection lost during download at %d bytes", bytesWritten);
+            break;
+        }
+    }
+    
+    log_i("Download loop completed - downloaded %d bytes, connection: %s", 
+          bytesWritten, http.connected() ? "connected" : "disconnected");
+
+    // Ensure file is properly flushed and closed
+    file.flush();
+    file.close();
+    http.end();
+
+    // Save bytesWritten before any cleanup to avoid corruption
+    int finalBytesWritten = bytesWritten;
+
+    // Clean up HTTPS client if used
+    freeSecureClient(secureClient, usedSpiram);
+    secureClient = nullptr;
+
+    // Check if download was successful - require exact file size match for FOTA safety
+    bool downloadSuccessful = false;
+    
+    if (originalFileSize > 0)
+    {
+        // We know the expected size - require exact match for firmware safety
+        downloadSuccessful = (finalBytesWritten == originalFileSize);
+        log_i("Download validation: %d bytes written, expected: %d bytes, match: %s", 
+              finalBytesWritten, originalFileSize, downloadSuccessful ? "EXACT" : "FAILED");
+        
+        if (!downloadSuccessful)
+        {
+            log_e("CRITICAL: Incomplete firmware download detected!");
+            log_e("Expected: %d bytes, Got: %d bytes, Missing: %d bytes", 
+                  originalFileSize, finalBytesWritten, originalFileSize - finalBytesWritten);
+            log_e("FOTA update will be aborted to prevent device corruption");
+        }
+    }
+    else
+    {
+        // Unknown size, assume success if we got reasonable amount of data
+        downloadSuccessful = (finalBytesWritten > 100000); // At least 100KB
+        log_w("Download validation: %d bytes written (unknown expected size), success: %s", 
+              finalBytesWritten, downloadSuccessful ? "ASSUMED" : "FAILED");
+    }
+    
+    log_i("Download completed: %d bytes written to %s", finalBytesWritten, filepath.c_str());
+    
+    if (!downloadSuccessful)
+    {
+        log_e("Download appears to be incomplete or failed");
+        log_e("Performing controlled reboot to prevent system instability...");
+        clearFirmwareDownloadInProgress();
+        
+        // Remove potentially corrupted firmware file
+        if (SD.exists(filepath.c_str()))
+        {
+            SD.remove(filepath.c_str());
+            log_i("Removed corrupted firmware file: %s", filepath.c_str());
+        }
+        
+        // Brief delay before reboot to ensure logs are written
+        delay(2000);
+        
+        // Perform controlled reboot instead of returning false
+        esp_restart();
+        
+        return false; // Will never reach here due to restart
+    }
+    
+    // Re-enable network connectivity tests
+    clearFirmwareDownloadInProgress();
+    
+    // Phase 1 complete: Download successful, restart to apply update
+    log_i("Download successful - restarting to apply firmware update with clean heap");
+    delay(1000); // Brief delay to ensure logs are written
+    esp_restart();
+    
+    return true; // Will never reach here due to restart
+}
+
+/**
+ * @brief Ask for the body from rangeStart on, if it still is the ifRange version
+ */
+static void addRangeHeaders(HTTPClient &http, uint32_t rangeStart, const String &ifRange)
+{
+    if (rangeStart == 0)
+    {
+        return;
+    }
+    http.addHeader("Range", "bytes=" + String((unsigned long)rangeStart) + "-");
+    if (!ifRange.isEmpty())
+    {
+        http.addHeader("If-Range", ifRange);
+    }
+}
+
+/**
+ * @brief Open a GET request, retrying connection errors and following redirects
+ * @param http HTTP client, to end() by the caller
+ * @param url URL to get
+ * @param secureClient HTTPS client allocated for the request, to free by the caller
+ * @param usedSpiram true when secureClient lives in SPIRAM
+ * @param rangeStart first byte wanted, 0 for the whole body
+ * @param ifRange ETag the rest must belong to, else the server sends the whole body
+ * @return HTTP status code, negative on connection errors
+ */
+static int openDownload(HTTPClient &http, const String &url, WiFiClientSecure **secureClient, bool *usedSpiram,
+                        uint32_t rangeStart, const String &ifRange)
+{
+    // Response headers a resumed download checks
+    static const char *responseHeaders[] = {"ETag", "Content-Range"};
+
+    http.setTimeout(FIRMWARE_UPDATE_TIMEOUT_MS);
+    *secureClient = nullptr;
+    *usedSpiram = false;
+
+    // Handle both HTTP and HTTPS URLs with proper client setup
+    if (url.startsWith("https://"))
+    {
+        // Use SPIRAM for WiFiClientSecure allocation to avoid heap issues
+        WiFiClientSecure *client = (WiFiClientSecure *)heap_caps_malloc(sizeof(WiFiClientSecure), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (!client)
+        {
+            log_w("SPIRAM allocation failed, trying regular heap");
+            client = new (std::nothrow) WiFiClientSecure();
+            if (!client)
+            {
+                log_e("Failed to allocate WiFiClientSecure - insufficient memory");
+                return HTTPC_ERROR_TOO_LESS_RAM;
+            }
+        }
+        else
+        {
+            // Construct the object in the SPIRAM memory
+            new (client) WiFiClientSecure();
+            *usedSpiram = true;
+            log_i("WiFiClientSecure allocated in SPIRAM");
+        }
+        *secureClient = client;
+
+        client->setInsecure();              // Accept all certificates for simplicity
+        client->setTimeout(60000);          // 60 second timeout for large downloads
+        client->setHandshakeTimeout(30000); // 30 second handshake timeout
+
+        if (!http.begin(*client, url))
+        {
+            log_e("Failed to initialize HTTPS client for download");
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+
+        log_i("HTTPS client initialized successfully");
+    }
+    else
+    {
+        if (!http.begin(url))
+        {
+            log_e("Failed to initialize HTTP client for download");
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        log_i("HTTP client initialized successfully");
+    }
+
+    http.collectHeaders(responseHeaders, sizeof(responseHeaders) / sizeof(responseHeaders[0]));
+    addRangeHeaders(http, rangeStart, ifRange);
+
+    // Attempt GET request with retry logic for connection issues
+    int httpCode = -1;
+    int retryCount = 0;
+    const int maxRetries = 3;
+
+    while (retryCount < maxRetries)
+    {
+        log_i("Attempting HTTP GET (attempt %d/%d)", retryCount + 1, maxRetries);
+
+        // Add User-Agent header for better compatibility with GitHub
+        http.addHeader("User-Agent", "MSP-Firmware-Downloader/1.0");
+        http.setFollowRedirects(HTTPC_STRICT_FOLLOW_REDIRECTS); // Enable redirect following
+
+        httpCode = http.GET();
+
+        if (httpCode > 0)
+        {
+            break; // Success or HTTP error (not connection error)
+        }
+
+        // Connection error (negative code), retry
+        log_w("Connection error %d, retrying in 2 seconds...", httpCode);
+        retryCount++;
+
+        if (retryCount < maxRetries)
+        {
+            delay(2000); // Wait 2 seconds before retry
+        }
+    }
+
+    if (httpCode < 0)
+    {
+        log_e("Connection failed after %d attempts with error: %d", maxRetries, httpCode);
+        return httpCode;
+    }
+
+    // Handle redirects the client did not follow (GitHub often returns 302 redirects)
+    int redirectCount = 0;
+    const int maxRedirects = 5;
+
+    while ((httpCode == HTTP_CODE_MOVED_PERMANENTLY || httpCode == HTTP_CODE_FOUND) && redirectCount < maxRedirects)
+    {
+        String newLocation = http.getLocation();
+        log_i("HTTP %d redirect to: %s", httpCode, newLocation.c_str());
+
+        if (newLocation.length() == 0)
+        {
+            log_e("Redirect location is empty");
+            break;
+        }
+
+        http.end();
+
+        // Follow the redirect, over the secure client when there is one
+        bool begun = (*secureClient != nullptr) ? http.begin(**secureClient, newLocation) : http.begin(newLocation);
+        if (!begun)
+        {
+            log_e("Failed to begin HTTP client for redirect URL");
+            return HTTPC_ERROR_CONNECTION_REFUSED;
+        }
+        addRangeHeaders(http, rangeStart, ifRange); // end() dropped the request headers
+
+        httpCode = http.GET();
+        redirectCount++;
+    }
+
+    log_i("Request completed with code %d after %d redirects", httpCode, redirectCount);
+    return httpCode;
+}
+
+/**
+ * @brief Free the HTTPS client allocated by openDownload()
+ */
+static void freeSecureClient(WiFiClientSecure *secureClient, bool usedSpiram)
+{
+    if (secureClient == nullptr)
+    {
+        return;
+    }
+    if (usedSpiram)
+    {
+        secureClient->~WiFiClientSecure();
+        heap_caps_free(secureClient);
+    }
+    else
+    {
+        delete secureClient;
+    }
+}
+
+/**
+ * @brief Get the SHA-256 published next to a firmware binary
+ * @param hashUrl URL of the sha256sum style asset
+ * @return lower case hex digest, empty if there is none
+ */
+static String fetchExpectedHash(const String &hashUrl)
+{
+    HTTPClient http;
+    WiFiClientSecure *secureClient = nullptr;
+    bool usedSpiram = false;
+    String hash = "";
+
+    int httpCode = openDownload(http, hashUrl, &secureClient, &usedSpiram);
+    if (httpCode == HTTP_CODE_OK)
+    {
+        String body = http.getString(); // "<64 hex digits>  update_<tag>.bin"
+        body.trim();
+        String digest = body.substring(0, HASH_LENGTH * 2);
+        digest.toLowerCase();
+
+        bool valid = (digest.length() == HASH_LENGTH * 2);
+        for (unsigned int i = 0; valid && (i < digest.length()); i++)
+        {
+            valid = isxdigit((unsigned char)digest[i]);
+        }
+        if (valid)
+        {
+            hash = digest;
+            log_i("Expected firmware SHA256: %s", hash.c_str());
+        }
+        else
+        {
+            log_e("Malformed firmware hash asset: %s", body.c_str());
+        }
+    }
+    else
+    {
+        log_w("Firmware hash asset request failed with code: %d", httpCode);
+    }
+
+    http.end();
+    freeSecureClient(secureClient, usedSpiram);
+    return hash;
+}
+
+/**
+ * @brief Check the image header as soon as its bytes are in
+ * @return true if the image is for this chip
+ */
+static bool checkImageHeader(const esp_image_header_t *header)
+{
+    // ESP32 firmware binary header should start with 0xE9 (ESP_IMAGE_HEADER_MAGIC)
+    if (header->magic != ESP_IMAGE_HEADER_MAGIC)
+    {
+        log_e("Invalid firmware header magic: 0x%02X (expected 0x%02X)", header->magic, ESP_IMAGE_HEADER_MAGIC);
+        return false;
+    }
+    if (header->chip_id != ESP_CHIP_ID_ESP32)
+    {
+        log_e("Firmware built for chip id %d, not an ESP32", header->chip_id);
+        return false;
+    }
+#ifdef ENABLE_ENHANCED_SECURITY
+    // Validate chip revision compatibility
+    uint32_t chip_rev = esp_efuse_get_pkg_ver();
+    if (header->min_chip_rev > chip_rev)
+    {
+        log_e("Firmware not compatible with this ESP32 chip revision");
+        return false;
+    }
+#endif
+    log_i("PASS: Valid ESP32 BIN file header detected");
+    return true;
+}
+
+// -- download checkpoint --
+
+/**
+ * @brief Load the checkpoint of an interrupted download
+ * @return true if there is one with the current layout
+ */
+static bool loadResumeCheckpoint(fwResumeCheckpoint_t *ckpt)
+{
+    Preferences prefs;
+    bool found = false;
+
+    if (!prefs.begin(FW_RESUME_NVS_NAMESPACE, true))
+    {
+        return false; // namespace not created yet: no download was ever interrupted
+    }
+    if (prefs.getBytesLength(FW_RESUME_NVS_KEY) == sizeof(fwResumeCheckpoint_t))
+    {
+        prefs.getBytes(FW_RESUME_NVS_KEY, ckpt, sizeof(fwResumeCheckpoint_t));
+        found = (ckpt->version == FW_RESUME_VERSION) && (ckpt->size == sizeof(fwResumeCheckpoint_t));
+    }
+    prefs.end();
+    return found;
+}
+
+/**
+ * @brief Persist the checkpoint, done once per completed chunk
+ */
+static void storeResumeCheckpoint(fwResumeCheckpoint_t *ckpt)
+{
+    Preferences prefs;
+
+    ckpt->version = FW_RESUME_VERSION;
+    ckpt->size = sizeof(fwResumeCheckpoint_t);
+    if (!prefs.begin(FW_RESUME_NVS_NAMESPACE, false) ||
+        (prefs.putBytes(FW_RESUME_NVS_KEY, ckpt, sizeof(fwResumeCheckpoint_t)) != sizeof(fwResumeCheckpoint_t)))
+    {
+        log_w("Failed to store firmware download checkpoint, an interruption restarts the chunk");
+    }
+    prefs.end();
+}
+
+/**
+ * @brief Forget the interrupted download
+ */
+static void clearResumeCheckpoint(void)
+{
+    Preferences prefs;
+    if (prefs.begin(FW_RESUME_NVS_NAMESPACE, false))
+    {
+        prefs.remove(FW_RESUME_NVS_KEY);
+        prefs.end();
+    }
+}
+
+// -- release check cache --
+
+/**
+ * @brief ETag of the last release JSON that needed no update
+ * @param version running firmware version; an ETag checked against another
+ *        version (e.g. before an SD card install) is not used
+ * @return the ETag, or an empty string when the JSON has to be fetched
+ */
+static String loadReleaseEtag(const String &version)
+{
+    Preferences prefs;
+    String etag = "";
+
+    if (!prefs.begin(FW_RESUME_NVS_NAMESPACE, true))
+    {
+        return etag;
+    }
+    if (prefs.getString(FW_RELEASE_VER_NVS_KEY) == version)
+    {
+        etag = prefs.getString(FW_RELEASE_ETAG_NVS_KEY);
+    }
+    prefs.end();
+    return etag;
+}
+
+/**
+ * @brief Remember a release JSON that needed no update
+ * @details Only stored once the release was fully handled: a release whose
+ *          download failed must be fetched again on the next check.
+ */
+static void storeReleaseEtag(const String &version, const String &etag)
+{
+    Preferences prefs;
+
+    if (etag.isEmpty() || !prefs.begin(FW_RESUME_NVS_NAMESPACE, false))
+    {
+        return;
+    }
+    // Both keys together: the ETag is only valid for the version it was stored with
+    if ((prefs.getString(FW_RELEASE_ETAG_NVS_KEY) != etag) || (prefs.getString(FW_RELEASE_VER_NVS_KEY) != version))
+    {
+        prefs.putString(FW_RELEASE_VER_NVS_KEY, version);
+        prefs.putString(FW_RELEASE_ETAG_NVS_KEY, etag);
+    }
+    prefs.end();
+}
+
+/**
+ * @brief True if the patch rebuilt an image that failed verification before
+ */
+static bool isDeltaPatchRejected(const String &patchUrl)
+{
+    Preferences prefs;
+    bool rejected = false;
+
+    if (prefs.begin(FW_RESUME_NVS_NAMESPACE, true))
+    {
+        rejected = (prefs.getString(FW_BAD_PATCH_NVS_KEY) == patchUrl);
+        prefs.end();
+    }
+    return rejected;
+}
+
+/**
+ * @brief Remember a patch whose image failed verification; the URL names
+ *        both the target and the running version, so only that pair is skipped
+ */
+static void rejectDeltaPatch(const String &patchUrl)
+{
+    Preferences prefs;
+
+    if (prefs.begin(FW_RESUME_NVS_NAMESPACE, false))
+    {
+        prefs.putString(FW_BAD_PATCH_NVS_KEY, patchUrl);
+        prefs.end();
+    }
+}
+
+// -- image writer --
+
+/**
+ * @brief Start writing into the next OTA partition; nothing is erased yet,
+ *        so chunks a previous attempt flashed stay in place
+ * @details The OTA handle only checks and holds the partition. Sectors are
+ *          erased and written with the partition API, which takes any offset:
+ *          the OTA writes cannot mix a manual erase with a resume offset.
+ */
+static bool otaStreamBegin(otaStream_t *ota)
+{
+    memset(ota, 0, sizeof(*ota));
+
+    ota->partition = esp_ota_get_next_update_partition(NULL);
+    if (ota->partition == NULL)
+    {
+        log_e("Failed to get next update partition");
+        return false;
+    }
+
+    log_i("Update partition: %s at offset 0x%08x (size: %d bytes)",
+          ota->partition->label, ota->partition->address, ota->partition->size);
+
+    // Erases nothing: sectors are erased as the data arrives, a full erase up front would stall the connection
+    esp_err_t err = esp_ota_begin(ota->partition, OTA_WITH_SEQUENTIAL_WRITES, &ota->handle);
+    if (err != ESP_OK)
+    {
+        log_e("Failed to begin OTA update: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    mbedtls_sha256_init(&ota->sha);
+    mbedtls_sha256_starts(&ota->sha, 0); // 0 for SHA256 (not SHA224)
+    return true;
+}
+
+/**
+ * @brief Start the image over from its first byte
+ */
+static void otaStreamRestart(otaStream_t *ota, fwResumeCheckpoint_t *ckpt)
+{
+    mbedtls_sha256_free(&ota->sha);
+    mbedtls_sha256_init(&ota->sha);
+    mbedtls_sha256_starts(&ota->sha, 0);
+    ota->headerLen = 0;
+    ota->written = 0;
+    ota->pending = 0;
+    ota->chunkCrc = 0;
+
+    ckpt->committed = 0;
+    ckpt->totalSize = 0;
+    ckpt->etag[0] = '\0';
+}
+
+/**
+ * @brief Flash the buffered bytes at the current offset: hashed here, so the
+ *        hash covers exactly what is in the partition
+ */
+static bool otaStreamFlush(otaStream_t *ota, fwResumeCheckpoint_t *ckpt)
+{
+    if (ota->pending == 0)
+    {
+        return true;
+    }
+
+    esp_err_t err = esp_partition_erase_range(ota->partition, ota->written, FIRMWARE_SECTOR_SIZE);
+    if (err == ESP_OK)
+    {
+        // An encrypted partition takes 16 byte blocks, the image tail is padded like esp_ota_write() does
+        size_t padded = (ota->pending + 15) & ~(size_t)15;
+        memset(ota->sector + ota->pending, 0xFF, padded - ota->pending);
+        err = esp_partition_write(ota->partition, ota->written, ota->sector, padded);
+    }
+    if (err != ESP_OK)
+    {
+        log_e("OTA write failed at offset %u: %s", (unsigned)ota->written, esp_err_to_name(err));
+        return false;
+    }
+
+    mbedtls_sha256_update(&ota->sha, ota->sector, ota->pending);
+    ota->chunkCrc = ulLogJournal_crc32(ota->chunkCrc, ota->sector, ota->pending);
+    ota->written += ota->pending;
+    ota->pending = 0;
+
+    if ((ota->written % FW_RESUME_CHUNK_SIZE) == 0)
+    {
+        size_t chunk = (ota->written / FW_RESUME_CHUNK_SIZE) - 1;
+        if (chunk < FW_RESUME_MAX_CHUNKS)
+        {
+            ckpt->chunkCrc[chunk] = ota->chunkCrc;
+            ckpt->committed = ota->written;
+            storeResumeCheckpoint(ckpt);
+        }
+        ota->chunkCrc = 0;
+    }
+    return true;
+}
+
+/**
+ * @brief Take the next bytes of the image; they are flashed a sector at a time
+ */
+static bool otaStreamWrite(otaStream_t *ota, fwResumeCheckpoint_t *ckpt, const uint8_t *data, size_t len)
+{
+    while (len > 0)
+    {
+        size_t take = min(len, FIRMWARE_SECTOR_SIZE - ota->pending);
+        memcpy(ota->sector + ota->pending, data, take);
+
+        size_t offset = ota->written + ota->pending;
+        if (offset < sizeof(ota->header))
+        {
+            size_t headerTake = min(take, sizeof(ota->header) - offset);
+            memcpy((uint8_t *)&ota->header + offset, data, headerTake);
+            ota->headerLen = offset + headerTake;
+            if ((ota->headerLen == sizeof(ota->header)) && !checkImageHeader(&ota->header))
+            {
+                return false;
+            }
+        }
+
+        ota->pending += take;
+        data += take;
+        len -= take;
+
+        if ((ota->pending == FIRMWARE_SECTOR_SIZE) && !otaStreamFlush(ota, ckpt))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Drop the bytes not flashed yet, the next connection asks for them again
+ */
+static void otaStreamRewind(otaStream_t *ota)
+{
+    ota->pending = 0;
+    if (ota->headerLen > ota->written)
+    {
+        ota->headerLen = ota->written;
+    }
+}
+
+/**
+ * @brief Pick up the chunks an interrupted download left in the partition:
+ *        each is read back, checked against its CRC and fed to the hash; the
+ *        first bad chunk and everything after it are fetched again
+ * @return bytes kept
+ */
+static size_t otaStreamRestore(otaStream_t *ota, fwResumeCheckpoint_t *ckpt)
+{
+    size_t chunks = min((size_t)(ckpt->committed / FW_RESUME_CHUNK_SIZE), (size_t)FW_RESUME_MAX_CHUNKS);
+    mbedtls_sha256_context chunkStart;
+    mbedtls_sha256_init(&chunkStart);
+
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+    {
+        uint32_t crc = 0;
+        size_t base = chunk * FW_RESUME_CHUNK_SIZE;
+        bool readable = true;
+
+        mbedtls_sha256_clone(&chunkStart, &ota->sha);
+        for (size_t offset = 0; readable && (offset < FW_RESUME_CHUNK_SIZE); offset += FIRMWARE_SECTOR_SIZE)
+        {
+            readable = (esp_partition_read(ota->partition, base + offset, ota->sector, FIRMWARE_SECTOR_SIZE) == ESP_OK);
+            crc = ulLogJournal_crc32(crc, ota->sector, FIRMWARE_SECTOR_SIZE);
+            mbedtls_sha256_update(&ota->sha, ota->sector, FIRMWARE_SECTOR_SIZE);
+        }
+        if (!readable || (crc != ckpt->chunkCrc[chunk]))
+        {
+            log_w("Firmware chunk %u failed its check, resuming before it", (unsigned)chunk);
+            mbedtls_sha256_clone(&ota->sha, &chunkStart);
+            break;
+        }
+        ota->written = base + FW_RESUME_CHUNK_SIZE;
+    }
+    mbedtls_sha256_free(&chunkStart);
+
+    ckpt->committed = ota->written;
+    if (ota->written >= sizeof(ota->header))
+    {
+        esp_partition_read(ota->partition, 0, &ota->header, sizeof(ota->header));
+        ota->headerLen = sizeof(ota->header);
+    }
+    return ota->written;
+}
+
+/**
+ * @brief Give up the image; the partition is not made bootable
+ */
+static void otaStreamAbort(otaStream_t *ota)
+{
+    esp_ota_abort(ota->handle);
+    mbedtls_sha256_free(&ota->sha);
+}
+
+/**
+ * @brief Validate the written image and make it the boot partition
+ * @param expectedHash hex SHA-256 the image must have, empty to skip
+ */
+static bool otaStreamFinish(otaStream_t *ota, fwResumeCheckpoint_t *ckpt, const String &expectedHash)
+{
+    if (!otaStreamFlush(ota, ckpt)) // image tail
+    {
+        otaStreamAbort(ota);
+        return false;
+    }
+    esp_ota_abort(ota->handle); // nothing went through the handle, the image is checked below
+
+    uint8_t hash[HASH_LENGTH];
+    mbedtls_sha256_finish(&ota->sha, hash);
+    mbedtls_sha256_free(&ota->sha);
+
+    char calculatedHash[HASH_LENGTH * 2 + 1];
+    for (int i = 0; i < HASH_LENGTH; i++)
+    {
+        sprintf(&calculatedHash[i * 2], "%02x", hash[i]);
+    }
+    log_i("Calculated SHA256: %s", calculatedHash);
+
+    if (ota->headerLen < sizeof(ota->header))
+    {
+        log_e("Firmware image too short: %u bytes", (unsigned)ota->written);
+        return false;
+    }
+
+    if (!expectedHash.isEmpty() && !expectedHash.equalsIgnoreCase(calculatedHash))
+    {
+        log_e("Hash verification FAILED");
+        log_e("Expected: %s", expectedHash.c_str());
+        log_e("Calculated: %s", calculatedHash);
+        return false;
+    }
+    if (!expectedHash.isEmpty())
+    {
+        log_i("Hash verification PASSED");
+    }
+
+    // Checks segments, checksum and appended hash, and the signature under secure boot, before switching
+    esp_err_t err = esp_ota_set_boot_partition(ota->partition);
+    if (err != ESP_OK)
+    {
+        log_e("Failed to set boot partition: %s", esp_err_to_name(err));
+        return false;
+    }
+
+    log_i("Boot partition set to: %s", ota->partition->label);
+    return true;
+}
+
+// -- download --
+
+/**
+ * @brief Total size from a "bytes first-last/total" Content-Range
+ * @return the total, 0 if the range does not start at first
+ */
+static uint32_t parseContentRangeTotal(const String &contentRange, uint32_t first)
+{
+    unsigned long start = 0;
+    unsigned long last = 0;
+    unsigned long total = 0;
+    if ((sscanf(contentRange.c_str(), "bytes %lu-%lu/%lu", &start, &last, &total) != 3) || (start != first))
+    {
+        return 0;
+    }
+    return (uint32_t)total;
+}
+
+/**
+ * @brief One connection of a firmware download, from the first byte not
+ *        flashed yet to the end or to the first failure
+ * @param fatal set when retrying cannot help (bad image, flash error, HTTP 4xx)
+ * @return true if the whole image was received
+ */
+static bool downloadImagePart(otaStream_t *ota, fwResumeCheckpoint_t *ckpt, const String &url, bool *fatal)
+{
+    HTTPClient http;
+    WiFiClientSecure *secureClient = nullptr;
+    bool usedSpiram = false;
+    uint32_t start = ota->written;
+
+    int httpCode = openDownload(http, url, &secureClient, &usedSpiram, start, String(ckpt->etag));
+    bool accepted = false;
+
+    if ((httpCode == HTTP_CODE_PARTIAL_CONTENT) && (start > 0))
+    {
+        uint32_t total = parseContentRangeTotal(http.header("Content-Range"), start);
+        if ((total == 0) || ((ckpt->totalSize != 0) && (total != ckpt->totalSize)))
+        {
+            log_w("Unexpected Content-Range '%s', restarting the download", http.header("Content-Range").c_str());
+            otaStreamRestart(ota, ckpt);
+        }
+        else
+        {
+            accepted = true;
+            ckpt->totalSize = total;
+            log_i("Resuming firmware download at %u of %u bytes", (unsigned)start, (unsigned)total);
+        }
+    }
+    else if (httpCode == HTTP_CODE_OK)
+    {
+        accepted = true;
+        if (start > 0)
+        {
+            log_w("Server sent the whole image (changed or no range support), restarting the download");
+            otaStreamRestart(ota, ckpt);
+            start = 0;
+        }
+        int size = http.getSize();
+        ckpt->totalSize = (size > 0) ? (uint32_t)size : 0;
+        strlcpy(ckpt->etag, http.header("ETag").c_str(), sizeof(ckpt->etag));
+        log_i("Starting download, file size: %d bytes", size);
+        if ((size > 0) && (size < 1000000 || size > 2000000)) // Reasonable firmware size range
+        {
+            log_w("Firmware file size (%d bytes) seems unusual", size);
+            // Don't fail, just warn - size limits may vary
+        }
+    }
+    else if (httpCode == HTTP_CODE_RANGE_NOT_SATISFIABLE)
+    {
+        log_w("Resume offset %u rejected, restarting the download", (unsigned)start);
+        otaStreamRestart(ota, ckpt);
+    }
+    else if ((httpCode >= 400) && (httpCode < 500))
+    {
+        log_e("Download request failed with code: %d", httpCode);
+        *fatal = true;
+    }
+    else
+    {
+        log_e("Download request failed with code: %d", httpCode);
+    }
+
+    if (!accepted)
+    {
+        http.end();
+        freeSecureClient(secureClient, usedSpiram);
+        return false;
+    }
+
+    if (ckpt->totalSize > ota->partition->size)
+    {
+        log_e("Firmware size (%u) exceeds partition size (%d)", (unsigned)ckpt->totalSize, ota->partition->size);
+        http.end();
+        freeSecureClient(secureClient, usedSpiram);
+        *fatal = true;
+        return false;
+    }
+
+    WiFiClient *stream = http.getStreamPtr();
+    size_t received = start;
+    size_t nextProgress = received + DOWNLOAD_PROGRESS_STEP;
+    unsigned long startTime = millis();
+    unsigned long lastDataTime = startTime;
+    bool failed = false;
+    bool closed = false;
+
+    while ((ckpt->totalSize == 0) || (received < ckpt->totalSize))
+    {
+        size_t availableBytes = stream->available();
+        if (availableBytes == 0)
+        {
+            if (!http.connected())
+            {
+                closed = true;
+                break;
+            }
+            if ((millis() - lastDataTime) > DOWNLOAD_NO_DATA_TIMEOUT_MS)
+            {
+                log_e("Download timeout: no data received for %lu ms", millis() - lastDataTime);
+                break;
+            }
+            delay(10);
+            continue;
+        }
+
+        size_t bytesToRead = min(availableBytes, sizeof(downloadBuffer));
+        if (ckpt->totalSize != 0)
+        {
+            bytesToRead = min(bytesToRead, (size_t)ckpt->totalSize - received);
+        }
+        int bytesRead = stream->readBytes(downloadBuffer, bytesToRead);
+        if (bytesRead <= 0)
+        {
+            continue;
+        }
+        lastDataTime = millis();
+        ckpt->bytesTransferred += bytesRead;
+
+        if (!otaStreamWrite(ota, ckpt, downloadBuffer, bytesRead))
+        {
+            failed = true;
+            *fatal = true;
+            break;
+        }
+        received += bytesRead;
+
+        if (received >= nextProgress)
+        {
+            nextProgress += DOWNLOAD_PROGRESS_STEP;
+            if (ckpt->totalSize != 0)
+            {
+                log_i("OTA progress: %u/%u bytes (%.1f%%)", (unsigned)received, (unsigned)ckpt->totalSize,
+                      (float)received / ckpt->totalSize * 100);
+            }
+            else
+            {
+                log_i("OTA progress: %u bytes", (unsigned)received);
+            }
+        }
+        yield(); // Give other tasks a chance
+    }
+
+    ckpt->msTransferring += millis() - startTime;
+    http.end();
+    freeSecureClient(secureClient, usedSpiram);
+
+    // Without a known size the end of the body is the end of the image, esp_ota_set_boot_partition() catches a truncation
+    bool complete = !failed && ((ckpt->totalSize == 0) ? closed : (received == ckpt->totalSize));
+    if (!complete)
+    {
+        if (closed)
+        {
+            log_w("HTTP connection closed at %u bytes", (unsigned)received);
+        }
+        otaStreamRewind(ota);
+    }
+    return complete;
+}
+
+// -- delta patch --
+
+/**
+ * @brief Old image reader of the patch applier: the running partition
+ */
+static bool deltaReadOld(void *ctx, uint32_t offset, uint8_t *buf, size_t len)
+{
+    deltaPatch_t *patch = (deltaPatch_t *)ctx;
+    return esp_partition_read(patch->running, offset, buf, len) == ESP_OK;
+}
+
+/**
+ * @brief New image writer of the patch applier: the OTA stream, as a download would
+ */
+static bool deltaWriteNew(void *ctx, const uint8_t *data, size_t len)
+{
+    deltaPatch_t *patch = (deltaPatch_t *)ctx;
+    return otaStreamWrite(patch->ota, patch->ckpt, data, len);
+}
+
+/**
+ * @brief Check that the patch was built from the image this device runs
+ * @details Hashes the first oldSize bytes of the running partition, using
+ *          the inflate window as read buffer before inflating starts
+ */
+static bool deltaBaseMatches(deltaPatch_t *patch, const ota_delta_header_t *hdr)
+{
+    if (hdr->oldSize > patch->running->size)
+    {
+        return false;
+    }
+
+    mbedtls_sha256_context sha;
+    uint8_t hash[HASH_LENGTH];
+    bool readOk = true;
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+    for (uint32_t offset = 0; readOk && (offset < hdr->oldSize); offset += sizeof(patch->dict))
+    {
+        size_t len = min((size_t)(hdr->oldSize - offset), sizeof(patch->dict));
+        readOk = (esp_partition_read(patch->running, offset, patch->dict, len) == ESP_OK);
+        mbedtls_sha256_update(&sha, patch->dict, len);
+    }
+    mbedtls_sha256_finish(&sha, hash);
+    mbedtls_sha256_free(&sha);
+
+    return readOk && (memcmp(hash, hdr->oldSha, HASH_LENGTH) == 0);
+}
+
+/**
+ * @brief Rebuild the release image from the running one and a delta patch
+ * @details The patch is inflated and applied as it arrives; the rebuilt bytes
+ *          go through the same OTA stream, chunk checkpoints and final checks
+ *          as a full download.
+ * @param keepWritten set when the connection dropped mid-patch: what was
+ *        written is the start of the new image and the full download can
+ *        continue after it
+ * @param newHash hex SHA-256 of the new image from the patch header, empty
+ *        until a header that applies was received
+ * @return true if the whole image was rebuilt
+ */
+static bool applyDeltaPatch(otaStream_t *ota, fwResumeCheckpoint_t *ckpt, const String &patchUrl, bool *keepWritten,
+                            String *newHash)
+{
+    *keepWritten = false;
+    *newHash = "";
+
+    size_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < DOWNLOAD_MIN_FREE_HEAP + sizeof(deltaPatch_t))
+    {
+        log_w("Not enough memory to apply a delta patch (have %zu bytes)", freeHeap);
+        return false;
+    }
+    deltaPatch_t *patch = (deltaPatch_t *)malloc(sizeof(deltaPatch_t));
+    if (patch == NULL)
+    {
+        log_w("Failed to allocate the delta patch inflater");
+        return false;
+    }
+    patch->running = esp_ota_get_running_partition();
+    patch->ota = ota;
+    patch->ckpt = ckpt;
+    patch->dictOfs = 0;
+
+    HTTPClient http;
+    WiFiClientSecure *secureClient = nullptr;
+    bool usedSpiram = false;
+
+    int httpCode = openDownload(http, patchUrl, &secureClient, &usedSpiram);
+    if (httpCode != HTTP_CODE_OK)
+    {
+        log_w("Delta patch request failed with code: %d", httpCode);
+        http.end();
+        freeSecureClient(secureClient, usedSpiram);
+        free(patch);
+        return false;
+    }
+
+    WiFiClient *stream = http.getStreamPtr();
+    uint8_t header[OTA_DELTA_HEADER_LEN];
+    size_t headerLen = 0;
+    ota_delta_header_t hdr;
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    size_t received = 0;
+    unsigned long startTime = millis();
+    unsigned long lastDataTime = startTime;
+    bool failed = false;
+
+    while ((status != TINFL_STATUS_DONE) && !failed)
+    {
+        size_t availableBytes = stream->available();
+        if (availableBytes == 0)
+        {
+            if (!http.connected() || ((millis() - lastDataTime) > DOWNLOAD_NO_DATA_TIMEOUT_MS))
             {
-                // No data was read
-                if (availableBytes > 0) {
-                    log_w("Stream readBytes returned 0 despite available data: %d", availableBytes);
-                } else {
-                    log_d("No data available and no data read, attempt: %d", consecutiveNoDataCount);
-                }
+                break;
             }
+            delay(10);
+            continue;
+        }
 
-            // Yield more frequently to prevent stack overflow
-            if (++loopCount % 5 == 0) // Increased frequency
-            {
-                yield();  // Give other tasks a chance
-                delay(1); // Small delay to prevent watchdog reset
-            }
+        int bytesRead = stream->readBytes(downloadBuffer, min(availableBytes, sizeof(downloadBuffer)));
+        if (bytesRead <= 0)
+        {
+            continue;
         }
-        else
+        lastDataTime = millis();
+        received += bytesRead;
+        ckpt->bytesTransferred += bytesRead;
+
+        const uint8_t *in = downloadBuffer;
+        size_t inLeft = bytesRead;
+        if (headerLen < OTA_DELTA_HEADER_LEN)
         {
-            // No data available - implement timeout and retry logic
-            consecutiveNoDataCount++;
-            
-            // Check for timeout
-            if ((millis() - lastDataTime) > noDataTimeout)
+            size_t take = min(inLeft, OTA_DELTA_HEADER_LEN - headerLen);
+            memcpy(header + headerLen, in, take);
+            headerLen += take;
+            in += take;
+            inLeft -= take;
+            if (headerLen < OTA_DELTA_HEADER_LEN)
             {
-                log_e("Download timeout: no data received for %lu ms", millis() - lastDataTime);
-                log_e("Connection status: %s, Total downloaded: %d bytes", 
-                      http.connected() ? "connected" : "disconnected", bytesWritten);
-                break;
+                continue;
             }
-            
-            // Check for too many consecutive no-data attempts (reduced threshold)
-            if (consecutiveNoDataCount > 50) // Reduced from 100 to 50 for faster failure detection
+            if (!bOtaDelta_parseHeader(header, sizeof(header), &hdr) || (hdr.newSize > ota->partition->size) ||
+                !deltaBaseMatches(patch, &hdr))
             {
-                log_e("Too many consecutive no-data attempts (%d), connection may be stalled", consecutiveNoDataCount);
-                log_e("Possible causes: SD card issues, network congestion, or server problems");
-                
-                // Final SD card check before giving up
-                if (!SD.exists(filepath.c_str())) 
-                {
-                    log_e("Downloaded file is missing - SD card failure detected!");
-                } else {
-                    log_i("Downloaded file still exists, likely network/server issue");
-                }
+                log_w("Delta patch does not apply to the running firmware");
+                failed = true;
                 break;
             }
-            
-            // Log periodic status when waiting for data (more frequent for better debugging)
-            if (consecutiveNoDataCount % 25 == 0)
+            ckpt->totalSize = hdr.newSize;
+            char hex[HASH_LENGTH * 2 + 1];
+            for (int i = 0; i < HASH_LENGTH; i++)
             {
-                log_d("Waiting for data... attempts: %d, connected: %s, downloaded: %d bytes", 
-                      consecutiveNoDataCount, http.connected() ? "yes" : "no", bytesWritten);
-                      
-                // Periodic SD card health check during long waits
-                if (!SD.exists("/"))
-                {
-                    log_w("SD card root directory check failed during wait");
-                }
+                sprintf(&hex[i * 2], "%02x", hdr.newSha[i]);
             }
-            
-            delay(10);
-            yield(); // Yield when waiting
+            *newHash = hex;
+            tinfl_init(&patch->inflator);
+            vOtaDelta_applyInit(&patch->apply, &hdr, deltaReadOld, deltaWriteNew, patch);
+            log_i("Applying delta patch: %d bytes for a %u byte image", http.getSize(), (unsigned)hdr.newSize);
         }
-        
-        // Additional safety check - if connection is lost, break
-        if (!http.connected())
+
+        // The window is a ring: each call fills it up to its end, then wraps
+        while ((inLeft > 0) || (status == TINFL_STATUS_HAS_MORE_OUTPUT))
         {
-            log_w("HTTP connection lost during download at %d bytes", bytesWritten);
-            break;
+            size_t inBytes = inLeft;
+            size_t outBytes = TINFL_LZ_DICT_SIZE - patch->dictOfs;
+            status = tinfl_decompress(&patch->inflator, in, &inBytes, patch->dict, patch->dict + patch->dictOfs,
+                                      &outBytes, TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+            in += inBytes;
+            inLeft -= inBytes;
+            if ((status < 0) || !bOtaDelta_applyFeed(&patch->apply, patch->dict + patch->dictOfs, outBytes))
+            {
+                log_w("Delta patch failed after %u records (inflate status %d)", (unsigned)patch->apply.records,
+                      (int)status);
+                failed = true;
+                break;
+            }
+            patch->dictOfs = (patch->dictOfs + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+            if (status == TINFL_STATUS_DONE)
+            {
+                break;
+            }
         }
+        yield(); // Give other tasks a chance
     }
-    
-    log_i("Download loop completed - downloaded %d bytes, connection: %s", 
-          bytesWritten, http.connected() ? "connected" : "disconnected");
 
-    // Ensure file is properly flushed and closed
-    file.flush();
-    file.close();
+    ckpt->msTransferring += millis() - startTime;
     http.end();
+    freeSecureClient(secureClient, usedSpiram);
 
-    // Save bytesWritten before any cleanup to avoid corruption
-    int finalBytesWritten = bytesWritten;
+    bool complete = !failed && (status == TINFL_STATUS_DONE) && bOtaDelta_applyDone(&patch->apply);
+    if (complete)
+    {
+        log_i("Delta patch applied: %u bytes received for a %u byte image (%.1f%%), %u records", (unsigned)received,
+              (unsigned)hdr.newSize, 100.0f * received / hdr.newSize, (unsigned)patch->apply.records);
+    }
+    else if (!failed && (status != TINFL_STATUS_DONE))
+    {
+        *keepWritten = (headerLen == OTA_DELTA_HEADER_LEN);
+        log_w("Delta patch download interrupted at %u bytes", (unsigned)received);
+    }
+    else if (!failed)
+    {
+        log_w("Delta patch ended before the whole image was rebuilt");
+    }
 
-    // Clean up HTTPS client if used
-    if (secureClient)
+    free(patch);
+    return complete;
+}
+
+// -- full download --
+
+/**
+ * @brief Download a firmware image into the next OTA partition in one pass,
+ *        resuming with Range requests after a dropped connection and, from
+ *        the last checkpointed chunk, after a reboot
+ * @param url firmware binary URL
+ * @param expectedHash hex SHA-256 the image must have, empty to skip
+ * @param patchUrl delta patch from the running firmware, tried first; empty for none
+ * @return true if the image is written, verified and set to boot
+ */
+static bool streamFirmwareToOta(const String &url, const String &expectedHash, const String &patchUrl)
+{
+    downloadResumable = false;
+
+    // Disable network connectivity tests during download to prevent interference
+    setFirmwareDownloadInProgress();
+
+    size_t freeHeap = ESP.getFreeHeap();
+    log_i("Free heap before download: %zu bytes", freeHeap);
+    if (freeHeap < DOWNLOAD_MIN_FREE_HEAP)
+    {
+        log_e("Insufficient memory for download (need 50KB, have %zu bytes)", freeHeap);
+        clearFirmwareDownloadInProgress();
+        return false;
+    }
+
+    static otaStream_t ota;              // Static to avoid stack allocation
+    static fwResumeCheckpoint_t ckpt;    // idem
+    if (!otaStreamBegin(&ota))
+    {
+        clearFirmwareDownloadInProgress();
+        return false;
+    }
+
+    if (loadResumeCheckpoint(&ckpt) && (strcmp(ckpt.url, url.c_str()) == 0) &&
+        (ckpt.partitionAddress == ota.partition->address) && (ckpt.committed > 0))
+    {
+        size_t kept = otaStreamRestore(&ota, &ckpt);
+        ckpt.resumes++;
+        log_i("Resuming interrupted firmware download: %u of %u bytes already flashed", (unsigned)kept,
+              (unsigned)ckpt.totalSize);
+    }
+    else
+    {
+        memset(&ckpt, 0, sizeof(ckpt));
+        strlcpy(ckpt.url, url.c_str(), sizeof(ckpt.url));
+        ckpt.partitionAddress = ota.partition->address;
+    }
+
+    bool complete = false;
+    bool fatal = false;
+    bool patched = false; // the image holds bytes rebuilt from the patch
+    String imageHash = expectedHash;
+    if (!patchUrl.isEmpty() && (ota.written == 0))
+    {
+        bool keepWritten = false;
+        String patchHash;
+        complete = applyDeltaPatch(&ota, &ckpt, patchUrl, &keepWritten, &patchHash);
+        patched = complete || keepWritten;
+        if (!complete && keepWritten)
+        {
+            otaStreamRewind(&ota);
+            log_w("Continuing with the full image from %u bytes", (unsigned)ota.written);
+        }
+        else if (!complete)
+        {
+            otaStreamRestart(&ota, &ckpt);
+            patchHash = ""; // a patch that did not apply says nothing about the full image
+            log_w("Falling back to the full image");
+        }
+        if (imageHash.isEmpty() && !patchHash.isEmpty())
+        {
+            imageHash = patchHash; // without a release hash asset, the image must still be the one the patch was built for
+            log_i("Checking the image against the delta patch hash");
+        }
+    }
+    for (int attempt = 0; (attempt < FW_RESUME_MAX_ATTEMPTS) && !complete && !fatal; attempt++)
+    {
+        if (attempt > 0)
+        {
+            ckpt.resumes++;
+            log_w("Firmware download interrupted at %u bytes, reconnecting (attempt %d/%d)", (unsigned)ota.written,
+                  attempt + 1, FW_RESUME_MAX_ATTEMPTS);
+            delay(FW_RESUME_RETRY_DELAY_MS * attempt);
+        }
+        complete = downloadImagePart(&ota, &ckpt, url, &fatal);
+    }
+
+    log_i("Firmware download: %u/%u bytes flashed, %u bytes transferred in %u ms (%.1f KB/s), %u resumes",
+          (unsigned)(ota.written + ota.pending), (unsigned)ckpt.totalSize, (unsigned)ckpt.bytesTransferred,
+          (unsigned)ckpt.msTransferring,
+          (ckpt.msTransferring > 0) ? (ckpt.bytesTransferred / 1.024f) / ckpt.msTransferring : 0.0f,
+          (unsigned)ckpt.resumes);
+
+    bool success = false;
+    if (complete)
+    {
+        success = otaStreamFinish(&ota, &ckpt, imageHash);
+        clearResumeCheckpoint(); // flashed and verified, or bad: either way not worth resuming
+    }
+    else
     {
-        if (usedSpiram)
+        otaStreamAbort(&ota);
+        if (fatal || (ckpt.committed == 0))
         {
-            secureClient->~WiFiClientSecure();
-            heap_caps_free(secureClient);
+            clearResumeCheckpoint();
         }
         else
         {
-            delete secureClient;
+            storeResumeCheckpoint(&ckpt); // counters of this attempt
+            downloadResumable = true;
+            log_i("Firmware download checkpoint kept at %u bytes", (unsigned)ckpt.committed);
         }
-        secureClient = nullptr;
     }
 
-    // Check if download was successful - require exact file size match for FOTA safety
-    bool downloadSuccessful = false;
-    
-    if (originalFileSize > 0)
+    clearFirmwareDownloadInProgress();
+
+    // A patched image that fails its checks would fail the same way on every check: skip the patch from now on
+    if (complete && !success && patched)
     {
-        // We know the expected size - require exact match for firmware safety
-        downloadSuccessful = (finalBytesWritten == originalFileSize);
-        log_i("Download validation: %d bytes written, expected: %d bytes, match: %s", 
-              finalBytesWritten, originalFileSize, downloadSuccessful ? "EXACT" : "FAILED");
-        
-        if (!downloadSuccessful)
+        rejectDeltaPatch(patchUrl);
+        log_w("Image rebuilt from the delta patch failed verification, downloading the full image");
+        return streamFirmwareToOta(url, expectedHash, "");
+    }
+    return success;
+}
+
+// -- install from SD --
+
+/**
+ * @brief Flash side of an SD install: takes filled buffers from the reader
+ *        and hands them back once written
+ */
+static void sdInstallWriterTask(void *pvParameters)
+{
+    sdInstall_t *inst = (sdInstall_t *)pvParameters;
+    uint8_t idx;
+
+    while ((xQueueReceive(inst->filled, &idx, portMAX_DELAY) == pdTRUE) && (idx != SD_INSTALL_END))
+    {
+        if (inst->err == ESP_OK)
         {
-            log_e("CRITICAL: Incomplete firmware download detected!");
-            log_e("Expected: %d bytes, Got: %d bytes, Missing: %d bytes", 
-                  originalFileSize, finalBytesWritten, originalFileSize - finalBytesWritten);
-            log_e("FOTA update will be aborted to prevent device corruption");
+            unsigned long startUs = micros();
+            inst->err = esp_ota_write(inst->handle, inst->buf[idx], inst->len[idx]);
+            inst->writeUs += micros() - startUs;
         }
+        xQueueSend(inst->free, &idx, portMAX_DELAY);
     }
-    else
+
+    xTaskNotifyGive(inst->reader);
+    vTaskDelete(NULL);
+}
+
+/**
+ * @brief Copy an image file into a begun OTA update
+ * @details Double buffered: this task reads the next block from the card
+ *          while a writer task on the other core erases and programs the
+ *          previous one, so the install takes about the longer of the two
+ *          instead of their sum.
+ * @param file open image file, read from its current position
+ * @param size bytes to copy
+ * @param handle from esp_ota_begin(), sequential writes so erasing is spread over the copy
+ * @return true if every byte was read and written
+ */
+static bool flashImageFromFile(File &file, size_t size, esp_ota_handle_t handle)
+{
+    static sdInstall_t inst; // Static to avoid stack allocation
+    memset(&inst, 0, sizeof(inst));
+    inst.handle = handle;
+    inst.reader = xTaskGetCurrentTaskHandle();
+    inst.err = ESP_OK;
+    inst.buf[0] = (uint8_t *)malloc(SD_INSTALL_BLOCK_SIZE);
+    inst.buf[1] = (uint8_t *)malloc(SD_INSTALL_BLOCK_SIZE);
+    inst.filled = xQueueCreate(SD_INSTALL_BUFFERS + 1, sizeof(uint8_t)); // room for the end marker
+    inst.free = xQueueCreate(SD_INSTALL_BUFFERS, sizeof(uint8_t));
+
+    TaskHandle_t writer = NULL;
+    bool ready = (inst.buf[0] != NULL) && (inst.buf[1] != NULL) && (inst.filled != NULL) && (inst.free != NULL);
+    if (ready)
+    {
+        for (uint8_t idx = 0; idx < SD_INSTALL_BUFFERS; idx++)
+        {
+            xQueueSend(inst.free, &idx, 0);
+        }
+        ready = (xTaskCreatePinnedToCore(sdInstallWriterTask, "otaWriter", SD_INSTALL_WRITER_STACK_SIZE, &inst,
+                                         uxTaskPriorityGet(NULL), &writer, 1 - xPortGetCoreID()) == pdPASS);
+    }
+    if (!ready)
     {
-        // Unknown size, assume success if we got reasonable amount of data
-        downloadSuccessful = (finalBytesWritten > 100000); // At least 100KB
-        log_w("Download validation: %d bytes written (unknown expected size), success: %s", 
-              finalBytesWritten, downloadSuccessful ? "ASSUMED" : "FAILED");
+        log_e("Failed to set up the SD install pipeline");
+        if (inst.filled != NULL)
+        {
+            vQueueDelete(inst.filled);
+        }
+        if (inst.free != NULL)
+        {
+            vQueueDelete(inst.free);
+        }
+        free(inst.buf[0]);
+        free(inst.buf[1]);
+        return false;
     }
-    
-    log_i("Download completed: %d bytes written to %s", finalBytesWritten, filepath.c_str());
-    
-    if (!downloadSuccessful)
+
+    size_t total = 0;
+    size_t nextProgress = DOWNLOAD_PROGRESS_STEP;
+    unsigned long readUs = 0;
+    unsigned long startMs = millis();
+    bool readOk = true;
+
+    while ((total < size) && readOk)
     {
-        log_e("Download appears to be incomplete or failed");
-        log_e("Performing controlled reboot to prevent system instability...");
-        clearFirmwareDownloadInProgress();
-        
-        // Remove potentially corrupted firmware file
-        if (SD.exists(filepath.c_str()))
+        uint8_t idx;
+        xQueueReceive(inst.free, &idx, portMAX_DELAY);
+        if (inst.err != ESP_OK)
         {
-            SD.remove(filepath.c_str());
-            log_i("Removed corrupted firmware file: %s", filepath.c_str());
+            break;
+        }
+
+        unsigned long startUs = micros();
+        int bytesRead = file.read(inst.buf[idx], min(size - total, (size_t)SD_INSTALL_BLOCK_SIZE));
+        readUs += micros() - startUs;
+        if (bytesRead <= 0)
+        {
+            log_e("SD read failed at offset %u", (unsigned)total);
+            readOk = false;
+            break;
+        }
+
+        inst.len[idx] = bytesRead;
+        xQueueSend(inst.filled, &idx, portMAX_DELAY);
+        total += bytesRead;
+
+        if (total >= nextProgress)
+        {
+            nextProgress += DOWNLOAD_PROGRESS_STEP;
+            log_i("OTA progress: %u/%u bytes (%.1f%%)", (unsigned)total, (unsigned)size, (float)total / size * 100);
         }
-        
-        // Brief delay before reboot to ensure logs are written
-        delay(2000);
-        
-        // Perform controlled reboot instead of returning false
-        esp_restart();
-        
-        return false; // Will never reach here due to restart
     }
-    
-    // Re-enable network connectivity tests
-    clearFirmwareDownloadInProgress();
-    
-    // Phase 1 complete: Download successful, restart to apply update
-    log_i("Download successful - restarting to apply firmware update with clean heap");
-    delay(1000); // Brief delay to ensure logs are written
-    esp_restart();
-    
-    return true; // Will never reach here due to restart
+
+    // The writer drains what is queued, then exits
+    uint8_t end = SD_INSTALL_END;
+    xQueueSend(inst.filled, &end, portMAX_DELAY);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    unsigned long elapsedMs = millis() - startMs;
+    log_i("SD install: %u bytes in %lu ms (%.1f KB/s), card read %lu ms, flash erase+write %lu ms",
+          (unsigned)total, elapsedMs, (elapsedMs > 0) ? (total / 1.024f) / elapsedMs : 0.0f, readUs / 1000,
+          inst.writeUs / 1000);
+
+    if (inst.err != ESP_OK)
+    {
+        log_e("OTA write failed: %s", esp_err_to_name(inst.err));
+    }
+
+    vQueueDelete(inst.filled);
+    vQueueDelete(inst.free);
+    free(inst.buf[0]);
+    free(inst.buf[1]);
+    return readOk && (inst.err == ESP_OK) && (total == size);
 }
 
 // ESP-IDF OTA management functions implementation
@@ -1839,9 +2939,9 @@ bool bHalFirmware_checkAndApplyPendingUpdate(const char* firmwarePath)
         return false;
     }
     
-    // Begin OTA update
+    // Begin OTA update; sectors are erased as the copy reaches them
     esp_ota_handle_t ota_handle = 0;
-    esp_err_t err = esp_ota_begin(update_partition, fileSize, &ota_handle);
+    esp_err_t err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
     if (err != ESP_OK) {
         log_e("Failed to begin OTA update: %s", esp_err_to_name(err));
         firmwareFile.close();
@@ -1850,36 +2950,13 @@ bool bHalFirmware_checkAndApplyPendingUpdate(const char* firmwarePath)
     
     log_i("OTA update started successfully");
     
-    // Write firmware in chunks
-    uint8_t buffer[1024];
-    size_t totalWritten = 0;
-    bool updateSuccess = true;
-    
     log_i("Writing firmware data...");
-    while (firmwareFile.available() && updateSuccess) {
-        size_t bytesRead = firmwareFile.readBytes((char*)buffer, sizeof(buffer));
-        if (bytesRead > 0) {
-            err = esp_ota_write(ota_handle, buffer, bytesRead);
-            if (err != ESP_OK) {
-                log_e("Failed to write OTA data at offset %d: %s", 
-                      totalWritten, esp_err_to_name(err));
-                updateSuccess = false;
-                break;
-            }
-            totalWritten += bytesRead;
-            
-            // Log progress every 100KB
-            if (totalWritten % (100 * 1024) == 0) {
-                log_i("Written: %d / %d bytes (%.1f%%)", 
-                      totalWritten, fileSize, (totalWritten * 100.0f) / fileSize);
-            }
-        }
-    }
+    bool updateSuccess = flashImageFromFile(firmwareFile, fileSize, ota_handle);
     
     firmwareFile.close();
     
-    if (updateSuccess && totalWritten == fileSize) {
-        log_i("Firmware write completed: %d bytes", totalWritten);
+    if (updateSuccess) {
+        log_i("Firmware write completed: %d bytes", fileSize);
         
         // Finalize OTA update
         err = esp_ota_end(ota_handle);
@@ -1900,8 +2977,8 @@ bool bHalFirmware_checkAndApplyPendingUpdate(const char* firmwarePath)
         esp_restart(); // This will boot into new firmware
         return true; // Never reached
     } else {
-        log_e("Firmware write failed: written %d, expected %d", totalWritten, fileSize);
-        esp_ota_end(ota_handle); // End OTA even on failure
+        log_e("Firmware write failed");
+        esp_ota_abort(ota_handle);
         return false;
     }
 }
\ No newline at end of file
@@ -18,7 +18,8 @@
 // Function declarations
 bool bHalFirmware_checkForUpdates(systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo);
 bool bHalFirmware_compareVersions(const String &currentVersion, const String &remoteVersion);
-bool bHalFirmware_downloadBinaryFirmware(const String &downloadUrl, systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo);
+bool bHalFirmware_downloadBinaryFirmware(const String &downloadUrl, systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo,
+                                         const String &patchUrl = "");
 bool bHalFirmware_performOTAUpdate(const String &firmwarePath);
 bool bHalFirmware_forceOTAUpdate(systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo);
 
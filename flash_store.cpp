@@ -0,0 +1,410 @@
+/************************************************************************************************
+ * @file    flash_store.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Internal flash fallback log store for the Milano Smart Park project
+ * @version 0.1
+ * @date    2025-09-13
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ************************************************************************************************/
+
+// -- includes --
+#include <LittleFS.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "flash_store.h"
+#include "config.h"
+
+#define FLASH_STORE_BASE_PATH "/flash"
+#define FLASH_STORE_MAX_OPEN_FILES 2
+#define FLASH_STORE_DIR "/ring"
+#define FLASH_STORE_PATH_LEN 32
+#define FLASH_STORE_READ_RECORDS 16
+#define FLASH_STORE_APPEND_OVERHEAD 256 // metadata commit plus amortized compaction per append (estimate)
+
+#define BASE_YEAR_OFFSET 1900
+#define MONTH_OFFSET 1
+#define MINUTES_PER_HOUR 60
+
+// Segment record: the day is not in log_bin_record_t, which only carries the minute
+typedef struct __attribute__((packed)) __FLASH_STORE_RECORD__
+{
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  log_bin_record_t rec;
+} flash_store_record_t;
+
+static SemaphoreHandle_t flashStoreMutex = NULL;
+static StaticSemaphore_t flashStoreMutexBuffer;
+
+static bool mounted = false;
+static uint32_t headSeq = 0;   /*!< oldest segment */
+static uint32_t tailSeq = 0;   /*!< segment being appended */
+static uint32_t segCount = 0;  /*!< segments on flash, 0 for an empty ring */
+static size_t tailBytes = 0;   /*!< bytes in the tail segment */
+static int budgetDayKey = -1;  /*!< day the daily counters belong to, rebuilt from the segments at mount */
+static flash_store_stats_t stats;
+
+static void vFlashStore_lock(void)
+{
+  if (flashStoreMutex != NULL)
+  {
+    xSemaphoreTake(flashStoreMutex, portMAX_DELAY);
+  }
+}
+
+static void vFlashStore_unlock(void)
+{
+  if (flashStoreMutex != NULL)
+  {
+    xSemaphoreGive(flashStoreMutex);
+  }
+}
+
+static void vFlashStore_segmentPath(uint32_t seq, char *path)
+{
+  snprintf(path, FLASH_STORE_PATH_LEN, FLASH_STORE_DIR "/%08lu.seg", (unsigned long)seq);
+}
+
+/**************************************************************
+ * @brief records held by a segment (a torn tail is not counted)
+ *************************************************************/
+static uint32_t ulFlashStore_segmentRecords(uint32_t seq)
+{
+  char path[FLASH_STORE_PATH_LEN];
+  vFlashStore_segmentPath(seq, path);
+  File seg = LittleFS.open(path, FILE_READ);
+  if (!seg)
+  {
+    return 0;
+  }
+  uint32_t records = seg.size() / sizeof(flash_store_record_t);
+  seg.close();
+  return records;
+}
+
+static int iFlashStore_dayKey(const flash_store_record_t *entry)
+{
+  return (entry->year * 12 + entry->month) * 31 + entry->day;
+}
+
+/**************************************************************
+ * @brief restore the daily budget counters after a reboot
+ *
+ * @details Records are appended in time order, so the newest
+ *          day is a run at the end of the ring: walk the
+ *          segments back from the tail until that run starts.
+ *          Segments drained to a card before the reboot are
+ *          gone and not counted.
+ *************************************************************/
+static void vFlashStore_rebuildBudget(void)
+{
+  flash_store_record_t records[FLASH_STORE_READ_RECORDS];
+  uint32_t todayRecords = 0;
+
+  for (uint32_t n = 0; n < segCount; n++)
+  {
+    char path[FLASH_STORE_PATH_LEN];
+    vFlashStore_segmentPath(tailSeq - n, path);
+    File seg = LittleFS.open(path, FILE_READ);
+    int firstKey = -1;
+    int runKey = -1;
+    uint32_t runCount = 0;
+    size_t got;
+
+    while (seg && ((got = seg.read((uint8_t *)records, sizeof(records))) >= sizeof(flash_store_record_t)))
+    {
+      for (size_t i = 0; i < (got / sizeof(flash_store_record_t)); i++)
+      {
+        int key = iFlashStore_dayKey(&records[i]);
+        firstKey = (firstKey < 0) ? key : firstKey;
+        if (key != runKey)
+        {
+          runKey = key;
+          runCount = 0;
+        }
+        runCount++;
+      }
+    }
+    seg.close();
+
+    if (runKey < 0)
+    {
+      continue; // empty segment
+    }
+    if (budgetDayKey < 0)
+    {
+      budgetDayKey = runKey;
+    }
+    else if (runKey != budgetDayKey)
+    {
+      break;
+    }
+    todayRecords += runCount;
+    if (firstKey != runKey)
+    {
+      break;
+    }
+  }
+
+  stats.bytesToday = todayRecords * sizeof(flash_store_record_t);
+  stats.flashBytesToday = todayRecords * (sizeof(flash_store_record_t) + FLASH_STORE_APPEND_OVERHEAD);
+}
+
+/**************************************************************
+ * @brief drop the oldest segment
+ *************************************************************/
+static void vFlashStore_removeHead(void)
+{
+  char path[FLASH_STORE_PATH_LEN];
+  vFlashStore_segmentPath(headSeq, path);
+  LittleFS.remove(path);
+  headSeq++;
+  segCount--;
+  if (segCount == 0)
+  {
+    tailBytes = 0;
+  }
+}
+
+/********************************************************
+ * @brief mount the partition and find the ring ends
+ *
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalFlashStore_init(void)
+{
+  if (flashStoreMutex == NULL)
+  {
+    flashStoreMutex = xSemaphoreCreateMutexStatic(&flashStoreMutexBuffer);
+  }
+
+  vFlashStore_lock();
+  if (mounted)
+  {
+    vFlashStore_unlock();
+    return true;
+  }
+
+  unsigned long startMs = millis();
+  if (!LittleFS.begin(true, FLASH_STORE_BASE_PATH, FLASH_STORE_MAX_OPEN_FILES, FLASH_STORE_PARTITION_LABEL))
+  {
+    log_e("Flash fallback store: cannot mount partition '%s'", FLASH_STORE_PARTITION_LABEL);
+    vFlashStore_unlock();
+    return false;
+  }
+  if (!LittleFS.exists(FLASH_STORE_DIR))
+  {
+    LittleFS.mkdir(FLASH_STORE_DIR);
+  }
+
+  // Segment names are increasing sequence numbers: the ring ends are the smallest and largest
+  uint32_t minSeq = UINT32_MAX;
+  uint32_t maxSeq = 0;
+  segCount = 0;
+  stats.pending = 0;
+  File dir = LittleFS.open(FLASH_STORE_DIR);
+  for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+  {
+    uint32_t seq = strtoul(entry.name(), NULL, 10);
+    minSeq = (seq < minSeq) ? seq : minSeq;
+    maxSeq = (seq > maxSeq) ? seq : maxSeq;
+    segCount++;
+    stats.pending += entry.size() / sizeof(flash_store_record_t);
+    entry.close();
+  }
+  dir.close();
+
+  if (segCount > 0)
+  {
+    char path[FLASH_STORE_PATH_LEN];
+    headSeq = minSeq;
+    tailSeq = maxSeq;
+    vFlashStore_segmentPath(tailSeq, path);
+    File tail = LittleFS.open(path, FILE_READ);
+    tailBytes = tail ? tail.size() : 0;
+    tail.close();
+    if ((tailBytes % sizeof(flash_store_record_t)) != 0)
+    {
+      tailBytes = FLASH_STORE_SEGMENT_SIZE; // torn record from a power cut: continue in a new segment
+    }
+    vFlashStore_rebuildBudget();
+  }
+  mounted = true;
+  vFlashStore_unlock();
+
+  log_i("Flash fallback store mounted in %lu ms: %lu segments, %lu records pending, %u of %u KB used, %lu of %lu budget bytes spent",
+        millis() - startMs, (unsigned long)segCount, (unsigned long)stats.pending,
+        (unsigned)(LittleFS.usedBytes() / 1024), (unsigned)(LittleFS.totalBytes() / 1024),
+        (unsigned long)stats.flashBytesToday, (unsigned long)FLASH_STORE_DAILY_BUDGET);
+  return true;
+}
+
+/********************************************************
+ * @brief store one record
+ *
+ * @param timeInfo
+ * @param rec
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalFlashStore_append(const struct tm *timeInfo, const log_bin_record_t *rec)
+{
+  flash_store_record_t entry;
+  entry.year = (uint16_t)(timeInfo->tm_year + BASE_YEAR_OFFSET);
+  entry.month = (uint8_t)(timeInfo->tm_mon + MONTH_OFFSET);
+  entry.day = (uint8_t)timeInfo->tm_mday;
+  entry.rec = *rec;
+
+  vFlashStore_lock();
+  if (!mounted)
+  {
+    vFlashStore_unlock();
+    return false;
+  }
+
+  // Endurance: daily budget of programmed bytes, estimated per append
+  int dayKey = iFlashStore_dayKey(&entry);
+  if (dayKey != budgetDayKey)
+  {
+    budgetDayKey = dayKey;
+    stats.bytesToday = 0;
+    stats.flashBytesToday = 0;
+  }
+  uint32_t cost = sizeof(entry) + FLASH_STORE_APPEND_OVERHEAD;
+  if ((stats.flashBytesToday + cost) > FLASH_STORE_DAILY_BUDGET)
+  {
+    if ((stats.droppedBudget++ % 64) == 0)
+    {
+      log_w("Flash fallback store: daily write budget spent, %lu records dropped", (unsigned long)stats.droppedBudget);
+    }
+    vFlashStore_unlock();
+    return false;
+  }
+
+  // Roll to a new segment when the tail is full; a full ring gives up its oldest segment
+  if ((segCount == 0) || ((tailBytes + sizeof(entry)) > FLASH_STORE_SEGMENT_SIZE))
+  {
+    tailSeq = (segCount == 0) ? headSeq : (tailSeq + 1);
+    segCount++;
+    tailBytes = 0;
+    if (segCount > FLASH_STORE_MAX_SEGMENTS)
+    {
+      uint32_t lost = ulFlashStore_segmentRecords(headSeq);
+      log_w("Flash fallback store full, overwriting %lu oldest records", (unsigned long)lost);
+      vFlashStore_removeHead();
+      stats.overwritten += lost;
+      stats.pending -= lost;
+    }
+  }
+
+  char path[FLASH_STORE_PATH_LEN];
+  vFlashStore_segmentPath(tailSeq, path);
+  File seg = LittleFS.open(path, FILE_APPEND);
+  bool ok = seg && (seg.write((const uint8_t *)&entry, sizeof(entry)) == sizeof(entry));
+  seg.close();
+
+  if (ok)
+  {
+    tailBytes += sizeof(entry);
+    stats.records++;
+    stats.pending++;
+    stats.bytesToday += sizeof(entry);
+    stats.flashBytesToday += cost;
+  }
+  else
+  {
+    log_e("Flash fallback store: write to %s failed", path);
+  }
+  vFlashStore_unlock();
+  return ok;
+}
+
+/********************************************************
+ * @brief hand stored records back oldest first
+ *
+ * @param maxSegments
+ * @param cb
+ * @param commit
+ * @param ctx
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalFlashStore_drain(uint8_t maxSegments, flash_store_drain_cb_t cb, flash_store_commit_cb_t commit, void *ctx)
+{
+  flash_store_record_t records[FLASH_STORE_READ_RECORDS];
+
+  vFlashStore_lock();
+  for (uint8_t done = 0; mounted && (segCount > 0) && (done < maxSegments); done++)
+  {
+    char path[FLASH_STORE_PATH_LEN];
+    vFlashStore_segmentPath(headSeq, path);
+    File seg = LittleFS.open(path, FILE_READ);
+    uint32_t handed = 0;
+    bool accepted = true;
+    size_t got;
+
+    while (seg && accepted && ((got = seg.read((uint8_t *)records, sizeof(records))) >= sizeof(flash_store_record_t)))
+    {
+      for (size_t i = 0; (i < (got / sizeof(flash_store_record_t))) && accepted; i++)
+      {
+        struct tm timeInfo = {};
+        timeInfo.tm_year = records[i].year - BASE_YEAR_OFFSET;
+        timeInfo.tm_mon = records[i].month - MONTH_OFFSET;
+        timeInfo.tm_mday = records[i].day;
+        timeInfo.tm_hour = records[i].rec.minuteOfDay / MINUTES_PER_HOUR;
+        timeInfo.tm_min = records[i].rec.minuteOfDay % MINUTES_PER_HOUR;
+        timeInfo.tm_isdst = -1;
+        accepted = cb(&timeInfo, &records[i].rec, ctx);
+        handed += accepted ? 1 : 0;
+      }
+    }
+    seg.close();
+
+    // A segment is only deleted once its records are durable; a cut before re-delivers it
+    if (!accepted || !commit(ctx))
+    {
+      log_w("Flash fallback store: drain of %s interrupted after %lu records", path, (unsigned long)handed);
+      break;
+    }
+    vFlashStore_removeHead();
+    stats.drained += handed;
+    stats.pending = (stats.pending > handed) ? (stats.pending - handed) : 0;
+  }
+  bool empty = (segCount == 0);
+  vFlashStore_unlock();
+
+  return empty;
+}
+
+/********************************************************
+ * @brief true if records are waiting for a card
+ *
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalFlashStore_hasPending(void)
+{
+  vFlashStore_lock();
+  bool pending = mounted && (segCount > 0);
+  vFlashStore_unlock();
+  return pending;
+}
+
+/********************************************************
+ * @brief copy the store counters
+ *
+ * @param out
+ ********************************************************/
+void vHalFlashStore_getStats(flash_store_stats_t *out)
+{
+  vFlashStore_lock();
+  *out = stats;
+  vFlashStore_unlock();
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,96 @@
+/******************************************************************************************************
+ * @file    flash_store.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Internal flash fallback log store for the Milano Smart Park project
+ * @details Ring of segment files on a LittleFS partition that takes the log records while
+ *          no SD card is present, and hands them back, oldest first, once a card reappears.
+ *          LittleFS spreads block erases over the partition; the store adds a daily write
+ *          budget so a long outage cannot wear the flash out.
+ * @version 0.1
+ * @date    2025-09-13
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *****************************************************************************************************/
+
+#ifndef FLASH_STORE_H
+#define FLASH_STORE_H
+
+// -- includes --
+#include <Arduino.h>
+#include <time.h>
+#include "log_codec.h"
+
+typedef struct __FLASH_STORE_STATS__
+{
+  uint32_t records;        /*!< records stored since boot */
+  uint32_t drained;        /*!< records handed back since boot */
+  uint32_t overwritten;    /*!< records lost to the ring wrapping */
+  uint32_t droppedBudget;  /*!< records refused by the daily budget */
+  uint32_t bytesToday;     /*!< record bytes written today */
+  uint32_t flashBytesToday; /*!< estimated bytes programmed today (block granularity) */
+  uint32_t pending;        /*!< records waiting for a card */
+} flash_store_stats_t;
+
+/********************************************************
+ * @brief record visitor for bHalFlashStore_drain
+ *
+ * @param timeInfo record timestamp
+ * @param rec      binary record
+ * @param ctx      caller context
+ * @return false to stop (segment stays for the next drain)
+ ********************************************************/
+typedef bool (*flash_store_drain_cb_t)(const struct tm *timeInfo, const log_bin_record_t *rec, void *ctx);
+
+/********************************************************
+ * @brief called after the records of a segment were
+ *        handed over, before the segment is deleted
+ *
+ * @param ctx caller context
+ * @return true the records are durable at the destination
+ ********************************************************/
+typedef bool (*flash_store_commit_cb_t)(void *ctx);
+
+/********************************************************
+ * @brief mount the partition and find the ring ends
+ *
+ * @return true store usable
+ ********************************************************/
+bool bHalFlashStore_init(void);
+
+/********************************************************
+ * @brief store one record
+ *
+ * @param timeInfo record timestamp
+ * @param rec      binary record
+ * @return true    stored
+ * @return false   store unusable or daily budget spent
+ ********************************************************/
+bool bHalFlashStore_append(const struct tm *timeInfo, const log_bin_record_t *rec);
+
+/********************************************************
+ * @brief hand stored records back oldest first; each
+ *        segment is deleted once all its records were
+ *        accepted and committed
+ *
+ * @param maxSegments segments to process in this call
+ * @param cb          record visitor
+ * @param commit      makes the handed-over records durable
+ * @param ctx         visitor context
+ * @return true       store is empty afterwards
+ ********************************************************/
+bool bHalFlashStore_drain(uint8_t maxSegments, flash_store_drain_cb_t cb, flash_store_commit_cb_t commit, void *ctx);
+
+/********************************************************
+ * @brief true if records are waiting for a card
+ ********************************************************/
+bool bHalFlashStore_hasPending(void);
+
+/********************************************************
+ * @brief copy the store counters
+ *
+ * @param stats destination
+ ********************************************************/
+void vHalFlashStore_getStats(flash_store_stats_t *stats);
+
+#endif
@@ -0,0 +1,560 @@
+/*******************************************************************************
+ * @file    log_codec.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   SD daily log record formats for the Milano Smart Park project
+ * @details Must stay free of Arduino/ESP-IDF includes: it is also compiled
+ *          on the host by tools/msplog2csv. Both targets are little-endian,
+ *          so records are stored in memory order.
+ * @version 0.1
+ * @date    2025-09-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ******************************************************************************/
+
+// -- includes --
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "log_codec.h"
+
+#define LOG_CSV_SEPARATOR ';'
+#define LOG_DATE_FORMAT "%d/%m/%Y"
+#define LOG_TIME_FORMAT "%H:%M:%S"
+#define LOG_ISO_DATETIME_FORMAT "%Y-%m-%dT%H:%M:%S.000Z"
+#define LOG_DATETIME_LEN 30
+
+#define BASE_YEAR_OFFSET 1900
+#define MONTH_OFFSET 1
+#define MINUTES_PER_HOUR 60
+
+// CSV_HEADER column positions
+enum
+{
+  LOG_COL_RECORDED_AT = 0,
+  LOG_COL_DATE,
+  LOG_COL_TIME,
+  LOG_COL_YEAR,
+  LOG_COL_MONTH,
+  LOG_COL_TEMP,
+  LOG_COL_HUM,
+  LOG_COL_PM1,
+  LOG_COL_PM25,
+  LOG_COL_PM10,
+  LOG_COL_PRES,
+  LOG_COL_RADIATION,
+  LOG_COL_NOX,
+  LOG_COL_CO,
+  LOG_COL_NH3,
+  LOG_COL_O3,
+  LOG_COL_VOC,
+  LOG_COL_MSP,
+  LOG_COL_COUNT
+};
+
+// Fixed point scales of log_bin_record_t
+#define LOG_SCALE_TEMP 100.0f
+#define LOG_SCALE_HUM 100.0f
+#define LOG_SCALE_PRE 10.0f
+#define LOG_SCALE_VOC 10.0f
+#define LOG_SCALE_GAS 10.0f
+#define LOG_SCALE_CO 1.0f
+
+// Header layout: magic, schema, record size, year (LE), month, day, reserved, data end (LE)
+#define LOG_BIN_HDR_SCHEMA_OFS 4
+#define LOG_BIN_HDR_RECSIZE_OFS 5
+#define LOG_BIN_HDR_YEAR_OFS 6
+#define LOG_BIN_HDR_MONTH_OFS 8
+#define LOG_BIN_HDR_DAY_OFS 9
+#define LOG_BIN_HDR_DATAEND_OFS 12
+
+/***************************************************************
+ * @brief appends one CSV column, tracking overflow
+ *
+ * @param buf
+ * @param bufLen
+ * @param pos     current length, updated; -1 once overflowed
+ * @param text    column text, NULL for an empty column
+ * @param last    no separator after the column
+ ***************************************************************/
+static void vLogCodec_appendColumn(char *buf, size_t bufLen, int *pos, const char *text, bool last)
+{
+  if (*pos < 0)
+  {
+    return;
+  }
+
+  size_t textLen = (text != NULL) ? strlen(text) : 0;
+  size_t need = textLen + (last ? 0 : 1);
+  if ((size_t)*pos + need >= bufLen)
+  {
+    *pos = -1;
+    return;
+  }
+
+  memcpy(buf + *pos, text, textLen);
+  *pos += (int)textLen;
+  if (!last)
+  {
+    buf[(*pos)++] = LOG_CSV_SEPARATOR;
+  }
+  buf[*pos] = '\0';
+}
+
+/***************************************************************
+ * @brief appends a 3 decimals float column with a decimal comma
+ *        (same text as vGeneric_floatToComma)
+ ***************************************************************/
+static void vLogCodec_appendFloat(char *buf, size_t bufLen, int *pos, bool present, float value)
+{
+  char text[24];
+
+  if (!present)
+  {
+    vLogCodec_appendColumn(buf, bufLen, pos, NULL, false);
+    return;
+  }
+
+  snprintf(text, sizeof(text), "%.3f", value);
+  char *dot = strchr(text, '.');
+  if (dot != NULL)
+  {
+    *dot = ',';
+  }
+  vLogCodec_appendColumn(buf, bufLen, pos, text, false);
+}
+
+/***************************************************************
+ * @brief appends an integer column
+ ***************************************************************/
+static void vLogCodec_appendInt(char *buf, size_t bufLen, int *pos, bool present, long value, bool last)
+{
+  char text[16];
+
+  if (!present)
+  {
+    vLogCodec_appendColumn(buf, bufLen, pos, NULL, last);
+    return;
+  }
+
+  snprintf(text, sizeof(text), "%ld", value);
+  vLogCodec_appendColumn(buf, bufLen, pos, text, last);
+}
+
+/***************************************************************
+ * @brief builds a CSV_HEADER-layout line
+ *
+ * @param timeInfo
+ * @param flags
+ * @param data
+ * @param buf
+ * @param bufLen
+ * @return int
+ ***************************************************************/
+int iLogCodec_formatCsvLine(const struct tm *timeInfo, uint8_t flags, const send_data_t *data,
+                            char *buf, size_t bufLen)
+{
+  char text[LOG_DATETIME_LEN];
+  bool bme = (flags & LOG_BIN_FLAG_BME680) != 0;
+  bool pms = (flags & LOG_BIN_FLAG_PMS5003) != 0;
+  bool mics = (flags & LOG_BIN_FLAG_MICS6814) != 0;
+  int pos = 0;
+
+  if (bufLen == 0)
+  {
+    return -1;
+  }
+  buf[0] = '\0';
+
+  // recordedAt;date;time;year;month
+  text[0] = '\0';
+  if (flags & LOG_BIN_FLAG_DATETIME)
+  {
+    strftime(text, sizeof(text), LOG_ISO_DATETIME_FORMAT, timeInfo);
+  }
+  vLogCodec_appendColumn(buf, bufLen, &pos, text, false);
+  strftime(text, sizeof(text), LOG_DATE_FORMAT, timeInfo);
+  vLogCodec_appendColumn(buf, bufLen, &pos, text, false);
+  strftime(text, sizeof(text), LOG_TIME_FORMAT, timeInfo);
+  vLogCodec_appendColumn(buf, bufLen, &pos, text, false);
+  vLogCodec_appendInt(buf, bufLen, &pos, true, timeInfo->tm_year + BASE_YEAR_OFFSET, false);
+  vLogCodec_appendInt(buf, bufLen, &pos, true, timeInfo->tm_mon + MONTH_OFFSET, false);
+
+  // temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp
+  vLogCodec_appendFloat(buf, bufLen, &pos, bme, data->temp);
+  vLogCodec_appendFloat(buf, bufLen, &pos, bme, data->hum);
+  vLogCodec_appendInt(buf, bufLen, &pos, pms, (long)data->PM1, false);
+  vLogCodec_appendInt(buf, bufLen, &pos, pms, (long)data->PM25, false);
+  vLogCodec_appendInt(buf, bufLen, &pos, pms, (long)data->PM10, false);
+  vLogCodec_appendFloat(buf, bufLen, &pos, bme, data->pre);
+  vLogCodec_appendColumn(buf, bufLen, &pos, NULL, false); // radiation
+  vLogCodec_appendFloat(buf, bufLen, &pos, mics, data->MICS_NO2);
+  vLogCodec_appendFloat(buf, bufLen, &pos, mics, data->MICS_CO);
+  vLogCodec_appendFloat(buf, bufLen, &pos, mics, data->MICS_NH3);
+  vLogCodec_appendFloat(buf, bufLen, &pos, (flags & LOG_BIN_FLAG_O3) != 0, data->ozone);
+  vLogCodec_appendFloat(buf, bufLen, &pos, bme, data->VOC);
+  vLogCodec_appendInt(buf, bufLen, &pos, true, data->MSP, true);
+
+  return pos;
+}
+
+/***************************************************************
+ * @brief reads a comma-decimal column
+ ***************************************************************/
+static float fLogCodec_parseFloat(char *text)
+{
+  char *comma = strchr(text, ',');
+  if (comma != NULL)
+  {
+    *comma = '.';
+  }
+  return strtof(text, NULL);
+}
+
+/***************************************************************
+ * @brief parses a CSV_HEADER-layout line
+ *
+ * @param line
+ * @param timeInfo
+ * @param flags
+ * @param data
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bLogCodec_parseCsvLine(const char *line, struct tm *timeInfo, uint8_t *flags, send_data_t *data)
+{
+  char copy[LOG_CSV_LINE_MAX_LEN];
+  char *cols[LOG_COL_COUNT];
+  size_t lineLen = strlen(line);
+  int count = 0;
+
+  if (lineLen >= sizeof(copy))
+  {
+    return false;
+  }
+  memcpy(copy, line, lineLen + 1);
+
+  // Split in place: empty columns stay as empty strings
+  cols[count++] = copy;
+  for (char *c = copy; (*c != '\0') && (count < LOG_COL_COUNT); c++)
+  {
+    if (*c == LOG_CSV_SEPARATOR)
+    {
+      *c = '\0';
+      cols[count++] = c + 1;
+    }
+  }
+  if (count != LOG_COL_COUNT)
+  {
+    return false;
+  }
+
+  memset(timeInfo, 0, sizeof(*timeInfo));
+  if ((sscanf(cols[LOG_COL_DATE], "%d/%d/%d", &timeInfo->tm_mday, &timeInfo->tm_mon, &timeInfo->tm_year) != 3) ||
+      (sscanf(cols[LOG_COL_TIME], "%d:%d:%d", &timeInfo->tm_hour, &timeInfo->tm_min, &timeInfo->tm_sec) != 3))
+  {
+    return false; // header line or damaged record
+  }
+  timeInfo->tm_mon -= MONTH_OFFSET;
+  timeInfo->tm_year -= BASE_YEAR_OFFSET;
+  timeInfo->tm_isdst = -1;
+
+  memset(data, 0, sizeof(*data));
+  data->sendTimeInfo = *timeInfo;
+  *flags = 0;
+
+  if (cols[LOG_COL_RECORDED_AT][0] != '\0')
+  {
+    *flags |= LOG_BIN_FLAG_DATETIME;
+  }
+  if (cols[LOG_COL_TEMP][0] != '\0')
+  {
+    *flags |= LOG_BIN_FLAG_BME680;
+    data->temp = fLogCodec_parseFloat(cols[LOG_COL_TEMP]);
+    data->hum = fLogCodec_parseFloat(cols[LOG_COL_HUM]);
+    data->pre = fLogCodec_parseFloat(cols[LOG_COL_PRES]);
+    data->VOC = fLogCodec_parseFloat(cols[LOG_COL_VOC]);
+  }
+  if (cols[LOG_COL_PM1][0] != '\0')
+  {
+    *flags |= LOG_BIN_FLAG_PMS5003;
+    data->PM1 = (int32_t)strtol(cols[LOG_COL_PM1], NULL, 10);
+    data->PM25 = (int32_t)strtol(cols[LOG_COL_PM25], NULL, 10);
+    data->PM10 = (int32_t)strtol(cols[LOG_COL_PM10], NULL, 10);
+  }
+  if (cols[LOG_COL_NOX][0] != '\0')
+  {
+    *flags |= LOG_BIN_FLAG_MICS6814;
+    data->MICS_NO2 = fLogCodec_parseFloat(cols[LOG_COL_NOX]);
+    data->MICS_CO = fLogCodec_parseFloat(cols[LOG_COL_CO]);
+    data->MICS_NH3 = fLogCodec_parseFloat(cols[LOG_COL_NH3]);
+  }
+  if (cols[LOG_COL_O3][0] != '\0')
+  {
+    *flags |= LOG_BIN_FLAG_O3;
+    data->ozone = fLogCodec_parseFloat(cols[LOG_COL_O3]);
+  }
+  data->MSP = (int8_t)strtol(cols[LOG_COL_MSP], NULL, 10);
+
+  return true;
+}
+
+/***************************************************************
+ * @brief builds the binary daily file header
+ *
+ * @param day
+ * @param out
+ * @param outLen
+ * @return size_t
+ ***************************************************************/
+size_t uLogCodec_formatBinHeader(const struct tm *day, uint8_t *out, size_t outLen)
+{
+  if (outLen < LOG_BIN_HEADER_LEN)
+  {
+    return 0;
+  }
+
+  uint16_t year = (uint16_t)(day->tm_year + BASE_YEAR_OFFSET);
+  memset(out, 0, LOG_BIN_HEADER_LEN);
+  memcpy(out, LOG_BIN_MAGIC, LOG_BIN_MAGIC_LEN);
+  out[LOG_BIN_HDR_SCHEMA_OFS] = LOG_BIN_SCHEMA_VERSION;
+  out[LOG_BIN_HDR_RECSIZE_OFS] = (uint8_t)sizeof(log_bin_record_t);
+  out[LOG_BIN_HDR_YEAR_OFS] = (uint8_t)(year & 0xFF);
+  out[LOG_BIN_HDR_YEAR_OFS + 1] = (uint8_t)(year >> 8);
+  out[LOG_BIN_HDR_MONTH_OFS] = (uint8_t)(day->tm_mon + MONTH_OFFSET);
+  out[LOG_BIN_HDR_DAY_OFS] = (uint8_t)day->tm_mday;
+
+  return LOG_BIN_HEADER_LEN;
+}
+
+/***************************************************************
+ * @brief validates a binary daily file header
+ *
+ * @param in
+ * @param inLen
+ * @param day
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bLogCodec_parseBinHeader(const uint8_t *in, size_t inLen, struct tm *day)
+{
+  if ((inLen < LOG_BIN_HEADER_LEN) || (memcmp(in, LOG_BIN_MAGIC, LOG_BIN_MAGIC_LEN) != 0))
+  {
+    return false;
+  }
+  if ((in[LOG_BIN_HDR_SCHEMA_OFS] != LOG_BIN_SCHEMA_VERSION) || (in[LOG_BIN_HDR_RECSIZE_OFS] != sizeof(log_bin_record_t)))
+  {
+    return false;
+  }
+
+  memset(day, 0, sizeof(*day));
+  day->tm_year = (int)(in[LOG_BIN_HDR_YEAR_OFS] | (in[LOG_BIN_HDR_YEAR_OFS + 1] << 8)) - BASE_YEAR_OFFSET;
+  day->tm_mon = (int)in[LOG_BIN_HDR_MONTH_OFS] - MONTH_OFFSET;
+  day->tm_mday = (int)in[LOG_BIN_HDR_DAY_OFS];
+  day->tm_isdst = -1;
+
+  return true;
+}
+
+/***************************************************************
+ * @brief data end checkpoint of a preallocated binary file
+ *
+ * @param header
+ * @return uint32_t
+ ***************************************************************/
+uint32_t ulLogCodec_binDataEnd(const uint8_t *header)
+{
+  const uint8_t *p = header + LOG_BIN_HDR_DATAEND_OFS;
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/***************************************************************
+ * @brief stores the data end checkpoint in a header
+ *
+ * @param header
+ * @param dataEnd
+ ***************************************************************/
+void vLogCodec_setBinDataEnd(uint8_t *header, uint32_t dataEnd)
+{
+  uint8_t *p = header + LOG_BIN_HDR_DATAEND_OFS;
+  p[0] = (uint8_t)(dataEnd & 0xFF);
+  p[1] = (uint8_t)((dataEnd >> 8) & 0xFF);
+  p[2] = (uint8_t)((dataEnd >> 16) & 0xFF);
+  p[3] = (uint8_t)(dataEnd >> 24);
+}
+
+/***************************************************************
+ * @brief true for preallocated (never written) record space
+ *
+ * @param rec
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bLogCodec_binRecordBlank(const log_bin_record_t *rec)
+{
+  const uint8_t *p = (const uint8_t *)rec;
+  for (size_t i = 0; i < sizeof(*rec); i++)
+  {
+    if (p[i] != 0)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/***************************************************************
+ * @brief length of a CSV log without its torn last line
+ *
+ * @param tail     last bytes of the file
+ * @param tailLen  bytes in @p tail
+ * @param fileLen  file size
+ * @return size_t  bytes up to and including the last '\n'
+ ***************************************************************/
+size_t uLogCodec_csvCompleteLength(const char *tail, size_t tailLen, size_t fileLen)
+{
+  for (size_t i = tailLen; i > 0; i--)
+  {
+    if (tail[i - 1] == '\n')
+    {
+      return fileLen - tailLen + i;
+    }
+  }
+  return fileLen - tailLen; // no terminator in the tail: the whole tail is one torn line
+}
+
+/***************************************************************
+ * @brief length of a binary log without its torn last record
+ *
+ * @param fileLen
+ * @return size_t
+ ***************************************************************/
+size_t uLogCodec_binCompleteLength(size_t fileLen)
+{
+  if (fileLen < LOG_BIN_HEADER_LEN)
+  {
+    return 0; // torn header: the file is started over
+  }
+  return fileLen - ((fileLen - LOG_BIN_HEADER_LEN) % sizeof(log_bin_record_t));
+}
+
+/***************************************************************
+ * @brief scales and rounds into an unsigned 16 bit field,
+ *        saturating at the type limits
+ ***************************************************************/
+static uint16_t uLogCodec_toU16(float value, float scale)
+{
+  float scaled = roundf(value * scale);
+  if (!(scaled > 0.0f)) // also catches NaN
+  {
+    return 0;
+  }
+  return (scaled >= (float)UINT16_MAX) ? UINT16_MAX : (uint16_t)scaled;
+}
+
+/***************************************************************
+ * @brief scales and rounds into a signed 16 bit field,
+ *        saturating at the type limits
+ ***************************************************************/
+static int16_t iLogCodec_toI16(float value, float scale)
+{
+  float scaled = roundf(value * scale);
+  if (scaled != scaled)
+  {
+    return 0;
+  }
+  if (scaled <= (float)INT16_MIN)
+  {
+    return INT16_MIN;
+  }
+  return (scaled >= (float)INT16_MAX) ? INT16_MAX : (int16_t)scaled;
+}
+
+/***************************************************************
+ * @brief clamps a particulate count into 16 bits
+ ***************************************************************/
+static uint16_t uLogCodec_clampPm(int32_t value)
+{
+  if (value < 0)
+  {
+    return 0;
+  }
+  return (value > UINT16_MAX) ? UINT16_MAX : (uint16_t)value;
+}
+
+/***************************************************************
+ * @brief packs a record into the binary layout
+ *
+ * @param timeInfo
+ * @param flags
+ * @param data
+ * @param rec
+ ***************************************************************/
+void vLogCodec_encodeBin(const struct tm *timeInfo, uint8_t flags, const send_data_t *data, log_bin_record_t *rec)
+{
+  memset(rec, 0, sizeof(*rec));
+  rec->minuteOfDay = (uint16_t)((timeInfo->tm_hour * MINUTES_PER_HOUR) + timeInfo->tm_min);
+  rec->flags = flags;
+  rec->msp = data->MSP;
+
+  if (flags & LOG_BIN_FLAG_BME680)
+  {
+    rec->temp = iLogCodec_toI16(data->temp, LOG_SCALE_TEMP);
+    rec->hum = uLogCodec_toU16(data->hum, LOG_SCALE_HUM);
+    rec->pre = uLogCodec_toU16(data->pre, LOG_SCALE_PRE);
+    rec->voc = uLogCodec_toU16(data->VOC, LOG_SCALE_VOC);
+  }
+  if (flags & LOG_BIN_FLAG_PMS5003)
+  {
+    rec->pm1 = uLogCodec_clampPm(data->PM1);
+    rec->pm25 = uLogCodec_clampPm(data->PM25);
+    rec->pm10 = uLogCodec_clampPm(data->PM10);
+  }
+  if (flags & LOG_BIN_FLAG_MICS6814)
+  {
+    rec->no2 = uLogCodec_toU16(data->MICS_NO2, LOG_SCALE_GAS);
+    rec->co = uLogCodec_toU16(data->MICS_CO, LOG_SCALE_CO);
+    rec->nh3 = uLogCodec_toU16(data->MICS_NH3, LOG_SCALE_GAS);
+  }
+  if (flags & LOG_BIN_FLAG_O3)
+  {
+    rec->o3 = uLogCodec_toU16(data->ozone, LOG_SCALE_GAS);
+  }
+}
+
+/***************************************************************
+ * @brief unpacks a binary record
+ *
+ * @param rec
+ * @param day
+ * @param timeInfo
+ * @param flags
+ * @param data
+ ***************************************************************/
+void vLogCodec_decodeBin(const log_bin_record_t *rec, const struct tm *day, struct tm *timeInfo,
+                         uint8_t *flags, send_data_t *data)
+{
+  *timeInfo = *day;
+  timeInfo->tm_hour = rec->minuteOfDay / MINUTES_PER_HOUR;
+  timeInfo->tm_min = rec->minuteOfDay % MINUTES_PER_HOUR;
+  timeInfo->tm_sec = 0;
+
+  memset(data, 0, sizeof(*data));
+  data->sendTimeInfo = *timeInfo;
+  data->temp = (float)rec->temp / LOG_SCALE_TEMP;
+  data->hum = (float)rec->hum / LOG_SCALE_HUM;
+  data->pre = (float)rec->pre / LOG_SCALE_PRE;
+  data->VOC = (float)rec->voc / LOG_SCALE_VOC;
+  data->PM1 = rec->pm1;
+  data->PM25 = rec->pm25;
+  data->PM10 = rec->pm10;
+  data->MICS_NO2 = (float)rec->no2 / LOG_SCALE_GAS;
+  data->MICS_CO = (float)rec->co / LOG_SCALE_CO;
+  data->MICS_NH3 = (float)rec->nh3 / LOG_SCALE_GAS;
+  data->ozone = (float)rec->o3 / LOG_SCALE_GAS;
+  data->MSP = rec->msp;
+  *flags = rec->flags;
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,181 @@
+/**************************************************************************************
+ * @file    log_codec.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   SD daily log record formats for the Milano Smart Park project
+ * @details CSV line layout (CSV_HEADER) and the fixed-width binary daily file.
+ *          Plain C/C++ with no Arduino dependency: tools/msplog2csv uses it to
+ *          export binary logs with exactly the text the device would write.
+ * @version 0.1
+ * @date    2025-09-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *************************************************************************************/
+
+#ifndef LOG_CODEC_H
+#define LOG_CODEC_H
+
+//-- includes --
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "record_codec.h" // send_data_t
+
+// CSV Header
+#define CSV_HEADER "recordedAt;date;time;year;month;temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp"
+#define LOG_CSV_LINE_MAX_LEN 256
+
+// Binary daily file: header followed by fixed-width little-endian records.
+// The writer preallocates the file with zeros: all-zero records at or past
+// the data end checkpoint in the header are free space, not data. Closed
+// days are cut to their data end.
+#define LOG_BIN_MAGIC "MSPL"
+#define LOG_BIN_MAGIC_LEN 4
+#define LOG_BIN_SCHEMA_VERSION 1
+#define LOG_BIN_HEADER_LEN 16
+
+// Record flags: which column groups hold data
+#define LOG_BIN_FLAG_DATETIME 0x01 /*!< recordedAt column valid */
+#define LOG_BIN_FLAG_BME680 0x02
+#define LOG_BIN_FLAG_PMS5003 0x04
+#define LOG_BIN_FLAG_MICS6814 0x08
+#define LOG_BIN_FLAG_O3 0x10
+
+typedef struct __attribute__((packed)) __LOG_BIN_RECORD__
+{
+  uint16_t minuteOfDay; /*!< hour * 60 + minute (records are minute aligned) */
+  uint8_t flags;        /*!< LOG_BIN_FLAG_* */
+  int8_t msp;           /*!< MSP# index */
+  int16_t temp;         /*!< 0.01 degC */
+  uint16_t hum;         /*!< 0.01 % */
+  uint16_t pre;         /*!< 0.1 hPa */
+  uint16_t voc;         /*!< 0.1 kOhm */
+  uint16_t pm1;         /*!< ug/m3 */
+  uint16_t pm25;        /*!< ug/m3 */
+  uint16_t pm10;        /*!< ug/m3 */
+  uint16_t no2;         /*!< 0.1 ug/m3 */
+  uint16_t co;          /*!< 1 ug/m3 */
+  uint16_t nh3;         /*!< 0.1 ug/m3 */
+  uint16_t o3;          /*!< 0.1 ug/m3 */
+} log_bin_record_t;
+
+/*************************************************
+ * @brief   builds a CSV_HEADER-layout line
+ *
+ * @param   timeInfo  record timestamp (local time)
+ * @param   flags     LOG_BIN_FLAG_* present columns
+ * @param   data      values
+ * @param   buf       output buffer
+ * @param   bufLen    output buffer size
+ * @return  int       line length, -1 if truncated
+ *************************************************/
+int iLogCodec_formatCsvLine(const struct tm *timeInfo, uint8_t flags, const send_data_t *data,
+                            char *buf, size_t bufLen);
+
+/*************************************************
+ * @brief   parses a CSV_HEADER-layout line back into
+ *          its values (inverse of iLogCodec_formatCsvLine)
+ *
+ * @param   line      NUL terminated line, no terminator
+ * @param   timeInfo  record timestamp from date;time
+ * @param   flags     LOG_BIN_FLAG_* of the non-empty columns
+ * @param   data      values
+ * @return  true      data line (false for header/malformed)
+ *************************************************/
+bool bLogCodec_parseCsvLine(const char *line, struct tm *timeInfo, uint8_t *flags, send_data_t *data);
+
+/*************************************************
+ * @brief   builds the binary daily file header
+ *
+ * @param   day     any time of the file's day
+ * @param   out     output buffer (LOG_BIN_HEADER_LEN)
+ * @param   outLen  output buffer size
+ * @return  size_t  header length, 0 on error
+ *************************************************/
+size_t uLogCodec_formatBinHeader(const struct tm *day, uint8_t *out, size_t outLen);
+
+/*************************************************
+ * @brief   validates a binary daily file header
+ *
+ * @param   in      header bytes
+ * @param   inLen   available bytes
+ * @param   day     filled with the file's date
+ * @return  true    known magic and schema
+ *************************************************/
+bool bLogCodec_parseBinHeader(const uint8_t *in, size_t inLen, struct tm *day);
+
+/*************************************************
+ * @brief   data end checkpoint of a binary file
+ *
+ * @param   header  LOG_BIN_HEADER_LEN header bytes
+ * @return  uint32_t  offset up to which the file is
+ *                    known to hold records, 0 if unset
+ *************************************************/
+uint32_t ulLogCodec_binDataEnd(const uint8_t *header);
+
+/*************************************************
+ * @brief   stores the data end checkpoint
+ *
+ * @param   header   LOG_BIN_HEADER_LEN header bytes
+ * @param   dataEnd  offset of the first free record
+ *************************************************/
+void vLogCodec_setBinDataEnd(uint8_t *header, uint32_t dataEnd);
+
+/*************************************************
+ * @brief   true for preallocated record space; a
+ *          blank record at or past the checkpoint
+ *          ends the data
+ *
+ * @param   rec  record read from the file
+ * @return  true all bytes zero
+ *************************************************/
+bool bLogCodec_binRecordBlank(const log_bin_record_t *rec);
+
+/*************************************************
+ * @brief   length of a CSV log without a torn last
+ *          line (power cut between two block writes)
+ *
+ * @param   tail     last bytes of the file (at least
+ *                   one line's worth)
+ * @param   tailLen  bytes in tail
+ * @param   fileLen  file size
+ * @return  size_t   length ending on a line terminator
+ *************************************************/
+size_t uLogCodec_csvCompleteLength(const char *tail, size_t tailLen, size_t fileLen);
+
+/*************************************************
+ * @brief   length of a binary log without a torn
+ *          last record
+ *
+ * @param   fileLen  file size
+ * @return  size_t   header plus whole records, 0 if
+ *                   the header itself is torn
+ *************************************************/
+size_t uLogCodec_binCompleteLength(size_t fileLen);
+
+/*************************************************
+ * @brief   packs a record into the binary layout
+ *
+ * @param   timeInfo  record timestamp (local time)
+ * @param   flags     LOG_BIN_FLAG_*
+ * @param   data      values
+ * @param   rec       output record
+ *************************************************/
+void vLogCodec_encodeBin(const struct tm *timeInfo, uint8_t flags, const send_data_t *data, log_bin_record_t *rec);
+
+/*************************************************
+ * @brief   unpacks a binary record
+ *
+ * @param   rec       input record
+ * @param   day       file date from the header
+ * @param   timeInfo  record timestamp
+ * @param   flags     LOG_BIN_FLAG_*
+ * @param   data      values
+ *************************************************/
+void vLogCodec_decodeBin(const log_bin_record_t *rec, const struct tm *day, struct tm *timeInfo,
+                         uint8_t *flags, send_data_t *data);
+
+#endif
+
+//************************************** EOF **************************************
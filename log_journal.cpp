@@ -0,0 +1,197 @@
+/*******************************************************************************
+ * @file    log_journal.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Write-ahead journal for SD log appends for the Milano Smart Park project
+ * @details Must stay free of Arduino/ESP-IDF includes: it is also compiled
+ *          on the host by tools/sdlog-powercut.
+ * @version 0.1
+ * @date    2025-09-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ******************************************************************************/
+
+// -- includes --
+#include <string.h>
+#include "log_journal.h"
+
+#define LOG_JOURNAL_CRC_POLY 0xEDB88320UL
+
+// Header layout: magic, offset (LE), length (LE), path length, flags, crc (LE)
+#define LOG_JOURNAL_OFFSET_OFS 4
+#define LOG_JOURNAL_LENGTH_OFS 8
+#define LOG_JOURNAL_PATHLEN_OFS 10
+#define LOG_JOURNAL_FLAGS_OFS 11
+#define LOG_JOURNAL_CRC_OFS 12
+
+static void vLogJournal_putU32(uint8_t *out, uint32_t value)
+{
+  out[0] = (uint8_t)value;
+  out[1] = (uint8_t)(value >> 8);
+  out[2] = (uint8_t)(value >> 16);
+  out[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t ulLogJournal_getU32(const uint8_t *in)
+{
+  return (uint32_t)in[0] | ((uint32_t)in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+/*************************************************
+ * @brief   CRC-32 (IEEE 802.3), chainable
+ *
+ * @param   crc
+ * @param   data
+ * @param   len
+ * @return  uint32_t
+ *************************************************/
+uint32_t ulLogJournal_crc32(uint32_t crc, const void *data, size_t len)
+{
+  // Nibble table: 64 bytes of flash instead of 1 KB, fast enough for one block per flush
+  static const uint32_t table[16] = {
+      0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL, 0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+      0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL, 0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL};
+  const uint8_t *p = (const uint8_t *)data;
+
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++)
+  {
+    crc = table[(crc ^ p[i]) & 0x0F] ^ (crc >> 4);
+    crc = table[(crc ^ (p[i] >> 4)) & 0x0F] ^ (crc >> 4);
+  }
+  return ~crc;
+}
+
+/*************************************************
+ * @brief   CRC of a record: header fields after the
+ *          magic up to the crc, then path and data
+ *************************************************/
+static uint32_t ulLogJournal_recordCrc(const uint8_t *header, const char *path, size_t pathLen,
+                                       const uint8_t *data, size_t len)
+{
+  uint32_t crc = ulLogJournal_crc32(0, header + LOG_JOURNAL_OFFSET_OFS, LOG_JOURNAL_CRC_OFS - LOG_JOURNAL_OFFSET_OFS);
+  crc = ulLogJournal_crc32(crc, path, pathLen);
+  return ulLogJournal_crc32(crc, data, len);
+}
+
+/*************************************************
+ * @brief   builds the record header for a write
+ *
+ * @param   path
+ * @param   offset
+ * @param   data
+ * @param   len
+ * @param   flags
+ * @param   out
+ * @param   outLen
+ * @return  size_t
+ *************************************************/
+size_t uLogJournal_formatHeader(const char *path, uint32_t offset, const uint8_t *data, size_t len,
+                                uint8_t flags, uint8_t *out, size_t outLen)
+{
+  size_t pathLen = strlen(path);
+
+  if ((outLen < LOG_JOURNAL_HEADER_LEN) || (pathLen > LOG_JOURNAL_PATH_MAX) || (len > LOG_JOURNAL_DATA_MAX))
+  {
+    return 0;
+  }
+
+  memcpy(out, LOG_JOURNAL_MAGIC, LOG_JOURNAL_MAGIC_LEN);
+  vLogJournal_putU32(out + LOG_JOURNAL_OFFSET_OFS, offset);
+  out[LOG_JOURNAL_LENGTH_OFS] = (uint8_t)len;
+  out[LOG_JOURNAL_LENGTH_OFS + 1] = (uint8_t)(len >> 8);
+  out[LOG_JOURNAL_PATHLEN_OFS] = (uint8_t)pathLen;
+  out[LOG_JOURNAL_FLAGS_OFS] = flags;
+  vLogJournal_putU32(out + LOG_JOURNAL_CRC_OFS, ulLogJournal_recordCrc(out, path, pathLen, data, len));
+  return LOG_JOURNAL_HEADER_LEN;
+}
+
+/*************************************************
+ * @brief   validates a complete journal record
+ *
+ * @param   in
+ * @param   inLen
+ * @param   entry
+ * @return  true
+ * @return  false
+ *************************************************/
+bool bLogJournal_parseRecord(const uint8_t *in, size_t inLen, log_journal_entry_t *entry)
+{
+  if ((inLen < LOG_JOURNAL_HEADER_LEN) || (memcmp(in, LOG_JOURNAL_MAGIC, LOG_JOURNAL_MAGIC_LEN) != 0))
+  {
+    return false;
+  }
+
+  entry->offset = ulLogJournal_getU32(in + LOG_JOURNAL_OFFSET_OFS);
+  entry->length = (uint16_t)(in[LOG_JOURNAL_LENGTH_OFS] | (in[LOG_JOURNAL_LENGTH_OFS + 1] << 8));
+  entry->pathLen = in[LOG_JOURNAL_PATHLEN_OFS];
+  entry->flags = in[LOG_JOURNAL_FLAGS_OFS];
+  entry->crc = ulLogJournal_getU32(in + LOG_JOURNAL_CRC_OFS);
+
+  if ((entry->pathLen == 0) || (entry->pathLen > LOG_JOURNAL_PATH_MAX) || (entry->length > LOG_JOURNAL_DATA_MAX) ||
+      (inLen != (size_t)(LOG_JOURNAL_HEADER_LEN + entry->pathLen + entry->length)))
+  {
+    return false;
+  }
+
+  const char *path = (const char *)(in + LOG_JOURNAL_HEADER_LEN);
+  const uint8_t *data = in + LOG_JOURNAL_HEADER_LEN + entry->pathLen;
+  return (ulLogJournal_recordCrc(in, path, entry->pathLen, data, entry->length) == entry->crc);
+}
+
+/*************************************************
+ * @brief   power-loss recovery
+ *
+ * @param   io
+ * @param   journalPath
+ * @param   scratch
+ * @param   scratchLen
+ * @return  log_journal_recovery_t
+ *************************************************/
+log_journal_recovery_t tLogJournal_recover(const log_journal_io_t *io, const char *journalPath,
+                                           uint8_t *scratch, size_t scratchLen)
+{
+  log_journal_entry_t entry;
+  char path[LOG_JOURNAL_PATH_MAX + 1];
+
+  long journalLen = io->size(io->ctx, journalPath);
+  if (journalLen < 0)
+  {
+    return LOG_JOURNAL_CLEAN;
+  }
+
+  // The target is only written after the whole record is on the card: a torn record means an untouched target
+  if ((scratchLen < LOG_JOURNAL_RECORD_MAX) || (journalLen > (long)LOG_JOURNAL_RECORD_MAX) ||
+      (io->read(io->ctx, journalPath, 0, scratch, (size_t)journalLen) != (size_t)journalLen) ||
+      !bLogJournal_parseRecord(scratch, (size_t)journalLen, &entry))
+  {
+    return io->remove(io->ctx, journalPath) ? LOG_JOURNAL_DISCARDED : LOG_JOURNAL_FAILED;
+  }
+
+  memcpy(path, scratch + LOG_JOURNAL_HEADER_LEN, entry.pathLen);
+  path[entry.pathLen] = '\0';
+  const uint8_t *data = scratch + LOG_JOURNAL_HEADER_LEN + entry.pathLen;
+
+  // A target shorter than the recorded offset lost an earlier sync: append rather than leave a hole
+  long targetLen = io->size(io->ctx, path);
+  uint32_t replayOffset = entry.offset;
+  if (targetLen < (long)entry.offset)
+  {
+    replayOffset = (targetLen < 0) ? 0 : (uint32_t)targetLen;
+  }
+
+  if (!io->writeAt(io->ctx, path, replayOffset, data, entry.length))
+  {
+    return LOG_JOURNAL_FAILED;
+  }
+  // Past an append only garbage of the torn write can follow; an in-place write keeps what is behind it
+  if (((entry.flags & LOG_JOURNAL_FLAG_IN_PLACE) == 0) && (targetLen > (long)(replayOffset + entry.length)) &&
+      !io->truncate(io->ctx, path, replayOffset + entry.length))
+  {
+    return LOG_JOURNAL_FAILED;
+  }
+
+  return io->remove(io->ctx, journalPath) ? LOG_JOURNAL_REPLAYED : LOG_JOURNAL_FAILED;
+}
+
+//************************************** EOF **************************************
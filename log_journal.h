@@ -0,0 +1,118 @@
+/**************************************************************************************
+ * @file    log_journal.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Write-ahead journal for SD log appends for the Milano Smart Park project
+ * @details Before a block goes to a log file it is written, framed with its length
+ *          and a CRC-32, to a one-record journal file; the journal is removed once
+ *          the block is flushed. After a power cut the recovery pass either replays
+ *          the block (journal intact) or drops the journal (target untouched).
+ *          Plain C/C++ with no Arduino dependency: tools/sdlog-powercut drives the
+ *          same recovery code against a simulated card.
+ * @version 0.1
+ * @date    2025-09-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *************************************************************************************/
+
+#ifndef LOG_JOURNAL_H
+#define LOG_JOURNAL_H
+
+//-- includes --
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LOG_JOURNAL_MAGIC "MSPJ"
+#define LOG_JOURNAL_MAGIC_LEN 4
+#define LOG_JOURNAL_HEADER_LEN 16
+#define LOG_JOURNAL_PATH_MAX 48
+#define LOG_JOURNAL_DATA_MAX 1024 /*!< largest block journaled in one record */
+#define LOG_JOURNAL_RECORD_MAX (LOG_JOURNAL_HEADER_LEN + LOG_JOURNAL_PATH_MAX + LOG_JOURNAL_DATA_MAX)
+
+// Record flags
+#define LOG_JOURNAL_FLAG_IN_PLACE 0x01 /*!< write inside existing or preallocated bytes: replay keeps the file length */
+
+typedef struct __LOG_JOURNAL_ENTRY__
+{
+  uint32_t offset; /*!< target offset of the write (file length for appends) */
+  uint16_t length; /*!< data bytes */
+  uint8_t pathLen; /*!< target path bytes, no terminator */
+  uint8_t flags;   /*!< LOG_JOURNAL_FLAG_* */
+  uint32_t crc;    /*!< CRC-32 of offset..flags, path and data */
+} log_journal_entry_t;
+
+typedef enum __LOG_JOURNAL_RECOVERY__
+{
+  LOG_JOURNAL_CLEAN = 0, /*!< no journal: last write completed */
+  LOG_JOURNAL_DISCARDED, /*!< torn journal: target never touched, journal dropped */
+  LOG_JOURNAL_REPLAYED,  /*!< intact journal: block rewritten at its offset */
+  LOG_JOURNAL_FAILED     /*!< I/O error, journal kept for the next boot */
+} log_journal_recovery_t;
+
+/*************************************************
+ * @brief   file operations the recovery pass needs;
+ *          paths are the ones stored in the journal
+ *************************************************/
+typedef struct __LOG_JOURNAL_IO__
+{
+  void *ctx;
+  long (*size)(void *ctx, const char *path); /*!< -1 if missing */
+  size_t (*read)(void *ctx, const char *path, uint32_t offset, uint8_t *buf, size_t len);
+  bool (*writeAt)(void *ctx, const char *path, uint32_t offset, const uint8_t *data, size_t len); /*!< creates, syncs */
+  bool (*truncate)(void *ctx, const char *path, uint32_t len);
+  bool (*remove)(void *ctx, const char *path);
+} log_journal_io_t;
+
+/*************************************************
+ * @brief   CRC-32 (IEEE 802.3), chainable
+ *
+ * @param   crc   previous value, 0 to start
+ * @param   data  bytes
+ * @param   len   byte count
+ * @return  uint32_t
+ *************************************************/
+uint32_t ulLogJournal_crc32(uint32_t crc, const void *data, size_t len);
+
+/*************************************************
+ * @brief   builds the record header for a write;
+ *          the record is header, path, data
+ *
+ * @param   path    target file
+ * @param   offset  target offset (length for appends)
+ * @param   data    block about to be written
+ * @param   len     block size (<= LOG_JOURNAL_DATA_MAX)
+ * @param   flags   LOG_JOURNAL_FLAG_*
+ * @param   out     output buffer (LOG_JOURNAL_HEADER_LEN)
+ * @param   outLen  output buffer size
+ * @return  size_t  header length, 0 on error
+ *************************************************/
+size_t uLogJournal_formatHeader(const char *path, uint32_t offset, const uint8_t *data, size_t len,
+                                uint8_t flags, uint8_t *out, size_t outLen);
+
+/*************************************************
+ * @brief   validates a complete journal record
+ *
+ * @param   in     record bytes
+ * @param   inLen  available bytes
+ * @param   entry  decoded header
+ * @return  true   framing and CRC match
+ *************************************************/
+bool bLogJournal_parseRecord(const uint8_t *in, size_t inLen, log_journal_entry_t *entry);
+
+/*************************************************
+ * @brief   power-loss recovery: replays or drops the
+ *          journal; at most one record is processed
+ *
+ * @param   io           file operations
+ * @param   journalPath  journal file
+ * @param   scratch      work buffer (LOG_JOURNAL_RECORD_MAX)
+ * @param   scratchLen   work buffer size
+ * @return  log_journal_recovery_t
+ *************************************************/
+log_journal_recovery_t tLogJournal_recover(const log_journal_io_t *io, const char *journalPath,
+                                           uint8_t *scratch, size_t scratchLen);
+
+#endif
+
+//************************************** EOF **************************************
@@ -49,6 +49,7 @@
 #include "display_task.h"
 #include "mspOs.h"
 #include "firmware_update.h"
+#include "config_store.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -103,6 +104,9 @@ static systemData_t sysData;
 // -- structure for PMS5003
 static PMS::DATA data;
 
+// -- config store subscription of the measurement loop
+static config_subscriber_t mainConfigSub = CONFIG_STORE_INVALID_SUBSCRIBER;
+
 //---------------------------------------- FUNCTIONS ----------------------------------------------------------------------
 
 void vMspInit_sensorStatusAndData(sensorData_t *p_tData);
@@ -118,21 +122,7 @@ void vMsp_setGpioPins(void);
 void vMspInit_NetworkAndMeasInfo(void);
 void vMspInit_MeasInfo(void);
 
-void Msp_getSystemStatus(systemStatus_t *stat);
-
-//*******************************************************************************************************************************
-
-void Msp_getSystemStatus(systemStatus_t *stat)
-{
-
-  vMspOs_takeDataAccessMutex();
-
-  memcpy(stat, &sysStat, sizeof(systemStatus_t));
-
-  vMspOs_giveDataAccessMutex();
-}
-
-/******************************************************************************************************************/
+void vMsp_applyConfigUpdate(void);
 
 //*******************************************************************************************************************************
 //******************************************  S E T U P  ************************************************************************
@@ -146,8 +136,6 @@ void setup()
 
   vMsp_setGpioPins();
 
-  vMspOs_initDataAccessMutex(); // Create the OS mutex for data access
-
   // init the sensor data structure /status / offset values with defualt values
   vMspInit_sensorStatusAndData(&sensorData_accumulate);
 
@@ -164,6 +152,7 @@ void setup()
   vMspInit_setApiSecSaltAndFwVer(&sysData);
 
   // Initialize the serial port and I2C for the display
+  vMspOs_initI2cBus();
   vHalDisplay_initSerialAndI2c();
 
   // Initialize the display task data queue
@@ -232,6 +221,14 @@ void setup()
   log_i("=== STEP 2: Configuring system with loaded data or defaults ===");
   vMspInit_configureSystemFromSD(&sysData, &sysStat, &devinfo, &measStat);
 
+  // Later config versions are applied by vMsp_applyConfigUpdate(); the boot one is already in place
+  mainConfigSub = tHalConfigStore_subscribe(CONFIG_CHANGED_SCHEDULE | CONFIG_CHANGED_SENSORS, NULL, NULL);
+  {
+    static msp_config_t bootCfg;
+    config_diff_t bootDiff;
+    bHalConfigStore_take(mainConfigSub, &bootCfg, &bootDiff);
+  }
+
   // Debug: Check final configuration status
   log_i("Final Configuration Status:");
   log_i("  SD Card: %s", sysStat.sdCard ? "OK" : "FAILED");
@@ -260,7 +257,9 @@ void setup()
   // BME680 +++++++++++++++++++++++++++++++++++++
   vMsp_updateDataAndSendEvent(DISP_EVENT_BME680_SENSOR_INIT, &sensorData_accumulate, &devinfo, &measStat, &sysData, &sysStat);
 
+  vMspOs_takeI2cBus(I2C_DEV_BME680);
   bme680.begin(BME68X_I2C_ADDR_HIGH, Wire);
+  vMspOs_giveI2cBus(I2C_DEV_BME680);
   if (tHalSensor_checkBMESensor(&bme680))
   {
     log_i("BME680 sensor detected, initializing...\n");
@@ -272,7 +271,9 @@ void setup()
         BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE,
         BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY,
     };
+    vMspOs_takeI2cBus(I2C_DEV_BME680);
     bme680.updateSubscription(sensor_list, sizeof(sensor_list) / sizeof(sensor_list[0]), BSEC_SAMPLE_RATE_LP);
+    vMspOs_giveI2cBus(I2C_DEV_BME680);
     sensorData_accumulate.status.BME680Sensor = true;
     vMsp_updateDataAndSendEvent(DISP_EVENT_BME680_SENSOR_OKAY, &sensorData_accumulate, &devinfo, &measStat, &sysData, &sysStat);
   }
@@ -307,18 +308,25 @@ void setup()
   // MICS6814 ++++++++++++++++++++++++++++++++++++
   vMsp_updateDataAndSendEvent(DISP_EVENT_MICS6814_SENSOR_INIT, &sensorData_accumulate, &devinfo, &measStat, &sysData, &sysStat);
 
-  if (gas.begin())
+  vMspOs_takeI2cBus(I2C_DEV_MICS6814);
+  bool micsFound = gas.begin();
+  vMspOs_giveI2cBus(I2C_DEV_MICS6814);
+  if (micsFound)
   { // Connect to sensor using default I2C address (0x04)
     log_i("MICS6814 sensor detected, initializing...\n");
     sensorData_accumulate.status.MICS6814Sensor = true;
+    vMspOs_takeI2cBus(I2C_DEV_MICS6814);
     gas.powerOn(); // turn on heating element and led
     gas.ledOn();
+    vMspOs_giveI2cBus(I2C_DEV_MICS6814);
     vMsp_updateDataAndSendEvent(DISP_EVENT_MICS6814_SENSOR_OKAY, &sensorData_accumulate, &devinfo, &measStat, &sysData, &sysStat);
 
     sensorR0Value_t r0Values;
+    vMspOs_takeI2cBus(I2C_DEV_MICS6814);
     r0Values.redSensor = gas.getBaseResistance(CH_RED);
     r0Values.oxSensor = gas.getBaseResistance(CH_OX);
     r0Values.nh3Sensor = gas.getBaseResistance(CH_NH3);
+    vMspOs_giveI2cBus(I2C_DEV_MICS6814);
 
     if (tHalSensor_checkMicsValues(&sensorData_accumulate, &r0Values) == STATUS_OK)
     {
@@ -478,6 +486,7 @@ void loop()
     { // Check every 30 seconds
       lastSdCheck = millis();
       vHalSdcard_periodicCheck(&sysStat, &devinfo);
+      vMsp_applyConfigUpdate();
     }
 
     if (getLocalTime(&timeinfo))
@@ -612,7 +621,13 @@ void loop()
         // if it is not the first transition, wait for timeout
         if (measStat.isSensorDataAvailable == false)
         {
-          vMsp_updateDataAndSendEvent(DISP_EVENT_WAIT_FOR_TIMEOUT, &sensorData_single, &devinfo, &measStat, &sysData, &sysStat);
+          // the countdown shows whole seconds: publish only when it moves
+          static uint32_t lastShownSecond = UINT32_MAX;
+          if (measStat.timeout_seconds != lastShownSecond)
+          {
+            lastShownSecond = measStat.timeout_seconds;
+            vMsp_updateDataAndSendEvent(DISP_EVENT_WAIT_FOR_TIMEOUT, &sensorData_single, &devinfo, &measStat, &sysData, &sysStat);
+          }
           delay(500);
         }
       }
@@ -702,7 +717,10 @@ void loop()
           delay(200);
         }
 
-        if (!bme680.run())
+        vMspOs_takeI2cBus(I2C_DEV_BME680);
+        bool bmeReady = bme680.run();
+        vMspOs_giveI2cBus(I2C_DEV_BME680);
+        if (!bmeReady)
         {
           log_v("BME680 sensor not ready, waiting... (attempt %d/%d)", retry + 1, MAX_SENSOR_RETRIES);
           if (retry == (MAX_SENSOR_RETRIES - 1)) // Last attempt and still not ready
@@ -764,9 +782,11 @@ void loop()
       {
         MICS6814SensorReading_t micsLocData;
 
+        vMspOs_takeI2cBus(I2C_DEV_MICS6814);
         micsLocData.carbonMonoxide = gas.measureCO();
         micsLocData.nitrogenDioxide = gas.measureNO2();
         micsLocData.ammonia = gas.measureNH3();
+        vMspOs_giveI2cBus(I2C_DEV_MICS6814);
 
         if ((micsLocData.carbonMonoxide < 0) || (micsLocData.nitrogenDioxide < 0) || (micsLocData.ammonia < 0))
         {
@@ -1060,6 +1080,7 @@ void loop()
     sendData.MICS_NH3 = sensorData_accumulate.pollutionData.data.ammonia;
     sendData.ozone = sensorData_accumulate.ozoneData.ozone;
     sendData.MSP = sensorData_accumulate.MSP;
+    sendData.seq = nextRecordSequence(); // stable across retries, lets the server de-duplicate
 
     log_i("Sensor values AFTER AVERAGE:\n");
     log_i("temp: %.2f, hum: %.2f, pre: %.2f, VOC: %.2f, PM1: %d, PM25: %d, PM10: %d, MICS_CO: %.2f, MICS_NO2: %.2f, MICS_NH3: %.2f, ozone: %.2f, MSP: %d, measurement_count: %d\n",
@@ -1167,8 +1188,6 @@ void loop()
  *********************************************************/
 void vMspInit_sensorStatusAndData(sensorData_t *p_tData)
 {
-  vMspOs_takeDataAccessMutex();
-
   // -- set default sensor status to disabled
   p_tData->status.BME680Sensor = DISABLED;
   p_tData->status.PMS5003Sensor = DISABLED;
@@ -1218,8 +1237,45 @@ void vMspInit_sensorStatusAndData(sensorData_t *p_tData)
   p_tData->compParams.currentPressure = PRESS_COMP_PARAM;    /*!<default pressure compensation */
 
   p_tData->MSP = MSP_DEFAULT_DATA; /*!<set to -1 to distinguish from grey (0) */
+}
 
-  vMspOs_giveDataAccessMutex();
+/**************************************************************
+ * @brief apply schedule/sensor settings published to the config
+ *        store since the last call; a new measurement interval
+ *        restarts the cycle alignment without touching the network
+ *************************************************************/
+void vMsp_applyConfigUpdate(void)
+{
+  static msp_config_t cfg;
+  config_diff_t diff;
+
+  if (!bHalConfigStore_take(mainConfigSub, &cfg, &diff))
+  {
+    return;
+  }
+
+  vHalConfigStore_apply(&cfg, diff.changed, NULL, &sensorData_accumulate, &measStat, NULL, NULL);
+
+  if (diff.changed & CONFIG_CHANGED_SCHEDULE)
+  {
+    if ((measStat.avg_measurements <= 0) || ((SEC_IN_MIN % measStat.avg_measurements) != 0))
+    {
+      log_w("Invalid avg_measurements (%d), must be submultiple of 60. Keeping %d", measStat.avg_measurements, measStat.max_measurements);
+      measStat.avg_measurements = measStat.max_measurements;
+    }
+    else
+    {
+      log_i("Measurement schedule changed: %d -> %d measurements, re-arming cycle", measStat.max_measurements, measStat.avg_measurements);
+      measStat.max_measurements = measStat.avg_measurements;
+      measStat.measurement_count = 0;
+      mainStateMachine.isFirstTransition = true;
+    }
+  }
+
+  if (diff.changed & CONFIG_CHANGED_SENSORS)
+  {
+    log_i("Sensor calibration updated (config version %lu)", (unsigned long)diff.toVersion);
+  }
 }
 
 void vMspInit_NetworkAndMeasInfo(void)
@@ -2,7 +2,7 @@
  * @file    mspOs.cpp
  * @author  AB-Engineering - https://ab-engineering.it
  * @brief   management for the Milano Smart Park project
- * @details This file contains functions to manage mutexes for thread safety in the project.
+ * @details This file contains functions to arbitrate the shared I2C bus between tasks.
  * @version 0.1
  * @date    2025-07-25
  *
@@ -12,44 +12,123 @@
 
 // -- includes --
 #include "mspOs.h"
+#include "freertos/task.h"
 
-// -- global mutex handle
-SemaphoreHandle_t dataAccessMutex = NULL;
+// -- defines
+#define I2C_STATS_PERIOD_MS 60000
+
+// -- I2C bus arbitration: sensors waiting make the display yield between its transfers
+typedef struct _I2C_DEVICE_STATS_
+{
+    uint32_t transactions;
+    uint32_t busyUs;    // bus held
+    uint32_t waitUs;    // waited for the bus
+    uint32_t maxWaitUs;
+} i2cDeviceStats_t;
+
+static SemaphoreHandle_t i2cBusMutex = NULL;
+static StaticSemaphore_t i2cBusMutexBuffer;
+static portMUX_TYPE i2cWaitMux = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t i2cSensorsWaiting = 0;
+static unsigned long i2cHoldStartUs = 0;
+static i2cDeviceStats_t i2cStats[I2C_DEV_NUM];
+static unsigned long i2cStatsStart = 0;
+static const char *const i2cDeviceNames[I2C_DEV_NUM] = {"display", "BME680", "MICS6814"};
 
 
-/**************************************************
- * @brief Initializes the mutex for data access.
+/**********************************************************
+ * @brief  Initializes the I2C bus arbitration.
  *
- **************************************************/
-void vMspOs_initDataAccessMutex()
+ **********************************************************/
+void vMspOs_initI2cBus()
 {
-    dataAccessMutex = xSemaphoreCreateMutex();
-    if (dataAccessMutex == NULL)
+    if (i2cBusMutex == NULL)
     {
-        Serial.println("Failed to create mutex!");
+        i2cBusMutex = xSemaphoreCreateMutexStatic(&i2cBusMutexBuffer);
+        i2cStatsStart = millis();
     }
 }
 
 /**********************************************************
- * @brief   Takes (locks) the mutex for data access.
+ * @brief  Takes the I2C bus for one transaction. Sensors
+ *         are served first: the display waits while any
+ *         sensor is waiting, so a sensor waits at most for
+ *         the display transfer in progress.
  *
- *********************************************************/
-void vMspOs_takeDataAccessMutex()
+ * @param device
+ **********************************************************/
+void vMspOs_takeI2cBus(mspI2cDevice_t device)
 {
-    if (dataAccessMutex != NULL)
+    if (i2cBusMutex == NULL)
     {
-        xSemaphoreTake(dataAccessMutex, portMAX_DELAY); // Wait indefinitely
+        return;
     }
+
+    unsigned long waitStart = micros();
+    if (device == I2C_DEV_DISPLAY)
+    {
+        while (i2cSensorsWaiting > 0)
+        {
+            vTaskDelay(1);
+        }
+        xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+    }
+    else
+    {
+        portENTER_CRITICAL(&i2cWaitMux);
+        i2cSensorsWaiting++;
+        portEXIT_CRITICAL(&i2cWaitMux);
+
+        xSemaphoreTake(i2cBusMutex, portMAX_DELAY);
+
+        portENTER_CRITICAL(&i2cWaitMux);
+        i2cSensorsWaiting--;
+        portEXIT_CRITICAL(&i2cWaitMux);
+    }
+
+    // the stats are only touched by the bus owner
+    uint32_t waited = micros() - waitStart;
+    i2cStats[device].transactions++;
+    i2cStats[device].waitUs += waited;
+    if (waited > i2cStats[device].maxWaitUs)
+    {
+        i2cStats[device].maxWaitUs = waited;
+    }
+    i2cHoldStartUs = micros();
 }
 
 /**********************************************************
- * @brief  Releases (unlocks) the mutex for data access.
+ * @brief  Releases the I2C bus and reports the per device
+ *         occupancy and wait times once a minute.
  *
+ * @param device
  **********************************************************/
-void vMspOs_giveDataAccessMutex()
+void vMspOs_giveI2cBus(mspI2cDevice_t device)
 {
-    if (dataAccessMutex != NULL)
+    if (i2cBusMutex == NULL)
     {
-        xSemaphoreGive(dataAccessMutex);
+        return;
     }
+
+    i2cStats[device].busyUs += micros() - i2cHoldStartUs;
+
+    unsigned long elapsed = millis() - i2cStatsStart;
+    if (elapsed >= I2C_STATS_PERIOD_MS)
+    {
+        for (int dev = 0; dev < I2C_DEV_NUM; dev++)
+        {
+            i2cDeviceStats_t *st = &i2cStats[dev];
+            if (st->transactions == 0)
+            {
+                continue;
+            }
+            log_d("I2C %s: %lu transactions, busy %lu ms of %lu s, wait avg %lu us max %lu us", i2cDeviceNames[dev],
+                  (unsigned long)st->transactions, (unsigned long)(st->busyUs / 1000), elapsed / 1000,
+                  (unsigned long)(st->waitUs / st->transactions), (unsigned long)st->maxWaitUs);
+        }
+        memset(i2cStats, 0, sizeof(i2cStats));
+        i2cStatsStart = millis();
+    }
+
+    xSemaphoreGive(i2cBusMutex);
 }
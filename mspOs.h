@@ -2,7 +2,8 @@
  * @file    mspOs.h
  * @author  AB-Engineering - https://ab-engineering.it
  * @brief   management for the Milano Smart Park project
- * @details This file contains functions to manage mutexes for thread safety in the project.
+ * @details This file contains functions to arbitrate the shared I2C bus between tasks.
+ *          Data shared between tasks goes through shared_state.h.
  * @version 0.1
  * @date    2025-07-25
  * 
@@ -18,9 +19,18 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 
-// Mutex handle
-void vMspOs_initDataAccessMutex();
-void vMspOs_takeDataAccessMutex();
-void vMspOs_giveDataAccessMutex();
+// -- devices sharing the I2C bus; sensors go before the display
+typedef enum _MSP_I2C_DEVICE_
+{
+    I2C_DEV_DISPLAY = 0,
+    I2C_DEV_BME680,
+    I2C_DEV_MICS6814,
+    I2C_DEV_NUM
+} mspI2cDevice_t;
+
+// I2C bus arbitration
+void vMspOs_initI2cBus();
+void vMspOs_takeI2cBus(mspI2cDevice_t device);
+void vMspOs_giveI2cBus(mspI2cDevice_t device);
 
 #endif // MSPOS_H
\ No newline at end of file
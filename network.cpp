@@ -16,6 +16,7 @@
 #include <TinyGsmClient.h>
 #include <HTTPClient.h>
 #include <WiFiClientSecure.h>
+#include <Preferences.h>
 #include <time.h>
 #include <stdbool.h>
 #include <string.h>
@@ -24,11 +25,15 @@
 #include "trust_anchor.h"
 #include "display_task.h"
 #include "display.h"
-#include "mspOs.h"
+#include "shared_state.h"
 #include "sdcard.h"
+#include "sdlog.h"
 #include "sensors.h"
 #include "config.h"
 #include "firmware_update.h"
+#include "record_codec.h"
+#include "config_store.h"
+#include "sd_health.h"
 
 // -- Network Configuration Constants
 #define TIME_SYNC_MAX_RETRY 5
@@ -44,6 +49,10 @@ HardwareSerial gsmSerial(1);
 // Task configuration - public values defined in network.h
 #define SEND_DATA_QUEUE_LENGTH 16 // Internal queue configuration
 
+// Config groups the network task applies; schedule and sensor settings belong to the main task
+#define NETWORK_CONFIG_INTEREST (CONFIG_CHANGED_WIFI | CONFIG_CHANGED_MODEM | CONFIG_CHANGED_SERVER | \
+                                 CONFIG_CHANGED_IDENTITY | CONFIG_CHANGED_TIME | CONFIG_CHANGED_FIRMWARE)
+
 // Static task variables
 static StaticTask_t networkTaskBuffer;
 static StackType_t networkTaskStack[NETWORK_TASK_STACK_SIZE];
@@ -55,6 +64,7 @@ static EventGroupHandle_t networkEventGroup = NULL;
 static StaticEventGroup_t networkEventGroupBuffer;
 static SemaphoreHandle_t networkStateMutex = NULL;
 static StaticSemaphore_t networkStateMutexBuffer;
+static config_subscriber_t networkConfigSub = CONFIG_STORE_INVALID_SUBSCRIBER;
 
 
 // Network state variables (protected by mutex)
@@ -72,6 +82,10 @@ static struct
     bool configurationLoaded;
     int ntpSyncExpired; // Counter for NTP sync expiration
     bool firmwareDownloadInProgress; // Flag to skip connectivity checks during firmware download
+    bool uploadHoldArmed; // Upload offset computed for the pending batch
+    unsigned long uploadHoldUntil; // millis() deadline before the pending batch may be sent
+    bool serverBackoffActive; // serverBackoffUntil is a pending deadline
+    unsigned long serverBackoffUntil; // millis() deadline advertised by the server (Retry-After)
 } networkState = {
     .wifiConnected = false,
     .gsmConnected = false,
@@ -84,19 +98,33 @@ static struct
     .taskRunning = false,
     .configurationLoaded = false,
     .ntpSyncExpired = NTP_SYNC_TX_COUNT, // Initialize with default count
-    .firmwareDownloadInProgress = false
+    .firmwareDownloadInProgress = false,
+    .uploadHoldArmed = false,
+    .uploadHoldUntil = 0,
+    .serverBackoffActive = false,
+    .serverBackoffUntil = 0
 };
 
+// Record sequence allocator (reserved in NVS by blocks)
+static uint32_t recordSeqNext = 0;
+static uint32_t recordSeqReserved = 0;
+static bool recordSeqLoaded = false;
+
+// SD health block is attached to one accepted upload per SD_HEALTH_UPLOAD_INTERVAL_SEC
+static unsigned long lastHealthUploadMs = 0;
+static bool healthUploaded = false;
+
 // Global instances (properly managed within task)
 static TinyGsm *modem = NULL;
 static TinyGsmClient *gsmClient = NULL;
 static WiFiClient wifi_base;
 static SSLClient *sslClient = NULL;
 
-// Global data structure pointers (shared with main task)
-static systemData_t *globalSysData = NULL;
-static systemStatus_t *globalSysStatus = NULL;
-static deviceNetworkInfo_t *globalDevInfo = NULL;
+// Main task data copied by initSendDataOp() before the task starts
+static systemData_t startupSysData;
+static systemStatus_t startupSysStatus;
+static deviceNetworkInfo_t startupDevInfo;
+static bool startupDataSet = false;
 
 // Forward declarations
 static void networkTask(void *pvParameters);
@@ -108,11 +136,17 @@ static bool syncDateTime(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus
 static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devInfo,
                              systemStatus_t *sysStatus, systemData_t *sysData);
 static void updateNetworkState(netwkr_task_evt_t newState);
+static void publishNetworkStatus();
+static void giveNetworkState();
 static netwkr_task_evt_t getNetworkState();
 static bool isNetworkConnected();
-static bool loadNetworkConfiguration(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus,
-                                     systemData_t *sysData, sensorData_t *sensorData,
-                                     deviceMeasurement_t *measStat);
+static uint32_t loadNetworkConfiguration(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus,
+                                         systemData_t *sysData);
+static void onNetworkConfigPublished(void *ctx);
+static uint32_t computeUploadJitterMs(const deviceNetworkInfo_t *devInfo);
+static String getResponseHeader(const String &response, const char *name);
+static uint32_t parseRetryAfterSeconds(const String &response);
+static bool isUploadHoldActive(const deviceNetworkInfo_t *devInfo);
 
 // Public interface functions
 bool enqueueSendData(const send_data_t &data, TickType_t ticksToWait)
@@ -167,15 +201,59 @@ bool dequeueSendData(send_data_t *data, TickType_t ticksToWait)
     return (xQueueReceive(sendDataQueue, data, ticksToWait) == pdPASS);
 }
 
+uint32_t nextRecordSequence(void)
+{
+    bool locked = (networkStateMutex != NULL) && (xSemaphoreTake(networkStateMutex, portMAX_DELAY) == pdTRUE);
+
+    if (!recordSeqLoaded)
+    {
+        Preferences prefs;
+        if (prefs.begin(RECORD_SEQ_NVS_NAMESPACE, true))
+        {
+            recordSeqReserved = prefs.getUInt(RECORD_SEQ_NVS_KEY, 0);
+            prefs.end();
+        }
+        // Values up to the stored mark may have been used before the reset: skip them
+        recordSeqNext = recordSeqReserved + 1;
+        recordSeqLoaded = true;
+        log_i("Record sequence resumes at %lu", (unsigned long)recordSeqNext);
+    }
+
+    if (recordSeqNext > recordSeqReserved)
+    {
+        Preferences prefs;
+        uint32_t newMark = recordSeqReserved + RECORD_SEQ_RESERVE_BLOCK;
+        if (prefs.begin(RECORD_SEQ_NVS_NAMESPACE, false) && (prefs.putUInt(RECORD_SEQ_NVS_KEY, newMark) == sizeof(uint32_t)))
+        {
+            log_d("Reserved record sequence block up to %lu", (unsigned long)newMark);
+        }
+        else
+        {
+            log_e("Failed to persist record sequence mark, numbers may repeat after reset");
+        }
+        prefs.end();
+        recordSeqReserved = newMark;
+    }
+
+    uint32_t seq = recordSeqNext++;
+
+    if (locked)
+    {
+        giveNetworkState();
+    }
+    return seq;
+}
+
 void initSendDataOp(systemData_t *sysData, systemStatus_t *sysStatus, deviceNetworkInfo_t *devInfo)
 {
-    // Store global data structure pointers
-    globalSysData = sysData;
-    globalSysStatus = sysStatus;
-    globalDevInfo = devInfo;
+    // Copied here, in the main task, so the network task never reads the main task structures
+    startupSysData = *sysData;
+    startupSysStatus = *sysStatus;
+    startupDevInfo = *devInfo;
+    startupDataSet = true;
 
     log_i("Network task initialized with global data structures");
-    log_i("Server OK from main task: %d", globalSysStatus->server_ok);
+    log_i("Server OK from main task: %d", sysStatus->server_ok);
 
     // Create queue
     if (sendDataQueue == NULL)
@@ -233,7 +311,7 @@ void initSendDataOp(systemData_t *sysData, systemStatus_t *sysStatus, deviceNetw
             if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
             {
                 networkState.taskRunning = true;
-                xSemaphoreGive(networkStateMutex);
+                giveNetworkState();
             }
         }
     }
@@ -307,7 +385,7 @@ uint8_t vHalNetwork_modemDisconnect()
         if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
             networkState.gsmConnected = false;
-            xSemaphoreGive(networkStateMutex);
+            giveNetworkState();
         }
 
         return result ? 1 : 0;
@@ -515,7 +593,7 @@ static void cleanupNetworkResources()
         networkState.internetConnected = false;
         networkState.timeSync = false;
         networkState.connectionRetries = 0;
-        xSemaphoreGive(networkStateMutex);
+        giveNetworkState();
     }
 
     log_i("Network resources cleaned up successfully");
@@ -625,6 +703,7 @@ static bool handleWiFiConnection(deviceNetworkInfo_t *devInfo, systemStatus_t *s
             // Update state - no mutex needed (internal state)
             networkState.wifiConnected = true;
             networkState.connectionRetries = 0;
+            publishNetworkStatus();
 
             sysStatus->connection = true;
             sendNetworkEvent(NET_EVENT_CONNECTED);
@@ -752,6 +831,7 @@ static bool handleGSMConnection(deviceNetworkInfo_t *devInfo, systemStatus_t *sy
             // Update state - no mutex needed (internal state)
             networkState.gsmConnected = true;
             networkState.connectionRetries = 0;
+            publishNetworkStatus();
 
             sysStatus->connection = true;
             sendNetworkEvent(NET_EVENT_CONNECTED);
@@ -878,7 +958,7 @@ static bool syncDateTime(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus
         if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
             networkState.timeSync = true;
-            xSemaphoreGive(networkStateMutex);
+            giveNetworkState();
         }
 
         sysStatus->datetime = true;
@@ -945,6 +1025,63 @@ static bool pingServer(const String& serverName)
     return serverAvailable;
 }
 
+// Deterministic per-device upload offset, so that a fleet aligned on the same
+// measurement boundary spreads its uploads over UPLOAD_JITTER_WINDOW_SEC instead
+// of hitting the backend in the same second. recordedAt is not affected.
+static uint32_t computeUploadJitterMs(const deviceNetworkInfo_t *devInfo)
+{
+    return ulRecordCodec_uploadJitterMs(devInfo->deviceid.c_str(), devInfo->baseMacChr,
+                                        UPLOAD_JITTER_WINDOW_SEC * 1000UL);
+}
+
+// Return the trimmed value of a header from a raw HTTP response, or an empty
+// string when the header is missing.
+static String getResponseHeader(const String &response, const char *name)
+{
+    char value[64];
+    if (!bRecordCodec_getHeader(response.c_str(), name, value, sizeof(value)))
+    {
+        return "";
+    }
+    return String(value);
+}
+
+// Extract the delta-seconds form of a Retry-After header from a raw HTTP response.
+// Returns 0 when the header is missing.
+static uint32_t parseRetryAfterSeconds(const String &response)
+{
+    return ulRecordCodec_parseRetryAfter(response.c_str(), SERVER_BACKOFF_DEFAULT_SEC, SERVER_BACKOFF_MAX_SEC);
+}
+
+// Arm the upload hold for a new batch (per-device offset, extended by any server
+// backoff) and report whether the batch still has to wait.
+static bool isUploadHoldActive(const deviceNetworkInfo_t *devInfo)
+{
+    unsigned long now = millis();
+
+    if (!networkState.uploadHoldArmed)
+    {
+        uint32_t jitterMs = computeUploadJitterMs(devInfo);
+        networkState.uploadHoldUntil = now + jitterMs;
+        networkState.uploadHoldArmed = true;
+        log_i("Upload offset for this device: %lu ms", (unsigned long)jitterMs);
+    }
+
+    // Server backoff takes precedence if it ends later than the device offset. A passed
+    // deadline is dropped: 2^31 ms later the wrapping comparison would read it as future again.
+    if (networkState.serverBackoffActive && ((long)(networkState.serverBackoffUntil - now) <= 0))
+    {
+        networkState.serverBackoffActive = false;
+    }
+    if (networkState.serverBackoffActive &&
+        ((long)(networkState.serverBackoffUntil - networkState.uploadHoldUntil) > 0))
+    {
+        networkState.uploadHoldUntil = networkState.serverBackoffUntil;
+    }
+
+    return ((long)(networkState.uploadHoldUntil - now) > 0);
+}
+
 // Send data to server
 static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devInfo,
                              systemStatus_t *sysStatus, systemData_t *sysData)
@@ -990,52 +1127,40 @@ static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devIn
 
     sslClient->setVerificationTime((epochTime / 86400UL) + 719528UL, epochTime % 86400UL);
 
-    // Build POST data string
-    String postData = "X-MSP-ID=" + devInfo->deviceid;
-
-    // Add sensor data - match original working logic by including all available data
-    // BME680 data (always include if temperature is in reasonable range)
-    if ((dataToSend->temp > -50.0) && (dataToSend->temp < 85.0))
+    // Sequence number makes every attempt of the same record idempotent on the server
+    if (dataToSend->seq == 0)
     {
-        postData += "&temp=" + String(dataToSend->temp, 3);
-        postData += "&hum=" + String(dataToSend->hum, 3);
-        postData += "&pre=" + String(dataToSend->pre, 3);
-        postData += "&voc=" + String(dataToSend->VOC, 3);
-        log_d("Added BME680 data: T=%.3f, H=%.3f, P=%.3f, VOC=%.3f",
-              dataToSend->temp, dataToSend->hum, dataToSend->pre, dataToSend->VOC);
+        dataToSend->seq = nextRecordSequence();
     }
+    log_i("Record sequence: %lu (Idempotency-Key: %s-%lu)", (unsigned long)dataToSend->seq,
+          devInfo->deviceid.c_str(), (unsigned long)dataToSend->seq);
 
-    // MICS6814 data (include if any gas reading is positive)
-    if ((dataToSend->MICS_CO >= 0.0) || (dataToSend->MICS_NO2 >= 0.0) || (dataToSend->MICS_NH3 >= 0.0))
+    // Build POST data string (shared wire format, see record_codec.cpp)
+    char postData[RECORD_CODEC_BODY_MAX_LEN];
+    int postDataLen = iRecordCodec_formatBody(dataToSend, devInfo->deviceid.c_str(), (long)epochTime,
+                                              postData, sizeof(postData));
+    if (postDataLen < 0)
     {
-        postData += "&cox=" + String(dataToSend->MICS_CO, 3);
-        postData += "&nox=" + String(dataToSend->MICS_NO2, 3);
-        postData += "&nh3=" + String(dataToSend->MICS_NH3, 3);
-        log_d("Added MICS6814 data: CO=%.3f, NO2=%.3f, NH3=%.3f",
-              dataToSend->MICS_CO, dataToSend->MICS_NO2, dataToSend->MICS_NH3);
-    }
-
-    // PMS5003 data (include if any PM reading is positive)
-    if ((dataToSend->PM1 >= 0) || (dataToSend->PM25 >= 0) || (dataToSend->PM10 >= 0))
-    {
-        postData += "&pm1=" + String(dataToSend->PM1);
-        postData += "&pm25=" + String(dataToSend->PM25);
-        postData += "&pm10=" + String(dataToSend->PM10);
-        log_d("Added PMS5003 data: PM1=%d, PM2.5=%d, PM10=%d",
-              dataToSend->PM1, dataToSend->PM25, dataToSend->PM10);
+        log_e("POST data does not fit in %d bytes", RECORD_CODEC_BODY_MAX_LEN);
+        return false;
     }
 
-    // O3 data (include if reading is positive)
-    if (dataToSend->ozone >= 0.0)
+    bool healthAttached = false;
+    if (!healthUploaded || ((millis() - lastHealthUploadMs) >= (SD_HEALTH_UPLOAD_INTERVAL_SEC * 1000UL)))
     {
-        postData += "&o3=" + String(dataToSend->ozone, 3);
-        log_d("Added O3 data: %.3f", dataToSend->ozone);
+        char healthBlock[SD_HEALTH_BLOCK_MAX_LEN];
+        if (iHalSdHealth_formatBlock(healthBlock, sizeof(healthBlock)) > 0)
+        {
+            int withHealthLen = iRecordCodec_appendHealth(postData, sizeof(postData), postDataLen, healthBlock);
+            if (withHealthLen > 0)
+            {
+                postDataLen = withHealthLen;
+                healthAttached = true;
+            }
+        }
     }
 
-    postData += "&msp=" + String(dataToSend->MSP);
-    postData += "&recordedAt=" + String(epochTime);
-
-    log_d("POST data length: %d bytes", postData.length());
+    log_d("POST data length: %d bytes", postDataLen);
 
     // Server communication with enhanced response logging
 
@@ -1058,15 +1183,17 @@ static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devIn
             log_i("Connected to server successfully via HTTPS");
 
             // Build HTTP request
-            String httpRequest = "POST /api/v1/records HTTP/1.1\r\n";
-            httpRequest += "Host: " + sysData->server + "\r\n";
-            httpRequest += "Authorization: Bearer " + sysData->api_secret_salt + ":" + devInfo->deviceid + "\r\n";
-            httpRequest += "Connection: close\r\n";
-            httpRequest += "User-Agent: MilanoSmartPark/0.2\r\n";
-            httpRequest += "Content-Type: application/x-www-form-urlencoded\r\n";
-            httpRequest += "Content-Length: " + String(postData.length()) + "\r\n";
-            httpRequest += "\r\n";
-            httpRequest += postData;
+            char requestHead[RECORD_CODEC_HEAD_MAX_LEN];
+            int requestHeadLen = iRecordCodec_formatRequestHead(sysData->server.c_str(), sysData->api_secret_salt.c_str(),
+                                                                devInfo->deviceid.c_str(), dataToSend->seq,
+                                                                (size_t)postDataLen, requestHead, sizeof(requestHead));
+            if (requestHeadLen < 0)
+            {
+                log_e("HTTP request head does not fit in %d bytes", RECORD_CODEC_HEAD_MAX_LEN);
+                sslClient->stop();
+                return false;
+            }
+            String httpRequest = String(requestHead) + postData;
 
             log_d("HTTP request size: %d bytes", httpRequest.length());
 
@@ -1143,12 +1270,30 @@ static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devIn
                 log_e("  - EMPTY RESPONSE! This indicates a timeout or SSL failure");
             }
 
+            // Server may acknowledge the highest sequence it has stored for this device
+            String ackSeq = getResponseHeader(response, "X-MSP-Ack-Seq");
+            if (ackSeq.length() > 0)
+            {
+                log_i("  - Server acknowledged records up to seq %s", ackSeq.c_str());
+            }
+
             // Response validation - same logic for all times
-            if (response.startsWith("HTTP/1.1 200", 0) || response.startsWith("HTTP/1.1 201", 0))
+            // 409 means the server already stored this Idempotency-Key: the record is safe.
+            // The ack header only counts on an accepting status, not on a proxy or error page.
+            int statusCode = response.startsWith("HTTP/1.") ? response.substring(9, 12).toInt() : 0;
+            bool statusAccepting = ((statusCode >= 200) && (statusCode < 300)) || (statusCode == 409);
+            if (response.startsWith("HTTP/1.1 200", 0) || response.startsWith("HTTP/1.1 201", 0) ||
+                response.startsWith("HTTP/1.1 409", 0) ||
+                (statusAccepting && (ackSeq.length() > 0) && (strtoul(ackSeq.c_str(), NULL, 10) >= dataToSend->seq)))
             {
                 log_i("SUCCESS: Data uploaded successfully! Status: %s",
                       response.substring(0, response.indexOf('\r')).c_str());
                 sysData->sent_ok = true;
+                if (healthAttached)
+                {
+                    healthUploaded = true;
+                    lastHealthUploadMs = millis();
+                }
                 sendNetworkEvent(NET_EVENT_DATA_SENT);
                 return true;
             }
@@ -1157,22 +1302,27 @@ static bool sendDataToServer(send_data_t *dataToSend, deviceNetworkInfo_t *devIn
                 log_e("TIMEOUT: No response received - likely SSL timeout or connection issue");
                 log_e("This could be due to server overload, network issues, or SSL problems");
                 wasSSLTimeout = true; // Mark this attempt as SSL timeout
-                
-                // Smart assumption logic: If server ping was successful AND data was sent completely,
-                // assume the data reached the server even though we didn't get a response
-                if (dataSentSuccessfully)
-                {
-                    log_w("SMART SUCCESS: Server ping was OK and data sent completely");
-                    log_w("Assuming server received data despite timeout response - preventing duplicates");
-                    sysData->sent_ok = true;
-                    sendNetworkEvent(NET_EVENT_DATA_SENT);
-                    return true;
-                }
-                else
+
+                // The outcome is unknown, but the Idempotency-Key lets the server drop a
+                // duplicate if the first attempt did land: retrying is safe, assuming is not
+                log_w("Unconfirmed delivery of seq %lu (request %s) - will retry with the same key",
+                      (unsigned long)dataToSend->seq, dataSentSuccessfully ? "complete" : "incomplete");
+            }
+            else if (response.startsWith("HTTP/1.1 429", 0) || response.startsWith("HTTP/1.1 503", 0))
+            {
+                // Server is shedding load: honor its backoff hint instead of retrying right away
+                uint32_t backoffSec = parseRetryAfterSeconds(response);
+                if (backoffSec == 0)
                 {
-                    log_e("Data transmission was incomplete - genuine failure, will retry");
-                    // Continue with normal retry logic
+                    backoffSec = SERVER_BACKOFF_DEFAULT_SEC;
                 }
+                networkState.serverBackoffUntil = millis() + (backoffSec * 1000UL);
+                networkState.serverBackoffActive = true;
+
+                log_w("SERVER BUSY: %s - backing off for %lu s",
+                      response.substring(0, response.indexOf('\r')).c_str(), (unsigned long)backoffSec);
+                sysData->sent_ok = false;
+                return false;
             }
             else if (response.startsWith("HTTP/1.1", 0))
             {
@@ -1236,14 +1386,11 @@ static void networkTask(void *pvParameters)
     systemStatus_t sysStatus;
     systemData_t sysData;
 
-    if (globalSysData && globalSysStatus && globalDevInfo)
+    if (startupDataSet)
     {
-        // Copy from global structures (with mutex protection)
-        vMspOs_takeDataAccessMutex();
-        devInfo = *globalDevInfo;
-        sysStatus = *globalSysStatus;
-        sysData = *globalSysData;
-        vMspOs_giveDataAccessMutex();
+        devInfo = startupDevInfo;
+        sysData = startupSysData;
+        sysStatus = startupSysStatus;
 
         log_i("Network task using global data structures");
         log_i("Server: %s, Server OK: %d", sysData.server.c_str(), sysStatus.server_ok);
@@ -1267,10 +1414,10 @@ static void networkTask(void *pvParameters)
         sysData.api_secret_salt = __API_SECRET_SALT;
     }
 
-    // Load initial configuration from SD card
-    sensorData_t sensorData = {};
-    deviceMeasurement_t measStat = {};
-    loadNetworkConfiguration(&devInfo, &sysStatus, &sysData, &sensorData, &measStat);
+    // Take the configuration published by the SD card reader, later versions arrive as NET_EVT_CONFIG_UPDATED
+    networkConfigSub = tHalConfigStore_subscribe(NETWORK_CONFIG_INTEREST, onNetworkConfigPublished, NULL);
+    loadNetworkConfiguration(&devInfo, &sysStatus, &sysData);
+    xEventGroupClearBits(networkEventGroup, NET_EVT_CONFIG_UPDATED);
 
     // Initialize network resources
     if (!initializeNetworkResources(sysStatus.use_modem))
@@ -1281,7 +1428,7 @@ static void networkTask(void *pvParameters)
         if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
             networkState.taskRunning = false;
-            xSemaphoreGive(networkStateMutex);
+            giveNetworkState();
         }
 
         vTaskDelete(NULL);
@@ -1325,13 +1472,33 @@ static void networkTask(void *pvParameters)
             if (events & NET_EVT_CONFIG_UPDATED)
             {
                 log_i("Configuration update request received");
-                // Reload configuration from SD card
-                sensorData_t sensorData = {};
-                deviceMeasurement_t measStat = {};
-                loadNetworkConfiguration(&devInfo, &sysStatus, &sysData, &sensorData, &measStat);
-
-                // Clear the processed event bit
+                // Clear first: a publish during the apply sets it again
                 xEventGroupClearBits(networkEventGroup, NET_EVT_CONFIG_UPDATED);
+
+                bool wasUsingModem = sysStatus.use_modem;
+                uint32_t changed = loadNetworkConfiguration(&devInfo, &sysStatus, &sysData);
+
+                if ((changed & CONFIG_CHANGED_MODEM) && sysStatus.use_modem && !wasUsingModem)
+                {
+                    initializeNetworkResources(true);
+                }
+
+                if ((changed & (CONFIG_CHANGED_WIFI | CONFIG_CHANGED_MODEM)) && isNetworkConnected())
+                {
+                    // Link settings changed: drop the connection, it is re-established with the new ones
+                    log_i("Connection settings changed, reconnecting");
+                    xEventGroupSetBits(networkEventGroup, NET_EVT_CONNECT_REQ);
+                    updateNetworkState(NETWRK_EVT_DEINIT_CONNECTION);
+                }
+                else if ((changed & CONFIG_CHANGED_TIME) && isNetworkConnected())
+                {
+                    log_i("Time settings changed, resynchronizing");
+                    updateNetworkState(NETWRK_EVT_SYNC_DATETIME);
+                }
+                else if (changed != 0)
+                {
+                    log_i("Configuration groups 0x%02lX applied without reconnecting", (unsigned long)changed);
+                }
             }
             else if (events & NET_EVT_CONNECT_REQ)
             {
@@ -1350,6 +1517,13 @@ static void networkTask(void *pvParameters)
                 // Clear the processed event bit
                 xEventGroupClearBits(networkEventGroup, NET_EVT_TIME_SYNC_REQ);
             }
+            else if ((events & NET_EVT_DATA_READY) && isUploadHoldActive(&devInfo))
+            {
+                // Keep DATA_READY set and poll in short slices so other requests are still served
+                unsigned long holdMs = networkState.uploadHoldUntil - millis();
+                log_v("Upload held for another %lu ms", holdMs);
+                vTaskDelay(pdMS_TO_TICKS((holdMs > 1000) ? 1000 : holdMs));
+            }
             else if (events & NET_EVT_DATA_READY)
             {
                 log_i("*** NET_EVT_DATA_READY event received - transitioning to UPDATE_DATA state");
@@ -1369,6 +1543,9 @@ static void networkTask(void *pvParameters)
             {
                 // Timeout occurred - perform periodic maintenance
                 log_v("Network task periodic check");
+
+                // Age-based flush of buffered SD log lines
+                vHalSdlog_poll();
                 
                 // PRIORITY: Check if queue has accumulated items that need processing
                 int queueSize = uxQueueMessagesWaiting(sendDataQueue);
@@ -1425,7 +1602,7 @@ static void networkTask(void *pvParameters)
                         }
                     }
 
-                    xSemaphoreGive(networkStateMutex);
+                    giveNetworkState();
                 }
             }
             break;
@@ -1441,7 +1618,7 @@ static void networkTask(void *pvParameters)
             if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
             {
                 currentRetries = networkState.connectionRetries;
-                xSemaphoreGive(networkStateMutex);
+                giveNetworkState();
             }
 
             if (currentRetries >= MAX_CONNECTION_RETRIES)
@@ -1453,7 +1630,7 @@ static void networkTask(void *pvParameters)
                 if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
                 {
                     networkState.connectionRetries = 0;
-                    xSemaphoreGive(networkStateMutex);
+                    giveNetworkState();
                 }
             }
 
@@ -1506,7 +1683,7 @@ static void networkTask(void *pvParameters)
                 if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
                 {
                     networkState.ntpSyncExpired = NTP_SYNC_TX_COUNT;
-                    xSemaphoreGive(networkStateMutex);
+                    giveNetworkState();
                 }
             }
             else
@@ -1647,11 +1824,12 @@ static void networkTask(void *pvParameters)
                 log_i("Data timestamp: %02d:%02d:%02d, Current time: %s",
                       dataTime.tm_hour, dataTime.tm_min, dataTime.tm_sec, processingTimeStr.c_str());
                 
-                // Check if this data originated from a peak time
+                // recordedAt stays on the boundary; only the upload itself is offset per device
                 bool dataFromPeakTime = (dataTime.tm_min == 0 || dataTime.tm_min == 30);
                 if (dataFromPeakTime)
                 {
-                    log_w("DATA FROM PEAK TIME DETECTED (minute %02d) - extra care needed for duplicates", dataTime.tm_min);
+                    log_i("Data from peak time (minute %02d) - upload offset by %lu ms for this device",
+                          dataTime.tm_min, (unsigned long)computeUploadJitterMs(&devInfo));
                 }
 
                 // Send data to server if connection and time sync are OK
@@ -1703,9 +1881,8 @@ static void networkTask(void *pvParameters)
                           networkState.timeSync, sysStatus.server_ok);
                 }
 
-                // Always log to SD card regardless of transmission status
+                // Always log regardless of transmission status (internal flash keeps the record without a card)
                 log_i("Writing data to SD card (mandatory logging)... SD status: %s", sysStatus.sdCard ? "OK" : "FAIL");
-                if (sysStatus.sdCard)
                 {
                     // Use a local sensor data structure - will be populated by the functions that need it
                     sensorData_t localSensorData;
@@ -1719,11 +1896,6 @@ static void networkTask(void *pvParameters)
                     localSensorData.status.O3Sensor = true;
 
                     vHalSdcard_logToSD(&currentData, &sysData, &sysStatus, &localSensorData, &devInfo);
-                    log_i("Data logged to SD card successfully with date-based folder structure");
-                }
-                else
-                {
-                    log_w("SD card not available for logging - data will be lost!");
                 }
 
                 // Print measurements to serial
@@ -1740,7 +1912,7 @@ static void networkTask(void *pvParameters)
                         if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
                         {
                             networkState.gsmConnected = false;
-                            xSemaphoreGive(networkStateMutex);
+                            giveNetworkState();
                         }
                         log_i("Modem disconnected to save power");
                     }
@@ -1774,6 +1946,9 @@ static void networkTask(void *pvParameters)
 
             // Manually clear the NET_EVT_DATA_READY bit now that we've finished processing all data
             xEventGroupClearBits(networkEventGroup, NET_EVT_DATA_READY);
+
+            // Next batch gets a fresh upload offset
+            networkState.uploadHoldArmed = false;
             log_d("NET_EVT_DATA_READY bit cleared after processing %d items", processedCount + failedCount);
 
             updateNetworkState(NETWRK_EVT_WAIT);
@@ -1812,7 +1987,7 @@ static void networkTask(void *pvParameters)
                 networkState.gsmConnected = false;
                 networkState.timeSync = false;
                 networkState.connectionRetries = 0;
-                xSemaphoreGive(networkStateMutex);
+                giveNetworkState();
             }
 
             sysStatus.connection = false;
@@ -1843,7 +2018,7 @@ static void networkTask(void *pvParameters)
     if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
     {
         networkState.taskRunning = false;
-        xSemaphoreGive(networkStateMutex);
+        giveNetworkState();
     }
 
     vTaskDelete(NULL);
@@ -1867,24 +2042,24 @@ void vHalNetwork_printWiFiMACAddr(systemStatus_t *p_tSys, deviceNetworkInfo_t *p
     updateDisplayStatus(p_tDev, p_tSys, DISP_EVENT_WIFI_MAC_ADDR);
 }
 
-// Load network configuration from SD card
-static bool loadNetworkConfiguration(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus,
-                                     systemData_t *sysData, sensorData_t *sensorData,
-                                     deviceMeasurement_t *measStat)
+// Apply the configuration changes published since the last call
+static uint32_t loadNetworkConfiguration(deviceNetworkInfo_t *devInfo, systemStatus_t *sysStatus,
+                                         systemData_t *sysData)
 {
-    log_i("Loading network configuration from SD card...");
+    static msp_config_t cfg; // only the network task calls this, keep ~600 bytes off its stack
+    config_diff_t diff;
 
-    // Initialize SD card if not already done
-    if (!initializeSD(sysStatus, devInfo))
+    if (!bHalConfigStore_take(networkConfigSub, &cfg, &diff))
     {
-        log_e("Failed to initialize SD card");
-        return false;
+        log_w("No new configuration published");
+        return 0;
     }
 
-    // Load configuration from SD card
-    bool configLoaded = checkConfig(CONFIG_PATH, devInfo, sensorData, measStat, sysStatus, sysData);
+    log_i("Applying configuration version %lu -> %lu (groups 0x%02lX)",
+          (unsigned long)diff.fromVersion, (unsigned long)diff.toVersion, (unsigned long)diff.changed);
+    vHalConfigStore_apply(&cfg, diff.changed, devInfo, NULL, NULL, sysStatus, sysData);
 
-    if (configLoaded)
+    if (cfg.valid)
     {
         log_i("Network configuration loaded successfully");
         log_i("WiFi SSID: %s", devInfo->ssid.c_str());
@@ -1913,44 +2088,57 @@ static bool loadNetworkConfiguration(deviceNetworkInfo_t *devInfo, systemStatus_
         if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
         {
             networkState.configurationLoaded = true;
-            xSemaphoreGive(networkStateMutex);
+            giveNetworkState();
         }
-
-        return true;
     }
     else
     {
         log_e("Failed to load network configuration");
         updateDisplayStatus(devInfo, sysStatus, DISP_EVENT_SD_CARD_CONFIG_ERROR);
-        return false;
     }
+
+    return diff.changed;
 }
 
-// Additional utility functions
-bool isNetworkTaskRunning()
+// Publish the fields other tasks read; the main task polls them without waiting on networkStateMutex
+static void publishNetworkStatus()
 {
-    bool running = false;
-
-    if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        running = networkState.taskRunning;
-        xSemaphoreGive(networkStateMutex);
-    }
+    networkStatus_t status;
+    status.taskRunning = networkState.taskRunning;
+    status.wifiConnected = networkState.wifiConnected;
+    status.gsmConnected = networkState.gsmConnected;
+    status.internetConnected = networkState.internetConnected;
+    status.timeSync = networkState.timeSync;
+    vSharedState_publishNetworkStatus(&status);
+}
 
-    return running;
+// Release networkStateMutex, publishing what changed while it was held
+static void giveNetworkState()
+{
+    publishNetworkStatus();
+    xSemaphoreGive(networkStateMutex);
 }
 
-bool isInternetConnected()
+// Config store callback, runs in the publisher's task
+static void onNetworkConfigPublished(void *ctx)
 {
-    bool connected = false;
+    (void)ctx;
+    updateNetworkConfig();
+}
 
-    if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        connected = networkState.internetConnected;
-        xSemaphoreGive(networkStateMutex);
-    }
+// Additional utility functions
+bool isNetworkTaskRunning()
+{
+    networkStatus_t status;
+    vSharedState_readNetworkStatus(&status);
+    return status.taskRunning;
+}
 
-    return connected;
+bool isInternetConnected()
+{
+    networkStatus_t status;
+    vSharedState_readNetworkStatus(&status);
+    return status.internetConnected;
 }
 
 void requestNetworkDisconnection()
@@ -1996,16 +2184,12 @@ bool getNetworkStatus(bool *wifiConnected, bool *gsmConnected, bool *timeSync)
         return false;
     }
 
-    if (xSemaphoreTake(networkStateMutex, pdMS_TO_TICKS(1000)) == pdTRUE)
-    {
-        *wifiConnected = networkState.wifiConnected;
-        *gsmConnected = networkState.gsmConnected;
-        *timeSync = networkState.timeSync;
-        xSemaphoreGive(networkStateMutex);
-        return true;
-    }
-
-    return false;
+    networkStatus_t status;
+    vSharedState_readNetworkStatus(&status);
+    *wifiConnected = status.wifiConnected;
+    *gsmConnected = status.gsmConnected;
+    *timeSync = status.timeSync;
+    return true;
 }
 
 // Network configuration initialization functions (moved from main file)
@@ -2034,7 +2218,7 @@ void setFirmwareDownloadInProgress(void)
     {
         networkState.firmwareDownloadInProgress = true;
         log_i("Firmware download started - network connectivity tests disabled");
-        xSemaphoreGive(networkStateMutex);
+        giveNetworkState();
     }
     else
     {
@@ -2048,7 +2232,7 @@ void clearFirmwareDownloadInProgress(void)
     {
         networkState.firmwareDownloadInProgress = false;
         log_i("Firmware download completed - network connectivity tests re-enabled");
-        xSemaphoreGive(networkStateMutex);
+        giveNetworkState();
     }
     else
     {
@@ -98,6 +98,14 @@ bool enqueueSendData(const send_data_t &data, TickType_t ticksToWait);
  */
 bool dequeueSendData(send_data_t *data, TickType_t ticksToWait);
 
+/**
+ * @brief Get the next record sequence number for this device
+ * @details Monotonic across reboots: numbers are reserved in NVS in blocks, so a
+ *          reset may leave a gap but never reuses a value. 0 is never returned.
+ * @return Sequence number to store in send_data_t::seq
+ */
+uint32_t nextRecordSequence(void);
+
 // ===== Event Management =====
 
 /**
@@ -0,0 +1,283 @@
+/*******************************************************************************
+ * @file    ota_delta.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Delta firmware patches for the Milano Smart Park project
+ * @details Must stay free of Arduino/ESP-IDF includes: it is also compiled
+ *          on the host by tools/otadiff. Inflating the zlib stream is left
+ *          to the caller (ROM miniz on the device, zlib on the host).
+ * @version 0.1
+ * @date    2025-10-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ******************************************************************************/
+
+// -- includes --
+#include <string.h>
+#include "ota_delta.h"
+
+// Header layout: magic, version (LE), reserved, old size (LE), new size (LE), old SHA-256, new SHA-256
+#define OTA_DELTA_HDR_VERSION_OFS 8
+#define OTA_DELTA_HDR_OLDSIZE_OFS 12
+#define OTA_DELTA_HDR_NEWSIZE_OFS 16
+#define OTA_DELTA_HDR_OLDSHA_OFS 20
+#define OTA_DELTA_HDR_NEWSHA_OFS 52
+
+/***************************************************************
+ * @brief stores a little-endian 32 bit value
+ ***************************************************************/
+static void vOtaDelta_put32(uint8_t *p, uint32_t value)
+{
+  p[0] = (uint8_t)value;
+  p[1] = (uint8_t)(value >> 8);
+  p[2] = (uint8_t)(value >> 16);
+  p[3] = (uint8_t)(value >> 24);
+}
+
+/***************************************************************
+ * @brief loads a little-endian 32 bit value
+ ***************************************************************/
+static uint32_t ulOtaDelta_get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/***************************************************************
+ * @brief builds a patch header
+ *
+ * @param hdr
+ * @param out
+ * @param outLen
+ * @return size_t
+ ***************************************************************/
+size_t uOtaDelta_formatHeader(const ota_delta_header_t *hdr, uint8_t *out, size_t outLen)
+{
+  if (outLen < OTA_DELTA_HEADER_LEN)
+  {
+    return 0;
+  }
+
+  memset(out, 0, OTA_DELTA_HEADER_LEN);
+  memcpy(out, OTA_DELTA_MAGIC, OTA_DELTA_MAGIC_LEN);
+  out[OTA_DELTA_HDR_VERSION_OFS] = (uint8_t)(OTA_DELTA_VERSION & 0xFF);
+  out[OTA_DELTA_HDR_VERSION_OFS + 1] = (uint8_t)(OTA_DELTA_VERSION >> 8);
+  vOtaDelta_put32(out + OTA_DELTA_HDR_OLDSIZE_OFS, hdr->oldSize);
+  vOtaDelta_put32(out + OTA_DELTA_HDR_NEWSIZE_OFS, hdr->newSize);
+  memcpy(out + OTA_DELTA_HDR_OLDSHA_OFS, hdr->oldSha, OTA_DELTA_HASH_LEN);
+  memcpy(out + OTA_DELTA_HDR_NEWSHA_OFS, hdr->newSha, OTA_DELTA_HASH_LEN);
+
+  return OTA_DELTA_HEADER_LEN;
+}
+
+/***************************************************************
+ * @brief validates a patch header
+ *
+ * @param in
+ * @param inLen
+ * @param hdr
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bOtaDelta_parseHeader(const uint8_t *in, size_t inLen, ota_delta_header_t *hdr)
+{
+  if ((inLen < OTA_DELTA_HEADER_LEN) || (memcmp(in, OTA_DELTA_MAGIC, OTA_DELTA_MAGIC_LEN) != 0))
+  {
+    return false;
+  }
+  if ((in[OTA_DELTA_HDR_VERSION_OFS] | (in[OTA_DELTA_HDR_VERSION_OFS + 1] << 8)) != OTA_DELTA_VERSION)
+  {
+    return false;
+  }
+
+  hdr->oldSize = ulOtaDelta_get32(in + OTA_DELTA_HDR_OLDSIZE_OFS);
+  hdr->newSize = ulOtaDelta_get32(in + OTA_DELTA_HDR_NEWSIZE_OFS);
+  memcpy(hdr->oldSha, in + OTA_DELTA_HDR_OLDSHA_OFS, OTA_DELTA_HASH_LEN);
+  memcpy(hdr->newSha, in + OTA_DELTA_HDR_NEWSHA_OFS, OTA_DELTA_HASH_LEN);
+
+  return true;
+}
+
+/***************************************************************
+ * @brief encodes a record
+ *
+ * @param diffLen
+ * @param extraLen
+ * @param seek
+ * @param out
+ ***************************************************************/
+void vOtaDelta_formatRecord(uint32_t diffLen, uint32_t extraLen, int32_t seek, uint8_t *out)
+{
+  vOtaDelta_put32(out, diffLen);
+  vOtaDelta_put32(out + 4, extraLen);
+  vOtaDelta_put32(out + 8, (uint32_t)seek);
+}
+
+/***************************************************************
+ * @brief starts applying a patch
+ *
+ * @param apply
+ * @param hdr
+ * @param readOld
+ * @param writeNew
+ * @param ctx
+ ***************************************************************/
+void vOtaDelta_applyInit(ota_delta_apply_t *apply, const ota_delta_header_t *hdr,
+                         otaDeltaReadOld_t readOld, otaDeltaWriteNew_t writeNew, void *ctx)
+{
+  memset(apply, 0, sizeof(*apply));
+  apply->readOld = readOld;
+  apply->writeNew = writeNew;
+  apply->ctx = ctx;
+  apply->oldSize = hdr->oldSize;
+  apply->newSize = hdr->newSize;
+  apply->state = OTA_DELTA_STATE_RECORD;
+}
+
+/***************************************************************
+ * @brief takes the record once its bytes are in; lengths that
+ *        would run past either image make the patch malformed
+ *
+ * @param apply
+ * @return true
+ * @return false
+ ***************************************************************/
+static bool bOtaDelta_startRecord(ota_delta_apply_t *apply)
+{
+  apply->diffLeft = ulOtaDelta_get32(apply->record);
+  apply->extraLeft = ulOtaDelta_get32(apply->record + 4);
+  apply->seek = (int32_t)ulOtaDelta_get32(apply->record + 8);
+  apply->recordLen = 0;
+  apply->records++;
+
+  uint64_t newEnd = (uint64_t)apply->newPos + apply->diffLeft + apply->extraLeft;
+  if ((newEnd > apply->newSize) || ((apply->oldPos + apply->diffLeft) > apply->oldSize))
+  {
+    return false;
+  }
+
+  apply->state = (apply->diffLeft > 0) ? OTA_DELTA_STATE_DIFF : OTA_DELTA_STATE_EXTRA;
+  return true;
+}
+
+/***************************************************************
+ * @brief moves to the next record once both parts are out
+ *
+ * @param apply
+ * @return true
+ * @return false
+ ***************************************************************/
+static bool bOtaDelta_endRecord(ota_delta_apply_t *apply)
+{
+  apply->oldPos += apply->seek;
+  if ((apply->oldPos < 0) || (apply->oldPos > apply->oldSize))
+  {
+    return false;
+  }
+  apply->state = OTA_DELTA_STATE_RECORD;
+  return true;
+}
+
+/***************************************************************
+ * @brief applies the next inflated patch bytes
+ *
+ * @param apply
+ * @param data
+ * @param len
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bOtaDelta_applyFeed(ota_delta_apply_t *apply, const uint8_t *data, size_t len)
+{
+  while ((len > 0) && (apply->state != OTA_DELTA_STATE_ERROR))
+  {
+    bool ok = true;
+
+    switch (apply->state)
+    {
+    case OTA_DELTA_STATE_RECORD:
+    {
+      size_t take = OTA_DELTA_RECORD_LEN - apply->recordLen;
+      take = (take < len) ? take : len;
+      memcpy(apply->record + apply->recordLen, data, take);
+      apply->recordLen += take;
+      data += take;
+      len -= take;
+      if (apply->recordLen == OTA_DELTA_RECORD_LEN)
+      {
+        ok = bOtaDelta_startRecord(apply);
+        if (ok && (apply->diffLeft == 0) && (apply->extraLeft == 0))
+        {
+          ok = bOtaDelta_endRecord(apply);
+        }
+      }
+      break;
+    }
+
+    case OTA_DELTA_STATE_DIFF:
+    {
+      size_t take = (apply->diffLeft < len) ? apply->diffLeft : len;
+      take = (take < OTA_DELTA_OLD_CACHE_LEN) ? take : OTA_DELTA_OLD_CACHE_LEN;
+      ok = apply->readOld(apply->ctx, (uint32_t)apply->oldPos, apply->oldCache, take);
+      for (size_t i = 0; ok && (i < take); i++)
+      {
+        apply->oldCache[i] = (uint8_t)(apply->oldCache[i] + data[i]);
+      }
+      ok = ok && apply->writeNew(apply->ctx, apply->oldCache, take);
+      apply->oldPos += take;
+      apply->newPos += take;
+      apply->diffLeft -= take;
+      data += take;
+      len -= take;
+      if (ok && (apply->diffLeft == 0))
+      {
+        apply->state = OTA_DELTA_STATE_EXTRA;
+        if (apply->extraLeft == 0)
+        {
+          ok = bOtaDelta_endRecord(apply);
+        }
+      }
+      break;
+    }
+
+    case OTA_DELTA_STATE_EXTRA:
+    {
+      size_t take = (apply->extraLeft < len) ? apply->extraLeft : len;
+      ok = apply->writeNew(apply->ctx, data, take);
+      apply->newPos += take;
+      apply->extraLeft -= take;
+      data += take;
+      len -= take;
+      if (ok && (apply->extraLeft == 0))
+      {
+        ok = bOtaDelta_endRecord(apply);
+      }
+      break;
+    }
+
+    default:
+      ok = false;
+      break;
+    }
+
+    if (!ok)
+    {
+      apply->state = OTA_DELTA_STATE_ERROR;
+    }
+  }
+
+  return apply->state != OTA_DELTA_STATE_ERROR;
+}
+
+/***************************************************************
+ * @brief true once the whole new image is out
+ *
+ * @param apply
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bOtaDelta_applyDone(const ota_delta_apply_t *apply)
+{
+  return (apply->state == OTA_DELTA_STATE_RECORD) && (apply->recordLen == 0) && (apply->newPos == apply->newSize);
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,152 @@
+/**************************************************************************************
+ * @file    ota_delta.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Delta firmware patches for the Milano Smart Park project
+ * @details A patch rebuilds a release image from the image the device runs,
+ *          bsdiff style: the header, then a zlib stream of records
+ *          {diffLen, extraLen, seek} each followed by diffLen bytes added to
+ *          the old image and extraLen bytes copied as they are.
+ *          The records are applied as they arrive, so the new image is written
+ *          in order without the patch ever being stored.
+ *          Plain C/C++ with no Arduino dependency: tools/otadiff builds
+ *          patches and checks them with this same code.
+ * @version 0.1
+ * @date    2025-10-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *************************************************************************************/
+
+#ifndef OTA_DELTA_H
+#define OTA_DELTA_H
+
+//-- includes --
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Patch header, little-endian, in front of the zlib stream
+#define OTA_DELTA_MAGIC "MSPDELTA"
+#define OTA_DELTA_MAGIC_LEN 8
+#define OTA_DELTA_VERSION 1
+#define OTA_DELTA_HASH_LEN 32
+#define OTA_DELTA_HEADER_LEN 84
+#define OTA_DELTA_RECORD_LEN 12 /*!< diffLen, extraLen, seek */
+
+#define OTA_DELTA_OLD_CACHE_LEN 512 /*!< old image bytes read at a time */
+
+typedef struct __OTA_DELTA_HEADER__
+{
+  uint32_t oldSize;                     /*!< bytes of the image the patch applies to */
+  uint32_t newSize;                     /*!< bytes of the rebuilt image */
+  uint8_t oldSha[OTA_DELTA_HASH_LEN];   /*!< SHA-256 of the old image */
+  uint8_t newSha[OTA_DELTA_HASH_LEN];   /*!< SHA-256 of the rebuilt image */
+} ota_delta_header_t;
+
+/*************************************************
+ * @brief   reads old image bytes
+ *
+ * @return  true  len bytes read at offset
+ *************************************************/
+typedef bool (*otaDeltaReadOld_t)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+
+/*************************************************
+ * @brief   takes the next bytes of the new image
+ *
+ * @return  true  written
+ *************************************************/
+typedef bool (*otaDeltaWriteNew_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef enum __OTA_DELTA_STATE__
+{
+  OTA_DELTA_STATE_RECORD = 0,
+  OTA_DELTA_STATE_DIFF,
+  OTA_DELTA_STATE_EXTRA,
+  OTA_DELTA_STATE_ERROR
+} otaDeltaState_t;
+
+typedef struct __OTA_DELTA_APPLY__
+{
+  otaDeltaReadOld_t readOld;
+  otaDeltaWriteNew_t writeNew;
+  void *ctx;
+  uint32_t oldSize;
+  uint32_t newSize;
+  otaDeltaState_t state;
+  uint8_t record[OTA_DELTA_RECORD_LEN];
+  size_t recordLen;                      /*!< record bytes collected so far */
+  uint32_t diffLeft;
+  uint32_t extraLeft;
+  int32_t seek;
+  int64_t oldPos;
+  uint32_t newPos;                       /*!< new image bytes written */
+  uint32_t records;
+  uint8_t oldCache[OTA_DELTA_OLD_CACHE_LEN];
+} ota_delta_apply_t;
+
+/*************************************************
+ * @brief   builds a patch header
+ *
+ * @param   hdr     header fields
+ * @param   out     output buffer (OTA_DELTA_HEADER_LEN)
+ * @param   outLen  output buffer size
+ * @return  size_t  header length, 0 on error
+ *************************************************/
+size_t uOtaDelta_formatHeader(const ota_delta_header_t *hdr, uint8_t *out, size_t outLen);
+
+/*************************************************
+ * @brief   validates a patch header
+ *
+ * @param   in      header bytes
+ * @param   inLen   available bytes
+ * @param   hdr     filled with the header fields
+ * @return  true    known magic and version
+ *************************************************/
+bool bOtaDelta_parseHeader(const uint8_t *in, size_t inLen, ota_delta_header_t *hdr);
+
+/*************************************************
+ * @brief   encodes a record
+ *
+ * @param   diffLen   bytes added to the old image
+ * @param   extraLen  bytes copied as they are
+ * @param   seek      old image move after them
+ * @param   out       OTA_DELTA_RECORD_LEN bytes
+ *************************************************/
+void vOtaDelta_formatRecord(uint32_t diffLen, uint32_t extraLen, int32_t seek, uint8_t *out);
+
+/*************************************************
+ * @brief   starts applying a patch
+ *
+ * @param   apply     applier state
+ * @param   hdr       parsed patch header
+ * @param   readOld   old image reader
+ * @param   writeNew  new image writer
+ * @param   ctx       passed to both callbacks
+ *************************************************/
+void vOtaDelta_applyInit(ota_delta_apply_t *apply, const ota_delta_header_t *hdr,
+                         otaDeltaReadOld_t readOld, otaDeltaWriteNew_t writeNew, void *ctx);
+
+/*************************************************
+ * @brief   applies the next inflated patch bytes,
+ *          in any split
+ *
+ * @param   apply  applier state
+ * @param   data   bytes after the zlib stream
+ * @param   len    bytes in data
+ * @return  true   applied; false on a malformed
+ *                 patch or a failed callback, after
+ *                 which every call fails
+ *************************************************/
+bool bOtaDelta_applyFeed(ota_delta_apply_t *apply, const uint8_t *data, size_t len);
+
+/*************************************************
+ * @brief   true once the whole new image is out
+ *          and no record is left half read
+ *
+ * @param   apply  applier state
+ *************************************************/
+bool bOtaDelta_applyDone(const ota_delta_apply_t *apply);
+
+#endif
+
+//************************************** EOF **************************************
@@ -0,0 +1,276 @@
+/*******************************************************************************
+ * @file    record_codec.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Upload record serialization for the Milano Smart Park project
+ * @details Must stay free of Arduino/ESP-IDF includes: it is also compiled
+ *          on the host by tools/fleet-sim.
+ * @version 0.1
+ * @date    2025-09-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ******************************************************************************/
+
+// -- includes --
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include "record_codec.h"
+
+#define FNV1A_OFFSET_BASIS 2166136261UL
+#define FNV1A_PRIME 16777619UL
+
+/***************************************************************
+ * @brief appends formatted text, tracking overflow
+ *
+ * @param buf
+ * @param bufLen
+ * @param pos     current length, updated; -1 once overflowed
+ * @param fmt
+ ***************************************************************/
+static void vRecordCodec_append(char *buf, size_t bufLen, int *pos, const char *fmt, ...)
+{
+  if (*pos < 0)
+  {
+    return;
+  }
+
+  va_list args;
+  va_start(args, fmt);
+  int written = vsnprintf(buf + *pos, bufLen - (size_t)*pos, fmt, args);
+  va_end(args);
+
+  if ((written < 0) || ((size_t)(*pos + written) >= bufLen))
+  {
+    *pos = -1;
+    return;
+  }
+  *pos += written;
+}
+
+/***************************************************************
+ * @brief builds the form-encoded body of a record
+ *
+ * @param data
+ * @param deviceId
+ * @param recordedAt
+ * @param buf
+ * @param bufLen
+ * @return int
+ ***************************************************************/
+int iRecordCodec_formatBody(const send_data_t *data, const char *deviceId, long recordedAt,
+                            char *buf, size_t bufLen)
+{
+  int pos = 0;
+
+  vRecordCodec_append(buf, bufLen, &pos, "X-MSP-ID=%s", deviceId);
+
+  // BME680 data (only if temperature is in a plausible range)
+  if ((data->temp > -50.0) && (data->temp < 85.0))
+  {
+    vRecordCodec_append(buf, bufLen, &pos, "&temp=%.3f&hum=%.3f&pre=%.3f&voc=%.3f",
+                        data->temp, data->hum, data->pre, data->VOC);
+  }
+
+  // MICS6814 data (if any gas reading is valid)
+  if ((data->MICS_CO >= 0.0) || (data->MICS_NO2 >= 0.0) || (data->MICS_NH3 >= 0.0))
+  {
+    vRecordCodec_append(buf, bufLen, &pos, "&cox=%.3f&nox=%.3f&nh3=%.3f",
+                        data->MICS_CO, data->MICS_NO2, data->MICS_NH3);
+  }
+
+  // PMS5003 data (if any PM reading is valid)
+  if ((data->PM1 >= 0) || (data->PM25 >= 0) || (data->PM10 >= 0))
+  {
+    vRecordCodec_append(buf, bufLen, &pos, "&pm1=%ld&pm25=%ld&pm10=%ld",
+                        (long)data->PM1, (long)data->PM25, (long)data->PM10);
+  }
+
+  // O3 data
+  if (data->ozone >= 0.0)
+  {
+    vRecordCodec_append(buf, bufLen, &pos, "&o3=%.3f", data->ozone);
+  }
+
+  vRecordCodec_append(buf, bufLen, &pos, "&msp=%d&recordedAt=%ld&seq=%lu",
+                      (int)data->MSP, recordedAt, (unsigned long)data->seq);
+
+  return pos;
+}
+
+/***************************************************************
+ * @brief appends the device health field to a formatted body
+ *
+ * @param buf
+ * @param bufLen
+ * @param bodyLen
+ * @param block
+ * @return int
+ ***************************************************************/
+int iRecordCodec_appendHealth(char *buf, size_t bufLen, int bodyLen, const char *block)
+{
+  int pos = bodyLen;
+
+  vRecordCodec_append(buf, bufLen, &pos, "&sdh=%s", block);
+  if (pos < 0)
+  {
+    buf[bodyLen] = '\0'; // body is left as it was
+  }
+  return pos;
+}
+
+/***************************************************************
+ * @brief builds the HTTP request head for a body
+ *
+ * @param host
+ * @param apiSalt
+ * @param deviceId
+ * @param seq
+ * @param contentLength
+ * @param buf
+ * @param bufLen
+ * @return int
+ ***************************************************************/
+int iRecordCodec_formatRequestHead(const char *host, const char *apiSalt, const char *deviceId,
+                                   uint32_t seq, size_t contentLength, char *buf, size_t bufLen)
+{
+  int pos = 0;
+
+  vRecordCodec_append(buf, bufLen, &pos,
+                      "POST " RECORD_CODEC_API_PATH " HTTP/1.1\r\n"
+                      "Host: %s\r\n"
+                      "Authorization: Bearer %s:%s\r\n"
+                      "Connection: close\r\n"
+                      "User-Agent: " RECORD_CODEC_USER_AGENT "\r\n"
+                      "Idempotency-Key: %s-%lu\r\n"
+                      "Content-Type: application/x-www-form-urlencoded\r\n"
+                      "Content-Length: %u\r\n"
+                      "\r\n",
+                      host, apiSalt, deviceId, deviceId, (unsigned long)seq, (unsigned)contentLength);
+
+  return pos;
+}
+
+/***************************************************************
+ * @brief FNV-1a over device id and MAC: stable across reboots,
+ *        different per device
+ *
+ * @param deviceId
+ * @param mac
+ * @param windowMs
+ * @return uint32_t
+ ***************************************************************/
+uint32_t ulRecordCodec_uploadJitterMs(const char *deviceId, const char *mac, uint32_t windowMs)
+{
+  uint32_t hash = FNV1A_OFFSET_BASIS;
+  const char *sources[] = {deviceId, mac};
+
+  if (windowMs == 0)
+  {
+    return 0;
+  }
+
+  for (size_t i = 0; i < (sizeof(sources) / sizeof(sources[0])); i++)
+  {
+    for (const char *c = sources[i]; (c != NULL) && (*c != '\0'); c++)
+    {
+      hash ^= (uint8_t)(*c);
+      hash *= FNV1A_PRIME;
+    }
+  }
+
+  return hash % windowMs;
+}
+
+/***************************************************************
+ * @brief copies the trimmed value of a response header
+ *
+ * @param response
+ * @param name
+ * @param out
+ * @param outLen
+ * @return true
+ * @return false
+ ***************************************************************/
+bool bRecordCodec_getHeader(const char *response, const char *name, char *out, size_t outLen)
+{
+  size_t nameLen = strlen(name);
+  const char *headersEnd = strstr(response, "\r\n\r\n");
+  const char *line = strstr(response, "\r\n");
+
+  if ((outLen == 0) || (line == NULL))
+  {
+    return false;
+  }
+
+  // Walk header lines (the status line is skipped)
+  while ((line != NULL) && ((headersEnd == NULL) || (line < headersEnd)))
+  {
+    line += 2;
+    if ((strncasecmp(line, name, nameLen) == 0) && (line[nameLen] == ':'))
+    {
+      const char *value = line + nameLen + 1;
+      while ((*value == ' ') || (*value == '\t'))
+      {
+        value++;
+      }
+
+      const char *valueEnd = strstr(value, "\r\n");
+      size_t valueLen = (valueEnd != NULL) ? (size_t)(valueEnd - value) : strlen(value);
+      while ((valueLen > 0) && isspace((unsigned char)value[valueLen - 1]))
+      {
+        valueLen--;
+      }
+      if (valueLen >= outLen)
+      {
+        valueLen = outLen - 1;
+      }
+
+      memcpy(out, value, valueLen);
+      out[valueLen] = '\0';
+      return true;
+    }
+    line = strstr(line, "\r\n");
+  }
+
+  return false;
+}
+
+/***************************************************************
+ * @brief parses the Retry-After backoff hint
+ *
+ * @param response
+ * @param defaultSec
+ * @param maxSec
+ * @return uint32_t
+ ***************************************************************/
+uint32_t ulRecordCodec_parseRetryAfter(const char *response, uint32_t defaultSec, uint32_t maxSec)
+{
+  char value[40];
+
+  if (!bRecordCodec_getHeader(response, "Retry-After", value, sizeof(value)) || (value[0] == '\0'))
+  {
+    return 0;
+  }
+
+  uint32_t seconds = 0;
+  for (const char *c = value; *c != '\0'; c++)
+  {
+    if (!isdigit((unsigned char)*c))
+    {
+      // HTTP-date form: no trustworthy wall clock comparison here
+      return (defaultSec > maxSec) ? maxSec : defaultSec;
+    }
+    seconds = (seconds * 10) + (uint32_t)(*c - '0');
+    if (seconds > maxSec)
+    {
+      return maxSec;
+    }
+  }
+
+  return seconds;
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,125 @@
+/**************************************************************************************
+ * @file    record_codec.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Upload record serialization for the Milano Smart Park project
+ * @details Wire format of a measurement record (form body + HTTP request head),
+ *          upload scheduling and response header parsing. Plain C/C++ with no
+ *          Arduino dependency, so host tools build against the exact same code
+ *          as the device.
+ * @version 0.1
+ * @date    2025-09-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *************************************************************************************/
+
+#ifndef RECORD_CODEC_H
+#define RECORD_CODEC_H
+
+//-- includes --
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#define RECORD_CODEC_API_PATH "/api/v1/records"
+#define RECORD_CODEC_USER_AGENT "MilanoSmartPark/0.2"
+
+#define RECORD_CODEC_HEALTH_MAX_LEN 128 /*!< optional health field value incl. terminator */
+#define RECORD_CODEC_BODY_MAX_LEN (384 + RECORD_CODEC_HEALTH_MAX_LEN) /*!< worst case form body incl. terminator */
+#define RECORD_CODEC_HEAD_MAX_LEN 512 /*!< worst case request head incl. terminator */
+
+typedef struct __SEND_DATA__
+{
+  tm sendTimeInfo; /*!< Date and time of the data to be sent */
+  float temp;
+  float hum;
+  float pre;
+  float VOC;
+  int32_t PM1;
+  int32_t PM25;
+  int32_t PM10;
+  float MICS_CO;
+  float MICS_NO2;
+  float MICS_NH3;
+  float ozone;
+  int8_t MSP; /*!< MSP# Index */
+  uint32_t seq; /*!< Per-device record sequence number (0 = not assigned) */
+} send_data_t;
+
+/*************************************************
+ * @brief   builds the form-encoded body of a record
+ *
+ * @param   data        record to serialize
+ * @param   deviceId    device identifier (X-MSP-ID)
+ * @param   recordedAt  epoch of the measurement boundary
+ * @param   buf         output buffer
+ * @param   bufLen      output buffer size
+ * @return  int         body length, -1 if it does not fit
+ *************************************************/
+int iRecordCodec_formatBody(const send_data_t *data, const char *deviceId, long recordedAt,
+                            char *buf, size_t bufLen);
+
+/*************************************************
+ * @brief   appends the device health field
+ *          ("&sdh=<block>") to a formatted body
+ *
+ * @param   buf      body from iRecordCodec_formatBody
+ * @param   bufLen   output buffer size
+ * @param   bodyLen  current body length
+ * @param   block    health block, no form escaping needed
+ * @return  int      new body length, -1 if it does not
+ *                   fit (body left unchanged)
+ *************************************************/
+int iRecordCodec_appendHealth(char *buf, size_t bufLen, int bodyLen, const char *block);
+
+/*************************************************
+ * @brief   builds the HTTP request head for a body
+ *
+ * @param   host           server host name
+ * @param   apiSalt        API secret salt
+ * @param   deviceId       device identifier
+ * @param   seq            record sequence number
+ * @param   contentLength  body length
+ * @param   buf            output buffer
+ * @param   bufLen         output buffer size
+ * @return  int            head length, -1 if it does not fit
+ *************************************************/
+int iRecordCodec_formatRequestHead(const char *host, const char *apiSalt, const char *deviceId,
+                                   uint32_t seq, size_t contentLength, char *buf, size_t bufLen);
+
+/*************************************************
+ * @brief   deterministic per-device upload offset
+ *
+ * @param   deviceId  device identifier
+ * @param   mac       base MAC address string
+ * @param   windowMs  offset window
+ * @return  uint32_t  offset in [0, windowMs)
+ *************************************************/
+uint32_t ulRecordCodec_uploadJitterMs(const char *deviceId, const char *mac, uint32_t windowMs);
+
+/*************************************************
+ * @brief   copies the value of a response header
+ *
+ * @param   response  raw HTTP response (NUL terminated)
+ * @param   name      header name, case-insensitive
+ * @param   out       output buffer for the trimmed value
+ * @param   outLen    output buffer size
+ * @return  true      header found
+ * @return  false     header missing
+ *************************************************/
+bool bRecordCodec_getHeader(const char *response, const char *name, char *out, size_t outLen);
+
+/*************************************************
+ * @brief   parses the Retry-After backoff hint
+ *
+ * @param   response     raw HTTP response
+ * @param   defaultSec   value used for non delta-seconds forms
+ * @param   maxSec       upper bound
+ * @return  uint32_t     seconds, 0 if header missing
+ *************************************************/
+uint32_t ulRecordCodec_parseRetryAfter(const char *response, uint32_t defaultSec, uint32_t maxSec);
+
+#endif
+
+//************************************** EOF **************************************
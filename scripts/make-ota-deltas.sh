@@ -0,0 +1,77 @@
+#!/bin/sh
+#
+# Build delta OTA patches for a release from the previous releases' images.
+#
+#   scripts/make-ota-deltas.sh TAG [update_TAG.bin]
+#
+# For each of the OTA_DELTA_BASES (default 3) tags before TAG, downloads
+# update_<base>.bin from its GitHub release and writes
+# update_<TAG>_from_<base>.patch next to the new image. A patch is kept only
+# when it is under OTA_DELTA_MAX_PERCENT (default 60) of the full image;
+# devices without a patch for their version download the full image.
+# Without the second argument the TAG image is downloaded too, which measures
+# the patches of a past release.
+#
+# Needs bin/otadiff (make otadiff) and an authenticated gh CLI (GH_TOKEN).
+# Prints a size table, also appended to the job summary on GitHub Actions.
+#
+set -e
+
+TAG="$1"
+NEW_BIN="$2"
+BASES="${OTA_DELTA_BASES:-3}"
+MAX_PERCENT="${OTA_DELTA_MAX_PERCENT:-60}"
+OTADIFF="${OTADIFF:-bin/otadiff}"
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ -z "$TAG" ]; then
+  echo "usage: $0 TAG [update_TAG.bin]" >&2
+  exit 2
+fi
+if [ -z "$NEW_BIN" ]; then
+  gh release download "$TAG" -p "update_$TAG.bin" -D "$WORK"
+  NEW_BIN="$WORK/update_$TAG.bin"
+  OUT_DIR="$WORK"
+else
+  OUT_DIR=$(dirname "$NEW_BIN")
+fi
+NEW_SIZE=$(wc -c < "$NEW_BIN")
+
+# Tags before TAG, newest first
+BASE_TAGS=$(git tag --list 'v*' --sort=-v:refname | sed -n "/^$TAG\$/,\$p" | sed 1d | head -n "$BASES")
+
+REPORT="$WORK/report.md"
+{
+  echo "### Delta OTA patches for $TAG"
+  echo
+  echo "Full image: $NEW_SIZE bytes"
+  echo
+  echo "| from | patch bytes | % of full | published |"
+  echo "|------|------------:|----------:|-----------|"
+} > "$REPORT"
+
+for BASE in $BASE_TAGS; do
+  if ! gh release download "$BASE" -p "update_$BASE.bin" -D "$WORK" 2>/dev/null; then
+    echo "| $BASE | - | - | no update_$BASE.bin |" >> "$REPORT"
+    continue
+  fi
+  PATCH="$OUT_DIR/update_${TAG}_from_${BASE}.patch"
+  "$OTADIFF" -q diff "$WORK/update_$BASE.bin" "$NEW_BIN" "$PATCH"
+  PATCH_SIZE=$(wc -c < "$PATCH")
+  PERMILLE=$((PATCH_SIZE * 1000 / NEW_SIZE))
+  if [ -z "$2" ]; then
+    PUBLISHED=-
+  elif [ "$PERMILLE" -lt $((MAX_PERCENT * 10)) ]; then
+    PUBLISHED=yes
+  else
+    PUBLISHED=no
+    rm -f "$PATCH"
+  fi
+  echo "| $BASE | $PATCH_SIZE | $((PERMILLE / 10)).$((PERMILLE % 10))% | $PUBLISHED |" >> "$REPORT"
+done
+
+cat "$REPORT"
+if [ -n "$GITHUB_STEP_SUMMARY" ]; then
+  cat "$REPORT" >> "$GITHUB_STEP_SUMMARY"
+fi
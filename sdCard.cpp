@@ -20,12 +20,16 @@
 #include "display_task.h"
 #include "display.h"
 #include "network.h"
-#include "mspOs.h"
 #include "config.h"
 #include "sensors.h"
+#include "sdlog.h"
+#include "log_codec.h"
+#include "config_cache.h"
+#include "config_store.h"
+#include "flash_store.h"
+#include "sd_health.h"
 
 #define FOLDER_NAME_LEN 16
-#define TIMEFORMAT_LEN 30
 
 // File system constants
 #define LOG_FILE_EXTENSION ".csv"
@@ -37,16 +41,12 @@
 #define DAY_FORMAT "%02d"
 #define DATE_FORMAT "%d/%m/%Y"
 #define TIME_FORMAT "%T"
-#define ISO_DATETIME_FORMAT "%Y-%m-%dT%T.000Z"
 
 // Numeric constants
 #define BASE_YEAR_OFFSET 1900
 #define MONTH_OFFSET 1
 #define FIRST_DATA_COLUMN_SEPARATOR ";"
 
-// CSV Header
-#define CSV_HEADER "recordedAt;date;time;year;month;temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp"
-
 // Log file size and rotation constants  
 #define LOG_MAX_SIZE 1000000
 #define RETRY_ATTEMPTS 3
@@ -63,18 +63,45 @@
 #define DEFAULT_WIFI_POWER "17dBm"
 #define UNINITIALIZED_MARKER 255
 
+// Config file streaming
+#define CONFIG_READ_CHUNK 64
+
 // Legacy CSV header (for compatibility)
 #define LEGACY_CSV_HEADER "sent_ok?;recordedAt;date;time;temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp"
+#define LEGACY_DATA_FIRST_FIELD 4 // sent_ok?;recordedAt;date;time precede the data columns
+#define LEGACY_MIGRATION_MAX_FILES 8
+#define LEGACY_MIGRATED_SUFFIX ".migrated"
+#define LEGACY_MIGRATING_SUFFIX ".migrating" // present while a migration runs, survives a power cut
+
+typedef struct __LEGACY_MIGRATION__
+{
+  uint32_t migrated;
+  bool failed;       /*!< an append failed: the migration stops and resumes on the next boot */
+  bool resume;       /*!< an earlier run was cut: skip lines already in the daily files */
+  int year;          /*!< day whose newest logged time is cached, -1 for none */
+  int month;
+  int day;
+  long newestSecond; /*!< second of day of the newest line in that daily file, -1 if empty */
+} legacy_migration_t;
+
+// Binary log export
+#define BIN_LOG_FILE_EXTENSION ".bin"
+#define BIN_EXPORT_RECORDS_PER_READ 16
+#define EXPORT_PART_SUFFIX ".part"
+
+// Hash of the config file content last loaded, lets the reload skip unchanged files
+static uint8_t loadedConfigHash[CONFIG_CACHE_HASH_LEN];
+static bool loadedConfigHashValid = false;
 
 //-------------------------- functions --------------------
 
-static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData, deviceMeasurement_t *pDev, systemStatus_t *sysStat, systemData_t *p_tSysData);
+static uint8_t parseConfig(File &fl, msp_config_t *cfg);
+static bool bSdcard_loadConfig(File &fl, msp_config_t *cfg);
 uint8_t initializeSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev);
 uint8_t checkConfig(const char *configpath, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData, deviceMeasurement_t *pDev, systemStatus_t *p_tSys, systemData_t *p_tSysData);
-uint8_t addToLog(const char *path, const char *oldpath, const char *errpath, String *message);
 
 /**********************************************************************
- * @brief Send network data to display task queue using local structure
+ * @brief Publish the network state and send an event to the display task
  *
  * @param p_tDev
  * @param p_tSys
@@ -82,15 +109,9 @@ uint8_t addToLog(const char *path, const char *oldpath, const char *errpath, Str
  **********************************************************************/
 static void vMsp_sendNetworkDataToDisplay(deviceNetworkInfo_t *p_tDev, systemStatus_t *p_tSys, displayEvents_t event)
 {
-  displayData_t localDisplayData = {};
-  localDisplayData.currentEvent = event;
-
-  vMspOs_takeDataAccessMutex();
-  localDisplayData.devInfo = *p_tDev;
-  localDisplayData.sysStat = *p_tSys;
-  vMspOs_giveDataAccessMutex();
+  vTaskDisplay_publishStatus(p_tSys, p_tDev);
 
-  tTaskDisplay_sendEvent(&localDisplayData);
+  tTaskDisplay_sendEvent(event);
 }
 
 /**********************************************************************
@@ -105,7 +126,7 @@ uint8_t initializeSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev)
   // checks for SD Card presence and type
 
   short timeout = 0;
-  while (!SD.begin())
+  while (!SD.begin(SS, SPI, SDLOG_SPI_FREQUENCY, SDLOG_MOUNT_POINT))
   {
     if (timeout > SD_INIT_TIMEOUT_RETRIES)
     { // errors after 10 seconds
@@ -141,6 +162,75 @@ uint8_t initializeSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev)
   return true;
 }
 
+/**********************************************************************
+ * @brief ArduinoJson reader over a File with a small read-ahead, so the
+ *        parser does not go through Stream::read() one byte at a time
+ **********************************************************************/
+class ConfigFileReader
+{
+public:
+  explicit ConfigFileReader(File &fl) : file(fl), len(0), pos(0) {}
+
+  int read()
+  {
+    if ((pos == len) && !refill())
+    {
+      return -1;
+    }
+    return buf[pos++];
+  }
+
+  size_t readBytes(char *out, size_t count)
+  {
+    size_t copied = 0;
+    while ((copied < count) && ((pos < len) || refill()))
+    {
+      size_t n = ((len - pos) < (count - copied)) ? (len - pos) : (count - copied);
+      memcpy(out + copied, buf + pos, n);
+      pos += n;
+      copied += n;
+    }
+    return copied;
+  }
+
+private:
+  bool refill()
+  {
+    int got = file.read(buf, sizeof(buf));
+    len = (got > 0) ? (size_t)got : 0;
+    pos = 0;
+    return len > 0;
+  }
+
+  File &file;
+  uint8_t buf[CONFIG_READ_CHUNK];
+  size_t len;
+  size_t pos;
+};
+
+/**********************************************************************
+ * @brief copy a config string into its fixed-size cache field
+ *
+ * @return false if the value does not fit (config is rejected rather
+ *         than silently truncated)
+ **********************************************************************/
+static bool bSdcard_copyConfigString(JsonVariantConst value, char *dst, size_t dstLen, const char *key)
+{
+  const char *text = value.as<const char *>();
+  if (text == NULL)
+  {
+    dst[0] = '\0';
+    return true;
+  }
+  if (strlcpy(dst, text, dstLen) >= dstLen)
+  {
+    log_e("Config value of %s too long (max %u chars)", key, (unsigned)(dstLen - 1));
+    dst[0] = '\0';
+    return false;
+  }
+  return true;
+}
+
 /*********************************************************
  * @brief parse configuratuion
  *
@@ -152,18 +242,18 @@ uint8_t initializeSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev)
  * @param p_tSysData
  * @return uint8_t
  *********************************************************/
-static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData, deviceMeasurement_t *pDev, systemStatus_t *sysStat, systemData_t *p_tSysData)
+static uint8_t parseConfig(File &fl, msp_config_t *cfg)
 { // parses the JSON configuration file on the SD Card
 
   uint8_t outcome = true;
 
-  // Read the entire file into a string
-  String jsonString = fl.readString();
-  fl.close();
+  // Stream straight from the file; the help section is dropped by the filter
+  JsonDocument filter;
+  filter[JSON_CONFIG_SECTION] = true;
 
-  // Parse JSON
   JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, jsonString);
+  ConfigFileReader reader(fl);
+  DeserializationError error = deserializeJson(doc, reader, DeserializationOption::Filter(filter));
 
   if (error)
   {
@@ -177,14 +267,15 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
     log_e("Missing 'config' section in JSON");
     return false;
   }
+  cfg->parsed = true;
 
   // Parse SSID
   if (!config[JSON_KEY_SSID].isNull())
   {
-    p_tDev->ssid = config[JSON_KEY_SSID].as<String>();
-    if (p_tDev->ssid.length() > 0)
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_SSID], cfg->ssid, sizeof(cfg->ssid), JSON_KEY_SSID);
+    if (cfg->ssid[0] != '\0')
     {
-      log_i("ssid = *%s*", p_tDev->ssid.c_str());
+      log_i("ssid = *%s*", cfg->ssid);
     }
     else
     {
@@ -200,8 +291,8 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
   // Parse Password
   if (!config[JSON_KEY_PASSWORD].isNull())
   {
-    p_tDev->passw = config[JSON_KEY_PASSWORD].as<String>();
-    log_i("passw = *%s*", p_tDev->passw.c_str());
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_PASSWORD], cfg->passw, sizeof(cfg->passw), JSON_KEY_PASSWORD);
+    log_i("passw = *%s*", cfg->passw);
   }
   else
   {
@@ -211,15 +302,15 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
   // Parse Device ID
   if (!config[JSON_KEY_DEVICE_ID].isNull())
   {
-    p_tDev->deviceid = config[JSON_KEY_DEVICE_ID].as<String>();
-    if (p_tDev->deviceid.length() == 0)
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_DEVICE_ID], cfg->deviceid, sizeof(cfg->deviceid), JSON_KEY_DEVICE_ID);
+    if (cfg->deviceid[0] == '\0')
     {
       log_e("DEVICEID value is empty!");
       outcome = false;
     }
     else
     {
-      log_i("deviceid = *%s*", p_tDev->deviceid.c_str());
+      log_i("deviceid = *%s*", cfg->deviceid);
     }
   }
   else
@@ -235,102 +326,96 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
     if (wifiPowerStr == "-1dBm")
     {
       log_i("Wifi power is set to POWER_MINUS_1_dBm");
-      p_tDev->wifipow = WIFI_POWER_MINUS_1dBm;
+      cfg->wifiPower = WIFI_POWER_MINUS_1dBm;
     }
     else if (wifiPowerStr == "2dBm")
     {
       log_i("Wifi power is set to POWER_2dBm");
-      p_tDev->wifipow = WIFI_POWER_2dBm;
+      cfg->wifiPower = WIFI_POWER_2dBm;
     }
     else if (wifiPowerStr == "5dBm")
     {
       log_i("Wifi power is set to POWER_5dBm");
-      p_tDev->wifipow = WIFI_POWER_5dBm;
+      cfg->wifiPower = WIFI_POWER_5dBm;
     }
     else if (wifiPowerStr == "7dBm")
     {
       log_i("Wifi power is set to POWER_7dBm");
-      p_tDev->wifipow = WIFI_POWER_7dBm;
+      cfg->wifiPower = WIFI_POWER_7dBm;
     }
     else if (wifiPowerStr == "8.5dBm")
     {
       log_i("Wifi power is set to POWER_8_5dBm");
-      p_tDev->wifipow = WIFI_POWER_8_5dBm;
+      cfg->wifiPower = WIFI_POWER_8_5dBm;
     }
     else if (wifiPowerStr == "11dBm")
     {
       log_i("Wifi power is set to POWER_11dBm");
-      p_tDev->wifipow = WIFI_POWER_11dBm;
+      cfg->wifiPower = WIFI_POWER_11dBm;
     }
     else if (wifiPowerStr == "13dBm")
     {
       log_i("Wifi power is set to POWER_13dBm");
-      p_tDev->wifipow = WIFI_POWER_13dBm;
+      cfg->wifiPower = WIFI_POWER_13dBm;
     }
     else if (wifiPowerStr == "15dBm")
     {
       log_i("Wifi power is set to POWER_15dBm");
-      p_tDev->wifipow = WIFI_POWER_15dBm;
+      cfg->wifiPower = WIFI_POWER_15dBm;
     }
     else if (wifiPowerStr == "17dBm")
     {
       log_i("Wifi power is set to POWER_17dBm");
-      p_tDev->wifipow = WIFI_POWER_17dBm;
+      cfg->wifiPower = WIFI_POWER_17dBm;
     }
     else if (wifiPowerStr == "18.5dBm")
     {
       log_i("Wifi power is set to POWER_18_5dBm");
-      p_tDev->wifipow = WIFI_POWER_18_5dBm;
+      cfg->wifiPower = WIFI_POWER_18_5dBm;
     }
     else if (wifiPowerStr == "19dBm")
     {
       log_i("Wifi power is set to POWER_19dBm");
-      p_tDev->wifipow = WIFI_POWER_19dBm;
+      cfg->wifiPower = WIFI_POWER_19dBm;
     }
     else if (wifiPowerStr == "19.5dBm")
     {
       log_i("Wifi power is set to POWER_19_5dBm");
-      p_tDev->wifipow = WIFI_POWER_19_5dBm;
+      cfg->wifiPower = WIFI_POWER_19_5dBm;
     }
     else
     {
       log_i("Wifi power parameter not recognized. Falling back to 17dBm");
-      p_tDev->wifipow = WIFI_POWER_17dBm;
+      cfg->wifiPower = WIFI_POWER_17dBm;
     }
   }
   else
   {
     log_e("Missing WIFI_POWER in config. Falling back to default value (17dBm)");
-    p_tDev->wifipow = WIFI_POWER_17dBm;
+    cfg->wifiPower = WIFI_POWER_17dBm;
   }
 
   // Parse O3 Zero Value
-  p_tData->ozoneData.o3ZeroOffset = config[JSON_KEY_O3_ZERO_VALUE] | -1;
-  log_i("o3_zero_value = *%d*", p_tData->ozoneData.o3ZeroOffset);
+  cfg->o3ZeroOffset = config[JSON_KEY_O3_ZERO_VALUE] | -1;
+  log_i("o3_zero_value = *%d*", cfg->o3ZeroOffset);
 
   // Parse Average Measurements
-  pDev->avg_measurements = config[JSON_KEY_AVERAGE_MEASUREMENTS] | 30;
-  log_i("avgMeasure = *%d*", pDev->avg_measurements);
+  cfg->avgMeasurements = config[JSON_KEY_AVERAGE_MEASUREMENTS] | 30;
+  log_i("avgMeasure = *%d*", cfg->avgMeasurements);
 
   // Parse Average Delay
-  pDev->avg_delay = config[JSON_KEY_AVERAGE_DELAY_SECONDS] | 55;
-  log_i("avgDelay = *%d*", pDev->avg_delay);
+  cfg->avgDelay = config[JSON_KEY_AVERAGE_DELAY_SECONDS] | 55;
+  log_i("avgDelay = *%d*", cfg->avgDelay);
 
   // Parse Sea Level Altitude
-  p_tData->gasData.seaLevelAltitude = config[JSON_KEY_SEA_LEVEL_ALTITUDE] | 122.0f;
-  log_i("sealevelalt = *%.2f*", p_tData->gasData.seaLevelAltitude);
+  cfg->seaLevelAltitude = config[JSON_KEY_SEA_LEVEL_ALTITUDE] | 122.0f;
+  log_i("sealevelalt = *%.2f*", cfg->seaLevelAltitude);
 
   // Parse Upload Server
   if (!config[JSON_KEY_UPLOAD_SERVER].isNull())
   {
-    String serverStr = config[JSON_KEY_UPLOAD_SERVER].as<String>();
-    if (serverStr.length() > 0)
-    {
-      p_tSysData->server = serverStr;
-      p_tSysData->server_ok = true;
-      sysStat->server_ok = true;
-    }
-    else
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_UPLOAD_SERVER], cfg->server, sizeof(cfg->server), JSON_KEY_UPLOAD_SERVER);
+    if (cfg->server[0] == '\0')
     {
 #ifdef API_SERVER
       log_i("SERVER value is empty. Falling back to value defined at compile time");
@@ -347,71 +432,70 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
     log_e("Missing UPLOAD_SERVER in config!");
 #endif
   }
-  log_i("server = *%s*", p_tSysData->server.c_str());
+  log_i("server = *%s*", cfg->server);
 
   // Parse MICS Calibration Values
   if (!config[JSON_KEY_MICS_CALIBRATION_VALUES].isNull())
   {
     JsonObject micsCalib = config[JSON_KEY_MICS_CALIBRATION_VALUES];
-    p_tData->pollutionData.sensingResInAir.redSensor = micsCalib[JSON_KEY_MICS_RED] | R0_RED_SENSOR;
-    p_tData->pollutionData.sensingResInAir.oxSensor = micsCalib[JSON_KEY_MICS_OX] | R0_OX_SENSOR;
-    p_tData->pollutionData.sensingResInAir.nh3Sensor = micsCalib[JSON_KEY_MICS_NH3] | R0_NH3_SENSOR;
+    cfg->micsR0[CONFIG_MICS_RED] = micsCalib[JSON_KEY_MICS_RED] | R0_RED_SENSOR;
+    cfg->micsR0[CONFIG_MICS_OX] = micsCalib[JSON_KEY_MICS_OX] | R0_OX_SENSOR;
+    cfg->micsR0[CONFIG_MICS_NH3] = micsCalib[JSON_KEY_MICS_NH3] | R0_NH3_SENSOR;
   }
   else
   {
     log_e("Missing MICS_CALIBRATION_VALUES in config. Using defaults");
-    p_tData->pollutionData.sensingResInAir.redSensor = R0_RED_SENSOR;
-    p_tData->pollutionData.sensingResInAir.oxSensor = R0_OX_SENSOR;
-    p_tData->pollutionData.sensingResInAir.nh3Sensor = R0_NH3_SENSOR;
+    cfg->micsR0[CONFIG_MICS_RED] = R0_RED_SENSOR;
+    cfg->micsR0[CONFIG_MICS_OX] = R0_OX_SENSOR;
+    cfg->micsR0[CONFIG_MICS_NH3] = R0_NH3_SENSOR;
   }
-  log_i("MICS R0[] = *%d*, *%d*, *%d*", p_tData->pollutionData.sensingResInAir.redSensor, p_tData->pollutionData.sensingResInAir.oxSensor, p_tData->pollutionData.sensingResInAir.nh3Sensor);
+  log_i("MICS R0[] = *%d*, *%d*, *%d*", cfg->micsR0[CONFIG_MICS_RED], cfg->micsR0[CONFIG_MICS_OX], cfg->micsR0[CONFIG_MICS_NH3]);
 
   // Parse MICS Measurement Offsets
   if (!config[JSON_KEY_MICS_MEASUREMENTS_OFFSETS].isNull())
   {
     JsonObject micsOffset = config[JSON_KEY_MICS_MEASUREMENTS_OFFSETS];
-    p_tData->pollutionData.sensingResInAirOffset.redSensor = (int16_t)(micsOffset[JSON_KEY_MICS_RED] | DEFAULT_SENSOR_OFFSET);
-    p_tData->pollutionData.sensingResInAirOffset.oxSensor = (int16_t)(micsOffset[JSON_KEY_MICS_OX] | DEFAULT_SENSOR_OFFSET);
-    p_tData->pollutionData.sensingResInAirOffset.nh3Sensor = (int16_t)(micsOffset[JSON_KEY_MICS_NH3] | DEFAULT_SENSOR_OFFSET);
+    cfg->micsOffset[CONFIG_MICS_RED] = (int16_t)(micsOffset[JSON_KEY_MICS_RED] | DEFAULT_SENSOR_OFFSET);
+    cfg->micsOffset[CONFIG_MICS_OX] = (int16_t)(micsOffset[JSON_KEY_MICS_OX] | DEFAULT_SENSOR_OFFSET);
+    cfg->micsOffset[CONFIG_MICS_NH3] = (int16_t)(micsOffset[JSON_KEY_MICS_NH3] | DEFAULT_SENSOR_OFFSET);
   }
   else
   {
     log_e("Missing MICS_MEASUREMENTS_OFFSETS in config. Using defaults");
-    p_tData->pollutionData.sensingResInAirOffset.redSensor = DEFAULT_SENSOR_OFFSET;
-    p_tData->pollutionData.sensingResInAirOffset.oxSensor = DEFAULT_SENSOR_OFFSET;
-    p_tData->pollutionData.sensingResInAirOffset.nh3Sensor = DEFAULT_SENSOR_OFFSET;
+    cfg->micsOffset[CONFIG_MICS_RED] = DEFAULT_SENSOR_OFFSET;
+    cfg->micsOffset[CONFIG_MICS_OX] = DEFAULT_SENSOR_OFFSET;
+    cfg->micsOffset[CONFIG_MICS_NH3] = DEFAULT_SENSOR_OFFSET;
   }
-  log_i("MICSoffset[] = *%d*, *%d*, *%d*", p_tData->pollutionData.sensingResInAirOffset.redSensor, p_tData->pollutionData.sensingResInAirOffset.oxSensor, p_tData->pollutionData.sensingResInAirOffset.nh3Sensor);
+  log_i("MICSoffset[] = *%d*, *%d*, *%d*", cfg->micsOffset[CONFIG_MICS_RED], cfg->micsOffset[CONFIG_MICS_OX], cfg->micsOffset[CONFIG_MICS_NH3]);
 
   // Parse Compensation Factors
   if (!config[JSON_KEY_COMPENSATION_FACTORS].isNull())
   {
     JsonObject compFactors = config[JSON_KEY_COMPENSATION_FACTORS];
-    p_tData->compParams.currentHumidity = compFactors[JSON_KEY_COMP_H] | HUMIDITY_COMP_PARAM;
-    p_tData->compParams.currentTemperature = compFactors[JSON_KEY_COMP_T] | TEMP_COMP_PARAM;
-    p_tData->compParams.currentPressure = compFactors[JSON_KEY_COMP_P] | PRESS_COMP_PARAM;
+    cfg->compHumidity = compFactors[JSON_KEY_COMP_H] | HUMIDITY_COMP_PARAM;
+    cfg->compTemperature = compFactors[JSON_KEY_COMP_T] | TEMP_COMP_PARAM;
+    cfg->compPressure = compFactors[JSON_KEY_COMP_P] | PRESS_COMP_PARAM;
   }
   else
   {
     log_e("Missing COMPENSATION_FACTORS in config. Using defaults");
-    p_tData->compParams.currentHumidity = HUMIDITY_COMP_PARAM;
-    p_tData->compParams.currentTemperature = TEMP_COMP_PARAM;
-    p_tData->compParams.currentPressure = PRESS_COMP_PARAM;
+    cfg->compHumidity = HUMIDITY_COMP_PARAM;
+    cfg->compTemperature = TEMP_COMP_PARAM;
+    cfg->compPressure = PRESS_COMP_PARAM;
   }
-  log_i("compensation[] = *%.3f*, *%.3f*, *%.6f*", p_tData->compParams.currentHumidity, p_tData->compParams.currentTemperature, p_tData->compParams.currentPressure);
+  log_i("compensation[] = *%.3f*, *%.3f*, *%.6f*", cfg->compHumidity, cfg->compTemperature, cfg->compPressure);
 
   // Parse Use Modem
-  sysStat->use_modem = config[JSON_KEY_USE_MODEM] | false;
-  log_i("useModem = *%s*", (sysStat->use_modem) ? STR_TRUE : STR_FALSE);
+  cfg->useModem = config[JSON_KEY_USE_MODEM] | false;
+  log_i("useModem = *%s*", (cfg->useModem) ? STR_TRUE : STR_FALSE);
 
   // Parse Modem APN
   if (!config[JSON_KEY_MODEM_APN].isNull())
   {
-    String apnStr = config[JSON_KEY_MODEM_APN].as<String>();
-    if (apnStr.length() > 0)
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_MODEM_APN], cfg->apn, sizeof(cfg->apn), JSON_KEY_MODEM_APN);
+    if (cfg->apn[0] != '\0')
     {
-      p_tDev->apn = apnStr;
-      log_i("modem_apn = *%s*", p_tDev->apn.c_str());
+      log_i("modem_apn = *%s*", cfg->apn);
     }
     else
     {
@@ -426,37 +510,28 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
   // Parse NTP Server
   if (!config[JSON_KEY_NTP_SERVER].isNull())
   {
-    String ntpStr = config[JSON_KEY_NTP_SERVER].as<String>();
-    if (ntpStr.length() > 0)
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_NTP_SERVER], cfg->ntpServer, sizeof(cfg->ntpServer), JSON_KEY_NTP_SERVER);
+    if (cfg->ntpServer[0] != '\0')
     {
-      p_tSysData->ntp_server = ntpStr;
-      log_i("ntp_server = *%s*", p_tSysData->ntp_server.c_str());
+      log_i("ntp_server = *%s*", cfg->ntpServer);
     }
     else
     {
       log_e("NTP_SERVER value is empty. Falling back to default value (pool.ntp.org)");
-      p_tSysData->ntp_server = DEFAULT_NTP_SERVER;
+      strlcpy(cfg->ntpServer, DEFAULT_NTP_SERVER, sizeof(cfg->ntpServer));
     }
   }
   else
   {
     log_e("Missing NTP_SERVER in config. Falling back to default value (pool.ntp.org)");
-    p_tSysData->ntp_server = DEFAULT_NTP_SERVER;
+    strlcpy(cfg->ntpServer, DEFAULT_NTP_SERVER, sizeof(cfg->ntpServer));
   }
 
   // Parse Timezone
   if (!config[JSON_KEY_TIMEZONE].isNull())
   {
-    String timezoneStr = config[JSON_KEY_TIMEZONE].as<String>();
-    if (timezoneStr.length() > 0)
-    {
-      p_tSysData->timezone = timezoneStr;
-      log_i("timezone = *%s*", p_tSysData->timezone.c_str());
-    }
-    else
-    {
-      log_i("timezone = *%s*", p_tSysData->timezone.c_str());
-    }
+    outcome &= bSdcard_copyConfigString(config[JSON_KEY_TIMEZONE], cfg->timezone, sizeof(cfg->timezone), JSON_KEY_TIMEZONE);
+    log_i("timezone = *%s*", cfg->timezone);
   }
   else
   {
@@ -464,12 +539,55 @@ static uint8_t parseConfig(File fl, deviceNetworkInfo_t *p_tDev, sensorData_t *p
   }
 
   // Parse Firmware Auto Upgrade
-  sysStat->fwAutoUpgrade = config[JSON_KEY_FW_AUTO_UPGRADE] | false;
-  log_i("fwAutoUpgrade = *%s*", (sysStat->fwAutoUpgrade) ? STR_TRUE : STR_FALSE);
+  cfg->fwAutoUpgrade = config[JSON_KEY_FW_AUTO_UPGRADE] | false;
+  log_i("fwAutoUpgrade = *%s*", (cfg->fwAutoUpgrade) ? STR_TRUE : STR_FALSE);
 
   return outcome;
 }
 
+/***************************************************************
+ * @brief hash the config file and take it from the NVS cache,
+ *        parsing (and caching) it only when the content changed
+ *
+ * @param fl  open config file
+ * @param cfg output; cfg->parsed tells whether it can be applied
+ * @return true file hash known (cfg->fileHash is valid)
+ ***************************************************************/
+static bool bSdcard_loadConfig(File &fl, msp_config_t *cfg)
+{
+  uint8_t fileHash[CONFIG_CACHE_HASH_LEN];
+  unsigned long startUs = micros();
+  bool hashed = bHalConfigCache_hashFile(fl, fileHash);
+
+  if (hashed)
+  {
+    memcpy(loadedConfigHash, fileHash, sizeof(fileHash));
+    loadedConfigHashValid = true;
+  }
+
+  if (hashed && bHalConfigCache_load(fileHash, cfg))
+  {
+    log_i("Config unchanged, loaded from NVS cache in %lu us (JSON parse took %lu us)",
+          micros() - startUs, (unsigned long)cfg->parseUs);
+    return true;
+  }
+
+  memset(cfg, 0, sizeof(*cfg));
+  unsigned long parseStartUs = micros();
+  cfg->valid = parseConfig(fl, cfg);
+  cfg->parseUs = micros() - parseStartUs;
+  log_i("Config parsed in %lu us (hash + parse %lu us)", (unsigned long)cfg->parseUs, micros() - startUs);
+  if (hashed)
+  {
+    memcpy(cfg->fileHash, fileHash, sizeof(fileHash));
+    if (cfg->parsed)
+    {
+      bHalConfigCache_store(cfg);
+    }
+  }
+  return hashed;
+}
+
 /***************************************************************
  * @brief check configuration
  *
@@ -491,7 +609,16 @@ uint8_t checkConfig(const char *configpath, deviceNetworkInfo_t *p_tDev, sensorD
     cfgfile = SD.open(configpath, FILE_READ); // open read only
     log_i("Found config file. Parsing...\n");
 
-    if (parseConfig(cfgfile, p_tDev, p_tData, pDev, p_tSys, p_tSysData))
+    static msp_config_t cfg; // ~600 bytes, kept off the caller's stack
+    bSdcard_loadConfig(cfgfile, &cfg);
+    cfgfile.close();
+
+    if (cfg.parsed)
+    {
+      vHalConfigStore_apply(&cfg, CONFIG_CHANGED_ALL, p_tDev, p_tData, pDev, p_tSys, p_tSysData);
+      ulHalConfigStore_publish(&cfg);
+    }
+    if (cfg.valid)
     {
       return true;
     }
@@ -575,61 +702,207 @@ uint8_t checkConfig(const char *configpath, deviceNetworkInfo_t *p_tDev, sensorD
 
 // Legacy uHalSdcard_checkLogFile function removed - now using date-based logging with automatic file creation
 
-/****************************************************************************
- * @brief add to log
+/**************************************************************
+ * @brief line visitor: second of day of the newest data line
+ *************************************************************/
+static bool bSdcard_newestLoggedLine(const char *line, void *ctx)
+{
+  struct tm lineTime;
+  uint8_t flags;
+  send_data_t values;
+  if (!bLogCodec_parseCsvLine(line, &lineTime, &flags, &values))
+  {
+    return true; // torn or header line, keep looking
+  }
+  *(long *)ctx = (lineTime.tm_hour * SEC_IN_HOUR) + (lineTime.tm_min * SEC_IN_MIN) + lineTime.tm_sec;
+  return false;
+}
+
+/**************************************************************
+ * @brief resumed migration: true if the line's minute is already
+ *        in its daily file (daily files are chronological)
+ *************************************************************/
+static bool bSdcard_alreadyMigrated(legacy_migration_t *mig, const char *converted)
+{
+  struct tm lineTime;
+  uint8_t flags;
+  send_data_t values;
+  if (!bLogCodec_parseCsvLine(converted, &lineTime, &flags, &values))
+  {
+    return false;
+  }
+
+  if ((lineTime.tm_year != mig->year) || (lineTime.tm_mon != mig->month) || (lineTime.tm_mday != mig->day))
+  {
+    char dayPath[SDLOG_PATH_LEN];
+    mig->year = lineTime.tm_year;
+    mig->month = lineTime.tm_mon;
+    mig->day = lineTime.tm_mday;
+    mig->newestSecond = -1;
+    vHalSdlog_dayPath(SDLOG_CHANNEL_CSV, &lineTime, dayPath);
+    if (SD.exists(dayPath))
+    {
+      bHalSdlog_readLinesNewestFirst(dayPath, bSdcard_newestLoggedLine, &mig->newestSecond);
+    }
+  }
+
+  long lineSecond = (lineTime.tm_hour * SEC_IN_HOUR) + (lineTime.tm_min * SEC_IN_MIN) + lineTime.tm_sec;
+  return (lineSecond <= mig->newestSecond);
+}
+
+/**************************************************************
+ * @brief convert one legacy (newest-first) log line into the
+ *        current layout and append it to its daily file
  *
- * @param path
- * @param oldpath
- * @param errpath
- * @param message
- * @return uint8_t
- ***************************************************************************/
-uint8_t addToLog(const char *path, const char *oldpath, const char *errpath, String *message)
-{ // adds new line to the log file at the top, after the header lines
+ * Legacy: sent_ok?;recordedAt;date;time;temp;...;msp
+ * Current: recordedAt;date;time;year;month;temp;...;msp
+ *************************************************************/
+static bool bSdcard_migrateLegacyLine(const char *line, void *ctx)
+{
+  legacy_migration_t *mig = (legacy_migration_t *)ctx;
+  const char *fields[LEGACY_DATA_FIRST_FIELD];
+  const char *cursor = line;
 
-  String temp = "";
-  log_v("Log file is located at: %s\n", path);
-  log_v("Old path is: %s\n", oldpath);
-  if (!SD.exists(oldpath))
+  if (strncmp(line, LEGACY_CSV_HEADER, strlen(LEGACY_CSV_HEADER)) == 0)
   {
-    SD.rename(path, oldpath);
+    return true; // header is visited last
   }
-  else
+
+  for (int i = 0; i < LEGACY_DATA_FIRST_FIELD; i++)
   {
-    if (SD.exists(path))
-      SD.rename(path, errpath);
-    log_e("An error occurred, resuming logging from the old log...\n");
+    fields[i] = cursor;
+    cursor = strchr(cursor, *FIRST_DATA_COLUMN_SEPARATOR);
+    if (cursor == NULL)
+    {
+      log_w("Skipping malformed legacy log line: %s", line);
+      return true;
+    }
+    cursor++;
   }
-  File oldfile = SD.open(oldpath, FILE_READ); // opening the renamed log
-  if (!oldfile)
+
+  struct tm lineTime = {};
+  if (sscanf(fields[2], "%d/%d/%d", &lineTime.tm_mday, &lineTime.tm_mon, &lineTime.tm_year) != 3)
   {
-    log_e("Error opening the renamed the log file!");
-    return false;
+    log_w("Skipping legacy log line without date: %s", line);
+    return true;
   }
-  File logfile = SD.open(path, FILE_WRITE); // recreates empty logfile
-  if (!logfile)
+  lineTime.tm_mon -= MONTH_OFFSET;
+  lineTime.tm_year -= BASE_YEAR_OFFSET;
+
+  // recordedAt;date;time are copied verbatim, year;month inserted, data columns follow
+  char converted[LOG_CSV_LINE_MAX_LEN];
+  int len = snprintf(converted, sizeof(converted), "%.*s%d;%d;%s",
+                     (int)(cursor - fields[1]), fields[1], lineTime.tm_year + BASE_YEAR_OFFSET, lineTime.tm_mon + MONTH_OFFSET, cursor);
+  if ((len < 0) || (len >= (int)sizeof(converted)))
   {
-    log_e("Error recreating the log file!");
-    return false;
+    log_w("Skipping over-long legacy log line");
+    return true;
+  }
+
+  if (mig->resume && bSdcard_alreadyMigrated(mig, converted))
+  {
+    return true;
   }
-  temp = oldfile.readStringUntil('\r'); // reads until CR character
-  logfile.println(temp);
-  oldfile.readStringUntil('\n'); // consumes LF character (uses DOS-style CRLF)
-  logfile.println(*message);     // printing the new string, only once and after the header
-  log_v("New line added!\n");
-  while (oldfile.available())
-  {                                       // copy the old log file with new string added
-    temp = oldfile.readStringUntil('\r'); // reads until CR character
-    logfile.println(temp);
-    oldfile.readStringUntil('\n'); // consumes LF character (uses DOS-style CRLF)
-  }
-  oldfile.close();
-  logfile.close();
-  SD.remove(oldpath); // deleting old log
 
+  if (!bHalSdlog_append(SDLOG_CHANNEL_CSV, &lineTime, converted))
+  {
+    mig->failed = true;
+    return false; // later lines would land before this one
+  }
+  mig->migrated++;
   return true;
 }
 
+/**************************************************************
+ * @brief one-time migration of the old single-file logs, kept
+ *        newest-first by the removed addToLog() rewrite, into
+ *        the append-only daily files; done files get renamed
+ *************************************************************/
+static void vSdcard_migrateLegacyLogs(void)
+{
+  String legacyPaths[LEGACY_MIGRATION_MAX_FILES];
+  String markerPaths[LEGACY_MIGRATION_MAX_FILES];
+  uint8_t legacyCount = 0;
+  uint8_t markerCount = 0;
+
+  File root = SD.open(PATH_SEPARATOR);
+  if (!root)
+  {
+    return;
+  }
+
+  for (File entry = root.openNextFile(); entry && (legacyCount < LEGACY_MIGRATION_MAX_FILES); entry = root.openNextFile())
+  {
+    String path = entry.path();
+    if (!entry.isDirectory() && path.endsWith(LOG_FILE_EXTENSION))
+    {
+      String firstLine = entry.readStringUntil('\n');
+      firstLine.trim();
+      if (firstLine == LEGACY_CSV_HEADER)
+      {
+        legacyPaths[legacyCount++] = path;
+      }
+    }
+    else if (!entry.isDirectory() && path.endsWith(LEGACY_MIGRATING_SUFFIX) && (markerCount < LEGACY_MIGRATION_MAX_FILES))
+    {
+      markerPaths[markerCount++] = path;
+    }
+    entry.close();
+  }
+  root.close();
+
+  // Marker without its legacy file: power cut between the rename and the marker removal
+  for (uint8_t i = 0; i < markerCount; i++)
+  {
+    String legacyPath = markerPaths[i].substring(0, markerPaths[i].length() - strlen(LEGACY_MIGRATING_SUFFIX));
+    if (!SD.exists(legacyPath))
+    {
+      log_i("Removing leftover migration marker %s", markerPaths[i].c_str());
+      SD.remove(markerPaths[i]);
+    }
+  }
+
+  for (uint8_t i = 0; i < legacyCount; i++)
+  {
+    legacy_migration_t mig = {.migrated = 0, .failed = false, .resume = false, .year = -1, .month = -1, .day = -1, .newestSecond = -1};
+    String markerPath = legacyPaths[i] + LEGACY_MIGRATING_SUFFIX;
+
+    mig.resume = SD.exists(markerPath);
+    if (mig.resume)
+    {
+      log_w("Resuming interrupted migration of %s, lines already logged are skipped", legacyPaths[i].c_str());
+    }
+    else
+    {
+      File marker = SD.open(markerPath, FILE_WRITE);
+      marker.close();
+    }
+    log_i("Migrating legacy log %s to daily files...", legacyPaths[i].c_str());
+
+    // Legacy files are newest-first: reading them backwards yields chronological order
+    if (bHalSdlog_readLinesNewestFirst(legacyPaths[i].c_str(), bSdcard_migrateLegacyLine, &mig))
+    {
+      bHalSdlog_flush(true);
+      if (mig.failed)
+      {
+        log_w("Legacy log %s: append failed after %lu lines, migration resumes on the next boot",
+              legacyPaths[i].c_str(), (unsigned long)mig.migrated);
+        continue; // the marker stays, lines already logged are skipped then
+      }
+      String donePath = legacyPaths[i] + LEGACY_MIGRATED_SUFFIX;
+      SD.rename(legacyPaths[i], donePath);
+      SD.remove(markerPath);
+      log_i("Legacy log migrated: %lu lines, original kept as %s", (unsigned long)mig.migrated, donePath.c_str());
+    }
+    else
+    {
+      bHalSdlog_flush(true);
+      log_w("Legacy log %s: read failed after %lu lines, migration resumes on the next boot",
+            legacyPaths[i].c_str(), (unsigned long)mig.migrated);
+    }
+  }
+}
+
 /*******************************************************************************
  * @brief log to SD card
  *
@@ -685,144 +958,307 @@ bool bHalSdcard_ensureDirectoryExists(const String& dirPath)
   }
 }
 
-void vHalSdcard_logToSD(send_data_t *data, systemData_t *p_tSysData, systemStatus_t *p_tSys, sensorData_t *p_tData, deviceNetworkInfo_t *p_tDev)
-{ // builds a new logfile line and calls addToLog() using date-based folder structure
+/**************************************************************
+ * @brief write one record to the daily log(s) on the card
+ *
+ * @param timeInfo
+ * @param flags
+ * @param data
+ * @param record
+ * @return true
+ * @return false
+ *************************************************************/
+static bool bSdcard_appendLogRecord(const struct tm *timeInfo, uint8_t flags, const send_data_t *data, const log_bin_record_t *record)
+{
+  bool ok = true;
 
-  log_i("Logging data to date-based CSV structure on SD Card...");
+#if (SD_LOG_FORMATS & SD_LOG_FORMAT_CSV)
+  // Data is layed out as follows:
+  // "recordedAt;date;time;year;month;temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp"
+  // Note: Removed sent_ok field as data is always logged regardless of transmission status
+  char logvalue[LOG_CSV_LINE_MAX_LEN];
+  if (iLogCodec_formatCsvLine(timeInfo, flags, data, logvalue, sizeof(logvalue)) < 0)
+  {
+    log_e("SD log line too long");
+    ok = false;
+  }
+  // Directory state and file handle are cached by the writer; lines go out in sector-sized blocks
+  else if (!bHalSdlog_append(SDLOG_CHANNEL_CSV, timeInfo, logvalue))
+  {
+    ok = false;
+  }
+#endif
 
-  // Create date-based log path
-  String logPath = sHalSdcard_createDateBasedLogPath(&data->sendTimeInfo);
-  
-  // Extract directory path from full file path
-  int lastSlashIndex = logPath.lastIndexOf(*PATH_SEPARATOR);
-  String dirPath = logPath.substring(0, lastSlashIndex);
-  
-  // Ensure year and month directories exist
-  char yearStr[FOLDER_NAME_LEN];
-  char monthStr[FOLDER_NAME_LEN]; // Generous buffer sizes to avoid any truncation warnings
-  snprintf(yearStr, sizeof(yearStr), YEAR_FORMAT, data->sendTimeInfo.tm_year + BASE_YEAR_OFFSET);
-  snprintf(monthStr, sizeof(monthStr), MONTH_FORMAT, data->sendTimeInfo.tm_mon + MONTH_OFFSET);
-  
-  String yearPath = PATH_SEPARATOR + String(yearStr);
-  String monthPath = yearPath + PATH_SEPARATOR + String(monthStr);
-  
-  // Create directories step by step
-  if (!bHalSdcard_ensureDirectoryExists(yearPath))
+#if (SD_LOG_FORMATS & SD_LOG_FORMAT_BINARY)
+  if (!bHalSdlog_appendRecord(SDLOG_CHANNEL_BIN, timeInfo, record, sizeof(*record)))
   {
-    log_e("Failed to create year directory: %s", yearPath.c_str());
-    return;
+    ok = false;
   }
-  
-  if (!bHalSdcard_ensureDirectoryExists(monthPath))
+#endif
+
+  return ok;
+}
+
+/**************************************************************
+ * @brief flash store drain visitor: replay a record into the
+ *        daily log(s)
+ *************************************************************/
+static bool bSdcard_drainFlashRecord(const struct tm *timeInfo, const log_bin_record_t *rec, void *ctx)
+{
+  (void)ctx;
+  struct tm recordTime;
+  uint8_t flags;
+  send_data_t data;
+
+  memset(&data, 0, sizeof(data));
+  vLogCodec_decodeBin(rec, timeInfo, &recordTime, &flags, &data);
+  return bSdcard_appendLogRecord(&recordTime, flags, &data, rec);
+}
+
+/**************************************************************
+ * @brief flash store drain commit: push the buffered blocks
+ *        out before the segment is deleted
+ *************************************************************/
+static bool bSdcard_commitFlashRecords(void *ctx)
+{
+  (void)ctx;
+  return bHalSdlog_flush(false);
+}
+
+/**************************************************************
+ * @brief move records kept in internal flash to the card
+ *
+ * @param maxSegments
+ *************************************************************/
+static void vSdcard_drainFlashStore(uint8_t maxSegments)
+{
+  if (!bHalFlashStore_hasPending())
   {
-    log_e("Failed to create month directory: %s", monthPath.c_str());
     return;
   }
 
+  flash_store_stats_t before;
+  flash_store_stats_t after;
+  vHalFlashStore_getStats(&before);
+  bool empty = bHalFlashStore_drain(maxSegments, bSdcard_drainFlashRecord, bSdcard_commitFlashRecords, NULL);
+  vHalFlashStore_getStats(&after);
+
+  log_i("Flash fallback store: %lu records moved to SD card, %lu still pending%s",
+        (unsigned long)(after.drained - before.drained), (unsigned long)after.pending, empty ? "" : " (continuing later)");
+  if (empty && ((after.overwritten > 0) || (after.droppedBudget > 0)))
+  {
+    log_w("Flash fallback store lost %lu records to ring wrap and %lu to the daily write budget since boot",
+          (unsigned long)after.overwritten, (unsigned long)after.droppedBudget);
+  }
+}
+
+void vHalSdcard_logToSD(send_data_t *data, systemData_t *p_tSysData, systemStatus_t *p_tSys, sensorData_t *p_tData, deviceNetworkInfo_t *p_tDev)
+{ // builds a new log record and hands it to the buffered daily log writer, or to internal flash without a card
+
+  log_i("Logging data to date-based log structure on SD Card...");
+
   strftime(p_tSysData->Date, sizeof(p_tSysData->Date), DATE_FORMAT, &data->sendTimeInfo); // Formatting date as DD/MM/YYYY
   strftime(p_tSysData->Time, sizeof(p_tSysData->Time), TIME_FORMAT, &data->sendTimeInfo);       // Formatting time as HH:MM:SS
 
-  String logvalue = "";
-  char timeFormat[TIMEFORMAT_LEN] = {0};
-  if (p_tSys->datetime)
-    strftime(timeFormat, sizeof(timeFormat), ISO_DATETIME_FORMAT, &data->sendTimeInfo); // formatting date&time in TZ format
+  uint8_t flags = 0;
+  flags |= p_tSys->datetime ? LOG_BIN_FLAG_DATETIME : 0;
+  flags |= p_tData->status.BME680Sensor ? LOG_BIN_FLAG_BME680 : 0;
+  flags |= p_tData->status.PMS5003Sensor ? LOG_BIN_FLAG_PMS5003 : 0;
+  flags |= p_tData->status.MICS6814Sensor ? LOG_BIN_FLAG_MICS6814 : 0;
+  flags |= p_tData->status.O3Sensor ? LOG_BIN_FLAG_O3 : 0;
 
-  // Data is layed out as follows:
-  // "recordedAt;date;time;temp;hum;PM1;PM2_5;PM10;pres;radiation;nox;co;nh3;o3;voc;msp"
-  // Note: Removed sent_ok field as data is always logged regardless of transmission status
+  log_bin_record_t record;
+  vLogCodec_encodeBin(&data->sendTimeInfo, flags, data, &record);
 
-  // Always log data regardless of transmission status
-  logvalue += String(timeFormat);
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += String(p_tSysData->Date);
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += String(p_tSysData->Time);
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += String(data->sendTimeInfo.tm_year + BASE_YEAR_OFFSET); // Add year
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += String(data->sendTimeInfo.tm_mon + MONTH_OFFSET); // Add month (1-12)
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.BME680Sensor)
+  // While a flash backlog is being moved to the card, new records queue behind it to keep the daily files in order
+  if (p_tSys->sdCard && !bHalFlashStore_hasPending())
   {
-    logvalue += vGeneric_floatToComma(data->temp);
+    if (bSdcard_appendLogRecord(&data->sendTimeInfo, flags, data, &record))
+    {
+      log_i("SD Card log record buffered for /%04d/%02d/%02d",
+            data->sendTimeInfo.tm_year + BASE_YEAR_OFFSET, data->sendTimeInfo.tm_mon + MONTH_OFFSET, data->sendTimeInfo.tm_mday);
+      return;
+    }
+    vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_SD_CARD_LOG_ERROR);
+  }
+
+  if (bHalFlashStore_append(&data->sendTimeInfo, &record))
+  {
+    log_i("Log record kept in internal flash until an SD card is available");
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.BME680Sensor)
+  else
   {
-    logvalue += vGeneric_floatToComma(data->hum);
+    log_e("Log record lost: no SD card and the internal flash store is unavailable");
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.PMS5003Sensor)
+}
+
+/**************************************************************
+ * @brief convert one binary daily file into its CSV_HEADER
+ *        layout sibling (/YYYY/MM/DD.bin -> /YYYY/MM/DD.csv)
+ *
+ * @param binPath
+ * @return true
+ * @return false
+ *************************************************************/
+bool bHalSdcard_exportBinaryLog(const char *binPath)
+{
+  File in = SD.open(binPath, FILE_READ);
+  if (!in)
   {
-    logvalue += String(data->PM1);
+    log_e("Failed to open %s for export", binPath);
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.PMS5003Sensor)
+
+  uint8_t header[LOG_BIN_HEADER_LEN];
+  struct tm day;
+  if ((in.read(header, sizeof(header)) != sizeof(header)) || !bLogCodec_parseBinHeader(header, sizeof(header), &day))
   {
-    logvalue += String(data->PM25);
+    log_e("Not a binary log (or unknown schema): %s", binPath);
+    in.close();
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.PMS5003Sensor)
+
+  String csvPath = String(binPath);
+  csvPath.replace(BIN_LOG_FILE_EXTENSION, LOG_FILE_EXTENSION);
+
+  // Written under a temporary name: a power cut leaves a .part (redone next time), never a short .csv
+  String partPath = csvPath + EXPORT_PART_SUFFIX;
+  File out = SD.open(partPath, FILE_WRITE);
+  if (!out)
   {
-    logvalue += String(data->PM10);
+    log_e("Failed to create %s", partPath.c_str());
+    in.close();
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.BME680Sensor)
+
+  out.print(CSV_HEADER "\r\n");
+
+  log_bin_record_t records[BIN_EXPORT_RECORDS_PER_READ];
+  char line[LOG_CSV_LINE_MAX_LEN];
+  uint32_t exported = 0;
+  uint32_t pos = LOG_BIN_HEADER_LEN;
+  uint32_t dataEnd = ulLogCodec_binDataEnd(header);
+  bool done = false;
+  size_t got;
+  while (!done && ((got = in.read((uint8_t *)records, sizeof(records))) >= sizeof(log_bin_record_t)))
   {
-    logvalue += vGeneric_floatToComma(data->pre);
+    for (size_t i = 0; i < (got / sizeof(log_bin_record_t)); i++, pos += sizeof(log_bin_record_t))
+    {
+      if ((pos >= dataEnd) && bLogCodec_binRecordBlank(&records[i]))
+      {
+        done = true; // preallocated space of a day not closed yet
+        break;
+      }
+      struct tm lineTime;
+      send_data_t values;
+      uint8_t flags;
+      vLogCodec_decodeBin(&records[i], &day, &lineTime, &flags, &values);
+      int len = iLogCodec_formatCsvLine(&lineTime, flags, &values, line, sizeof(line) - 2);
+      if (len > 0)
+      {
+        memcpy(line + len, "\r\n", 2);
+        out.write((const uint8_t *)line, len + 2);
+        exported++;
+      }
+    }
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR; // for "radiation"
-  if (p_tData->status.MICS6814Sensor)
+
+  out.close();
+  in.close();
+  if (!SD.rename(partPath, csvPath))
   {
-    logvalue += vGeneric_floatToComma(data->MICS_NO2);
+    log_e("Failed to rename %s", partPath.c_str());
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.MICS6814Sensor)
+  log_i("Exported %lu records from %s to %s", (unsigned long)exported, binPath, csvPath.c_str());
+  return true;
+}
+
+/**************************************************************
+ * @brief on-demand export: when the request file is on the card,
+ *        every /YYYY/MM/DD.bin without a .csv gets one
+ *************************************************************/
+static void vSdcard_exportRequestedBinaryLogs(void)
+{
+  if (!SD.exists(SD_LOG_EXPORT_REQUEST_PATH))
   {
-    logvalue += vGeneric_floatToComma(data->MICS_CO);
+    return;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.MICS6814Sensor)
+
+  log_i("CSV export requested, converting binary daily logs...");
+  File root = SD.open(PATH_SEPARATOR);
+  for (File year = root.openNextFile(); year; year = root.openNextFile())
   {
-    logvalue += vGeneric_floatToComma(data->MICS_NH3);
+    if (year.isDirectory())
+    {
+      for (File month = year.openNextFile(); month; month = year.openNextFile())
+      {
+        if (month.isDirectory())
+        {
+          for (File entry = month.openNextFile(); entry; entry = month.openNextFile())
+          {
+            String path = entry.path();
+            entry.close();
+            if (path.endsWith(BIN_LOG_FILE_EXTENSION))
+            {
+              String csvPath = path.substring(0, path.length() - strlen(BIN_LOG_FILE_EXTENSION)) + LOG_FILE_EXTENSION;
+              if (!SD.exists(csvPath))
+              {
+                bHalSdcard_exportBinaryLog(path.c_str());
+              }
+            }
+          }
+        }
+        month.close();
+      }
+    }
+    year.close();
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.O3Sensor)
+  root.close();
+
+  SD.remove(SD_LOG_EXPORT_REQUEST_PATH);
+}
+
+/******************************************************
+ * @brief re-read the config file and publish it to the
+ *        config store if its content changed
+ *
+ * @return true  a new configuration version was published
+ * @return false file missing, unchanged or unparsable
+ *****************************************************/
+bool bHalSdcard_reloadConfig(void)
+{
+  static msp_config_t cfg;
+  uint8_t fileHash[CONFIG_CACHE_HASH_LEN];
+
+  if (!SD.exists(CONFIG_PATH))
   {
-    logvalue += vGeneric_floatToComma(data->ozone);
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  if (p_tData->status.BME680Sensor)
+
+  File cfgfile = SD.open(CONFIG_PATH, FILE_READ);
+  if (!cfgfile)
   {
-    logvalue += vGeneric_floatToComma(data->VOC);
+    return false;
   }
-  logvalue += FIRST_DATA_COLUMN_SEPARATOR;
-  logvalue += String(data->MSP);
 
-  // Simple append-based logging for date-based files
-  bool needsHeader = !SD.exists(logPath);
-  
-  File logFile = SD.open(logPath, FILE_APPEND);
-  if (!logFile)
+  if (loadedConfigHashValid && bHalConfigCache_hashFile(cfgfile, fileHash) &&
+      (memcmp(fileHash, loadedConfigHash, sizeof(fileHash)) == 0))
   {
-    log_e("Failed to open log file for writing: %s", logPath.c_str());
-    vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_SD_CARD_LOG_ERROR);
-    return;
+    cfgfile.close();
+    return false;
   }
-  
-  // Add header if this is a new file
-  if (needsHeader)
+
+  log_i("Config file changed, reloading...");
+  bSdcard_loadConfig(cfgfile, &cfg);
+  cfgfile.close();
+
+  if (!cfg.parsed)
   {
-    logFile.println(CSV_HEADER);
-    log_i("CSV header added to new log file: %s", logPath.c_str());
+    log_e("Reloaded config could not be parsed, keeping the active one");
+    return false;
   }
-  
-  // Append the data
-  logFile.println(logvalue);
-  logFile.close();
-  
-  log_i("SD Card log file updated successfully: %s", logPath.c_str());
+  return (ulHalConfigStore_publish(&cfg) != 0);
 }
 
 /******************************************************
@@ -838,13 +1274,21 @@ void vHalSdcard_readSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev, sens
 {
 
   log_i("Initializing SD Card...\n");
+  vHalSdHealth_init();
+  vHalSdlog_init();
+  vHalConfigStore_init();
+  bHalFlashStore_init();
   vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_SD_CARD_INIT);
   p_tSys->sdCard = initializeSD(p_tSys, p_tDev);
   if (p_tSys->sdCard)
   {
+    vHalSdlog_recover(); // before anything reads or appends to the logs
     log_i("SD Card ok! Reading configuration...\n");
     vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_CONFIG_READ);
     p_tSys->configuration = checkConfig(CONFIG_PATH, p_tDev, p_tData, pDev, p_tSys, p_tSysData);
+    vSdcard_migrateLegacyLogs();
+    vSdcard_exportRequestedBinaryLogs();
+    vSdcard_drainFlashStore(FLASH_STORE_DRAIN_SEGMENTS_PER_CALL); // records kept while the card was missing, the periodic check moves the rest
     if (p_tSys->server_ok)
     {
       log_e("No server URL defined. Can't upload data!\n");
@@ -870,7 +1314,7 @@ uint8_t vHalSdcard_periodicCheck(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_
 {
   static uint8_t previousSdStatus = UNINITIALIZED_MARKER; // Use as uninitialized marker
   uint8_t currentSdStatus = false;
-  
+  bool cardInserted = false;
 
   // Initialize previousSdStatus based on actual system status on first call
   if (previousSdStatus == UNINITIALIZED_MARKER)
@@ -892,7 +1336,9 @@ uint8_t vHalSdcard_periodicCheck(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_
     if (previousSdStatus == true)
     {
       // Try to re-initialize if card seems missing but was previously present
-      if (SD.begin())
+      vHalSdlog_invalidate(); // open log handle does not survive SD.begin()
+      vHalSdHealth_countReinit();
+      if (SD.begin(SS, SPI, SDLOG_SPI_FREQUENCY, SDLOG_MOUNT_POINT))
       {
         cardType = SD.cardType();
         if (cardType != CARD_NONE)
@@ -922,9 +1368,14 @@ uint8_t vHalSdcard_periodicCheck(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_
   // Update system status and log changes
   if (currentSdStatus != previousSdStatus)
   {
+    // Cached log file handle/directories belong to the previous card state
+    vHalSdlog_invalidate();
+
     if (currentSdStatus)
     {
       log_i("SD Card detected - card was inserted");
+      cardInserted = true;
+      vHalSdlog_recover();
       vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_SD_CARD_INIT);
     }
     else
@@ -938,6 +1389,35 @@ uint8_t vHalSdcard_periodicCheck(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_
   // Update system status
   p_tSys->sdCard = currentSdStatus;
 
+  // Config hot-reload: on card insertion and every CONFIG_RELOAD_CHECK_INTERVAL_MS
+  static unsigned long lastConfigCheckMs = 0;
+  if (currentSdStatus && ((millis() - lastConfigCheckMs) >= CONFIG_RELOAD_CHECK_INTERVAL_MS || cardInserted))
+  {
+    lastConfigCheckMs = millis();
+    bHalSdcard_reloadConfig();
+  }
+
+  // Records kept in internal flash while the card was missing, a few segments per check
+  if (currentSdStatus)
+  {
+    vSdcard_drainFlashStore(FLASH_STORE_DRAIN_SEGMENTS_PER_CALL);
+  }
+
+  // SD health: daily summary row and slow card alarm
+  if (currentSdStatus)
+  {
+    if (p_tSys->datetime)
+    {
+      struct tm now;
+      time_t epoch = time(NULL);
+      localtime_r(&epoch, &now);
+      vHalSdHealth_dayTick(&now);
+    }
+    if (bHalSdHealth_checkSlowAlarm())
+    {
+      vMsp_sendNetworkDataToDisplay(p_tDev, p_tSys, DISP_EVENT_SD_CARD_SLOW);
+    }
+  }
 
   return currentSdStatus;
 }
@@ -0,0 +1,400 @@
+/************************************************************************************************
+ * @file    sd_health.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   SD card I/O latency and health telemetry for the Milano Smart Park project
+ * @version 0.1
+ * @date    2025-09-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ************************************************************************************************/
+
+// -- includes --
+#include <SD.h>
+#include <stdarg.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "sd_health.h"
+#include "config.h"
+
+#define SD_HEALTH_FIRST_BUCKET_SHIFT 6 // bucket 0 upper bound: 64 us
+#define SD_HEALTH_ROW_LEN 512 // header with six ops is 465 chars
+#define US_PER_MS 1000
+
+#define BASE_YEAR_OFFSET 1900
+#define MONTH_OFFSET 1
+
+typedef struct __SD_HEALTH_HISTOGRAM__
+{
+  uint32_t buckets[SD_HEALTH_BUCKETS];
+  uint32_t count;
+  uint32_t errors;
+  uint32_t maxUs;
+} sd_health_histogram_t;
+
+typedef struct __SD_HEALTH_WINDOW__
+{
+  sd_health_histogram_t op[SD_HEALTH_OP_MAX];
+  uint32_t bytesWritten;
+  uint32_t retries;
+  uint32_t reinits;
+  bool slow;
+} sd_health_window_t;
+
+static const char *const opNames[SD_HEALTH_OP_MAX] = {"open", "write", "close", "mkdir", "exists", "journal"};
+static const char opTags[SD_HEALTH_OP_MAX] = {'o', 'w', 'c', 'm', 'x', 'j'};
+
+static SemaphoreHandle_t sdHealthMutex = NULL;
+static StaticSemaphore_t sdHealthMutexBuffer;
+
+static sd_health_window_t window;
+static int windowYear = -1; /*!< tm_year/tm_mon/tm_mday of the window, -1 before the first valid time */
+static int windowMonth = -1;
+static int windowDay = -1;
+
+static void vSdHealth_lock(void)
+{
+  if (sdHealthMutex != NULL)
+  {
+    xSemaphoreTake(sdHealthMutex, portMAX_DELAY);
+  }
+}
+
+static void vSdHealth_unlock(void)
+{
+  if (sdHealthMutex != NULL)
+  {
+    xSemaphoreGive(sdHealthMutex);
+  }
+}
+
+/**************************************************************
+ * @brief histogram bucket of a latency
+ *************************************************************/
+static uint8_t uSdHealth_bucket(uint32_t us)
+{
+  uint8_t bucket = 0;
+  uint32_t bound = 1UL << SD_HEALTH_FIRST_BUCKET_SHIFT;
+  while ((us >= bound) && (bucket < (SD_HEALTH_BUCKETS - 1)))
+  {
+    bound <<= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/**************************************************************
+ * @brief upper bound of the bucket holding the p-th percentile,
+ *        capped at the largest sample seen
+ *************************************************************/
+static uint32_t ulSdHealth_percentile(const sd_health_histogram_t *h, uint8_t percent)
+{
+  if (h->count == 0)
+  {
+    return 0;
+  }
+
+  uint32_t rank = (uint32_t)(((uint64_t)h->count * percent + 99) / 100);
+  uint32_t seen = 0;
+  for (uint8_t i = 0; i < SD_HEALTH_BUCKETS; i++)
+  {
+    seen += h->buckets[i];
+    if (seen >= rank)
+    {
+      uint32_t upper = 1UL << (SD_HEALTH_FIRST_BUCKET_SHIFT + i);
+      return ((i == (SD_HEALTH_BUCKETS - 1)) || (upper > h->maxUs)) ? h->maxUs : upper;
+    }
+  }
+  return h->maxUs;
+}
+
+static void vSdHealth_summarize(sd_health_summary_t *summary)
+{
+  for (uint8_t i = 0; i < SD_HEALTH_OP_MAX; i++)
+  {
+    const sd_health_histogram_t *h = &window.op[i];
+    summary->op[i].count = h->count;
+    summary->op[i].errors = h->errors;
+    summary->op[i].p50Us = ulSdHealth_percentile(h, 50);
+    summary->op[i].p95Us = ulSdHealth_percentile(h, 95);
+    summary->op[i].p99Us = ulSdHealth_percentile(h, 99);
+    summary->op[i].maxUs = h->maxUs;
+  }
+  summary->bytesWritten = window.bytesWritten;
+  summary->retries = window.retries;
+  summary->reinits = window.reinits;
+  summary->slow = window.slow;
+}
+
+/**************************************************************
+ * @brief printf at @p pos of @p row, keeping @p pos inside the
+ *        buffer when the output is truncated
+ *************************************************************/
+static void vSdHealth_format(char *row, size_t rowLen, size_t *pos, const char *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  int n = vsnprintf(row + *pos, rowLen - *pos, fmt, args);
+  va_end(args);
+  if (n > 0)
+  {
+    *pos = ((*pos + n) < rowLen) ? (*pos + n) : (rowLen - 1);
+  }
+}
+
+/**************************************************************
+ * @brief true if SD_HEALTH_PATH is missing, empty or starts
+ *        with @p header
+ *************************************************************/
+static bool bSdHealth_headerMatches(const char *header)
+{
+  File fl = SD.open(SD_HEALTH_PATH, FILE_READ);
+  if (!fl)
+  {
+    return true;
+  }
+  bool matches = (fl.size() == 0) || ((fl.readStringUntil('\n') + "\n") == header);
+  fl.close();
+  return matches;
+}
+
+/**************************************************************
+ * @brief append one day row to SD_HEALTH_PATH, header first
+ *        on a new file; a file with other columns is moved to
+ *        SD_HEALTH_OLD_PATH
+ *************************************************************/
+static void vSdHealth_writeRow(int year, int month, int day, const sd_health_summary_t *s)
+{
+  char header[SD_HEALTH_ROW_LEN];
+  char row[SD_HEALTH_ROW_LEN];
+  size_t pos = 0;
+
+  vSdHealth_format(header, sizeof(header), &pos, "date;bytes;retries;reinits;slow");
+  for (uint8_t i = 0; i < SD_HEALTH_OP_MAX; i++)
+  {
+    vSdHealth_format(header, sizeof(header), &pos, ";%s_n;%s_err;%s_p50_us;%s_p95_us;%s_p99_us;%s_max_us",
+                     opNames[i], opNames[i], opNames[i], opNames[i], opNames[i], opNames[i]);
+  }
+  vSdHealth_format(header, sizeof(header), &pos, "\r\n");
+
+  if (!bSdHealth_headerMatches(header))
+  {
+    log_i("%s has other columns, moved to %s", SD_HEALTH_PATH, SD_HEALTH_OLD_PATH);
+    SD.remove(SD_HEALTH_OLD_PATH);
+    SD.rename(SD_HEALTH_PATH, SD_HEALTH_OLD_PATH);
+  }
+
+  File fl = SD.open(SD_HEALTH_PATH, FILE_APPEND);
+  if (!fl)
+  {
+    log_w("Cannot open %s, SD health summary dropped", SD_HEALTH_PATH);
+    return;
+  }
+
+  if (fl.size() == 0)
+  {
+    fl.print(header);
+  }
+
+  pos = 0;
+  vSdHealth_format(row, sizeof(row), &pos, "%04d-%02d-%02d;%lu;%lu;%lu;%d", year + BASE_YEAR_OFFSET, month + MONTH_OFFSET, day,
+                   (unsigned long)s->bytesWritten, (unsigned long)s->retries, (unsigned long)s->reinits, s->slow ? 1 : 0);
+  for (uint8_t i = 0; i < SD_HEALTH_OP_MAX; i++)
+  {
+    const sd_health_latency_t *l = &s->op[i];
+    vSdHealth_format(row, sizeof(row), &pos, ";%lu;%lu;%lu;%lu;%lu;%lu", (unsigned long)l->count,
+                     (unsigned long)l->errors, (unsigned long)l->p50Us, (unsigned long)l->p95Us,
+                     (unsigned long)l->p99Us, (unsigned long)l->maxUs);
+  }
+  vSdHealth_format(row, sizeof(row), &pos, "\r\n");
+  fl.print(row);
+  fl.close();
+}
+
+/********************************************************
+ * @brief initialize the counters
+ ********************************************************/
+void vHalSdHealth_init(void)
+{
+  if (sdHealthMutex == NULL)
+  {
+    sdHealthMutex = xSemaphoreCreateMutexStatic(&sdHealthMutexBuffer);
+  }
+}
+
+/********************************************************
+ * @brief record one timed operation
+ *
+ * @param op
+ * @param startUs
+ * @param ok
+ ********************************************************/
+void vHalSdHealth_record(sd_health_op_t op, uint32_t startUs, bool ok)
+{
+  uint32_t us = (uint32_t)micros() - startUs;
+
+  vSdHealth_lock();
+  sd_health_histogram_t *h = &window.op[op];
+  h->buckets[uSdHealth_bucket(us)]++;
+  h->count++;
+  h->errors += ok ? 0 : 1;
+  h->maxUs = (us > h->maxUs) ? us : h->maxUs;
+  vSdHealth_unlock();
+}
+
+/********************************************************
+ * @brief count bytes written to the card
+ *
+ * @param bytes
+ ********************************************************/
+void vHalSdHealth_addBytes(uint32_t bytes)
+{
+  vSdHealth_lock();
+  window.bytesWritten += bytes;
+  vSdHealth_unlock();
+}
+
+/********************************************************
+ * @brief count a block write-out repeated after a failure
+ ********************************************************/
+void vHalSdHealth_countRetry(void)
+{
+  vSdHealth_lock();
+  window.retries++;
+  vSdHealth_unlock();
+}
+
+/********************************************************
+ * @brief count an SD.begin() re-initialization
+ ********************************************************/
+void vHalSdHealth_countReinit(void)
+{
+  vSdHealth_lock();
+  window.reinits++;
+  vSdHealth_unlock();
+}
+
+/********************************************************
+ * @brief summarize the current window
+ *
+ * @param summary
+ ********************************************************/
+void vHalSdHealth_getSummary(sd_health_summary_t *summary)
+{
+  vSdHealth_lock();
+  vSdHealth_summarize(summary);
+  vSdHealth_unlock();
+}
+
+/********************************************************
+ * @brief evaluate the slow card alarm
+ *
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdHealth_checkSlowAlarm(void)
+{
+  bool raised = false;
+
+  vSdHealth_lock();
+  const sd_health_histogram_t *w = &window.op[SD_HEALTH_OP_WRITE];
+  if (!window.slow && (w->count >= SD_HEALTH_SLOW_MIN_SAMPLES))
+  {
+    uint32_t p95 = ulSdHealth_percentile(w, 95);
+    if (p95 > SD_HEALTH_SLOW_WRITE_P95_US)
+    {
+      window.slow = true;
+      raised = true;
+      log_w("SD card slow: write p95 %lu us over %lu writes (limit %lu us), replace the card",
+            (unsigned long)p95, (unsigned long)w->count, (unsigned long)SD_HEALTH_SLOW_WRITE_P95_US);
+    }
+  }
+  vSdHealth_unlock();
+
+  return raised;
+}
+
+/********************************************************
+ * @brief compact summary for uploads
+ *
+ * @param buf
+ * @param bufLen
+ * @return int
+ ********************************************************/
+int iHalSdHealth_formatBlock(char *buf, size_t bufLen)
+{
+  static const sd_health_op_t blockOps[] = {SD_HEALTH_OP_WRITE, SD_HEALTH_OP_OPEN, SD_HEALTH_OP_CLOSE};
+  sd_health_summary_t s;
+  uint32_t errors = 0;
+  int pos = 0;
+
+  vHalSdHealth_getSummary(&s);
+  for (uint8_t i = 0; i < SD_HEALTH_OP_MAX; i++)
+  {
+    errors += s.op[i].errors;
+  }
+
+  for (size_t i = 0; i < (sizeof(blockOps) / sizeof(blockOps[0])); i++)
+  {
+    const sd_health_latency_t *l = &s.op[blockOps[i]];
+    int n = snprintf(buf + pos, bufLen - pos, "%c:%lu/%lu/%lu/%lu,", opTags[blockOps[i]],
+                     (unsigned long)(l->p50Us / US_PER_MS), (unsigned long)(l->p95Us / US_PER_MS),
+                     (unsigned long)(l->p99Us / US_PER_MS), (unsigned long)(l->maxUs / US_PER_MS));
+    if ((n < 0) || ((size_t)n >= (bufLen - pos)))
+    {
+      return -1;
+    }
+    pos += n;
+  }
+
+  int n = snprintf(buf + pos, bufLen - pos, "b:%lu,r:%lu,i:%lu,e:%lu,s:%d", (unsigned long)s.bytesWritten,
+                   (unsigned long)s.retries, (unsigned long)s.reinits, (unsigned long)errors, s.slow ? 1 : 0);
+  if ((n < 0) || ((size_t)n >= (bufLen - pos)))
+  {
+    return -1;
+  }
+  return pos + n;
+}
+
+/********************************************************
+ * @brief on a day change, append the finished window to
+ *        SD_HEALTH_PATH and start a new one
+ *
+ * @param now
+ ********************************************************/
+void vHalSdHealth_dayTick(const struct tm *now)
+{
+  sd_health_summary_t summary;
+
+  vSdHealth_lock();
+  if ((windowYear < 0) || ((now->tm_year == windowYear) && (now->tm_mon == windowMonth) && (now->tm_mday == windowDay)))
+  {
+    // First valid time: the window since boot belongs to this day
+    windowYear = now->tm_year;
+    windowMonth = now->tm_mon;
+    windowDay = now->tm_mday;
+    vSdHealth_unlock();
+    return;
+  }
+
+  vSdHealth_summarize(&summary);
+  int year = windowYear;
+  int month = windowMonth;
+  int day = windowDay;
+  memset(&window, 0, sizeof(window));
+  windowYear = now->tm_year;
+  windowMonth = now->tm_mon;
+  windowDay = now->tm_mday;
+  vSdHealth_unlock();
+
+  // Written outside the lock: the append is itself an SD operation
+  vSdHealth_writeRow(year, month, day, &summary);
+  log_i("SD health %04d-%02d-%02d: write p50/p95/p99/max %lu/%lu/%lu/%lu us, %lu bytes, %lu retries, %lu re-inits",
+        year + BASE_YEAR_OFFSET, month + MONTH_OFFSET, day, (unsigned long)summary.op[SD_HEALTH_OP_WRITE].p50Us,
+        (unsigned long)summary.op[SD_HEALTH_OP_WRITE].p95Us, (unsigned long)summary.op[SD_HEALTH_OP_WRITE].p99Us,
+        (unsigned long)summary.op[SD_HEALTH_OP_WRITE].maxUs, (unsigned long)summary.bytesWritten,
+        (unsigned long)summary.retries, (unsigned long)summary.reinits);
+}
+
+//************************************** EOF **************************************
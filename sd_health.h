@@ -0,0 +1,123 @@
+/******************************************************************************************************
+ * @file    sd_health.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   SD card I/O latency and health telemetry for the Milano Smart Park project
+ * @details Per-operation latency histograms (log2 microsecond buckets), byte, retry, re-init
+ *          and error counters over a daily window. The window is summarized once per day into
+ *          SD_HEALTH_PATH, as a compact block attached to uploads, and raises a slow card alarm
+ *          when the write p95 stays above SD_HEALTH_SLOW_WRITE_P95_US.
+ * @version 0.1
+ * @date    2025-09-14
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *****************************************************************************************************/
+
+#ifndef SD_HEALTH_H
+#define SD_HEALTH_H
+
+// -- includes --
+#include <Arduino.h>
+#include <time.h>
+
+#define SD_HEALTH_BUCKETS 16         /*!< bucket i holds [2^(i+5), 2^(i+6)) us, bucket 0 everything below 64 us */
+#define SD_HEALTH_BLOCK_MAX_LEN 128  /*!< compact upload block incl. terminator */
+
+typedef enum __SD_HEALTH_OP__
+{
+  SD_HEALTH_OP_OPEN,
+  SD_HEALTH_OP_WRITE, /*!< write + flush of one block */
+  SD_HEALTH_OP_CLOSE,
+  SD_HEALTH_OP_MKDIR,
+  SD_HEALTH_OP_EXISTS,
+  SD_HEALTH_OP_JOURNAL, /*!< write of one journal record, kept out of the slow card alarm */
+  SD_HEALTH_OP_MAX
+} sd_health_op_t;
+
+typedef struct __SD_HEALTH_LATENCY__
+{
+  uint32_t count;
+  uint32_t errors;
+  uint32_t p50Us;
+  uint32_t p95Us;
+  uint32_t p99Us;
+  uint32_t maxUs;
+} sd_health_latency_t;
+
+typedef struct __SD_HEALTH_SUMMARY__
+{
+  sd_health_latency_t op[SD_HEALTH_OP_MAX];
+  uint32_t bytesWritten; /*!< bytes written to the card, journal included */
+  uint32_t retries;      /*!< block write-outs repeated after a failure */
+  uint32_t reinits;      /*!< SD.begin() re-initializations */
+  bool slow;             /*!< slow card alarm raised in this window */
+} sd_health_summary_t;
+
+/********************************************************
+ * @brief initialize the counters
+ ********************************************************/
+void vHalSdHealth_init(void);
+
+/********************************************************
+ * @brief record one timed operation
+ *
+ * @param op      operation
+ * @param startUs micros() taken before the call
+ * @param ok      operation succeeded
+ ********************************************************/
+void vHalSdHealth_record(sd_health_op_t op, uint32_t startUs, bool ok);
+
+/********************************************************
+ * @brief count bytes written to the card
+ *
+ * @param bytes
+ ********************************************************/
+void vHalSdHealth_addBytes(uint32_t bytes);
+
+/********************************************************
+ * @brief count a block write-out repeated after a failure
+ ********************************************************/
+void vHalSdHealth_countRetry(void);
+
+/********************************************************
+ * @brief count an SD.begin() re-initialization
+ ********************************************************/
+void vHalSdHealth_countReinit(void);
+
+/********************************************************
+ * @brief summarize the current window
+ *
+ * @param summary destination
+ ********************************************************/
+void vHalSdHealth_getSummary(sd_health_summary_t *summary);
+
+/********************************************************
+ * @brief evaluate the slow card alarm
+ *
+ * @return true the alarm was raised by this call (once
+ *         per window)
+ ********************************************************/
+bool bHalSdHealth_checkSlowAlarm(void);
+
+/********************************************************
+ * @brief compact summary for uploads, e.g.
+ *        "w:4/18/40/95,o:2/9/12/30,c:1/3/3/7,b:51200,r:0,i:0,e:0,s:0"
+ *        (latencies p50/p95/p99/max in ms)
+ *
+ * @param buf    output buffer
+ * @param bufLen output buffer size
+ * @return int   block length, -1 if it does not fit
+ ********************************************************/
+int iHalSdHealth_formatBlock(char *buf, size_t bufLen);
+
+/********************************************************
+ * @brief on a day change, append the finished window to
+ *        SD_HEALTH_PATH and start a new one
+ *
+ * @param now current local time
+ ********************************************************/
+void vHalSdHealth_dayTick(const struct tm *now);
+
+#endif
+
+//************************************** EOF **************************************
@@ -22,7 +22,7 @@
 // Legacy function removed - now using date-based logging with automatic file creation
 
 /*******************************************************************************
- * @brief log to SD card 
+ * @brief log to SD card, or to the internal flash store without a card
  * 
  * @param data 
  * @param p_tSysData 
@@ -32,6 +32,14 @@
  ******************************************************************************/
 void vHalSdcard_logToSD(send_data_t *data, systemData_t *p_tSysData, systemStatus_t *p_tSys, sensorData_t *p_tData, deviceNetworkInfo_t *p_tDev);
 
+/**************************************************************
+ * @brief Convert a binary daily log to CSV_HEADER layout
+ * 
+ * @param binPath /YYYY/MM/DD.bin, written as /YYYY/MM/DD.csv
+ * @return bool Success/failure
+ *************************************************************/
+bool bHalSdcard_exportBinaryLog(const char *binPath);
+
 /**************************************************************
  * @brief Create date-based log path (YYYY/MM/DD.csv format)
  * 
@@ -81,6 +89,14 @@ uint8_t initializeSD(systemStatus_t *p_tSys, deviceNetworkInfo_t *p_tDev);
  ********************************************************/
 uint8_t checkConfig(const char *configpath, deviceNetworkInfo_t *p_tDev, sensorData_t *p_tData, deviceMeasurement_t *pDev, systemStatus_t *p_tSys, systemData_t *p_tSysData);
 
+/********************************************************
+ * @brief re-read the configuration file and publish it to
+ *        the config store when its content changed
+ *
+ * @return true a new configuration version was published
+ ********************************************************/
+bool bHalSdcard_reloadConfig(void);
+
 /********************************************************
  * @brief periodic SD card presence check
  * 
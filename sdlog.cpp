@@ -0,0 +1,1461 @@
+/************************************************************************************************
+ * @file    sdlog.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Buffered daily log writer for the Milano Smart Park project
+ * @version 0.1
+ * @date    2025-09-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ************************************************************************************************/
+
+// -- includes --
+#include <SD.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+
+#include <unistd.h>
+
+#include "sdlog.h"
+#include "log_codec.h"
+#include "log_journal.h"
+#include "sd_health.h"
+
+#define SDLOG_BUFFER_SIZE (2 * SDLOG_BLOCK_SIZE)
+#define SDLOG_LINE_END "\r\n" // same terminator println() used to write
+#define SDLOG_LINE_END_LEN 2
+#define SDLOG_DIR_LEN 16
+#define SDLOG_READ_LINE_MAX 320
+#define SDLOG_HEADER_MAX_LEN 128
+#define SDLOG_INDEX_PENDING 16 /*!< index entries batched per .idx write (256 records) */
+#define SDLOG_INDEX_PATH_LEN (SDLOG_PATH_LEN + sizeof(SDLOG_INDEX_EXTENSION))
+#define SDLOG_QUERY_RECORDS (SDLOG_BLOCK_SIZE / sizeof(log_bin_record_t))
+#define SDLOG_VFS_PATH_LEN (sizeof(SDLOG_MOUNT_POINT) + SDLOG_INDEX_PATH_LEN)
+
+#define MINUTES_PER_HOUR 60
+#define MINUTES_PER_DAY (24 * MINUTES_PER_HOUR)
+
+#define BASE_YEAR_OFFSET 1900
+#define MONTH_OFFSET 1
+
+static SemaphoreHandle_t sdlogMutex = NULL;
+static StaticSemaphore_t sdlogMutexBuffer;
+
+// Journal record assembly and recovery work buffer, used under sdlogMutex
+static uint8_t journalScratch[LOG_JOURNAL_RECORD_MAX];
+
+// Source of the preallocation fill
+static uint8_t zeroBlock[SDLOG_BLOCK_SIZE];
+
+// Sparse index entry, appended to <day file>.idx every SDLOG_INDEX_STRIDE records
+typedef struct __attribute__((packed)) __SDLOG_INDEX_ENTRY__
+{
+  uint16_t minuteOfDay; /*!< hour * 60 + minute of the indexed record */
+  uint16_t reserved;
+  uint32_t offset; /*!< byte offset of the record in the day file */
+} sdlog_index_entry_t;
+
+typedef struct __SDLOG_STATE__
+{
+  const char *extension;
+  size_t preallocDefault; /*!< preallocation while no day's size is known */
+  int year;  /*!< tm_year of the open day, -1 if none */
+  int month; /*!< tm_mon of the open day */
+  int day;   /*!< tm_mday of the open day */
+  char path[SDLOG_PATH_LEN];
+  bool dirsReady;
+  bool fileOpen;
+  File file;
+  char buffer[SDLOG_BUFFER_SIZE];
+  size_t used;
+  unsigned long oldestLineMs; /*!< millis() of the oldest buffered line */
+  size_t fileBytes;           /*!< bytes already in the open day file (its data end) */
+  size_t fileCapacity;        /*!< physical size of the open day file, data plus preallocated space */
+  size_t lastDayBytes;        /*!< data length of the last closed day, sizes the next preallocation */
+  long newestDay;             /*!< day key of the newest day opened, older days are not preallocated */
+  bool preallocated;          /*!< day file is listed in SDLOG_PREALLOC_PATH */
+  uint16_t sinceIndex;        /*!< records since the last index entry */
+  sdlog_index_entry_t pendingIndex[SDLOG_INDEX_PENDING];
+  uint8_t pendingCount;
+  bool writeFailed; /*!< last write-out failed, buffered data is retried */
+  sdlog_stats_t stats;
+} sdlog_state_t;
+
+static sdlog_state_t sdlog[SDLOG_CHANNEL_MAX] = {
+    {.extension = ".csv", .preallocDefault = SDLOG_PREALLOC_CSV_BYTES, .year = -1, .month = -1, .day = -1},
+    {.extension = ".bin", .preallocDefault = SDLOG_PREALLOC_BIN_BYTES, .year = -1, .month = -1, .day = -1},
+};
+
+static void vSdlog_lock(void)
+{
+  if (sdlogMutex != NULL)
+  {
+    xSemaphoreTake(sdlogMutex, portMAX_DELAY);
+  }
+}
+
+static void vSdlog_unlock(void)
+{
+  if (sdlogMutex != NULL)
+  {
+    xSemaphoreGive(sdlogMutex);
+  }
+}
+
+/**************************************************************
+ * @brief day ordering key of a broken-down time
+ *************************************************************/
+static long lSdlog_dayKey(const struct tm *t)
+{
+  return ((long)t->tm_year * 12 + t->tm_mon) * 32 + t->tm_mday;
+}
+
+/**************************************************************
+ * @brief create a directory unless it is already there
+ *************************************************************/
+static bool bSdlog_ensureDir(sdlog_state_t *log, const char *dirPath)
+{
+  log->stats.fsOps++;
+  uint32_t startUs = micros();
+  bool exists = SD.exists(dirPath);
+  vHalSdHealth_record(SD_HEALTH_OP_EXISTS, startUs, true);
+  if (exists)
+  {
+    return true;
+  }
+
+  log_i("Creating directory: %s", dirPath);
+  log->stats.fsOps++;
+  startUs = micros();
+  bool created = SD.mkdir(dirPath);
+  vHalSdHealth_record(SD_HEALTH_OP_MKDIR, startUs, created);
+  if (!created)
+  {
+    log_e("Failed to create directory: %s", dirPath);
+    return false;
+  }
+  return true;
+}
+
+/**************************************************************
+ * @brief cut a file (card path) to @p len bytes
+ *************************************************************/
+static bool bSdlog_truncate(const char *path, uint32_t len)
+{
+  char vfsPath[SDLOG_VFS_PATH_LEN];
+  snprintf(vfsPath, sizeof(vfsPath), SDLOG_MOUNT_POINT "%s", path);
+  return (truncate(vfsPath, len) == 0);
+}
+
+/**************************************************************
+ * @brief drop index entries past the end of the day file; they
+ *        are appended ahead of the data they point to
+ *************************************************************/
+static void vSdlog_trimIndex(sdlog_state_t *log, size_t dataLen)
+{
+  char idxPath[SDLOG_INDEX_PATH_LEN];
+  snprintf(idxPath, sizeof(idxPath), "%s" SDLOG_INDEX_EXTENSION, log->path);
+
+  File idx = SD.open(idxPath, FILE_READ);
+  if (!idx)
+  {
+    return;
+  }
+
+  size_t idxLen = idx.size();
+  size_t keep = idxLen / sizeof(sdlog_index_entry_t); // a torn entry is never kept
+  while (keep > 0)
+  {
+    sdlog_index_entry_t entry;
+    if (!idx.seek((keep - 1) * sizeof(sdlog_index_entry_t)) ||
+        (idx.read((uint8_t *)&entry, sizeof(entry)) != sizeof(entry)) || (entry.offset < dataLen))
+    {
+      break;
+    }
+    keep--;
+  }
+  idx.close();
+
+  size_t keepLen = keep * sizeof(sdlog_index_entry_t);
+  if (keepLen < idxLen)
+  {
+    log_w("Index %s cut to %u entries", idxPath, (unsigned)keep);
+    bSdlog_truncate(idxPath, keepLen);
+  }
+}
+
+/**************************************************************
+ * @brief end of the data in a day file: preallocated space is
+ *        zero filled, CSV text never holds a NUL and a binary
+ *        file marks free space with blank records past the
+ *        checkpoint in its header
+ *************************************************************/
+static size_t uSdlog_dataEnd(File &fl, bool binary)
+{
+  size_t fileLen = fl.size();
+
+  if (binary)
+  {
+    uint8_t header[LOG_BIN_HEADER_LEN];
+    if ((fileLen < LOG_BIN_HEADER_LEN) || !fl.seek(0) || (fl.read(header, sizeof(header)) != sizeof(header)))
+    {
+      return fileLen;
+    }
+    size_t pos = ulLogCodec_binDataEnd(header);
+    if ((pos < LOG_BIN_HEADER_LEN) || (pos > fileLen) || (((pos - LOG_BIN_HEADER_LEN) % sizeof(log_bin_record_t)) != 0))
+    {
+      pos = LOG_BIN_HEADER_LEN; // no checkpoint yet: scan from the first record
+    }
+
+    log_bin_record_t records[SDLOG_QUERY_RECORDS];
+    size_t got;
+    fl.seek(pos);
+    while ((got = fl.read((uint8_t *)records, sizeof(records))) >= sizeof(log_bin_record_t))
+    {
+      for (size_t i = 0; i < (got / sizeof(log_bin_record_t)); i++)
+      {
+        if (bLogCodec_binRecordBlank(&records[i]))
+        {
+          return pos;
+        }
+        pos += sizeof(log_bin_record_t);
+      }
+    }
+    return fileLen; // no free space left, a torn record is the caller's business
+  }
+
+  // Text then zeros only: bisect for the first NUL
+  size_t lo = 0;
+  size_t hi = fileLen;
+  while (lo < hi)
+  {
+    size_t mid = lo + ((hi - lo) / 2);
+    uint8_t c;
+    if (!fl.seek(mid) || (fl.read(&c, 1) != 1))
+    {
+      return fileLen;
+    }
+    if (c == 0)
+    {
+      hi = mid;
+    }
+    else
+    {
+      lo = mid + 1;
+    }
+  }
+  return lo;
+}
+
+/**************************************************************
+ * @brief data end of an existing day file; with @p trimTorn a
+ *        partial last line/record is dropped first: whole
+ *        sectors go out on the size trigger, so a power cut can
+ *        end the data mid-line
+ *************************************************************/
+static bool bSdlog_probeDay(sdlog_state_t *log, bool trimTorn, size_t *dataEnd)
+{
+  bool binary = (log == &sdlog[SDLOG_CHANNEL_BIN]);
+
+  *dataEnd = 0;
+  log->stats.fsOps++;
+  File fl = SD.open(log->path, FILE_READ);
+  if (!fl)
+  {
+    return false; // new file
+  }
+
+  size_t dataLen = uSdlog_dataEnd(fl, binary);
+  size_t completeLen = dataLen;
+  if (binary)
+  {
+    completeLen = uLogCodec_binCompleteLength(dataLen);
+  }
+  else if (dataLen > 0)
+  {
+    char tail[SDLOG_READ_LINE_MAX];
+    size_t tailLen = (dataLen > sizeof(tail)) ? sizeof(tail) : dataLen;
+    log->stats.fsOps += 2;
+    if (fl.seek(dataLen - tailLen) && (fl.read((uint8_t *)tail, tailLen) == tailLen))
+    {
+      completeLen = uLogCodec_csvCompleteLength(tail, tailLen, dataLen);
+    }
+  }
+  fl.close();
+
+  *dataEnd = dataLen;
+  if (!trimTorn)
+  {
+    return true;
+  }
+
+  vSdlog_trimIndex(log, completeLen);
+
+  if (completeLen < dataLen)
+  {
+    // The cut takes any preallocated space with it; it is rebuilt on open
+    log->stats.fsOps++;
+    if (bSdlog_truncate(log->path, completeLen))
+    {
+      log_w("Torn tail of %s cut: %u -> %u bytes", log->path, (unsigned)dataLen, (unsigned)completeLen);
+      log->stats.tornTails++;
+      *dataEnd = completeLen;
+    }
+    else
+    {
+      log_e("Failed to cut torn tail of %s", log->path);
+      log->stats.errors++;
+    }
+  }
+  return true;
+}
+
+/**************************************************************
+ * @brief write-ahead: store the block, framed with its length
+ *        and CRC, in the journal before the target is touched
+ *************************************************************/
+static bool bSdlog_journal(sdlog_state_t *log, const char *path, uint32_t offset, const uint8_t *data, size_t len,
+                           uint8_t flags)
+{
+  size_t pathLen = strlen(path);
+  size_t headerLen = uLogJournal_formatHeader(path, offset, data, len, flags, journalScratch, sizeof(journalScratch));
+  if (headerLen == 0)
+  {
+    return false;
+  }
+  memcpy(journalScratch + headerLen, path, pathLen);
+  memcpy(journalScratch + headerLen + pathLen, data, len);
+  size_t recordLen = headerLen + pathLen + len;
+
+  log->stats.fsOps += 3;
+  uint32_t startUs = micros();
+  File journal = SD.open(SDLOG_JOURNAL_PATH, FILE_WRITE);
+  vHalSdHealth_record(SD_HEALTH_OP_OPEN, startUs, (bool)journal);
+  if (!journal)
+  {
+    return false;
+  }
+  startUs = micros();
+  bool ok = (journal.write(journalScratch, recordLen) == recordLen);
+  vHalSdHealth_record(SD_HEALTH_OP_JOURNAL, startUs, ok);
+  vHalSdHealth_addBytes(recordLen);
+  startUs = micros();
+  journal.close(); // close syncs: the record is complete on the card before the target write starts
+  vHalSdHealth_record(SD_HEALTH_OP_CLOSE, startUs, true);
+  return ok;
+}
+
+/**************************************************************
+ * @brief journaled write: journal, write, sync, drop journal;
+ *        a power cut at any point is undone by vHalSdlog_recover()
+ *************************************************************/
+static size_t uSdlog_commitWrite(sdlog_state_t *log, File &fl, const char *path, uint32_t offset,
+                                 const uint8_t *data, size_t len, bool inPlace)
+{
+  bool journaled = bSdlog_journal(log, path, offset, data, len, inPlace ? LOG_JOURNAL_FLAG_IN_PLACE : 0);
+  if (!journaled)
+  {
+    log_w("SD log journal write failed, %s written unprotected", path);
+    log->stats.errors++;
+  }
+
+  log->stats.fsOps += 3;
+  uint32_t startUs = micros();
+  size_t written = fl.seek(offset) ? fl.write(data, len) : 0;
+  fl.flush(); // commits the data and the FAT directory entry (file size)
+  vHalSdHealth_record(SD_HEALTH_OP_WRITE, startUs, (written == len));
+  vHalSdHealth_addBytes(written);
+
+  if (journaled && (written == len))
+  {
+    log->stats.fsOps++;
+    SD.remove(SDLOG_JOURNAL_PATH);
+  }
+  return written;
+}
+
+/**************************************************************
+ * @brief header written at the top of a new daily file
+ *************************************************************/
+static size_t uSdlog_formatHeader(sdlog_state_t *log, uint8_t *out, size_t outLen)
+{
+  if (log == &sdlog[SDLOG_CHANNEL_BIN])
+  {
+    struct tm day = {};
+    day.tm_year = log->year;
+    day.tm_mon = log->month;
+    day.tm_mday = log->day;
+    return uLogCodec_formatBinHeader(&day, out, outLen);
+  }
+
+  int len = snprintf((char *)out, outLen, "%s" SDLOG_LINE_END, CSV_HEADER);
+  return ((len > 0) && ((size_t)len < outLen)) ? (size_t)len : 0;
+}
+
+/**************************************************************
+ * @brief list the day files holding preallocated space, so a
+ *        reset before the day is closed still gets them cut
+ *************************************************************/
+static void vSdlog_writePreallocMarker(sdlog_state_t *log)
+{
+  bool any = false;
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    any = any || sdlog[ch].preallocated;
+  }
+
+  log->stats.fsOps++;
+  if (!any)
+  {
+    if (SD.exists(SDLOG_PREALLOC_PATH))
+    {
+      log->stats.fsOps++;
+      SD.remove(SDLOG_PREALLOC_PATH);
+    }
+    return;
+  }
+
+  File marker = SD.open(SDLOG_PREALLOC_PATH, FILE_WRITE);
+  if (!marker)
+  {
+    log_w("Failed to write %s, preallocated space is only cut at day close", SDLOG_PREALLOC_PATH);
+    log->stats.errors++;
+    return;
+  }
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    if (sdlog[ch].preallocated)
+    {
+      marker.print(sdlog[ch].path);
+      marker.print(SDLOG_LINE_END);
+    }
+  }
+  log->stats.fsOps += 2;
+  marker.close();
+}
+
+/**************************************************************
+ * @brief store the data end in the binary day header; blank
+ *        records before it are data, after it free space
+ *************************************************************/
+static void vSdlog_checkpoint(sdlog_state_t *log)
+{
+  if ((log != &sdlog[SDLOG_CHANNEL_BIN]) || !log->fileOpen || (log->fileBytes < LOG_BIN_HEADER_LEN))
+  {
+    return;
+  }
+
+  uint8_t header[SDLOG_HEADER_MAX_LEN];
+  size_t headerLen = uSdlog_formatHeader(log, header, sizeof(header));
+  if (headerLen != LOG_BIN_HEADER_LEN)
+  {
+    return;
+  }
+  vLogCodec_setBinDataEnd(header, (uint32_t)log->fileBytes);
+  uSdlog_commitWrite(log, log->file, log->path, 0, header, headerLen, true);
+}
+
+/**************************************************************
+ * @brief zero-fill the open day file up to @p target bytes: the
+ *        clusters are chained once here instead of one FAT
+ *        update per block write during the day
+ *************************************************************/
+static void vSdlog_preallocate(sdlog_state_t *log, size_t target)
+{
+  target = ((target + SDLOG_BLOCK_SIZE - 1) / SDLOG_BLOCK_SIZE) * SDLOG_BLOCK_SIZE;
+  if (target <= log->fileCapacity)
+  {
+    return;
+  }
+
+  // Listed before the fill, a cut mid-way leaves nothing behind uncut
+  if (!log->preallocated)
+  {
+    log->preallocated = true;
+    vSdlog_writePreallocMarker(log);
+  }
+
+  size_t pos = log->fileCapacity;
+  log->stats.fsOps++;
+  if (log->file.seek(pos))
+  {
+    while (pos < target)
+    {
+      size_t chunk = ((target - pos) > sizeof(zeroBlock)) ? sizeof(zeroBlock) : (target - pos);
+      size_t written = log->file.write(zeroBlock, chunk);
+      log->stats.fsOps++;
+      pos += written;
+      if (written != chunk)
+      {
+        log_w("Preallocation of %s stopped at %u bytes", log->path, (unsigned)pos);
+        break;
+      }
+    }
+  }
+  log->stats.fsOps++;
+  log->file.flush();
+
+  vHalSdHealth_addBytes(pos - log->fileCapacity);
+  log->stats.preallocBytes += pos - log->fileCapacity;
+  log_i("Preallocated %s: %u -> %u bytes", log->path, (unsigned)log->fileCapacity, (unsigned)pos);
+  log->fileCapacity = pos;
+  vSdlog_checkpoint(log);
+}
+
+/**************************************************************
+ * @brief preallocation of a new day: the last full day plus a
+ *        quarter, the channel default before one is known
+ *************************************************************/
+static size_t uSdlog_preallocTarget(sdlog_state_t *log)
+{
+  size_t target = log->lastDayBytes + (log->lastDayBytes / 4);
+  if (target < log->preallocDefault)
+  {
+    target = log->preallocDefault;
+  }
+  if (target > SDLOG_PREALLOC_MAX_BYTES)
+  {
+    target = SDLOG_PREALLOC_MAX_BYTES;
+  }
+  return (target > log->fileBytes) ? target : log->fileBytes;
+}
+
+/**************************************************************
+ * @brief open the cached day file (directories checked once
+ *        per day), writing the header of a new file; the
+ *        newest day is preallocated
+ *************************************************************/
+static bool bSdlog_openDay(sdlog_state_t *log)
+{
+  if (log->fileOpen)
+  {
+    return true;
+  }
+
+  if (!log->dirsReady)
+  {
+    char yearPath[SDLOG_DIR_LEN];
+    char monthPath[SDLOG_DIR_LEN];
+    snprintf(yearPath, sizeof(yearPath), "/%04d", log->year + BASE_YEAR_OFFSET);
+    snprintf(monthPath, sizeof(monthPath), "%s/%02d", yearPath, log->month + MONTH_OFFSET);
+
+    if (!bSdlog_ensureDir(log, yearPath) || !bSdlog_ensureDir(log, monthPath))
+    {
+      log->stats.errors++;
+      return false;
+    }
+    log->dirsReady = true;
+  }
+
+  // With lines still buffered the file tail may be the start of one of them, keep it
+  size_t dataEnd;
+  bool exists = bSdlog_probeDay(log, (log->used == 0), &dataEnd);
+
+  // Writes land at the data end, inside preallocated space: no append mode
+  log->stats.fsOps++;
+  uint32_t startUs = micros();
+  log->file = SD.open(log->path, exists ? "r+" : FILE_WRITE);
+  vHalSdHealth_record(SD_HEALTH_OP_OPEN, startUs, (bool)log->file);
+  if (!log->file)
+  {
+    log_e("Failed to open log file for writing: %s", log->path);
+    log->stats.errors++;
+    log->dirsReady = false; // card may have been swapped, re-check next time
+    return false;
+  }
+  log->fileOpen = true;
+  log->stats.dayOpens++;
+  log->sinceIndex = 0; // offsets of earlier records are not known here, index the next one
+
+  // New file: header goes in front of anything already buffered
+  log->fileBytes = dataEnd;
+  log->fileCapacity = log->file.size();
+  if (log->fileBytes == 0)
+  {
+    uint8_t header[SDLOG_HEADER_MAX_LEN];
+    size_t headerLen = uSdlog_formatHeader(log, header, sizeof(header));
+    log->fileBytes = uSdlog_commitWrite(log, log->file, log->path, 0, header, headerLen, false);
+    log->fileCapacity = log->fileBytes;
+    log->stats.bytesWritten += headerLen;
+    log_i("Header added to new log file: %s", log->path);
+  }
+
+  // Days refilled from the flash store are not preallocated, they are written once
+  struct tm day = {};
+  day.tm_year = log->year;
+  day.tm_mon = log->month;
+  day.tm_mday = log->day;
+  if (lSdlog_dayKey(&day) >= log->newestDay)
+  {
+    log->newestDay = lSdlog_dayKey(&day);
+    vSdlog_preallocate(log, uSdlog_preallocTarget(log));
+  }
+  return true;
+}
+
+/**************************************************************
+ * @brief write the first @p len buffered bytes to the file
+ *************************************************************/
+static bool bSdlog_writeOut(sdlog_state_t *log, size_t len)
+{
+  if (len == 0)
+  {
+    return true;
+  }
+  if (log->writeFailed)
+  {
+    vHalSdHealth_countRetry();
+  }
+  if (!bSdlog_openDay(log))
+  {
+    log->writeFailed = true;
+    return false;
+  }
+
+  // Out of preallocated space: extend by the channel default rather than grow per block
+  if (log->preallocated && ((log->fileBytes + len) > log->fileCapacity))
+  {
+    vSdlog_preallocate(log, log->fileBytes + len + log->preallocDefault);
+  }
+
+  bool inPlace = ((log->fileBytes + len) <= log->fileCapacity);
+  size_t written = uSdlog_commitWrite(log, log->file, log->path, (uint32_t)log->fileBytes, (const uint8_t *)log->buffer, len,
+                                      inPlace);
+  if (written != len)
+  {
+    log_e("Short write on %s: %u/%u bytes", log->path, (unsigned)written, (unsigned)len);
+    log->stats.errors++;
+    log->file.close();
+    log->fileOpen = false;
+    log->dirsReady = false;
+    log->writeFailed = true;
+    return false;
+  }
+
+  log->writeFailed = false;
+  log->fileBytes += written;
+  if (log->fileBytes > log->fileCapacity)
+  {
+    log->fileCapacity = log->fileBytes;
+  }
+  log->stats.bytesWritten += written;
+  log->stats.blockWrites++;
+  memmove(log->buffer, log->buffer + len, log->used - len);
+  log->used -= len;
+  return true;
+}
+
+/**************************************************************
+ * @brief append the pending index entries to the .idx file;
+ *        the index only speeds up queries, so failures drop it
+ *************************************************************/
+static void vSdlog_writeIndex(sdlog_state_t *log)
+{
+  if (log->pendingCount == 0)
+  {
+    return;
+  }
+
+  char idxPath[SDLOG_INDEX_PATH_LEN];
+  snprintf(idxPath, sizeof(idxPath), "%s" SDLOG_INDEX_EXTENSION, log->path);
+
+  log->stats.fsOps++;
+  uint32_t startUs = micros();
+  File idx = SD.open(idxPath, FILE_APPEND);
+  vHalSdHealth_record(SD_HEALTH_OP_OPEN, startUs, (bool)idx);
+  if (!idx)
+  {
+    log_w("Failed to open index %s, %u entries dropped", idxPath, (unsigned)log->pendingCount);
+    log->stats.errors++;
+    log->pendingCount = 0;
+    return;
+  }
+
+  uSdlog_commitWrite(log, idx, idxPath, (uint32_t)idx.size(), (const uint8_t *)log->pendingIndex,
+                     log->pendingCount * sizeof(sdlog_index_entry_t), false);
+  log->stats.fsOps++;
+  startUs = micros();
+  idx.close();
+  vHalSdHealth_record(SD_HEALTH_OP_CLOSE, startUs, true);
+  log->stats.indexWrites += log->pendingCount;
+  log->pendingCount = 0;
+}
+
+/**************************************************************
+ * @brief write everything buffered and optionally close
+ *************************************************************/
+static void vSdlog_flushLocked(sdlog_state_t *log, bool closeFile)
+{
+  if (log->used > 0)
+  {
+    if (!bSdlog_writeOut(log, log->used))
+    {
+      log_w("SD log flush failed, %u bytes kept in buffer", (unsigned)log->used);
+    }
+  }
+
+  // Batched: entries lost to a power cut only make queries scan from an earlier entry
+  if (closeFile && (log->used == 0))
+  {
+    vSdlog_writeIndex(log);
+  }
+
+  if (closeFile && log->fileOpen)
+  {
+    log->stats.fsOps++;
+    uint32_t startUs = micros();
+    log->file.close();
+    vHalSdHealth_record(SD_HEALTH_OP_CLOSE, startUs, true);
+    log->fileOpen = false;
+  }
+}
+
+/**************************************************************
+ * @brief flush and close the day file, cutting preallocated
+ *        space past the data end
+ *************************************************************/
+static void vSdlog_closeDay(sdlog_state_t *log)
+{
+  vSdlog_flushLocked(log, false);
+  vSdlog_checkpoint(log);
+  vSdlog_flushLocked(log, true);
+
+  if (log->preallocated)
+  {
+    if (log->fileCapacity > log->fileBytes)
+    {
+      log->stats.fsOps++;
+      if (bSdlog_truncate(log->path, log->fileBytes))
+      {
+        log_i("Day file %s closed at %u of %u bytes", log->path, (unsigned)log->fileBytes, (unsigned)log->fileCapacity);
+      }
+      else
+      {
+        log_e("Failed to cut %s to its data end", log->path);
+        log->stats.errors++;
+      }
+    }
+    log->preallocated = false;
+    vSdlog_writePreallocMarker(log);
+    log->lastDayBytes = log->fileBytes;
+  }
+  log->fileCapacity = log->fileBytes;
+}
+
+/**************************************************************
+ * @brief esp_restart() hook: buffered lines must not be lost on
+ *        the firmware update and watchdog reboot paths
+ *************************************************************/
+static void vSdlog_shutdownHandler(void)
+{
+  if ((sdlogMutex != NULL) && (xSemaphoreTake(sdlogMutex, pdMS_TO_TICKS(500)) != pdTRUE))
+  {
+    return; // writer busy in the restarting task: better lose the tail than deadlock
+  }
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    vSdlog_closeDay(&sdlog[ch]);
+  }
+  vSdlog_unlock();
+}
+
+/********************************************************
+ * @brief initialize the log writer
+ ********************************************************/
+void vHalSdlog_init(void)
+{
+  if (sdlogMutex == NULL)
+  {
+    sdlogMutex = xSemaphoreCreateMutexStatic(&sdlogMutexBuffer);
+    esp_register_shutdown_handler(vSdlog_shutdownHandler);
+  }
+}
+
+/**************************************************************
+ * @brief log_journal_io_t on the SD card
+ *************************************************************/
+static long lSdlog_ioSize(void *ctx, const char *path)
+{
+  (void)ctx;
+  if (!SD.exists(path))
+  {
+    return -1;
+  }
+  File fl = SD.open(path, FILE_READ);
+  long len = fl ? (long)fl.size() : -1;
+  fl.close();
+  return len;
+}
+
+static size_t uSdlog_ioRead(void *ctx, const char *path, uint32_t offset, uint8_t *buf, size_t len)
+{
+  (void)ctx;
+  File fl = SD.open(path, FILE_READ);
+  if (!fl || !fl.seek(offset))
+  {
+    return 0;
+  }
+  size_t got = fl.read(buf, len);
+  fl.close();
+  return got;
+}
+
+static bool bSdlog_ioWriteAt(void *ctx, const char *path, uint32_t offset, const uint8_t *data, size_t len)
+{
+  (void)ctx;
+  File fl = SD.open(path, SD.exists(path) ? "r+" : FILE_WRITE);
+  if (!fl || !fl.seek(offset))
+  {
+    return false;
+  }
+  bool ok = (fl.write(data, len) == len);
+  fl.close();
+  return ok;
+}
+
+static bool bSdlog_ioTruncate(void *ctx, const char *path, uint32_t len)
+{
+  (void)ctx;
+  return bSdlog_truncate(path, len);
+}
+
+static bool bSdlog_ioRemove(void *ctx, const char *path)
+{
+  (void)ctx;
+  return SD.remove(path);
+}
+
+/**************************************************************
+ * @brief cut the day files a reset left preallocated to their
+ *        data end
+ *************************************************************/
+static void vSdlog_cutPreallocated(void)
+{
+  if (!SD.exists(SDLOG_PREALLOC_PATH))
+  {
+    return;
+  }
+
+  char list[SDLOG_CHANNEL_MAX * (SDLOG_PATH_LEN + SDLOG_LINE_END_LEN)];
+  File marker = SD.open(SDLOG_PREALLOC_PATH, FILE_READ);
+  size_t listLen = marker ? marker.read((uint8_t *)list, sizeof(list) - 1) : 0;
+  marker.close();
+  list[listLen] = '\0';
+
+  char *save = NULL;
+  for (char *path = strtok_r(list, SDLOG_LINE_END, &save); path != NULL; path = strtok_r(NULL, SDLOG_LINE_END, &save))
+  {
+    size_t pathLen = strlen(path);
+    size_t extLen = strlen(sdlog[SDLOG_CHANNEL_BIN].extension);
+    bool binary = (pathLen > extLen) && (strcmp(path + pathLen - extLen, sdlog[SDLOG_CHANNEL_BIN].extension) == 0);
+
+    File fl = SD.open(path, FILE_READ);
+    if (!fl)
+    {
+      continue;
+    }
+    size_t fileLen = fl.size();
+    size_t dataEnd = uSdlog_dataEnd(fl, binary);
+    uint8_t header[LOG_BIN_HEADER_LEN];
+    bool haveHeader = binary && fl.seek(0) && (fl.read(header, sizeof(header)) == sizeof(header));
+    fl.close();
+
+    if (dataEnd < fileLen)
+    {
+      log_w("SD log: %s left preallocated, cut %u -> %u bytes", path, (unsigned)fileLen, (unsigned)dataEnd);
+      bSdlog_truncate(path, dataEnd);
+    }
+    if (haveHeader && (ulLogCodec_binDataEnd(header) != dataEnd))
+    {
+      vLogCodec_setBinDataEnd(header, (uint32_t)dataEnd);
+      bSdlog_ioWriteAt(NULL, path, 0, header, sizeof(header));
+    }
+  }
+  SD.remove(SDLOG_PREALLOC_PATH);
+}
+
+/********************************************************
+ * @brief power-loss recovery of the last journaled write
+ ********************************************************/
+void vHalSdlog_recover(void)
+{
+  static const log_journal_io_t io = {
+      .ctx = NULL,
+      .size = lSdlog_ioSize,
+      .read = uSdlog_ioRead,
+      .writeAt = bSdlog_ioWriteAt,
+      .truncate = bSdlog_ioTruncate,
+      .remove = bSdlog_ioRemove,
+  };
+
+  vSdlog_lock();
+  unsigned long startMs = millis();
+  log_journal_recovery_t outcome = tLogJournal_recover(&io, SDLOG_JOURNAL_PATH, journalScratch, sizeof(journalScratch));
+  if (outcome != LOG_JOURNAL_FAILED)
+  {
+    vSdlog_cutPreallocated(); // after the replay, which may write into the preallocated space
+  }
+  vSdlog_unlock();
+
+  switch (outcome)
+  {
+  case LOG_JOURNAL_CLEAN:
+    log_d("SD log journal clean");
+    break;
+  case LOG_JOURNAL_DISCARDED:
+    log_w("SD log: torn journal record dropped, log files were not touched (%lu ms)", millis() - startMs);
+    break;
+  case LOG_JOURNAL_REPLAYED:
+    log_w("SD log: interrupted write replayed from the journal (%lu ms)", millis() - startMs);
+    break;
+  default:
+    log_e("SD log journal recovery failed, retrying on next boot");
+    break;
+  }
+}
+
+/********************************************************
+ * @brief build the daily file path of a channel
+ *
+ * @param channel
+ * @param timeInfo
+ * @param path
+ ********************************************************/
+void vHalSdlog_dayPath(sdlog_channel_t channel, const struct tm *timeInfo, char *path)
+{
+  snprintf(path, SDLOG_PATH_LEN, "/%04d/%02d/%02d%s", timeInfo->tm_year + BASE_YEAR_OFFSET,
+           timeInfo->tm_mon + MONTH_OFFSET, timeInfo->tm_mday, sdlog[channel].extension);
+}
+
+/**************************************************************
+ * @brief buffer @p len bytes plus an optional terminator for
+ *        the day of @p timeInfo
+ *************************************************************/
+static bool bSdlog_appendLocked(sdlog_state_t *log, const struct tm *timeInfo, const void *data, size_t len,
+                                const char *terminator, size_t terminatorLen)
+{
+  bool ok = true;
+
+  // Day rollover: flush and close the previous file, forget its directories
+  if ((timeInfo->tm_year != log->year) || (timeInfo->tm_mon != log->month) || (timeInfo->tm_mday != log->day))
+  {
+    vSdlog_closeDay(log);
+    if (log->used > 0)
+    {
+      log_e("Dropping %u unwritten bytes of %s", (unsigned)log->used, log->path);
+      log->used = 0;
+    }
+    log->pendingCount = 0;
+    log->sinceIndex = 0;
+    log->year = timeInfo->tm_year;
+    log->month = timeInfo->tm_mon;
+    log->day = timeInfo->tm_mday;
+    log->dirsReady = false;
+    vHalSdlog_dayPath((sdlog_channel_t)(log - sdlog), timeInfo, log->path);
+    log_i("Daily log file: %s", log->path);
+  }
+
+  // Header handling needs the file state, so make sure it is open
+  ok = bSdlog_openDay(log);
+
+  if (ok)
+  {
+    if ((log->used + len + terminatorLen) > SDLOG_BUFFER_SIZE)
+    {
+      ok = bSdlog_writeOut(log, log->used);
+    }
+  }
+
+  if (ok)
+  {
+    if (log->used == 0)
+    {
+      log->oldestLineMs = millis();
+    }
+
+    if (log->sinceIndex == 0)
+    {
+      if (log->pendingCount == SDLOG_INDEX_PENDING)
+      {
+        vSdlog_writeIndex(log);
+      }
+      sdlog_index_entry_t *entry = &log->pendingIndex[log->pendingCount++];
+      entry->minuteOfDay = (uint16_t)((timeInfo->tm_hour * MINUTES_PER_HOUR) + timeInfo->tm_min);
+      entry->reserved = 0;
+      entry->offset = (uint32_t)(log->fileBytes + log->used);
+    }
+    log->sinceIndex = (log->sinceIndex + 1) % SDLOG_INDEX_STRIDE;
+
+    memcpy(log->buffer + log->used, data, len);
+    if (terminatorLen > 0)
+    {
+      memcpy(log->buffer + log->used + len, terminator, terminatorLen);
+    }
+    log->used += len + terminatorLen;
+    log->stats.records++;
+
+    // Only whole sectors go out on the size trigger; the tail waits for more lines
+    if (log->used >= SDLOG_BLOCK_SIZE)
+    {
+      ok = bSdlog_writeOut(log, log->used - (log->used % SDLOG_BLOCK_SIZE));
+    }
+  }
+
+  return ok;
+}
+
+/********************************************************
+ * @brief append one line to the daily log of its timestamp
+ *
+ * @param channel
+ * @param timeInfo
+ * @param line
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdlog_append(sdlog_channel_t channel, const struct tm *timeInfo, const char *line)
+{
+  size_t lineLen = strlen(line);
+
+  if ((lineLen + SDLOG_LINE_END_LEN) > SDLOG_BUFFER_SIZE)
+  {
+    log_e("SD log line too long (%u bytes)", (unsigned)lineLen);
+    return false;
+  }
+
+  vSdlog_lock();
+  bool ok = bSdlog_appendLocked(&sdlog[channel], timeInfo, line, lineLen, SDLOG_LINE_END, SDLOG_LINE_END_LEN);
+  vSdlog_unlock();
+  return ok;
+}
+
+/********************************************************
+ * @brief append one fixed-size binary record
+ *
+ * @param channel
+ * @param timeInfo
+ * @param record
+ * @param len
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdlog_appendRecord(sdlog_channel_t channel, const struct tm *timeInfo, const void *record, size_t len)
+{
+  if (len > SDLOG_BUFFER_SIZE)
+  {
+    log_e("SD log record too long (%u bytes)", (unsigned)len);
+    return false;
+  }
+
+  vSdlog_lock();
+  bool ok = bSdlog_appendLocked(&sdlog[channel], timeInfo, record, len, NULL, 0);
+  vSdlog_unlock();
+  return ok;
+}
+
+/********************************************************
+ * @brief write out buffered lines of all channels
+ *
+ * @param closeFile
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdlog_flush(bool closeFile)
+{
+  bool flushed = true;
+
+  vSdlog_lock();
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    vSdlog_flushLocked(&sdlog[ch], closeFile);
+    flushed = flushed && (sdlog[ch].used == 0); // a failed block write keeps its bytes in the buffer
+  }
+  vSdlog_unlock();
+  return flushed;
+}
+
+/********************************************************
+ * @brief timer driven flush, call periodically
+ ********************************************************/
+void vHalSdlog_poll(void)
+{
+  vSdlog_lock();
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    sdlog_state_t *log = &sdlog[ch];
+    if ((log->used > 0) && ((millis() - log->oldestLineMs) >= SDLOG_FLUSH_INTERVAL_MS))
+    {
+      log_d("SD log timer flush (%s, %u bytes)", log->extension, (unsigned)log->used);
+      vSdlog_flushLocked(log, false);
+      log_i("SD log %s: %lu records, %lu bytes, %lu fs ops (%.2f per record), %lu block writes, %lu errors",
+            log->extension, (unsigned long)log->stats.records, (unsigned long)log->stats.bytesWritten,
+            (unsigned long)log->stats.fsOps,
+            (log->stats.records > 0) ? ((float)log->stats.fsOps / log->stats.records) : 0.0f,
+            (unsigned long)log->stats.blockWrites, (unsigned long)log->stats.errors);
+    }
+  }
+  vSdlog_unlock();
+}
+
+/********************************************************
+ * @brief forget cached file/directory state
+ ********************************************************/
+void vHalSdlog_invalidate(void)
+{
+  vSdlog_lock();
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    if (sdlog[ch].fileOpen)
+    {
+      sdlog[ch].file.close();
+      sdlog[ch].fileOpen = false;
+    }
+    sdlog[ch].dirsReady = false;
+  }
+  vSdlog_unlock();
+}
+
+/**************************************************************
+ * @brief hand a line collected back-to-front to the visitor
+ *************************************************************/
+static bool bSdlog_emitReversed(const char *rev, size_t len, sdlog_line_cb_t cb, void *ctx)
+{
+  char line[SDLOG_READ_LINE_MAX + 1];
+  for (size_t i = 0; i < len; i++)
+  {
+    line[i] = rev[len - 1 - i];
+  }
+  line[len] = '\0';
+  return cb(line, ctx);
+}
+
+/********************************************************
+ * @brief iterate the lines of a log newest first
+ *
+ * @param path
+ * @param cb
+ * @param ctx
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdlog_readLinesNewestFirst(const char *path, sdlog_line_cb_t cb, void *ctx)
+{
+  // Lines of the open day may still sit in the buffer
+  vSdlog_lock();
+  for (int ch = 0; ch < SDLOG_CHANNEL_MAX; ch++)
+  {
+    if (sdlog[ch].fileOpen && (strcmp(path, sdlog[ch].path) == 0))
+    {
+      vSdlog_flushLocked(&sdlog[ch], false);
+    }
+  }
+  vSdlog_unlock();
+
+  File fl = SD.open(path, FILE_READ);
+  if (!fl)
+  {
+    log_e("Failed to open %s for reading", path);
+    return false;
+  }
+
+  char chunk[SDLOG_BLOCK_SIZE];
+  char rev[SDLOG_READ_LINE_MAX];
+  size_t revLen = 0;
+  bool truncated = false;
+  bool keepGoing = true;
+  bool readOk = true;
+  size_t pos = uSdlog_dataEnd(fl, false);
+
+  while ((pos > 0) && keepGoing)
+  {
+    size_t chunkLen = (pos > sizeof(chunk)) ? sizeof(chunk) : pos;
+    pos -= chunkLen;
+    fl.seek(pos);
+    if (fl.read((uint8_t *)chunk, chunkLen) != chunkLen)
+    {
+      log_e("Read error in %s at %u", path, (unsigned)pos);
+      readOk = false;
+      break;
+    }
+
+    for (size_t i = chunkLen; (i > 0) && keepGoing; i--)
+    {
+      char c = chunk[i - 1];
+      if (c == '\n')
+      {
+        if (revLen > 0)
+        {
+          if (truncated)
+          {
+            log_w("Skipping over-long line in %s", path);
+          }
+          else
+          {
+            keepGoing = bSdlog_emitReversed(rev, revLen, cb, ctx);
+          }
+        }
+        revLen = 0;
+        truncated = false;
+      }
+      else if (c != '\r')
+      {
+        if (revLen < sizeof(rev))
+        {
+          rev[revLen++] = c;
+        }
+        else
+        {
+          truncated = true;
+        }
+      }
+    }
+  }
+
+  // First line of the file (normally the header)
+  if (readOk && keepGoing && (revLen > 0) && !truncated)
+  {
+    bSdlog_emitReversed(rev, revLen, cb, ctx);
+  }
+
+  fl.close();
+  return readOk;
+}
+
+/**************************************************************
+ * @brief offset of the last indexed record before @p fromMinute,
+ *        0 when the day has no (usable) index
+ *************************************************************/
+static uint32_t ulSdlog_indexLookup(const char *path, int fromMinute)
+{
+  char idxPath[SDLOG_INDEX_PATH_LEN];
+  snprintf(idxPath, sizeof(idxPath), "%s" SDLOG_INDEX_EXTENSION, path);
+
+  File idx = SD.open(idxPath, FILE_READ);
+  if (!idx)
+  {
+    return 0;
+  }
+
+  sdlog_index_entry_t entries[SDLOG_BLOCK_SIZE / sizeof(sdlog_index_entry_t)];
+  uint32_t offset = 0;
+  bool done = false;
+  size_t got;
+  while (!done && ((got = idx.read((uint8_t *)entries, sizeof(entries))) >= sizeof(sdlog_index_entry_t)))
+  {
+    for (size_t i = 0; i < (got / sizeof(sdlog_index_entry_t)); i++)
+    {
+      // Strictly before: earlier records of the same minute may precede the entry
+      if (entries[i].minuteOfDay >= fromMinute)
+      {
+        done = true;
+        break;
+      }
+      offset = entries[i].offset;
+    }
+  }
+  idx.close();
+  return offset;
+}
+
+typedef enum
+{
+  SDLOG_VISIT_NEXT = 0,     /*!< keep reading */
+  SDLOG_VISIT_END_OF_RANGE, /*!< past the day's range, next day */
+  SDLOG_VISIT_STOP          /*!< visitor asked to stop */
+} sdlog_visit_t;
+
+/**************************************************************
+ * @brief hand one record to the visitor if it is in range
+ *************************************************************/
+static sdlog_visit_t tSdlog_visit(const struct tm *timeInfo, uint8_t flags, const send_data_t *data,
+                        int fromMinute, int toMinute, sdlog_record_cb_t cb, void *ctx)
+{
+  int minute = (timeInfo->tm_hour * MINUTES_PER_HOUR) + timeInfo->tm_min;
+  if (minute < fromMinute)
+  {
+    return SDLOG_VISIT_NEXT;
+  }
+  if (minute > toMinute)
+  {
+    return SDLOG_VISIT_END_OF_RANGE; // day files are chronological
+  }
+  return cb(timeInfo, flags, data, ctx) ? SDLOG_VISIT_NEXT : SDLOG_VISIT_STOP;
+}
+
+/**************************************************************
+ * @brief stream the in-range records of one binary day file
+ *************************************************************/
+static bool bSdlog_queryBinDay(File &fl, uint32_t start, int fromMinute, int toMinute, sdlog_record_cb_t cb, void *ctx)
+{
+  uint8_t header[LOG_BIN_HEADER_LEN];
+  struct tm day;
+  if ((fl.read(header, sizeof(header)) != sizeof(header)) || !bLogCodec_parseBinHeader(header, sizeof(header), &day))
+  {
+    log_e("Unknown binary log layout: %s", fl.path());
+    return true;
+  }
+
+  uint32_t pos = (start > LOG_BIN_HEADER_LEN) ? start : LOG_BIN_HEADER_LEN;
+  uint32_t dataEnd = ulLogCodec_binDataEnd(header);
+  fl.seek(pos);
+
+  log_bin_record_t records[SDLOG_QUERY_RECORDS];
+  size_t got;
+  while ((got = fl.read((uint8_t *)records, sizeof(records))) >= sizeof(log_bin_record_t))
+  {
+    for (size_t i = 0; i < (got / sizeof(log_bin_record_t)); i++, pos += sizeof(log_bin_record_t))
+    {
+      if ((pos >= dataEnd) && bLogCodec_binRecordBlank(&records[i]))
+      {
+        return true; // preallocated space of the open day
+      }
+      struct tm timeInfo;
+      send_data_t data;
+      uint8_t flags;
+      vLogCodec_decodeBin(&records[i], &day, &timeInfo, &flags, &data);
+      sdlog_visit_t res = tSdlog_visit(&timeInfo, flags, &data, fromMinute, toMinute, cb, ctx);
+      if (res != SDLOG_VISIT_NEXT)
+      {
+        return (res == SDLOG_VISIT_END_OF_RANGE);
+      }
+    }
+  }
+  return true;
+}
+
+/**************************************************************
+ * @brief stream the in-range lines of one CSV day file
+ *************************************************************/
+static bool bSdlog_queryCsvDay(File &fl, uint32_t start, int fromMinute, int toMinute, sdlog_record_cb_t cb, void *ctx)
+{
+  char chunk[SDLOG_BLOCK_SIZE];
+  char line[SDLOG_READ_LINE_MAX + 1];
+  size_t lineLen = 0;
+  bool truncated = false;
+  size_t got;
+
+  fl.seek(start);
+  while ((got = fl.read((uint8_t *)chunk, sizeof(chunk))) > 0)
+  {
+    for (size_t i = 0; i < got; i++)
+    {
+      char c = chunk[i];
+      if (c == '\0')
+      {
+        return true; // preallocated space of the open day
+      }
+      if (c == '\n')
+      {
+        struct tm timeInfo;
+        send_data_t data;
+        uint8_t flags;
+        line[lineLen] = '\0';
+        // Header and damaged lines do not parse and are skipped
+        if (!truncated && bLogCodec_parseCsvLine(line, &timeInfo, &flags, &data))
+        {
+          sdlog_visit_t res = tSdlog_visit(&timeInfo, flags, &data, fromMinute, toMinute, cb, ctx);
+          if (res != SDLOG_VISIT_NEXT)
+          {
+            return (res == SDLOG_VISIT_END_OF_RANGE);
+          }
+        }
+        lineLen = 0;
+        truncated = false;
+      }
+      else if (c != '\r')
+      {
+        if (lineLen < SDLOG_READ_LINE_MAX)
+        {
+          line[lineLen++] = c;
+        }
+        else
+        {
+          truncated = true;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/********************************************************
+ * @brief stream the records logged between two instants
+ *
+ * @param channel
+ * @param from
+ * @param to
+ * @param cb
+ * @param ctx
+ * @return true
+ * @return false
+ ********************************************************/
+bool bHalSdlog_queryRange(sdlog_channel_t channel, const struct tm *from, const struct tm *to, sdlog_record_cb_t cb, void *ctx)
+{
+  if (lSdlog_dayKey(from) > lSdlog_dayKey(to))
+  {
+    return false;
+  }
+
+  // Noon keeps the day walk clear of DST transitions
+  struct tm day = *from;
+  day.tm_hour = 12;
+  day.tm_min = 0;
+  day.tm_sec = 0;
+  day.tm_isdst = -1;
+  mktime(&day);
+
+  bool keepGoing = true;
+  while (keepGoing && (lSdlog_dayKey(&day) <= lSdlog_dayKey(to)))
+  {
+    int fromMinute = (lSdlog_dayKey(&day) == lSdlog_dayKey(from)) ? ((from->tm_hour * MINUTES_PER_HOUR) + from->tm_min) : 0;
+    int toMinute = (lSdlog_dayKey(&day) == lSdlog_dayKey(to)) ? ((to->tm_hour * MINUTES_PER_HOUR) + to->tm_min) : (MINUTES_PER_DAY - 1);
+    char path[SDLOG_PATH_LEN];
+    vHalSdlog_dayPath(channel, &day, path);
+
+    // Held for the whole day so the writer cannot append or cut the files under the reader
+    vSdlog_lock();
+
+    // Records of the open day may still sit in the buffer
+    if (sdlog[channel].fileOpen && (strcmp(path, sdlog[channel].path) == 0))
+    {
+      vSdlog_flushLocked(&sdlog[channel], false);
+    }
+
+    File fl = SD.open(path, FILE_READ);
+    if (fl)
+    {
+      uint32_t start = ulSdlog_indexLookup(path, fromMinute);
+      if (start >= fl.size())
+      {
+        start = 0; // stale index (card swapped or tail lost): scan from the top
+      }
+      keepGoing = (channel == SDLOG_CHANNEL_BIN) ? bSdlog_queryBinDay(fl, start, fromMinute, toMinute, cb, ctx)
+                                                 : bSdlog_queryCsvDay(fl, start, fromMinute, toMinute, cb, ctx);
+      fl.close();
+    }
+    vSdlog_unlock();
+
+    day.tm_mday++;
+    day.tm_hour = 12;
+    day.tm_isdst = -1;
+    mktime(&day);
+  }
+
+  return true;
+}
+
+/********************************************************
+ * @brief copy the writer counters
+ *
+ * @param channel
+ * @param stats
+ ********************************************************/
+void vHalSdlog_getStats(sdlog_channel_t channel, sdlog_stats_t *stats)
+{
+  vSdlog_lock();
+  *stats = sdlog[channel].stats;
+  vSdlog_unlock();
+}
+
+//************************************** EOF **************************************
@@ -0,0 +1,183 @@
+/******************************************************************************************************
+ * @file    sdlog.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Buffered daily log writer for the Milano Smart Park project
+ * @details Keeps the current day's log file open and its directories known, collects
+ *          lines in a sector-sized buffer and writes them out on size, timer or day
+ *          rollover. Replaces the exists/mkdir/open/write/close sequence per record.
+ *          One writer per channel, so CSV and binary days can be kept side by side.
+ * @version 0.1
+ * @date    2025-09-04
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *****************************************************************************************************/
+
+#ifndef SDLOG_H
+#define SDLOG_H
+
+// -- includes --
+#include <Arduino.h>
+#include <time.h>
+#include "log_codec.h"
+
+#define SDLOG_BLOCK_SIZE 512                    /*!< SD sector size, write granularity */
+#define SDLOG_FLUSH_INTERVAL_MS (10 * 60 * 1000) /*!< max age of buffered lines */
+#define SDLOG_PATH_LEN 32
+#define SDLOG_INDEX_STRIDE 16   /*!< records between two index entries */
+#define SDLOG_INDEX_EXTENSION ".idx"
+#define SDLOG_MOUNT_POINT "/sd"          /*!< VFS mount point passed to SD.begin(), prefixes POSIX paths */
+#define SDLOG_SPI_FREQUENCY 4000000      /*!< SD.begin() default, stated because the mount point follows it */
+#define SDLOG_JOURNAL_PATH "/sdlog.jnl" /*!< write-ahead record of the block being written */
+#define SDLOG_PREALLOC_PATH "/sdlog.pre"  /*!< day files holding preallocated space, cut at recovery */
+#define SDLOG_PREALLOC_CSV_BYTES (64 * 1024) /*!< CSV day file preallocation before a day's size is known */
+#define SDLOG_PREALLOC_BIN_BYTES (16 * 1024) /*!< binary day file preallocation before a day's size is known */
+#define SDLOG_PREALLOC_MAX_BYTES (512 * 1024) /*!< cap of the preallocation sized from the previous day */
+
+typedef enum __SDLOG_CHANNEL__
+{
+  SDLOG_CHANNEL_CSV = 0, /*!< /YYYY/MM/DD.csv, CSV_HEADER lines */
+  SDLOG_CHANNEL_BIN,     /*!< /YYYY/MM/DD.bin, log_bin_record_t records */
+  SDLOG_CHANNEL_MAX
+} sdlog_channel_t;
+
+typedef struct __SDLOG_STATS__
+{
+  uint32_t records;      /*!< lines/records appended */
+  uint32_t fsOps;        /*!< filesystem calls issued (exists, mkdir, open, write, flush, close) */
+  uint32_t bytesWritten; /*!< bytes handed to the file */
+  uint32_t blockWrites;  /*!< buffer write-outs */
+  uint32_t dayOpens;     /*!< daily files opened */
+  uint32_t errors;       /*!< failed opens/writes */
+  uint32_t indexWrites;  /*!< index entries written */
+  uint32_t tornTails;    /*!< partial last lines/records cut after a power loss */
+  uint32_t preallocBytes; /*!< zero bytes written ahead of the data */
+} sdlog_stats_t;
+
+/********************************************************
+ * @brief initialize the log writer
+ ********************************************************/
+void vHalSdlog_init(void);
+
+/********************************************************
+ * @brief power-loss recovery, call once the card is mounted
+ *        and before the first append: replays the block a
+ *        power cut interrupted, or drops its torn journal
+ *        record, then cuts day files left preallocated by a
+ *        reset to their data end
+ ********************************************************/
+void vHalSdlog_recover(void);
+
+/********************************************************
+ * @brief append one line to the daily log of its timestamp
+ *
+ * @param channel  daily file family
+ * @param timeInfo record timestamp, selects /YYYY/MM/DD file
+ * @param line     line without terminator
+ * @return true    line accepted (buffered or written)
+ * @return false   file could not be opened
+ ********************************************************/
+bool bHalSdlog_append(sdlog_channel_t channel, const struct tm *timeInfo, const char *line);
+
+/********************************************************
+ * @brief append one fixed-size binary record
+ *
+ * @param channel  daily file family
+ * @param timeInfo record timestamp, selects /YYYY/MM/DD file
+ * @param record   record bytes
+ * @param len      record size
+ * @return true    record accepted (buffered or written)
+ * @return false   file could not be opened
+ ********************************************************/
+bool bHalSdlog_appendRecord(sdlog_channel_t channel, const struct tm *timeInfo, const void *record, size_t len);
+
+/********************************************************
+ * @brief build the daily file path of a channel
+ *
+ * @param channel  daily file family
+ * @param timeInfo day
+ * @param path     output, SDLOG_PATH_LEN bytes
+ ********************************************************/
+void vHalSdlog_dayPath(sdlog_channel_t channel, const struct tm *timeInfo, char *path);
+
+/********************************************************
+ * @brief write out buffered lines of all channels
+ *
+ * @param closeFile also close the cached file handles
+ * @return true  nothing left in the buffers, every block
+ *               written and synced to the card
+ * @return false a block write failed, its lines are still
+ *               buffered
+ ********************************************************/
+bool bHalSdlog_flush(bool closeFile);
+
+/********************************************************
+ * @brief timer driven flush, call periodically
+ ********************************************************/
+void vHalSdlog_poll(void);
+
+/********************************************************
+ * @brief forget cached file/directory state (card removed
+ *        or re-initialized); buffered lines are kept
+ ********************************************************/
+void vHalSdlog_invalidate(void);
+
+/********************************************************
+ * @brief line visitor for bHalSdlog_readLinesNewestFirst
+ *
+ * @param line NUL terminated line without terminator
+ * @param ctx  caller context
+ * @return false to stop the iteration
+ ********************************************************/
+typedef bool (*sdlog_line_cb_t)(const char *line, void *ctx);
+
+/********************************************************
+ * @brief iterate the lines of an append-only log from the
+ *        end of the file (newest first), reading it backwards
+ *        in sector-sized chunks; the header comes last
+ *
+ * @param path file to read
+ * @param cb   line visitor
+ * @param ctx  visitor context
+ * @return true  file read (or iteration stopped by cb)
+ * @return false file could not be opened or read to its start
+ ********************************************************/
+bool bHalSdlog_readLinesNewestFirst(const char *path, sdlog_line_cb_t cb, void *ctx);
+
+/********************************************************
+ * @brief record visitor for bHalSdlog_queryRange; runs
+ *        with the log writer locked, so it must not log
+ *
+ * @param timeInfo record timestamp
+ * @param flags    LOG_BIN_FLAG_* present columns
+ * @param data     values
+ * @param ctx      caller context
+ * @return false to stop the query
+ ********************************************************/
+typedef bool (*sdlog_record_cb_t)(const struct tm *timeInfo, uint8_t flags, const send_data_t *data, void *ctx);
+
+/********************************************************
+ * @brief stream the records logged between two instants
+ *        (inclusive, minute resolution, local time); each
+ *        day seeks through its sparse .idx file and reads
+ *        sector-sized chunks, nothing is kept in memory
+ *
+ * @param channel daily file family to read
+ * @param from    first minute
+ * @param to      last minute
+ * @param cb      record visitor
+ * @param ctx     visitor context
+ * @return true   range scanned (or stopped by cb)
+ * @return false  invalid range
+ ********************************************************/
+bool bHalSdlog_queryRange(sdlog_channel_t channel, const struct tm *from, const struct tm *to, sdlog_record_cb_t cb, void *ctx);
+
+/********************************************************
+ * @brief copy the writer counters
+ *
+ * @param channel daily file family
+ * @param stats   destination
+ ********************************************************/
+void vHalSdlog_getStats(sdlog_channel_t channel, sdlog_stats_t *stats);
+
+#endif
@@ -14,6 +14,7 @@
 #include <stdio.h>
 #include "config.h"
 #include "generic_functions.h"
+#include "mspOs.h"
 #include <MiCS6814-I2C.h>
 #include "sensors.h"
 #include <stdbool.h>
@@ -89,6 +90,7 @@ mspStatus_t tHalSensor_isAnalogO3Connected()
  ********************************************************************/
 void vHalSensor_writeMicsValues(sensorData_t *p_tData)
 {
+  vMspOs_takeI2cBus(I2C_DEV_MICS6814);
   Wire.beginTransmission(DATA_I2C_ADDR);
   Wire.write(CMD_V2_SET_R0);
   Wire.write(p_tData->pollutionData.sensingResInAir.nh3Sensor >> 8); // NH3
@@ -98,6 +100,7 @@ void vHalSensor_writeMicsValues(sensorData_t *p_tData)
   Wire.write(p_tData->pollutionData.sensingResInAir.oxSensor >> 8); // OX
   Wire.write(p_tData->pollutionData.sensingResInAir.oxSensor & 0xFF);
   Wire.endTransmission();
+  vMspOs_giveI2cBus(I2C_DEV_MICS6814);
 }
 
 /**********************************************************
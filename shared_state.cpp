@@ -0,0 +1,193 @@
+/***********************************************************************************************
+ * @file    shared_state.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   state shared between tasks for the Milano Smart Park project
+ * @details Sequence-locked double buffers replacing the global data access mutex.
+ * @version 0.1
+ * @date    2025-10-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ***********************************************************************************************/
+
+// -- includes --
+#include "shared_state.h"
+
+// -- network status domain
+static networkStatus_t networkStatusSlots[2];
+static sharedState_t networkStatusState = SHARED_STATE_INITIALIZER("network status", networkStatusSlots[0], networkStatusSlots[1]);
+
+/**********************************************************
+ * @brief  Starts a write: takes the writer spinlock and
+ *         returns the back slot holding a copy of the
+ *         published state, to be changed in place. Keep
+ *         the update short and free of blocking calls,
+ *         then call vSharedState_endWrite().
+ *
+ * @param state
+ * @return void* back slot
+ **********************************************************/
+void *pvSharedState_beginWrite(sharedState_t *state)
+{
+    portENTER_CRITICAL(&state->writeMux);
+    uint32_t seq = state->seq;
+    void *back = state->slot[(seq + 1) & 1];
+    memcpy(back, state->slot[seq & 1], state->size);
+    return back;
+}
+
+/**********************************************************
+ * @brief  Publishes the back slot filled since
+ *         pvSharedState_beginWrite().
+ *
+ * @param state
+ **********************************************************/
+void vSharedState_endWrite(sharedState_t *state)
+{
+    // the slot contents are visible before the new sequence
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&state->writeMux);
+}
+
+/**********************************************************
+ * @brief  Publishes a whole new state.
+ *
+ * @param state
+ * @param data  state->size bytes
+ **********************************************************/
+void vSharedState_write(sharedState_t *state, const void *data)
+{
+    portENTER_CRITICAL(&state->writeMux);
+    memcpy(state->slot[(state->seq + 1) & 1], data, state->size);
+    __atomic_store_n(&state->seq, state->seq + 1, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&state->writeMux);
+}
+
+/**********************************************************
+ * @brief  Copies the published slot. A write in progress
+ *         fills the other slot and does not disturb the
+ *         copy; only a write published during the copy
+ *         can have reused this slot, and then the copy is
+ *         repeated.
+ *
+ * @param state
+ * @param data
+ * @return uint32_t sequence of the copy
+ **********************************************************/
+static uint32_t uSharedState_copy(sharedState_t *state, void *data, uint32_t *retries)
+{
+    for (;;)
+    {
+        uint32_t seq = __atomic_load_n(&state->seq, __ATOMIC_ACQUIRE);
+        memcpy(data, state->slot[seq & 1], state->size);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&state->seq, __ATOMIC_RELAXED) == seq)
+        {
+            return seq;
+        }
+        (*retries)++;
+    }
+}
+
+/**********************************************************
+ * @brief  Accounts one read and reports the domain read
+ *         latency once a minute.
+ *
+ * @param state
+ * @param startUs
+ * @param retries
+ **********************************************************/
+static void vSharedState_countRead(sharedState_t *state, unsigned long startUs, uint32_t retries)
+{
+    uint32_t took = micros() - startUs;
+    bool report = false;
+    uint32_t reads = 0, readUs = 0, maxReadUs = 0, allRetries = 0, writes = 0;
+    unsigned long elapsed = 0;
+
+    portENTER_CRITICAL(&state->statsMux);
+    state->reads++;
+    state->retries += retries;
+    state->readUs += took;
+    if (took > state->maxReadUs)
+    {
+        state->maxReadUs = took;
+    }
+    elapsed = millis() - state->statsStart;
+    if (elapsed >= SHARED_STATE_STATS_PERIOD_MS)
+    {
+        report = true;
+        reads = state->reads;
+        readUs = state->readUs;
+        maxReadUs = state->maxReadUs;
+        allRetries = state->retries;
+        writes = __atomic_load_n(&state->seq, __ATOMIC_RELAXED) - state->statsSeq;
+        state->statsSeq += writes;
+        state->reads = 0;
+        state->readUs = 0;
+        state->maxReadUs = 0;
+        state->retries = 0;
+        state->statsStart = millis();
+    }
+    portEXIT_CRITICAL(&state->statsMux);
+
+    if (report)
+    {
+        log_d("Shared %s: %lu writes, %lu reads in %lu s, read avg %lu us max %lu us, %lu retries", state->name,
+              (unsigned long)writes, (unsigned long)reads, elapsed / 1000, (unsigned long)(readUs / reads),
+              (unsigned long)maxReadUs, (unsigned long)allRetries);
+    }
+}
+
+/**********************************************************
+ * @brief  Copies the latest published state.
+ *
+ * @param state
+ * @param data  state->size bytes
+ * @return uint32_t sequence of the copy
+ **********************************************************/
+uint32_t uSharedState_read(sharedState_t *state, void *data)
+{
+    unsigned long startUs = micros();
+    uint32_t retries = 0;
+    uint32_t seq = uSharedState_copy(state, data, &retries);
+    vSharedState_countRead(state, startUs, retries);
+    return seq;
+}
+
+/**********************************************************
+ * @brief  Copies the latest state if it changed since @p seq
+ *
+ * @param state
+ * @param data  state->size bytes
+ * @param seq   sequence of the copy in @p data, updated
+ * @return true a newer state was copied
+ **********************************************************/
+bool bSharedState_readIfChanged(sharedState_t *state, void *data, uint32_t *seq)
+{
+    if (__atomic_load_n(&state->seq, __ATOMIC_ACQUIRE) == *seq)
+    {
+        return false;
+    }
+    *seq = uSharedState_read(state, data);
+    return true;
+}
+
+/**********************************************************
+ * @brief  Publishes the network task status.
+ *
+ * @param stat
+ **********************************************************/
+void vSharedState_publishNetworkStatus(const networkStatus_t *stat)
+{
+    vSharedState_write(&networkStatusState, stat);
+}
+
+/**********************************************************
+ * @brief  Copies the last published network status.
+ *
+ * @param stat
+ **********************************************************/
+void vSharedState_readNetworkStatus(networkStatus_t *stat)
+{
+    uSharedState_read(&networkStatusState, stat);
+}
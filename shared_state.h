@@ -0,0 +1,68 @@
+/********************************************************
+ * @file    shared_state.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   state shared between tasks for the Milano Smart Park project
+ * @details Each domain is a sequence-locked double buffer: a write fills
+ *          the slot readers are not using and then bumps the sequence,
+ *          a read copies the published slot and retries if the sequence
+ *          moved meanwhile. Readers never wait for a writer, writers never
+ *          wait for a reader; concurrent writers of one domain are
+ *          serialized by a spinlock held for the copy only.
+ *          Only trivially copyable structures can be shared this way.
+ * @version 0.1
+ * @date    2025-10-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ********************************************************/
+
+#ifndef SHARED_STATE_H
+#define SHARED_STATE_H
+
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+
+#define SHARED_STATE_STATS_PERIOD_MS 60000
+
+// -- one shared domain; define it with SHARED_STATE_INITIALIZER
+typedef struct _SHARED_STATE_
+{
+    const char *name;
+    void *slot[2];           // the published one is slot[seq & 1]
+    size_t size;
+    uint32_t seq;            // bumped once per write
+    portMUX_TYPE writeMux;   // writers of the domain, held while filling the back slot
+    portMUX_TYPE statsMux;
+    uint32_t statsSeq;       // sequence when the stats period started
+    uint32_t reads;
+    uint32_t retries;        // reads repeated because a write was published meanwhile
+    uint32_t readUs;
+    uint32_t maxReadUs;
+    unsigned long statsStart;
+} sharedState_t;
+
+#define SHARED_STATE_INITIALIZER(label, slotA, slotB) \
+    {(label), {&(slotA), &(slotB)}, sizeof(slotA), 0, portMUX_INITIALIZER_UNLOCKED, portMUX_INITIALIZER_UNLOCKED, 0, 0, 0, 0, 0, 0}
+
+// -- network task status, published by the network task
+typedef struct _NETWORK_STATUS_
+{
+    bool taskRunning;
+    bool wifiConnected;
+    bool gsmConnected;
+    bool internetConnected;
+    bool timeSync;
+} networkStatus_t;
+
+// Generic domain access
+void *pvSharedState_beginWrite(sharedState_t *state);
+void vSharedState_endWrite(sharedState_t *state);
+void vSharedState_write(sharedState_t *state, const void *data);
+uint32_t uSharedState_read(sharedState_t *state, void *data);
+bool bSharedState_readIfChanged(sharedState_t *state, void *data, uint32_t *seq);
+
+// Network status, published by the network task
+void vSharedState_publishNetworkStatus(const networkStatus_t *stat);
+void vSharedState_readNetworkStatus(networkStatus_t *stat);
+
+#endif // SHARED_STATE_H
@@ -16,6 +16,7 @@
 #include <Arduino.h>
 #include <WiFiGeneric.h>
 #include <stdbool.h>
+#include "record_codec.h" // send_data_t
 
 //-- pin defines --
 // O3 sensor ADC pin
@@ -246,21 +247,4 @@ typedef struct __SYSTEMDATA_T__
   int ntp_last_sync_day; // Day of year (0-365) when NTP was last synced
 } systemData_t;
 
-typedef struct __SEND_DATA__
-{
-  tm sendTimeInfo; /*!< Date and time of the data to be sent */
-  float temp;
-  float hum;
-  float pre;
-  float VOC;
-  int32_t PM1;
-  int32_t PM25;
-  int32_t PM10;
-  float MICS_CO;
-  float MICS_NO2;
-  float MICS_NH3;
-  float ozone;
-  int8_t MSP; /*!< MSP# Index */
-} send_data_t;
-
 #endif
\ No newline at end of file
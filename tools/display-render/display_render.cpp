@@ -0,0 +1,504 @@
+/****************************************************
+ * @file    display_render.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host screen renderer of the display task for the Milano Smart Park project
+ * @details Links the firmware's display.cpp and display_task.cpp against
+ *          an in-memory SH1106 (tools/display-render/host) and draws every
+ *          displayEvents_t screen through uTaskDisplay_drawScreen(), the
+ *          measurement carousel page by page. Each screen is dumped as
+ *          PBM/PNG, compared against golden PBMs, and timed; the tiles the
+ *          dirty tile sender puts on the bus are counted against a full
+ *          frame.
+ *
+ *          Build: make display-render   (see tools/display-render/README.md)
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "Arduino.h"
+#include "U8g2lib.h"
+#include "display.h"
+#include "display_task.h"
+#include "mspOs.h"
+
+#define RENDER_TILES_PER_FRAME ((HOST_DISP_WIDTH / 8) * (HOST_DISP_HEIGHT / 8))
+#define RENDER_ROW_BYTES (HOST_DISP_WIDTH / 8)
+#define RENDER_MEAS_PAGES 5
+
+struct ScreenCase
+{
+    displayEvents_t event;
+    const char *name;
+};
+
+#define SCREEN(ev) {DISP_EVENT_##ev, #ev}
+
+// every event of displayEvents_t but WAIT_FOR_EVENT, in enum order
+static const ScreenCase screenCases[] = {
+    SCREEN(DEVICE_BOOT),
+    SCREEN(WIFI_MAC_ADDR),
+    SCREEN(SHOW_MEAS_DATA),
+    SCREEN(SD_CARD_INIT),
+    SCREEN(CONFIG_READ),
+    SCREEN(URL_UPLOAD_STAT),
+    SCREEN(SD_CARD_NOT_PRESENT),
+    SCREEN(SD_CARD_FORMAT),
+    SCREEN(SD_CARD_LOG_ERROR),
+    SCREEN(SD_CARD_CONFIG_CREATE),
+    SCREEN(SD_CARD_CONFIG_ERROR),
+    SCREEN(SD_CARD_CONFIG_INS_DATA),
+    SCREEN(SD_CARD_WRITE_DATA),
+    SCREEN(SD_CARD_SLOW),
+    SCREEN(BME680_SENSOR_INIT),
+    SCREEN(BME680_SENSOR_OKAY),
+    SCREEN(BME680_SENSOR_ERR),
+    SCREEN(PMS5003_SENSOR_INIT),
+    SCREEN(PMS5003_SENSOR_OKAY),
+    SCREEN(PMS5003_SENSOR_ERR),
+    SCREEN(MICS6814_SENSOR_INIT),
+    SCREEN(MICS6814_SENSOR_OKAY),
+    SCREEN(MICS6814_VALUES_OKAY),
+    SCREEN(MICS6814_DEF_SETTING),
+    SCREEN(MICS6814_DONE),
+    SCREEN(MICS6814_SENSOR_ERR),
+    SCREEN(O3_SENSOR_INIT),
+    SCREEN(O3_SENSOR_OKAY),
+    SCREEN(O3_SENSOR_ERR),
+    SCREEN(WAIT_FOR_NETWORK_CONN),
+    SCREEN(NETWORK_CONN_FAIL),
+    SCREEN(READING_SENSORS),
+    SCREEN(WAIT_FOR_TIMEOUT),
+    SCREEN(PREHEAT_STAT),
+    SCREEN(MEAS_IN_PROGRESS),
+    SCREEN(SENDING_MEAS),
+    SCREEN(SYSTEM_ERROR),
+    SCREEN(CONN_TO_WIFI),
+    SCREEN(CONN_TO_GPRS),
+    SCREEN(RETREIVE_DATETIME),
+    SCREEN(DATETIME_OK),
+    SCREEN(DATETIME),
+    SCREEN(DATETIME_ERR),
+    SCREEN(WIFI_CONNECTED),
+    SCREEN(WIFI_DISCONNECTED),
+    SCREEN(SSID_NOT_FOUND),
+    SCREEN(NO_NETWORKS_FOUND),
+    SCREEN(CONN_RETRY),
+    SCREEN(NO_INTERNET),
+    SCREEN(SIM_ERROR),
+    SCREEN(NETWORK_ERROR),
+    SCREEN(GPRS_ERROR),
+};
+
+#define SCREEN_CASES (sizeof(screenCases) / sizeof(screenCases[0]))
+
+struct Options
+{
+    const char *outDir = NULL;
+    const char *goldenDir = NULL;
+    bool updateGolden = false;
+    int iterations = 200;
+};
+
+struct Totals
+{
+    int screens = 0;
+    int blank = 0;
+    int mismatched = 0;
+    int missing = 0;
+    unsigned long tiles = 0;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-o dir] [-g goldendir [-u]] [-n iterations]\n"
+            "  -o dir        write every screen as NN_NAME.pbm and NN_NAME.png\n"
+            "  -g goldendir  compare every screen with goldendir/NN_NAME.pbm\n"
+            "  -u            write the screens to goldendir instead of comparing\n"
+            "  -n count      renders per screen for the timing (default 200)\n",
+            prog);
+}
+
+static void sampleSnapshot(displaySnapshot_t *snap)
+{
+    memset(snap, 0, sizeof(*snap));
+    strlcpy(snap->deviceId, "msp-0042", sizeof(snap->deviceId));
+    snap->sdCard = 1;
+    snap->datetime = 1;
+    snap->connection = 1;
+    snap->useModem = 0;
+
+    strlcpy(snap->fwVersion, "4.0.0", sizeof(snap->fwVersion));
+    strlcpy(snap->baseMac, "24:6F:28:A1:B2:C3", sizeof(snap->baseMac));
+    strlcpy(snap->dateTime, "2025/09/28 14:05:00", sizeof(snap->dateTime));
+    strlcpy(snap->noNet, "NO", sizeof(snap->noNet));
+    strlcpy(snap->remain, "3", sizeof(snap->remain));
+
+    snap->measurementCount = 3;
+    snap->maxMeasurements = 5;
+    snap->delayBetweenMeasurements = 60;
+    snap->timeoutSeconds = 17;
+
+    snap->sensorStat.BME680Sensor = 1;
+    snap->sensorStat.PMS5003Sensor = 1;
+    snap->sensorStat.MICS6814Sensor = 1;
+    snap->sensorStat.MICS4514Sensor = 0;
+    snap->sensorStat.O3Sensor = 1;
+    snap->temperature = 21.37f;
+    snap->humidity = 48.52f;
+    snap->pressure = 1013.25f;
+    snap->voc = 112.40f;
+    snap->pm1 = 4;
+    snap->pm25 = 11;
+    snap->pm10 = 17;
+    snap->co = 0.62f;
+    snap->no2 = 23.10f;
+    snap->nh3 = 5.75f;
+    snap->ozone = 41.80f;
+    snap->msp = 2;
+}
+
+// -- images --
+
+static bool lit(const uint8_t *frame, int x, int y)
+{
+    return (frame[(y / 8) * HOST_DISP_WIDTH + x] >> (y % 8)) & 1;
+}
+
+// P4 bitmap, lit pixels are white (0) as on the panel
+static std::vector<uint8_t> toPbm(const uint8_t *frame)
+{
+    char header[32];
+    int len = snprintf(header, sizeof(header), "P4\n%d %d\n", HOST_DISP_WIDTH, HOST_DISP_HEIGHT);
+    std::vector<uint8_t> out(header, header + len);
+    for (int y = 0; y < HOST_DISP_HEIGHT; y++)
+    {
+        for (int x = 0; x < HOST_DISP_WIDTH; x += 8)
+        {
+            uint8_t bits = 0;
+            for (int b = 0; b < 8; b++)
+            {
+                bits = (uint8_t)((bits << 1) | (lit(frame, x + b, y) ? 0 : 1));
+            }
+            out.push_back(bits);
+        }
+    }
+    return out;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0)
+{
+    crc = ~crc;
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= data[i];
+        for (int k = 0; k < 8; k++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void putBe32(std::vector<uint8_t> &out, uint32_t value)
+{
+    out.push_back((uint8_t)(value >> 24));
+    out.push_back((uint8_t)(value >> 16));
+    out.push_back((uint8_t)(value >> 8));
+    out.push_back((uint8_t)value);
+}
+
+static void pngChunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data)
+{
+    putBe32(out, (uint32_t)data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    putBe32(out, crc32(&out[start], out.size() - start));
+}
+
+// 1 bit grayscale PNG, the image data in a single stored deflate block
+static std::vector<uint8_t> toPng(const uint8_t *frame)
+{
+    std::vector<uint8_t> raw;
+    for (int y = 0; y < HOST_DISP_HEIGHT; y++)
+    {
+        raw.push_back(0); // filter: none
+        for (int x = 0; x < HOST_DISP_WIDTH; x += 8)
+        {
+            uint8_t bits = 0;
+            for (int b = 0; b < 8; b++)
+            {
+                bits = (uint8_t)((bits << 1) | (lit(frame, x + b, y) ? 1 : 0));
+            }
+            raw.push_back(bits);
+        }
+    }
+
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (uint8_t byte : raw)
+    {
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    std::vector<uint8_t> zlib = {0x78, 0x01, 0x01}; // no compression, final stored block
+    uint16_t len = (uint16_t)raw.size();
+    zlib.push_back((uint8_t)len);
+    zlib.push_back((uint8_t)(len >> 8));
+    zlib.push_back((uint8_t)~len);
+    zlib.push_back((uint8_t)(~len >> 8));
+    zlib.insert(zlib.end(), raw.begin(), raw.end());
+    putBe32(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> ihdr;
+    putBe32(ihdr, HOST_DISP_WIDTH);
+    putBe32(ihdr, HOST_DISP_HEIGHT);
+    ihdr.push_back(1); // bit depth
+    ihdr.push_back(0); // grayscale
+    ihdr.push_back(0);
+    ihdr.push_back(0);
+    ihdr.push_back(0);
+
+    std::vector<uint8_t> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    pngChunk(out, "IHDR", ihdr);
+    pngChunk(out, "IDAT", zlib);
+    pngChunk(out, "IEND", std::vector<uint8_t>());
+    return out;
+}
+
+static bool writeFile(const std::string &path, const std::vector<uint8_t> &data)
+{
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == NULL)
+    {
+        fprintf(stderr, "cannot write %s\n", path.c_str());
+        return false;
+    }
+    bool ok = (fwrite(data.data(), 1, data.size(), f) == data.size());
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+}
+
+static bool readFile(const std::string &path, std::vector<uint8_t> *data)
+{
+    FILE *f = fopen(path.c_str(), "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    uint8_t buf[512];
+    size_t n;
+    data->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        data->insert(data->end(), buf, buf + n);
+    }
+    fclose(f);
+    return true;
+}
+
+// differing pixels of two P4 images of the panel size, -1 if a header differs
+static int pbmDiff(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+    if (a.size() != b.size())
+    {
+        return -1;
+    }
+    size_t pixels = (size_t)RENDER_ROW_BYTES * HOST_DISP_HEIGHT;
+    size_t header = a.size() - pixels;
+    if (memcmp(a.data(), b.data(), header) != 0)
+    {
+        return -1;
+    }
+    int diff = 0;
+    for (size_t i = header; i < a.size(); i++)
+    {
+        diff += __builtin_popcount((unsigned)(a[i] ^ b[i]));
+    }
+    return diff;
+}
+
+// -- rendering --
+
+static void renderScreen(const Options &opt, Totals *totals, int index, const char *name, displayEvents_t event,
+                         const displaySnapshot_t *snap, uint8_t page)
+{
+    U8G2_SH1106_128X64_NONAME_F_HW_I2C *disp = p_tHostDisplay;
+
+    uint32_t frames = disp->drawnFrames();
+    uint32_t tiles = disp->sentTiles();
+    uint8_t measPage = page;
+    uint32_t holdMs = uTaskDisplay_drawScreen(event, snap, &measPage);
+    uint32_t tilesSent = disp->sentTiles() - tiles;
+
+    if (disp->drawnFrames() == frames)
+    {
+        printf("%2d  %-28s  %-9s  %6s  %9s  no screen\n", index, name, "-", "-", "-");
+        totals->blank++;
+        return;
+    }
+
+    std::vector<uint8_t> pbm = toPbm(disp->panel());
+
+    // timing: the same screen again and again; the countdown skips frames
+    // with the text on screen, so its seconds move on every render
+    displaySnapshot_t timed = *snap;
+    unsigned long start = micros();
+    for (int i = 0; i < opt.iterations; i++)
+    {
+        timed.timeoutSeconds = snap->timeoutSeconds + 1 + (uint32_t)(i % 2);
+        measPage = page;
+        uTaskDisplay_drawScreen(event, &timed, &measPage);
+    }
+    double usPerRender = (opt.iterations > 0) ? (double)(micros() - start) / opt.iterations : 0.0;
+    measPage = page;
+    uTaskDisplay_drawScreen(event, snap, &measPage); // leave the panel as the next screen would find it
+
+    char file[64];
+    snprintf(file, sizeof(file), "%02d_%s", index, name);
+    std::string result = (opt.goldenDir != NULL) ? "ok" : "-";
+    if (opt.outDir != NULL)
+    {
+        writeFile(std::string(opt.outDir) + "/" + file + ".pbm", pbm);
+        writeFile(std::string(opt.outDir) + "/" + file + ".png", toPng(disp->panel()));
+    }
+    if (opt.goldenDir != NULL)
+    {
+        std::string path = std::string(opt.goldenDir) + "/" + file + ".pbm";
+        std::vector<uint8_t> golden;
+        if (opt.updateGolden)
+        {
+            result = writeFile(path, pbm) ? "golden written" : "golden not written";
+        }
+        else if (!readFile(path, &golden))
+        {
+            result = "MISSING golden";
+            totals->missing++;
+        }
+        else
+        {
+            int diff = pbmDiff(pbm, golden);
+            if (diff != 0)
+            {
+                char msg[48];
+                snprintf(msg, sizeof(msg), (diff < 0) ? "MISMATCH (format)" : "MISMATCH (%d px)", diff);
+                result = msg;
+                totals->mismatched++;
+            }
+        }
+    }
+
+    char tilesCol[16];
+    snprintf(tilesCol, sizeof(tilesCol), "%u/%d", (unsigned)tilesSent, RENDER_TILES_PER_FRAME);
+    printf("%2d  %-28s  %-9s  %6u  %9.1f  %s\n", index, name, tilesCol, (unsigned)holdMs, usPerRender, result.c_str());
+    totals->screens++;
+    totals->tiles += tilesSent;
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-o") == 0) && ((i + 1) < argc))
+        {
+            opt.outDir = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-g") == 0) && ((i + 1) < argc))
+        {
+            opt.goldenDir = argv[++i];
+        }
+        else if (strcmp(argv[i], "-u") == 0)
+        {
+            opt.updateGolden = true;
+        }
+        else if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+        {
+            opt.iterations = atoi(argv[++i]);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((opt.iterations < 0) || (opt.updateGolden && (opt.goldenDir == NULL)))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    if (opt.outDir != NULL)
+    {
+        mkdir(opt.outDir, 0755);
+    }
+    if ((opt.goldenDir != NULL) && opt.updateGolden)
+    {
+        mkdir(opt.goldenDir, 0755);
+    }
+
+    // a screen added to displayEvents_t must be added here too
+    bool covered[DISP_EVENT_GPRS_ERROR + 1] = {false};
+    for (size_t i = 0; i < SCREEN_CASES; i++)
+    {
+        covered[screenCases[i].event] = true;
+    }
+    for (int ev = DISP_EVENT_WAIT_FOR_EVENT + 1; ev <= DISP_EVENT_GPRS_ERROR; ev++)
+    {
+        if (!covered[ev])
+        {
+            fprintf(stderr, "display event %d has no screen case\n", ev);
+            return 2;
+        }
+    }
+
+    vMspOs_initI2cBus();
+    vHalDisplay_initSerialAndI2c();
+
+    displaySnapshot_t snap;
+    sampleSnapshot(&snap);
+
+    printf("%d display events, %d renders per screen, tiles sent after the previous screen\n\n", (int)SCREEN_CASES, opt.iterations);
+    printf("%2s  %-28s  %-9s  %6s  %9s  %s\n", "#", "screen", "tiles", "holdms", "us/render", "golden");
+
+    Totals totals;
+    int index = 0;
+    for (size_t i = 0; i < SCREEN_CASES; i++)
+    {
+        if (screenCases[i].event == DISP_EVENT_SHOW_MEAS_DATA)
+        {
+            for (uint8_t page = 0; page < RENDER_MEAS_PAGES; page++)
+            {
+                char name[48];
+                snprintf(name, sizeof(name), "%s_%u", screenCases[i].name, (unsigned)(page + 1));
+                renderScreen(opt, &totals, index++, name, screenCases[i].event, &snap, page);
+            }
+        }
+        else
+        {
+            renderScreen(opt, &totals, index++, screenCases[i].name, screenCases[i].event, &snap, 0);
+        }
+    }
+
+    printf("\n%d screens drawn, %d without a screen, %lu tiles sent vs %lu as full frames\n", totals.screens, totals.blank,
+           totals.tiles, (unsigned long)totals.screens * RENDER_TILES_PER_FRAME);
+    if ((opt.goldenDir != NULL) && !opt.updateGolden)
+    {
+        printf("golden: %d mismatched, %d missing\n", totals.mismatched, totals.missing);
+        return ((totals.mismatched != 0) || (totals.missing != 0)) ? 1 : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+/********************************************************************
+ * @file    Arduino.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the parts of the Arduino core the
+ *          display modules use
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+
+#define PROGMEM
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+
+size_t strlcpy(char *dst, const char *src, size_t size);
+
+// -- ESP32 log macros: arguments are evaluated, nothing is printed
+static inline void vHost_log(const char *fmt, ...) { (void)fmt; }
+#define log_e(...) vHost_log(__VA_ARGS__)
+#define log_w(...) vHost_log(__VA_ARGS__)
+#define log_i(...) vHost_log(__VA_ARGS__)
+#define log_d(...) vHost_log(__VA_ARGS__)
+#define log_v(...) vHost_log(__VA_ARGS__)
+
+class String
+{
+public:
+  String(const char *s = "") : str(s ? s : "") {}
+  String(const std::string &s) : str(s) {}
+  String(int value) : str(std::to_string(value)) {}
+  String(unsigned int value) : str(std::to_string(value)) {}
+  String(long value) : str(std::to_string(value)) {}
+  String(unsigned long value) : str(std::to_string(value)) {}
+  String(float value, unsigned int decimals = 2)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", (int)decimals, (double)value);
+    str = buf;
+  }
+  const char *c_str() const { return str.c_str(); }
+  unsigned int length() const { return (unsigned int)str.size(); }
+  void replace(const String &from, const String &to)
+  {
+    size_t pos = 0;
+    while ((!from.str.empty()) && ((pos = str.find(from.str, pos)) != std::string::npos))
+    {
+      str.replace(pos, from.str.size(), to.str);
+      pos += to.str.size();
+    }
+  }
+  String operator+(const String &rhs) const { return String(str + rhs.str); }
+  friend String operator+(const char *lhs, const String &rhs) { return String(std::string(lhs) + rhs.str); }
+
+private:
+  std::string str;
+};
+
+class HardwareSerial
+{
+public:
+  void begin(unsigned long baud) { (void)baud; }
+  void println(const char *s) { fprintf(stderr, "%s\n", s); }
+};
+extern HardwareSerial Serial;
+
+#endif
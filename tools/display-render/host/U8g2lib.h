@@ -0,0 +1,79 @@
+/********************************************************************
+ * @file    U8g2lib.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the SH1106 U8g2 driver: draws into an
+ *          in-memory frame buffer in the U8g2 tile layout and copies
+ *          what is sent into a second buffer, the panel
+ * @details Text uses a built-in 5x7 glyph set in 6 px cells, so string
+ *          widths and positions match the 6x13 fonts of the firmware,
+ *          glyph shapes do not.
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_U8G2LIB_H
+#define HOST_U8G2LIB_H
+
+#include "Arduino.h"
+
+#define U8G2_R0 0
+#define U8X8_PIN_NONE 255
+
+#define HOST_DISP_WIDTH 128
+#define HOST_DISP_HEIGHT 64
+#define HOST_DISP_BUFFER_LEN (HOST_DISP_WIDTH * HOST_DISP_HEIGHT / 8)
+
+typedef uint16_t u8g2_uint_t;
+
+// first byte: 1 for the bold face
+extern const uint8_t u8g2_font_6x13_tf[];
+extern const uint8_t u8g2_font_6x13_mf[];
+extern const uint8_t u8g2_font_6x13B_tf[];
+
+class U8G2_SH1106_128X64_NONAME_F_HW_I2C
+{
+public:
+  U8G2_SH1106_128X64_NONAME_F_HW_I2C(int rotation, int reset, int clock, int data);
+
+  void begin(void);
+  void clearBuffer(void);
+  void sendBuffer(void);
+  void updateDisplayArea(unsigned tx, unsigned ty, unsigned tw, unsigned th);
+  uint8_t *getBufferPtr(void) { return buffer; }
+
+  void setFont(const uint8_t *font) { bold = (font[0] != 0); }
+  void setCursor(int x, int y) { cursorX = x; cursorY = y; }
+  void print(const char *s) { cursorX += drawStr(cursorX, cursorY, s); }
+  void print(const String &s) { print(s.c_str()); }
+  int drawStr(int x, int y, const char *s);
+  u8g2_uint_t getStrWidth(const char *s);
+  u8g2_uint_t getDisplayWidth(void) { return HOST_DISP_WIDTH; }
+
+  void drawPixel(int x, int y);
+  void drawLine(int x0, int y0, int x1, int y1);
+  void drawXBM(int x, int y, int w, int h, const unsigned char *bits);
+  void drawXBMP(int x, int y, int w, int h, const unsigned char *bits) { drawXBM(x, y, w, h, bits); }
+
+  // -- host side: what the panel shows and what was sent to it
+  const uint8_t *panel(void) const { return shown; }
+  uint32_t sentTiles(void) const { return tilesSent; }
+  uint32_t sentAreas(void) const { return areasSent; }
+  uint32_t drawnFrames(void) const { return framesDrawn; }
+
+private:
+  uint8_t buffer[HOST_DISP_BUFFER_LEN];
+  uint8_t shown[HOST_DISP_BUFFER_LEN];
+  int cursorX = 0;
+  int cursorY = 0;
+  bool bold = false;
+  uint32_t tilesSent = 0;
+  uint32_t areasSent = 0;
+  uint32_t framesDrawn = 0; // clearBuffer() calls, every screen starts with one
+};
+
+// the display instance of display.cpp, registered by its constructor
+extern U8G2_SH1106_128X64_NONAME_F_HW_I2C *p_tHostDisplay;
+
+#endif
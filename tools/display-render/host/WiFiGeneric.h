@@ -0,0 +1,16 @@
+/********************************************************************
+ * @file    WiFiGeneric.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the WiFi types in shared_values.h
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_WIFIGENERIC_H
+#define HOST_WIFIGENERIC_H
+
+typedef int wifi_power_t;
+
+#endif
@@ -0,0 +1,21 @@
+/********************************************************************
+ * @file    Wire.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the I2C bus, the display is in memory
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+class TwoWire
+{
+public:
+  bool begin(int sda, int scl) { (void)sda; (void)scl; return true; }
+};
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,34 @@
+/********************************************************************
+ * @file    FreeRTOS.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the FreeRTOS types the display modules
+ *          use; a single thread, so locks and waits are no-ops
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t StackType_t;
+typedef void *TaskHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef struct { int dummy; } StaticTask_t;
+typedef struct { int dummy; } StaticSemaphore_t;
+typedef struct { int dummy; } portMUX_TYPE;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xffffffffUL
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+#endif
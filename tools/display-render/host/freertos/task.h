@@ -0,0 +1,23 @@
+/********************************************************************
+ * @file    task.h
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host stand-in for the FreeRTOS task API
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+TickType_t xTaskGetTickCount(void);
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+TaskHandle_t xTaskCreateStaticPinnedToCore(void (*task)(void *), const char *name, uint32_t stackDepth, void *params,
+                                           uint32_t priority, StackType_t *stack, StaticTask_t *taskBuffer, int core);
+
+#endif
@@ -0,0 +1,292 @@
+/********************************************************************
+ * @file    host_shims.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Host implementations behind the stand-in headers: clock,
+ *          FreeRTOS no-ops and the in-memory SH1106 display
+ * @version 0.1
+ * @date    2025-09-28
+ *
+ * @copyright Copyright (c) 2025
+ *
+ *********************************************************************/
+#include <chrono>
+#include "Arduino.h"
+#include "Wire.h"
+#include "U8g2lib.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "generic_functions.h"
+
+HardwareSerial Serial;
+TwoWire Wire;
+U8G2_SH1106_128X64_NONAME_F_HW_I2C *p_tHostDisplay = NULL;
+
+const uint8_t u8g2_font_6x13_tf[] = {0};
+const uint8_t u8g2_font_6x13_mf[] = {0};
+const uint8_t u8g2_font_6x13B_tf[] = {1};
+
+#define GLYPH_FIRST ' '
+#define GLYPH_LAST '~'
+#define GLYPH_COLS 5
+#define GLYPH_ADVANCE 6
+#define GLYPH_ASCENT 8 // rows above the baseline; bit 7 of a column is the descender row
+
+// 5x7 glyphs, one byte per column, bit 0 at the top
+static const uint8_t glyphs[GLYPH_LAST - GLYPH_FIRST + 1][GLYPH_COLS] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, {0x00, 0x00, 0x5F, 0x00, 0x00}, {0x00, 0x07, 0x00, 0x07, 0x00},
+    {0x14, 0x7F, 0x14, 0x7F, 0x14}, {0x24, 0x2A, 0x7F, 0x2A, 0x12}, {0x23, 0x13, 0x08, 0x64, 0x62},
+    {0x36, 0x49, 0x56, 0x20, 0x50}, {0x00, 0x05, 0x03, 0x00, 0x00}, {0x00, 0x1C, 0x22, 0x41, 0x00},
+    {0x00, 0x41, 0x22, 0x1C, 0x00}, {0x2A, 0x1C, 0x7F, 0x1C, 0x2A}, {0x08, 0x08, 0x3E, 0x08, 0x08},
+    {0x00, 0x50, 0x30, 0x00, 0x00}, {0x08, 0x08, 0x08, 0x08, 0x08}, {0x00, 0x60, 0x60, 0x00, 0x00},
+    {0x20, 0x10, 0x08, 0x04, 0x02}, {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00},
+    {0x42, 0x61, 0x51, 0x49, 0x46}, {0x21, 0x41, 0x45, 0x4B, 0x31}, {0x18, 0x14, 0x12, 0x7F, 0x10},
+    {0x27, 0x45, 0x45, 0x45, 0x39}, {0x3C, 0x4A, 0x49, 0x49, 0x30}, {0x01, 0x71, 0x09, 0x05, 0x03},
+    {0x36, 0x49, 0x49, 0x49, 0x36}, {0x06, 0x49, 0x49, 0x29, 0x1E}, {0x00, 0x36, 0x36, 0x00, 0x00},
+    {0x00, 0x56, 0x36, 0x00, 0x00}, {0x08, 0x14, 0x22, 0x41, 0x00}, {0x14, 0x14, 0x14, 0x14, 0x14},
+    {0x00, 0x41, 0x22, 0x14, 0x08}, {0x02, 0x01, 0x51, 0x09, 0x06}, {0x32, 0x49, 0x79, 0x41, 0x3E},
+    {0x7E, 0x11, 0x11, 0x11, 0x7E}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x22, 0x1C}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x49, 0x49, 0x7A}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x0C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x46, 0x49, 0x49, 0x49, 0x31}, {0x01, 0x01, 0x7F, 0x01, 0x01}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x07, 0x08, 0x70, 0x08, 0x07}, {0x61, 0x51, 0x49, 0x45, 0x43}, {0x00, 0x7F, 0x41, 0x41, 0x00},
+    {0x02, 0x04, 0x08, 0x10, 0x20}, {0x00, 0x41, 0x41, 0x7F, 0x00}, {0x04, 0x02, 0x01, 0x02, 0x04},
+    {0x40, 0x40, 0x40, 0x40, 0x40}, {0x00, 0x01, 0x02, 0x04, 0x00}, {0x20, 0x54, 0x54, 0x54, 0x78},
+    {0x7F, 0x48, 0x44, 0x44, 0x38}, {0x38, 0x44, 0x44, 0x44, 0x20}, {0x38, 0x44, 0x44, 0x48, 0x7F},
+    {0x38, 0x54, 0x54, 0x54, 0x18}, {0x08, 0x7E, 0x09, 0x01, 0x02}, {0x18, 0xA4, 0xA4, 0xA4, 0x7C},
+    {0x7F, 0x08, 0x04, 0x04, 0x78}, {0x00, 0x44, 0x7D, 0x40, 0x00}, {0x40, 0x80, 0x84, 0x7D, 0x00},
+    {0x7F, 0x10, 0x28, 0x44, 0x00}, {0x00, 0x41, 0x7F, 0x40, 0x00}, {0x7C, 0x04, 0x18, 0x04, 0x78},
+    {0x7C, 0x08, 0x04, 0x04, 0x78}, {0x38, 0x44, 0x44, 0x44, 0x38}, {0xFC, 0x24, 0x24, 0x24, 0x18},
+    {0x18, 0x24, 0x24, 0x18, 0xFC}, {0x7C, 0x08, 0x04, 0x04, 0x08}, {0x48, 0x54, 0x54, 0x54, 0x20},
+    {0x04, 0x3F, 0x44, 0x40, 0x20}, {0x3C, 0x40, 0x40, 0x20, 0x7C}, {0x1C, 0x20, 0x40, 0x20, 0x1C},
+    {0x3C, 0x40, 0x30, 0x40, 0x3C}, {0x44, 0x28, 0x10, 0x28, 0x44}, {0x1C, 0xA0, 0xA0, 0xA0, 0x7C},
+    {0x44, 0x64, 0x54, 0x4C, 0x44}, {0x00, 0x08, 0x36, 0x41, 0x00}, {0x00, 0x00, 0x7F, 0x00, 0x00},
+    {0x00, 0x41, 0x36, 0x08, 0x00}, {0x08, 0x04, 0x08, 0x10, 0x08},
+};
+
+// -- clock --
+
+static const std::chrono::steady_clock::time_point hostStart = std::chrono::steady_clock::now();
+
+unsigned long millis(void)
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+void delay(unsigned long ms)
+{
+  (void)ms; // screens are rendered back to back
+}
+
+size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t len = strlen(src);
+  if (size != 0)
+  {
+    size_t n = (len < size - 1) ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = '\0';
+  }
+  return len;
+}
+
+// -- FreeRTOS: a single thread, nothing ever waits --
+
+TickType_t xTaskGetTickCount(void)
+{
+  return (TickType_t)millis();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  (void)ticks;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+  (void)task;
+  return pdTRUE;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks)
+{
+  (void)clearOnExit;
+  (void)ticks;
+  return 0;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(void (*task)(void *), const char *name, uint32_t stackDepth, void *params,
+                                           uint32_t priority, StackType_t *stack, StaticTask_t *taskBuffer, int core)
+{
+  (void)task, (void)name, (void)stackDepth, (void)params, (void)priority, (void)stack, (void)taskBuffer, (void)core;
+  return NULL;
+}
+
+static StaticSemaphore_t hostMutex;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+  return &hostMutex;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+  return buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks)
+{
+  (void)mutex;
+  (void)ticks;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex)
+{
+  (void)mutex;
+  return pdTRUE;
+}
+
+// -- generic_functions.cpp pulls in the sensor libraries; same format as there --
+
+void vGeneric_dspFloatToComma(float value, char *buffer, size_t bufferSize)
+{
+  int intPart = (int)value;
+  int decimalPart = (int)(fabs(value - intPart) * 100);
+  snprintf(buffer, bufferSize, "%d,%02d", intPart, decimalPart);
+}
+
+// -- in-memory SH1106 --
+
+U8G2_SH1106_128X64_NONAME_F_HW_I2C::U8G2_SH1106_128X64_NONAME_F_HW_I2C(int rotation, int reset, int clock, int data)
+{
+  (void)rotation, (void)reset, (void)clock, (void)data;
+  memset(buffer, 0, sizeof(buffer));
+  memset(shown, 0, sizeof(shown));
+  p_tHostDisplay = this;
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::begin(void)
+{
+  memset(buffer, 0, sizeof(buffer));
+  memset(shown, 0, sizeof(shown)); // begin() clears the panel
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::clearBuffer(void)
+{
+  memset(buffer, 0, sizeof(buffer));
+  framesDrawn++;
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::sendBuffer(void)
+{
+  updateDisplayArea(0, 0, HOST_DISP_WIDTH / 8, HOST_DISP_HEIGHT / 8);
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::updateDisplayArea(unsigned tx, unsigned ty, unsigned tw, unsigned th)
+{
+  for (unsigned row = ty; (row < ty + th) && (row < HOST_DISP_HEIGHT / 8); row++)
+  {
+    for (unsigned col = tx; (col < tx + tw) && (col < HOST_DISP_WIDTH / 8); col++)
+    {
+      size_t offset = (row * HOST_DISP_WIDTH) + (col * 8);
+      memcpy(shown + offset, buffer + offset, 8);
+      tilesSent++;
+    }
+  }
+  areasSent++;
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::drawPixel(int x, int y)
+{
+  if ((x < 0) || (y < 0) || (x >= HOST_DISP_WIDTH) || (y >= HOST_DISP_HEIGHT))
+  {
+    return;
+  }
+  buffer[(y / 8) * HOST_DISP_WIDTH + x] |= (uint8_t)(1u << (y % 8));
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::drawLine(int x0, int y0, int x1, int y1)
+{
+  int dx = abs(x1 - x0);
+  int dy = -abs(y1 - y0);
+  int sx = (x0 < x1) ? 1 : -1;
+  int sy = (y0 < y1) ? 1 : -1;
+  int err = dx + dy;
+  for (;;)
+  {
+    drawPixel(x0, y0);
+    if ((x0 == x1) && (y0 == y1))
+    {
+      break;
+    }
+    int e2 = 2 * err;
+    if (e2 >= dy)
+    {
+      err += dy;
+      x0 += sx;
+    }
+    if (e2 <= dx)
+    {
+      err += dx;
+      y0 += sy;
+    }
+  }
+}
+
+void U8G2_SH1106_128X64_NONAME_F_HW_I2C::drawXBM(int x, int y, int w, int h, const unsigned char *bits)
+{
+  int rowBytes = (w + 7) / 8;
+  for (int row = 0; row < h; row++)
+  {
+    for (int col = 0; col < w; col++)
+    {
+      if (bits[row * rowBytes + col / 8] & (1u << (col % 8)))
+      {
+        drawPixel(x + col, y + row);
+      }
+    }
+  }
+}
+
+int U8G2_SH1106_128X64_NONAME_F_HW_I2C::drawStr(int x, int y, const char *s)
+{
+  int start = x;
+  for (; *s != '\0'; s++, x += GLYPH_ADVANCE)
+  {
+    char c = *s;
+    if ((c < GLYPH_FIRST) || (c > GLYPH_LAST))
+    {
+      c = '?';
+    }
+    const uint8_t *glyph = glyphs[c - GLYPH_FIRST];
+    for (int col = 0; col < GLYPH_COLS; col++)
+    {
+      for (int bit = 0; bit < 8; bit++)
+      {
+        if (glyph[col] & (1u << bit))
+        {
+          drawPixel(x + col, y - GLYPH_ASCENT + 1 + bit);
+          if (bold)
+          {
+            drawPixel(x + col + 1, y - GLYPH_ASCENT + 1 + bit);
+          }
+        }
+      }
+    }
+  }
+  return x - start;
+}
+
+u8g2_uint_t U8G2_SH1106_128X64_NONAME_F_HW_I2C::getStrWidth(const char *s)
+{
+  return (u8g2_uint_t)(strlen(s) * GLYPH_ADVANCE);
+}
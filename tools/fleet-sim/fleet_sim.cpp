@@ -0,0 +1,778 @@
+/****************************************************
+ * @file    fleet_sim.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Fleet load simulator for the Milano Smart Park ingest backend
+ * @details Runs N virtual devices on the host, each following the firmware
+ *          upload schedule (clock-aligned boundaries, per-device offset,
+ *          server backoff, outages with a bounded backlog), and posts the
+ *          records built by the firmware's own record_codec.cpp either to a
+ *          built-in ingest stand-in or to an external plain-HTTP endpoint.
+ *          Reports request rate, latency percentiles and bytes on the wire.
+ *
+ *          Build: make fleet-sim   (see tools/fleet-sim/README.md)
+ * @version 0.1
+ * @date    2025-09-02
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "record_codec.h"
+
+// Mirrors of the firmware constants this simulator models (config.h / network.cpp)
+#define SIM_SEND_DATA_QUEUE_LENGTH 16
+#define SIM_UPLOAD_JITTER_WINDOW_SEC 45
+#define SIM_SERVER_BACKOFF_DEFAULT_SEC 60
+#define SIM_SERVER_BACKOFF_MAX_SEC (15 * 60)
+#define SIM_PERIODIC_CHECK_MS 30000 // network task re-triggers a failed queue after this
+#define SIM_SERVER_RESPONSE_TIMEOUT_MS 10000
+
+#define SIM_EPOCH_BASE 1735689600L // 2025-01-01T00:00:00Z, a boundary for every interval
+#define SIM_STANDIN_ACCEPT_THREADS 16
+#define SIM_RESPONSE_MAX_LEN 1024
+
+typedef struct
+{
+    int devices;
+    int intervalMin;
+    int durationMin;
+    double speedup;
+    bool jitter;
+    int jitterWindowSec;
+    double outageProb;
+    int outageMaxCycles;
+    int workers;
+    std::string host;
+    int port;
+    bool useStandIn;
+    int capacityRps;
+    int serviceMs;
+    unsigned seed;
+} sim_config_t;
+
+typedef struct
+{
+    std::mutex lock;
+    std::string deviceId;
+    char mac[18];
+    std::deque<send_data_t> queue;
+    uint32_t nextSeq;
+    int64_t backoffUntilMs;
+    int outageCyclesLeft;
+    bool jobPending;
+} sim_device_t;
+
+typedef struct
+{
+    int64_t simMs;
+    int device;
+} sim_job_t;
+
+struct simJobLater
+{
+    bool operator()(const sim_job_t &a, const sim_job_t &b) const { return a.simMs > b.simMs; }
+};
+
+static sim_config_t cfg;
+static std::vector<sim_device_t *> devices;
+static std::chrono::steady_clock::time_point simStart;
+
+// Job scheduling (simulated time) and worker hand-off (real time)
+static std::mutex jobLock;
+static std::condition_variable jobCv;
+static std::priority_queue<sim_job_t, std::vector<sim_job_t>, simJobLater> jobHeap;
+static std::deque<int> readyJobs;
+static std::condition_variable readyCv;
+static bool simDone = false;
+
+// Statistics
+static std::mutex statLock;
+static std::vector<uint32_t> latenciesUs;
+static std::map<int64_t, uint32_t> requestsPerSimSec;
+static std::map<int, uint32_t> statusCounts;
+static std::atomic<uint64_t> bytesOut(0);
+static std::atomic<uint64_t> bytesIn(0);
+static std::atomic<uint64_t> recordsCreated(0);
+static std::atomic<uint64_t> recordsDelivered(0);
+static std::atomic<uint64_t> recordsDropped(0);
+static std::atomic<uint64_t> connectFailures(0);
+
+// Ingest stand-in state
+static int standInFd = -1;
+static std::mutex standInLock;
+static std::unordered_set<std::string> standInKeys;
+static std::map<int64_t, uint32_t> standInPerSimSec;
+
+static int64_t simNowMs()
+{
+    std::chrono::duration<double, std::milli> real = std::chrono::steady_clock::now() - simStart;
+    return (int64_t)(real.count() * cfg.speedup);
+}
+
+static void sleepUntilSim(int64_t simMs)
+{
+    int64_t delta = simMs - simNowMs();
+    if (delta > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds((int64_t)((delta * 1000.0) / cfg.speedup)));
+    }
+}
+
+static void scheduleJob(int device, int64_t simMs)
+{
+    sim_device_t *dev = devices[device];
+    {
+        std::lock_guard<std::mutex> guard(dev->lock);
+        if (dev->jobPending)
+        {
+            return; // already queued: one upload batch per device at a time, like the network task
+        }
+        dev->jobPending = true;
+    }
+    std::lock_guard<std::mutex> guard(jobLock);
+    jobHeap.push({simMs, device});
+    jobCv.notify_one();
+}
+
+// ---------------------------------------------------------------------------
+// Ingest stand-in
+// ---------------------------------------------------------------------------
+
+static bool readHttpRequest(int fd, std::string &request)
+{
+    char buf[1024];
+    size_t headerEnd = std::string::npos;
+    size_t contentLength = 0;
+
+    while (true)
+    {
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0)
+        {
+            return false;
+        }
+        request.append(buf, (size_t)n);
+
+        if (headerEnd == std::string::npos)
+        {
+            headerEnd = request.find("\r\n\r\n");
+            if (headerEnd != std::string::npos)
+            {
+                char value[32];
+                if (bRecordCodec_getHeader(request.c_str(), "Content-Length", value, sizeof(value)))
+                {
+                    contentLength = strtoul(value, NULL, 10);
+                }
+            }
+        }
+        if ((headerEnd != std::string::npos) && (request.size() >= headerEnd + 4 + contentLength))
+        {
+            return true;
+        }
+    }
+}
+
+static void standInWorker()
+{
+    while (true)
+    {
+        int fd = accept(standInFd, NULL, NULL);
+        if (fd < 0)
+        {
+            return;
+        }
+
+        std::string request;
+        if (!readHttpRequest(fd, request))
+        {
+            close(fd);
+            continue;
+        }
+
+        if (cfg.serviceMs > 0)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(cfg.serviceMs));
+        }
+
+        char key[96] = "";
+        bRecordCodec_getHeader(request.c_str(), "Idempotency-Key", key, sizeof(key));
+        const char *seq = strrchr(key, '-');
+
+        char response[256];
+        int64_t simSec = simNowMs() / 1000;
+        bool overloaded = false;
+        bool duplicate = false;
+        {
+            std::lock_guard<std::mutex> guard(standInLock);
+            uint32_t &count = standInPerSimSec[simSec];
+            if ((cfg.capacityRps > 0) && (count >= (uint32_t)cfg.capacityRps))
+            {
+                overloaded = true;
+            }
+            else
+            {
+                count++;
+                duplicate = !standInKeys.insert(key).second;
+            }
+        }
+
+        if (overloaded)
+        {
+            snprintf(response, sizeof(response),
+                     "HTTP/1.1 429 Too Many Requests\r\nRetry-After: %d\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                     SIM_SERVER_BACKOFF_DEFAULT_SEC);
+        }
+        else
+        {
+            snprintf(response, sizeof(response),
+                     "HTTP/1.1 %s\r\nX-MSP-Ack-Seq: %s\r\nContent-Length: 0\r\nConnection: close\r\n\r\n",
+                     duplicate ? "409 Conflict" : "201 Created", (seq != NULL) ? (seq + 1) : "0");
+        }
+        send(fd, response, strlen(response), MSG_NOSIGNAL);
+        close(fd);
+    }
+}
+
+static bool startStandIn()
+{
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    int one = 1;
+
+    standInFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (standInFd < 0)
+    {
+        perror("socket");
+        return false;
+    }
+    setsockopt(standInFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if ((bind(standInFd, (struct sockaddr *)&addr, sizeof(addr)) < 0) || (listen(standInFd, 4096) < 0) ||
+        (getsockname(standInFd, (struct sockaddr *)&addr, &addrLen) < 0))
+    {
+        perror("stand-in listen");
+        return false;
+    }
+
+    cfg.host = "127.0.0.1";
+    cfg.port = ntohs(addr.sin_port);
+    for (int i = 0; i < SIM_STANDIN_ACCEPT_THREADS; i++)
+    {
+        std::thread(standInWorker).detach();
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// Virtual device upload (one record, firmware request format)
+// ---------------------------------------------------------------------------
+
+static int connectToServer()
+{
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    char port[8];
+    int fd = -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    snprintf(port, sizeof(port), "%d", cfg.port);
+    if (getaddrinfo(cfg.host.c_str(), port, &hints, &res) != 0)
+    {
+        return -1;
+    }
+
+    for (struct addrinfo *ai = res; ai != NULL; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0)
+        {
+            continue;
+        }
+        struct timeval tv = {SIM_SERVER_RESPONSE_TIMEOUT_MS / 1000, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+        {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    return fd;
+}
+
+// Returns the HTTP status (0 on transport failure) and fills the raw response
+static int postRecord(sim_device_t *dev, const send_data_t *record, char *response, size_t responseLen)
+{
+    char body[RECORD_CODEC_BODY_MAX_LEN];
+    char head[RECORD_CODEC_HEAD_MAX_LEN];
+    struct tm recordTime = record->sendTimeInfo;
+    long recordedAt = (long)timegm(&recordTime);
+
+    int bodyLen = iRecordCodec_formatBody(record, dev->deviceId.c_str(), recordedAt, body, sizeof(body));
+    int headLen = iRecordCodec_formatRequestHead(cfg.host.c_str(), "sim_salt", dev->deviceId.c_str(), record->seq,
+                                                 (size_t)bodyLen, head, sizeof(head));
+    if ((bodyLen < 0) || (headLen < 0))
+    {
+        fprintf(stderr, "record does not fit in codec buffers\n");
+        return 0;
+    }
+
+    int64_t simSec = simNowMs() / 1000;
+    auto started = std::chrono::steady_clock::now();
+
+    int fd = connectToServer();
+    if (fd < 0)
+    {
+        connectFailures++;
+        return 0;
+    }
+
+    std::string request = std::string(head, (size_t)headLen) + std::string(body, (size_t)bodyLen);
+    ssize_t sent = send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    size_t received = 0;
+    if (sent == (ssize_t)request.size())
+    {
+        while (received < responseLen - 1)
+        {
+            ssize_t n = recv(fd, response + received, responseLen - 1 - received, 0);
+            if (n <= 0)
+            {
+                break;
+            }
+            received += (size_t)n;
+        }
+    }
+    response[received] = '\0';
+    close(fd);
+
+    uint32_t latency = (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                           std::chrono::steady_clock::now() - started)
+                           .count();
+    bytesOut += (sent > 0) ? (uint64_t)sent : 0;
+    bytesIn += received;
+
+    int status = 0;
+    if (strncmp(response, "HTTP/1.1 ", 9) == 0)
+    {
+        status = atoi(response + 9);
+    }
+
+    std::lock_guard<std::mutex> guard(statLock);
+    latenciesUs.push_back(latency);
+    requestsPerSimSec[simSec]++;
+    statusCounts[status]++;
+    return status;
+}
+
+// Drain one device queue the way NETWRK_EVT_UPDATE_DATA does
+static void runDeviceJob(int index)
+{
+    sim_device_t *dev = devices[index];
+    char response[SIM_RESPONSE_MAX_LEN];
+
+    {
+        std::lock_guard<std::mutex> guard(dev->lock);
+        dev->jobPending = false;
+        if (dev->outageCyclesLeft > 0)
+        {
+            return; // offline: backlog keeps growing until the next boundary after recovery
+        }
+    }
+
+    while (true)
+    {
+        send_data_t record;
+        {
+            std::lock_guard<std::mutex> guard(dev->lock);
+            if (dev->queue.empty())
+            {
+                return;
+            }
+            record = dev->queue.front();
+        }
+
+        int status = postRecord(dev, &record, response, sizeof(response));
+        if ((status == 200) || (status == 201) || (status == 409))
+        {
+            std::lock_guard<std::mutex> guard(dev->lock);
+            dev->queue.pop_front();
+            recordsDelivered++;
+            continue;
+        }
+
+        int64_t retryAt = simNowMs() + SIM_PERIODIC_CHECK_MS;
+        if ((status == 429) || (status == 503))
+        {
+            uint32_t backoffSec = ulRecordCodec_parseRetryAfter(response, SIM_SERVER_BACKOFF_DEFAULT_SEC,
+                                                                SIM_SERVER_BACKOFF_MAX_SEC);
+            if (backoffSec == 0)
+            {
+                backoffSec = SIM_SERVER_BACKOFF_DEFAULT_SEC;
+            }
+            std::lock_guard<std::mutex> guard(dev->lock);
+            dev->backoffUntilMs = simNowMs() + (int64_t)backoffSec * 1000;
+            retryAt = std::max(retryAt, dev->backoffUntilMs);
+        }
+        scheduleJob(index, retryAt);
+        return;
+    }
+}
+
+static void workerThread()
+{
+    while (true)
+    {
+        int device;
+        {
+            std::unique_lock<std::mutex> guard(jobLock);
+            readyCv.wait(guard, [] { return simDone || !readyJobs.empty(); });
+            if (readyJobs.empty())
+            {
+                return;
+            }
+            device = readyJobs.front();
+            readyJobs.pop_front();
+        }
+        runDeviceJob(device);
+    }
+}
+
+// Releases jobs to the worker pool once their simulated time is reached
+static void dispatcherThread(int64_t endSimMs)
+{
+    std::unique_lock<std::mutex> guard(jobLock);
+    while (true)
+    {
+        if (jobHeap.empty())
+        {
+            if (simNowMs() >= endSimMs)
+            {
+                break;
+            }
+            jobCv.wait_for(guard, std::chrono::milliseconds(10));
+            continue;
+        }
+
+        sim_job_t next = jobHeap.top();
+        if (next.simMs >= endSimMs)
+        {
+            break;
+        }
+        int64_t delta = next.simMs - simNowMs();
+        if (delta > 0)
+        {
+            jobCv.wait_for(guard, std::chrono::microseconds((int64_t)((delta * 1000.0) / cfg.speedup)));
+            continue;
+        }
+        jobHeap.pop();
+        readyJobs.push_back(next.device);
+        readyCv.notify_one();
+    }
+    simDone = true;
+    readyCv.notify_all();
+}
+
+// ---------------------------------------------------------------------------
+// Fleet schedule
+// ---------------------------------------------------------------------------
+
+static void createDevices(std::mt19937 &rng)
+{
+    std::uniform_int_distribution<int> byte(0, 255);
+    for (int i = 0; i < cfg.devices; i++)
+    {
+        sim_device_t *dev = new sim_device_t();
+        char id[32];
+        snprintf(id, sizeof(id), "msp-sim-%05d", i);
+        dev->deviceId = id;
+        snprintf(dev->mac, sizeof(dev->mac), "24:6F:28:%02X:%02X:%02X", byte(rng), byte(rng), byte(rng));
+        dev->nextSeq = 1;
+        dev->backoffUntilMs = 0;
+        dev->outageCyclesLeft = 0;
+        dev->jobPending = false;
+        devices.push_back(dev);
+    }
+}
+
+static void produceBoundary(int64_t boundarySimMs, std::mt19937 &rng)
+{
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::uniform_int_distribution<int> outageLen(1, std::max(1, cfg.outageMaxCycles));
+    std::uniform_int_distribution<int> readSkewMs(0, 3000); // sensor read time before enqueue
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    time_t recordedAt = SIM_EPOCH_BASE + (time_t)(boundarySimMs / 1000);
+
+    for (int i = 0; i < cfg.devices; i++)
+    {
+        sim_device_t *dev = devices[i];
+        send_data_t record;
+        memset(&record, 0, sizeof(record));
+        gmtime_r(&recordedAt, &record.sendTimeInfo);
+        record.temp = 21.0f + noise(rng);
+        record.hum = 55.0f + 5.0f * noise(rng);
+        record.pre = 1013.0f + noise(rng);
+        record.VOC = 0.5f + 0.1f * noise(rng);
+        record.PM1 = 8 + (int32_t)(rng() % 5);
+        record.PM25 = 12 + (int32_t)(rng() % 8);
+        record.PM10 = 20 + (int32_t)(rng() % 10);
+        record.MICS_CO = 300.0f + 20.0f * noise(rng);
+        record.MICS_NO2 = 40.0f + 5.0f * noise(rng);
+        record.MICS_NH3 = 10.0f + noise(rng);
+        record.ozone = 60.0f + 5.0f * noise(rng);
+        record.MSP = 1;
+
+        int64_t uploadAt = boundarySimMs + readSkewMs(rng);
+        {
+            std::lock_guard<std::mutex> guard(dev->lock);
+            record.seq = dev->nextSeq++;
+            recordsCreated++;
+            if (dev->queue.size() >= SIM_SEND_DATA_QUEUE_LENGTH)
+            {
+                recordsDropped++; // enqueueSendData() fails when the queue is full
+            }
+            else
+            {
+                dev->queue.push_back(record);
+            }
+
+            if (dev->outageCyclesLeft > 0)
+            {
+                dev->outageCyclesLeft--;
+            }
+            else if (uniform(rng) < cfg.outageProb)
+            {
+                dev->outageCyclesLeft = outageLen(rng);
+            }
+
+            if (cfg.jitter)
+            {
+                uploadAt += ulRecordCodec_uploadJitterMs(dev->deviceId.c_str(), dev->mac,
+                                                         (uint32_t)cfg.jitterWindowSec * 1000U);
+            }
+            uploadAt = std::max(uploadAt, dev->backoffUntilMs);
+        }
+        scheduleJob(i, uploadAt);
+    }
+}
+
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double p)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t idx = (size_t)((p / 100.0) * (double)(sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+static void printReport()
+{
+    std::lock_guard<std::mutex> guard(statLock);
+    std::vector<uint32_t> sorted = latenciesUs;
+    std::sort(sorted.begin(), sorted.end());
+
+    uint32_t peak = 0;
+    int64_t peakSec = 0;
+    for (const auto &entry : requestsPerSimSec)
+    {
+        if (entry.second > peak)
+        {
+            peak = entry.second;
+            peakSec = entry.first;
+        }
+    }
+
+    uint64_t backlog = 0;
+    for (sim_device_t *dev : devices)
+    {
+        std::lock_guard<std::mutex> devGuard(dev->lock);
+        backlog += dev->queue.size();
+    }
+
+    double simSeconds = (double)cfg.durationMin * 60.0;
+    printf("\n=== Fleet simulation report ===\n");
+    printf("devices=%d interval=%dmin duration=%dmin jitter=%s(%ds) outage_prob=%.3f speedup=%.0fx\n",
+           cfg.devices, cfg.intervalMin, cfg.durationMin, cfg.jitter ? "on" : "off", cfg.jitterWindowSec,
+           cfg.outageProb, cfg.speedup);
+    printf("target=%s:%d%s\n", cfg.host.c_str(), cfg.port, cfg.useStandIn ? " (built-in stand-in)" : "");
+    printf("requests            : %zu\n", sorted.size());
+    printf("mean rate           : %.2f req/s (simulated time)\n", (double)sorted.size() / simSeconds);
+    printf("peak rate           : %u req/s at t+%llds (busiest simulated second)\n", peak, (long long)peakSec);
+    printf("latency p50/p95/p99 : %.2f / %.2f / %.2f ms\n", percentile(sorted, 50) / 1000.0,
+           percentile(sorted, 95) / 1000.0, percentile(sorted, 99) / 1000.0);
+    printf("latency max         : %.2f ms\n", (sorted.empty() ? 0 : sorted.back()) / 1000.0);
+    printf("bytes out/in        : %llu / %llu (%.1f B/request out)\n", (unsigned long long)bytesOut.load(),
+           (unsigned long long)bytesIn.load(), sorted.empty() ? 0.0 : (double)bytesOut.load() / sorted.size());
+    printf("records             : created=%llu delivered=%llu dropped=%llu backlog=%llu\n",
+           (unsigned long long)recordsCreated.load(), (unsigned long long)recordsDelivered.load(),
+           (unsigned long long)recordsDropped.load(), (unsigned long long)backlog);
+    printf("connect failures    : %llu\n", (unsigned long long)connectFailures.load());
+    printf("status codes        :");
+    for (const auto &entry : statusCounts)
+    {
+        printf(" %d=%u", entry.first, entry.second);
+    }
+    printf("\n");
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [options]\n"
+           "  --devices N          virtual devices (default 1000)\n"
+           "  --interval MIN       avg_measurements, upload boundary in minutes (default 5)\n"
+           "  --duration MIN       simulated minutes (default 60)\n"
+           "  --speedup X          simulated/real time ratio (default 60; use 1 for true latencies)\n"
+           "  --no-jitter          upload exactly on the boundary (pre user-026 firmware)\n"
+           "  --jitter-window SEC  per-device offset window (default %d)\n"
+           "  --outage-prob P      chance per device and boundary to go offline (default 0.01)\n"
+           "  --outage-cycles C    max outage length in boundaries (default 6)\n"
+           "  --workers W          concurrent uploads (default 256)\n"
+           "  --target HOST:PORT   external plain-HTTP ingest instead of the stand-in\n"
+           "  --capacity RPS       stand-in answers 429 above this rate per simulated second (default 0 = off)\n"
+           "  --service-ms MS      stand-in processing time per request (default 1)\n"
+           "  --seed N             random seed (default 1)\n",
+           prog, SIM_UPLOAD_JITTER_WINDOW_SEC);
+}
+
+static bool parseArgs(int argc, char **argv)
+{
+    cfg.devices = 1000;
+    cfg.intervalMin = 5;
+    cfg.durationMin = 60;
+    cfg.speedup = 60.0;
+    cfg.jitter = true;
+    cfg.jitterWindowSec = SIM_UPLOAD_JITTER_WINDOW_SEC;
+    cfg.outageProb = 0.01;
+    cfg.outageMaxCycles = 6;
+    cfg.workers = 256;
+    cfg.useStandIn = true;
+    cfg.capacityRps = 0;
+    cfg.serviceMs = 1;
+    cfg.seed = 1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        const char *val = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (arg == "--no-jitter")
+        {
+            cfg.jitter = false;
+            continue;
+        }
+        if (arg == "--help" || arg == "-h" || val == NULL)
+        {
+            return false;
+        }
+        i++;
+        if (arg == "--devices") cfg.devices = atoi(val);
+        else if (arg == "--interval") cfg.intervalMin = atoi(val);
+        else if (arg == "--duration") cfg.durationMin = atoi(val);
+        else if (arg == "--speedup") cfg.speedup = atof(val);
+        else if (arg == "--jitter-window") cfg.jitterWindowSec = atoi(val);
+        else if (arg == "--outage-prob") cfg.outageProb = atof(val);
+        else if (arg == "--outage-cycles") cfg.outageMaxCycles = atoi(val);
+        else if (arg == "--workers") cfg.workers = atoi(val);
+        else if (arg == "--capacity") cfg.capacityRps = atoi(val);
+        else if (arg == "--service-ms") cfg.serviceMs = atoi(val);
+        else if (arg == "--seed") cfg.seed = (unsigned)strtoul(val, NULL, 10);
+        else if (arg == "--target")
+        {
+            std::string target = val;
+            size_t colon = target.rfind(':');
+            if (colon == std::string::npos)
+            {
+                return false;
+            }
+            cfg.host = target.substr(0, colon);
+            cfg.port = atoi(target.c_str() + colon + 1);
+            cfg.useStandIn = false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return (cfg.devices > 0) && (cfg.intervalMin > 0) && (cfg.durationMin > 0) && (cfg.speedup > 0.0) &&
+           (cfg.workers > 0);
+}
+
+int main(int argc, char **argv)
+{
+    if (!parseArgs(argc, argv))
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (cfg.useStandIn && !startStandIn())
+    {
+        return 1;
+    }
+
+    std::mt19937 rng(cfg.seed);
+    createDevices(rng);
+
+    int64_t intervalMs = (int64_t)cfg.intervalMin * 60 * 1000;
+    int64_t endSimMs = (int64_t)cfg.durationMin * 60 * 1000;
+
+    simStart = std::chrono::steady_clock::now();
+    std::thread dispatcher(dispatcherThread, endSimMs);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < cfg.workers; i++)
+    {
+        workers.emplace_back(workerThread);
+    }
+
+    for (int64_t boundary = 0; boundary < endSimMs; boundary += intervalMs)
+    {
+        sleepUntilSim(boundary);
+        produceBoundary(boundary, rng);
+        fprintf(stderr, "\rsimulated t+%llds / %llds", (long long)(boundary / 1000), (long long)(endSimMs / 1000));
+    }
+
+    dispatcher.join();
+    for (std::thread &worker : workers)
+    {
+        worker.join();
+    }
+    fprintf(stderr, "\n");
+
+    printReport();
+    return 0;
+}
@@ -0,0 +1,178 @@
+/****************************************************
+ * @file    msplog2csv.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Binary daily log to CSV converter for the Milano Smart Park project
+ * @details Reads /YYYY/MM/DD.bin files pulled from a device card and writes
+ *          the CSV_HEADER layout the firmware logs in text mode, using the
+ *          firmware's own log_codec.cpp so both outputs are the same text.
+ *
+ *          Build: make msplog2csv   (see tools/msplog2csv/README.md)
+ * @version 0.1
+ * @date    2025-09-08
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_codec.h"
+
+#define CSV_LINE_END "\r\n"
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-o out.csv] [-q] DD.bin [DD.bin ...]\n"
+            "  -o FILE  write to FILE instead of stdout\n"
+            "  -q       no size summary on stderr\n"
+            "Files are converted in the given order under a single header.\n",
+            prog);
+}
+
+/****************************************************
+ * @brief converts one binary daily file
+ *
+ * @param path      input file
+ * @param out       CSV destination
+ * @param records   incremented per record
+ * @param binBytes  incremented by the input size
+ * @param csvBytes  incremented by the output size
+ * @return true on success
+ ****************************************************/
+static bool convertFile(const char *path, FILE *out, unsigned long *records,
+                        unsigned long *binBytes, unsigned long *csvBytes)
+{
+    FILE *in = fopen(path, "rb");
+    if (in == NULL)
+    {
+        perror(path);
+        return false;
+    }
+
+    uint8_t header[LOG_BIN_HEADER_LEN];
+    struct tm day;
+    if ((fread(header, 1, sizeof(header), in) != sizeof(header)) ||
+        !bLogCodec_parseBinHeader(header, sizeof(header), &day))
+    {
+        fprintf(stderr, "%s: not a binary log or unknown schema\n", path);
+        fclose(in);
+        return false;
+    }
+    *binBytes += sizeof(header);
+
+    log_bin_record_t rec;
+    char line[LOG_CSV_LINE_MAX_LEN];
+    unsigned long pos = sizeof(header);
+    unsigned long dataEnd = ulLogCodec_binDataEnd(header);
+    size_t got;
+    while ((got = fread(&rec, 1, sizeof(rec), in)) == sizeof(rec))
+    {
+        struct tm lineTime;
+        send_data_t values;
+        uint8_t flags;
+
+        // A card pulled before the day was closed still holds its zero-filled preallocation
+        if ((pos >= dataEnd) && bLogCodec_binRecordBlank(&rec))
+        {
+            got = 0;
+            break;
+        }
+        pos += sizeof(rec);
+
+        vLogCodec_decodeBin(&rec, &day, &lineTime, &flags, &values);
+        int len = iLogCodec_formatCsvLine(&lineTime, flags, &values, line, sizeof(line));
+        if (len < 0)
+        {
+            fprintf(stderr, "%s: record %lu does not fit a line\n", path, *records);
+            continue;
+        }
+        fputs(line, out);
+        fputs(CSV_LINE_END, out);
+        *csvBytes += (unsigned long)len + strlen(CSV_LINE_END);
+        *binBytes += sizeof(rec);
+        (*records)++;
+    }
+
+    if (got != 0)
+    {
+        // Power loss mid-write leaves a partial record at the end
+        fprintf(stderr, "%s: ignoring %u trailing bytes\n", path, (unsigned)got);
+    }
+
+    fclose(in);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const char *outPath = NULL;
+    bool quiet = false;
+    int first = 1;
+
+    while ((first < argc) && (argv[first][0] == '-'))
+    {
+        if ((strcmp(argv[first], "-o") == 0) && ((first + 1) < argc))
+        {
+            outPath = argv[first + 1];
+            first += 2;
+        }
+        else if (strcmp(argv[first], "-q") == 0)
+        {
+            quiet = true;
+            first++;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (first >= argc)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    FILE *out = stdout;
+    if (outPath != NULL)
+    {
+        out = fopen(outPath, "wb");
+        if (out == NULL)
+        {
+            perror(outPath);
+            return 1;
+        }
+    }
+
+    unsigned long records = 0;
+    unsigned long binBytes = 0;
+    unsigned long csvBytes = 0;
+    int failures = 0;
+
+    fputs(CSV_HEADER CSV_LINE_END, out);
+    csvBytes += strlen(CSV_HEADER CSV_LINE_END);
+
+    for (int i = first; i < argc; i++)
+    {
+        if (!convertFile(argv[i], out, &records, &binBytes, &csvBytes))
+        {
+            failures++;
+        }
+    }
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    if (!quiet)
+    {
+        fprintf(stderr, "%lu records: %lu bytes binary, %lu bytes CSV (%.1fx)\n", records, binBytes,
+                csvBytes, (binBytes > 0) ? ((double)csvBytes / (double)binBytes) : 0.0);
+    }
+
+    return (failures > 0) ? 1 : 0;
+}
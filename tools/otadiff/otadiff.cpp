@@ -0,0 +1,624 @@
+/****************************************************
+ * @file    otadiff.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Delta firmware patch builder for the Milano Smart Park project
+ * @details Builds the patch that turns one release image into another
+ *          (bsdiff matching over a suffix array of the old image) and
+ *          applies patches with the firmware's own ota_delta.cpp, so a
+ *          patch that applies here applies on the device.
+ *
+ *          Build: make otadiff   (see tools/otadiff/README.md)
+ * @version 0.1
+ * @date    2025-10-20
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+#include <vector>
+#include <zlib.h>
+
+#include "ota_delta.h"
+
+#define INFLATE_CHUNK 2048 // the device inflates what one network read gives
+
+typedef std::vector<uint8_t> bytes_t;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-q] diff OLD.bin NEW.bin PATCH\n"
+            "       %s [-q] apply OLD.bin PATCH NEW.bin\n"
+            "  -q       no size summary on stderr\n"
+            "diff checks the patch by applying it before writing it.\n",
+            prog, prog);
+}
+
+static bool readFile(const char *path, bytes_t *out)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[65536];
+    size_t n;
+    out->clear();
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    {
+        out->insert(out->end(), buf, buf + n);
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    if (!ok)
+    {
+        perror(path);
+    }
+    return ok;
+}
+
+static bool writeFile(const char *path, const bytes_t &data)
+{
+    FILE *f = fopen(path, "wb");
+    if (f == NULL)
+    {
+        perror(path);
+        return false;
+    }
+    bool ok = (fwrite(data.data(), 1, data.size(), f) == data.size());
+    ok = (fclose(f) == 0) && ok;
+    if (!ok)
+    {
+        perror(path);
+    }
+    return ok;
+}
+
+static double elapsedMs(const struct timespec &start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+// -- SHA-256 (FIPS 180-4), the hash the device computes with mbedtls --
+
+static const uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static uint32_t rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+static void sha256Block(uint32_t h[8], const uint8_t *p)
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) | ((uint32_t)p[i * 4 + 2] << 8) | p[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], k = h[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = k + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + sha256K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        k = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e, h[5] += f, h[6] += g, h[7] += k;
+}
+
+static void sha256(const bytes_t &data, uint8_t out[OTA_DELTA_HASH_LEN])
+{
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    size_t full = data.size() / 64 * 64;
+    for (size_t i = 0; i < full; i += 64)
+    {
+        sha256Block(h, &data[i]);
+    }
+
+    uint8_t tail[128] = {0};
+    size_t rest = data.size() - full;
+    memcpy(tail, data.data() + full, rest);
+    tail[rest] = 0x80;
+    size_t tailLen = (rest < 56) ? 64 : 128;
+    uint64_t bits = (uint64_t)data.size() * 8;
+    for (int i = 0; i < 8; i++)
+    {
+        tail[tailLen - 1 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    for (size_t i = 0; i < tailLen; i += 64)
+    {
+        sha256Block(h, tail + i);
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        out[i * 4] = (uint8_t)(h[i] >> 24);
+        out[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        out[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        out[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+// -- diff --
+
+/****************************************************
+ * @brief suffix array of the old image, prefix
+ *        doubling with counting sorts
+ ****************************************************/
+static std::vector<int32_t> suffixArray(const bytes_t &s)
+{
+    int32_t n = (int32_t)s.size();
+    std::vector<int32_t> sa(n), rank(n), tmp(n), cnt(std::max(n, 256) + 1);
+
+    for (int32_t i = 0; i < n; i++)
+    {
+        cnt[s[i]]++;
+    }
+    for (int32_t i = 1; i < 256; i++)
+    {
+        cnt[i] += cnt[i - 1];
+    }
+    for (int32_t i = n - 1; i >= 0; i--)
+    {
+        sa[--cnt[s[i]]] = i;
+    }
+    for (int32_t i = 0; i < n; i++)
+    {
+        rank[i] = s[i];
+    }
+
+    int32_t classes = 256;
+    for (int32_t k = 1; k < n; k <<= 1)
+    {
+        // Order by the second half first: suffixes too short for one come first
+        int32_t p = 0;
+        for (int32_t i = n - k; i < n; i++)
+        {
+            tmp[p++] = i;
+        }
+        for (int32_t i = 0; i < n; i++)
+        {
+            if (sa[i] >= k)
+            {
+                tmp[p++] = sa[i] - k;
+            }
+        }
+
+        std::fill(cnt.begin(), cnt.begin() + classes + 1, 0);
+        for (int32_t i = 0; i < n; i++)
+        {
+            cnt[rank[i]]++;
+        }
+        for (int32_t i = 1; i <= classes; i++)
+        {
+            cnt[i] += cnt[i - 1];
+        }
+        for (int32_t i = n - 1; i >= 0; i--)
+        {
+            sa[--cnt[rank[tmp[i]]]] = tmp[i];
+        }
+
+        tmp[sa[0]] = 0;
+        for (int32_t i = 1; i < n; i++)
+        {
+            int32_t a = sa[i - 1], b = sa[i];
+            int32_t ra = (a + k < n) ? rank[a + k] : -1;
+            int32_t rb = (b + k < n) ? rank[b + k] : -1;
+            tmp[b] = tmp[a] + (((rank[a] != rank[b]) || (ra != rb)) ? 1 : 0);
+        }
+        rank.swap(tmp);
+        classes = rank[sa[n - 1]] + 1;
+        if (classes == n)
+        {
+            break;
+        }
+    }
+    return sa;
+}
+
+static int32_t matchLen(const uint8_t *a, int32_t aLen, const uint8_t *b, int32_t bLen)
+{
+    int32_t i = 0;
+    while ((i < aLen) && (i < bLen) && (a[i] == b[i]))
+    {
+        i++;
+    }
+    return i;
+}
+
+/****************************************************
+ * @brief longest match of newData in the old image
+ ****************************************************/
+static int32_t search(const std::vector<int32_t> &sa, const bytes_t &old, const uint8_t *newData, int32_t newLen,
+                      int32_t st, int32_t en, int32_t *pos)
+{
+    int32_t oldLen = (int32_t)old.size();
+    while (en - st >= 2)
+    {
+        int32_t x = st + (en - st) / 2;
+        int32_t cmpLen = std::min(oldLen - sa[x], newLen);
+        if (memcmp(old.data() + sa[x], newData, cmpLen) < 0)
+        {
+            st = x;
+        }
+        else
+        {
+            en = x;
+        }
+    }
+    int32_t x = matchLen(old.data() + sa[st], oldLen - sa[st], newData, newLen);
+    int32_t y = matchLen(old.data() + sa[en], oldLen - sa[en], newData, newLen);
+    *pos = (x > y) ? sa[st] : sa[en];
+    return std::max(x, y);
+}
+
+static void appendRecord(bytes_t *out, const bytes_t &old, const bytes_t &nw, int32_t lastScan, int32_t lastPos,
+                         int32_t lenF, int32_t extraLen, int32_t seek)
+{
+    uint8_t record[OTA_DELTA_RECORD_LEN];
+    vOtaDelta_formatRecord((uint32_t)lenF, (uint32_t)extraLen, seek, record);
+    out->insert(out->end(), record, record + OTA_DELTA_RECORD_LEN);
+    for (int32_t i = 0; i < lenF; i++)
+    {
+        out->push_back((uint8_t)(nw[lastScan + i] - old[lastPos + i]));
+    }
+    out->insert(out->end(), nw.begin() + lastScan + lenF, nw.begin() + lastScan + lenF + extraLen);
+}
+
+/****************************************************
+ * @brief bsdiff record stream turning old into new:
+ *        approximate matches become diff runs (mostly
+ *        zeros, which deflate well), the rest extra
+ *
+ * @return number of records
+ ****************************************************/
+static unsigned long diffRecords(const bytes_t &old, const bytes_t &nw, bytes_t *out)
+{
+    int32_t oldLen = (int32_t)old.size();
+    int32_t newLen = (int32_t)nw.size();
+    std::vector<int32_t> sa = suffixArray(old);
+    unsigned long records = 0;
+
+    int32_t scan = 0, len = 0, pos = 0;
+    int32_t lastScan = 0, lastPos = 0, lastOffset = 0;
+    while (scan < newLen)
+    {
+        int32_t oldScore = 0;
+        int32_t scsc = scan += len;
+        for (; scan < newLen; scan++)
+        {
+            len = (oldLen > 0) ? search(sa, old, nw.data() + scan, newLen - scan, 0, oldLen - 1, &pos) : 0;
+            for (; scsc < scan + len; scsc++)
+            {
+                if ((scsc + lastOffset < oldLen) && (old[scsc + lastOffset] == nw[scsc]))
+                {
+                    oldScore++;
+                }
+            }
+            if (((len == oldScore) && (len != 0)) || (len > oldScore + 8))
+            {
+                break;
+            }
+            if ((scan + lastOffset < oldLen) && (old[scan + lastOffset] == nw[scan]))
+            {
+                oldScore--;
+            }
+        }
+
+        if ((len == oldScore) && (scan != newLen))
+        {
+            continue;
+        }
+
+        // Extend the previous match forward and this one backward while more than half the bytes agree
+        int32_t s = 0, sF = 0, lenF = 0;
+        for (int32_t i = 0; (lastScan + i < scan) && (lastPos + i < oldLen);)
+        {
+            if (old[lastPos + i] == nw[lastScan + i])
+            {
+                s++;
+            }
+            i++;
+            if (s * 2 - i > sF * 2 - lenF)
+            {
+                sF = s;
+                lenF = i;
+            }
+        }
+
+        int32_t lenB = 0;
+        if (scan < newLen)
+        {
+            int32_t sB = 0;
+            s = 0;
+            for (int32_t i = 1; (scan >= lastScan + i) && (pos >= i); i++)
+            {
+                if (old[pos - i] == nw[scan - i])
+                {
+                    s++;
+                }
+                if (s * 2 - i > sB * 2 - lenB)
+                {
+                    sB = s;
+                    lenB = i;
+                }
+            }
+        }
+
+        if (lastScan + lenF > scan - lenB)
+        {
+            int32_t overlap = (lastScan + lenF) - (scan - lenB);
+            int32_t sS = 0, lenS = 0;
+            s = 0;
+            for (int32_t i = 0; i < overlap; i++)
+            {
+                if (nw[lastScan + lenF - overlap + i] == old[lastPos + lenF - overlap + i])
+                {
+                    s++;
+                }
+                if (nw[scan - lenB + i] == old[pos - lenB + i])
+                {
+                    s--;
+                }
+                if (s > sS)
+                {
+                    sS = s;
+                    lenS = i + 1;
+                }
+            }
+            lenF += lenS - overlap;
+            lenB -= lenS;
+        }
+
+        int32_t extraLen = (scan - lenB) - (lastScan + lenF);
+        int32_t seek = (pos - lenB) - (lastPos + lenF);
+        appendRecord(out, old, nw, lastScan, lastPos, lenF, extraLen, seek);
+        records++;
+
+        lastScan = scan - lenB;
+        lastPos = pos - lenB;
+        lastOffset = pos - scan;
+    }
+    return records;
+}
+
+// -- apply --
+
+typedef struct
+{
+    const bytes_t *old;
+    bytes_t *out;
+} applyCtx_t;
+
+static bool readOld(void *ctx, uint32_t offset, uint8_t *buf, size_t len)
+{
+    const bytes_t *old = ((applyCtx_t *)ctx)->old;
+    if ((size_t)offset + len > old->size())
+    {
+        return false;
+    }
+    memcpy(buf, old->data() + offset, len);
+    return true;
+}
+
+static bool writeNew(void *ctx, const uint8_t *data, size_t len)
+{
+    bytes_t *out = ((applyCtx_t *)ctx)->out;
+    out->insert(out->end(), data, data + len);
+    return true;
+}
+
+/****************************************************
+ * @brief applies a patch the way the device does:
+ *        the stream is inflated a network read at a
+ *        time and each piece fed as it comes out
+ *
+ * @param records  filled with the record count
+ * @return NULL on success, otherwise the reason
+ ****************************************************/
+static const char *applyPatch(const bytes_t &old, const bytes_t &patch, bytes_t *out, unsigned long *records)
+{
+    ota_delta_header_t hdr;
+    if (!bOtaDelta_parseHeader(patch.data(), patch.size(), &hdr))
+    {
+        return "not a patch or unknown version";
+    }
+    uint8_t hash[OTA_DELTA_HASH_LEN];
+    sha256(old, hash);
+    if ((hdr.oldSize != old.size()) || (memcmp(hash, hdr.oldSha, OTA_DELTA_HASH_LEN) != 0))
+    {
+        return "patch is for another old image";
+    }
+
+    applyCtx_t ctx = {&old, out};
+    static ota_delta_apply_t apply;
+    vOtaDelta_applyInit(&apply, &hdr, readOld, writeNew, &ctx);
+    out->clear();
+
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (inflateInit(&zs) != Z_OK)
+    {
+        return "zlib init failed";
+    }
+    uint8_t inflated[INFLATE_CHUNK];
+    size_t inPos = OTA_DELTA_HEADER_LEN;
+    int zerr = Z_OK;
+    bool applied = true;
+    while (applied && (zerr == Z_OK))
+    {
+        if (zs.avail_in == 0)
+        {
+            size_t chunk = std::min((size_t)INFLATE_CHUNK, patch.size() - inPos);
+            if (chunk == 0)
+            {
+                break;
+            }
+            zs.next_in = (Bytef *)patch.data() + inPos;
+            zs.avail_in = (uInt)chunk;
+            inPos += chunk;
+        }
+        zs.next_out = inflated;
+        zs.avail_out = sizeof(inflated);
+        zerr = inflate(&zs, Z_NO_FLUSH);
+        applied = bOtaDelta_applyFeed(&apply, inflated, sizeof(inflated) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    *records = apply.records;
+
+    if (zerr != Z_STREAM_END)
+    {
+        return "corrupt or truncated zlib stream";
+    }
+    if (!applied)
+    {
+        return "malformed record";
+    }
+    if (!bOtaDelta_applyDone(&apply))
+    {
+        return "patch ends before the new image";
+    }
+    sha256(*out, hash);
+    if (memcmp(hash, hdr.newSha, OTA_DELTA_HASH_LEN) != 0)
+    {
+        return "rebuilt image hash mismatch";
+    }
+    return NULL;
+}
+
+static int cmdDiff(const char *oldPath, const char *newPath, const char *patchPath, bool quiet)
+{
+    bytes_t old, nw;
+    if (!readFile(oldPath, &old) || !readFile(newPath, &nw))
+    {
+        return 1;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    ota_delta_header_t hdr;
+    hdr.oldSize = (uint32_t)old.size();
+    hdr.newSize = (uint32_t)nw.size();
+    sha256(old, hdr.oldSha);
+    sha256(nw, hdr.newSha);
+
+    bytes_t stream;
+    unsigned long records = diffRecords(old, nw, &stream);
+
+    bytes_t patch(OTA_DELTA_HEADER_LEN + compressBound(stream.size()));
+    uLongf packedLen = patch.size() - OTA_DELTA_HEADER_LEN;
+    uOtaDelta_formatHeader(&hdr, patch.data(), OTA_DELTA_HEADER_LEN);
+    if (compress2(patch.data() + OTA_DELTA_HEADER_LEN, &packedLen, stream.data(), stream.size(), Z_BEST_COMPRESSION) != Z_OK)
+    {
+        fprintf(stderr, "zlib compression failed\n");
+        return 1;
+    }
+    patch.resize(OTA_DELTA_HEADER_LEN + packedLen);
+    double diffMs = elapsedMs(start);
+
+    bytes_t rebuilt;
+    unsigned long applied = 0;
+    const char *err = applyPatch(old, patch, &rebuilt, &applied);
+    if (err != NULL)
+    {
+        fprintf(stderr, "%s: self-check failed: %s\n", patchPath, err);
+        return 1;
+    }
+    if (!writeFile(patchPath, patch))
+    {
+        return 1;
+    }
+
+    if (!quiet)
+    {
+        fprintf(stderr, "old %zu, new %zu, patch %zu bytes (%.1f%% of new), %lu records, %.0f ms\n",
+                old.size(), nw.size(), patch.size(), 100.0 * patch.size() / std::max<size_t>(nw.size(), 1),
+                records, diffMs);
+    }
+    return 0;
+}
+
+static int cmdApply(const char *oldPath, const char *patchPath, const char *newPath, bool quiet)
+{
+    bytes_t old, patch, nw;
+    if (!readFile(oldPath, &old) || !readFile(patchPath, &patch))
+    {
+        return 1;
+    }
+
+    unsigned long records = 0;
+    const char *err = applyPatch(old, patch, &nw, &records);
+    if (err != NULL)
+    {
+        fprintf(stderr, "%s: %s\n", patchPath, err);
+        return 1;
+    }
+    if (!writeFile(newPath, nw))
+    {
+        return 1;
+    }
+
+    if (!quiet)
+    {
+        fprintf(stderr, "%s: %zu bytes from %lu records, hash ok\n", newPath, nw.size(), records);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool quiet = false;
+    int arg = 1;
+
+    if ((arg < argc) && (strcmp(argv[arg], "-q") == 0))
+    {
+        quiet = true;
+        arg++;
+    }
+    if (argc - arg != 4)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (strcmp(argv[arg], "diff") == 0)
+    {
+        return cmdDiff(argv[arg + 1], argv[arg + 2], argv[arg + 3], quiet);
+    }
+    if (strcmp(argv[arg], "apply") == 0)
+    {
+        return cmdApply(argv[arg + 1], argv[arg + 2], argv[arg + 3], quiet);
+    }
+    usage(argv[0]);
+    return 2;
+}
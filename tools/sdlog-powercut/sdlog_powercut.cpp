@@ -0,0 +1,526 @@
+/****************************************************
+ * @file    sdlog_powercut.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Power-cut injection test of the SD log writer for the Milano Smart Park project
+ * @details Replays the daily log write sequence of sdlog.cpp (sector-sized
+ *          block writes, journal -> write+sync -> journal removal) on a
+ *          simulated card and cuts power at every write boundary, and inside
+ *          every write with torn variants. After each cut it runs the
+ *          firmware's own recovery (log_journal.cpp) and torn-tail rule
+ *          (log_codec.cpp), appends again and checks the day file: only whole
+ *          lines/records, in order, nothing lost that a completed journal
+ *          record covered. Recovery itself is cut as well.
+ *
+ *          Build: make sdlog-powercut   (see tools/sdlog-powercut/README.md)
+ * @version 0.1
+ * @date    2025-09-12
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_codec.h"
+#include "log_journal.h"
+
+// Mirrors of the firmware constants this test models (sdlog.h / sdlog.cpp)
+#define SIM_BLOCK_SIZE 512
+#define SIM_READ_LINE_MAX 320
+#define SIM_JOURNAL_PATH "/sdlog.jnl"
+#define SIM_CSV_PATH "/2025/09/12.csv"
+#define SIM_BIN_PATH "/2025/09/12.bin"
+#define SIM_LINE_END "\r\n"
+
+#define SIM_RECORDS_BEFORE 40 // records written before the cut
+#define SIM_RECORDS_AFTER 3   // records appended after the reboot
+#define SIM_FLUSH_EVERY 7     // timer flush every N records
+#define SIM_RECOVERY_OPS_MAX 8
+
+typedef enum
+{
+    SIM_CUT_BEFORE = 0,   // op not started
+    SIM_CUT_PREFIX_ONE,   // one byte landed
+    SIM_CUT_PREFIX_HALF,  // half the bytes landed
+    SIM_CUT_PREFIX_LAST,  // all but one byte landed
+    SIM_CUT_GARBAGE_TAIL, // size committed, second half of the data is not
+    SIM_CUT_VARIANTS
+} sim_cut_t;
+
+static const char *cutNames[SIM_CUT_VARIANTS] = {"before", "1 byte", "half", "all-1", "garbage tail"};
+
+struct PowerCut
+{
+};
+
+// Simulated card: durable file contents plus the cut trigger
+struct SimCard
+{
+    std::map<std::string, std::vector<uint8_t>> files;
+    long ops = 0;
+    long cutAt = -1;
+    sim_cut_t variant = SIM_CUT_BEFORE;
+
+    // Every durable operation passes here; returns how many bytes of a write land
+    size_t begin(size_t len)
+    {
+        if (ops++ != cutAt)
+        {
+            return len;
+        }
+        switch (variant)
+        {
+        case SIM_CUT_PREFIX_ONE:
+            return (len > 0) ? 1 : 0;
+        case SIM_CUT_PREFIX_HALF:
+        case SIM_CUT_GARBAGE_TAIL:
+            return len / 2;
+        case SIM_CUT_PREFIX_LAST:
+            return (len > 0) ? (len - 1) : 0;
+        default:
+            return 0;
+        }
+    }
+
+    bool cutNow() const
+    {
+        return (ops - 1) == cutAt;
+    }
+
+    void writeAt(const std::string &path, size_t offset, const uint8_t *data, size_t len)
+    {
+        size_t landed = begin(len);
+        std::vector<uint8_t> &f = files[path];
+        if (f.size() < offset)
+        {
+            f.resize(offset, 0);
+        }
+        size_t end = offset + landed;
+        if (cutNow() && (variant == SIM_CUT_GARBAGE_TAIL))
+        {
+            end = offset + len;
+        }
+        if (f.size() < end)
+        {
+            f.resize(end, 0xFF);
+        }
+        memcpy(f.data() + offset, data, landed);
+        if (cutNow())
+        {
+            throw PowerCut();
+        }
+    }
+
+    void create(const std::string &path, const uint8_t *data, size_t len)
+    {
+        files[path].clear();
+        writeAt(path, 0, data, len);
+    }
+
+    void remove(const std::string &path)
+    {
+        begin(0);
+        if (cutNow())
+        {
+            throw PowerCut();
+        }
+        files.erase(path);
+    }
+
+    void truncate(const std::string &path, size_t len)
+    {
+        begin(0);
+        if (cutNow())
+        {
+            throw PowerCut();
+        }
+        files[path].resize(len);
+    }
+};
+
+// -- log_journal_io_t on the simulated card --
+static long simSize(void *ctx, const char *path)
+{
+    SimCard *card = (SimCard *)ctx;
+    auto it = card->files.find(path);
+    return (it == card->files.end()) ? -1 : (long)it->second.size();
+}
+
+static size_t simRead(void *ctx, const char *path, uint32_t offset, uint8_t *buf, size_t len)
+{
+    SimCard *card = (SimCard *)ctx;
+    const std::vector<uint8_t> &f = card->files[path];
+    if (offset > f.size())
+    {
+        return 0;
+    }
+    size_t got = ((f.size() - offset) < len) ? (f.size() - offset) : len;
+    memcpy(buf, f.data() + offset, got);
+    return got;
+}
+
+static bool simWriteAt(void *ctx, const char *path, uint32_t offset, const uint8_t *data, size_t len)
+{
+    ((SimCard *)ctx)->writeAt(path, offset, data, len);
+    return true;
+}
+
+static bool simTruncate(void *ctx, const char *path, uint32_t len)
+{
+    ((SimCard *)ctx)->truncate(path, len);
+    return true;
+}
+
+static bool simRemove(void *ctx, const char *path)
+{
+    ((SimCard *)ctx)->remove(path);
+    return true;
+}
+
+// Writer model of one sdlog channel
+struct SimWriter
+{
+    SimCard &card;
+    std::string path;
+    bool binary;
+    bool open = false;
+    size_t fileBytes = 0;
+    std::vector<uint8_t> buffer;
+    size_t journaledBytes = 0; // file length covered by completed journal records
+
+    SimWriter(SimCard &c, const char *p, bool bin) : card(c), path(p), binary(bin) {}
+
+    // uSdlog_commitWrite(): journal, write + sync, drop the journal
+    void commit(const uint8_t *data, size_t len)
+    {
+        uint8_t record[LOG_JOURNAL_RECORD_MAX];
+        size_t headerLen = uLogJournal_formatHeader(path.c_str(), (uint32_t)fileBytes, data, len, 0, record, sizeof(record));
+        memcpy(record + headerLen, path.data(), path.size());
+        memcpy(record + headerLen + path.size(), data, len);
+        card.create(SIM_JOURNAL_PATH, record, headerLen + path.size() + len);
+        journaledBytes = fileBytes + len;
+        card.writeAt(path, fileBytes, data, len);
+        fileBytes += len;
+        card.remove(SIM_JOURNAL_PATH);
+    }
+
+    // vSdlog_trimTornTail() + bSdlog_openDay()
+    void openDay()
+    {
+        auto it = card.files.find(path);
+        if (it != card.files.end())
+        {
+            std::vector<uint8_t> &f = it->second;
+            size_t complete = f.size();
+            if (binary)
+            {
+                complete = uLogCodec_binCompleteLength(f.size());
+            }
+            else if (!f.empty())
+            {
+                size_t tailLen = (f.size() > SIM_READ_LINE_MAX) ? SIM_READ_LINE_MAX : f.size();
+                complete = uLogCodec_csvCompleteLength((const char *)f.data() + f.size() - tailLen, tailLen, f.size());
+            }
+            if (complete < f.size())
+            {
+                card.truncate(path, complete);
+            }
+        }
+        fileBytes = (it != card.files.end()) ? card.files[path].size() : 0;
+        open = true;
+        if (fileBytes == 0)
+        {
+            uint8_t header[LOG_CSV_LINE_MAX_LEN];
+            size_t headerLen;
+            if (binary)
+            {
+                struct tm day = {};
+                day.tm_year = 125;
+                day.tm_mon = 8;
+                day.tm_mday = 12;
+                headerLen = uLogCodec_formatBinHeader(&day, header, sizeof(header));
+            }
+            else
+            {
+                headerLen = (size_t)snprintf((char *)header, sizeof(header), "%s" SIM_LINE_END, CSV_HEADER);
+            }
+            commit(header, headerLen);
+        }
+    }
+
+    void append(const uint8_t *data, size_t len)
+    {
+        if (!open)
+        {
+            openDay();
+        }
+        buffer.insert(buffer.end(), data, data + len);
+        if (buffer.size() >= SIM_BLOCK_SIZE)
+        {
+            size_t whole = buffer.size() - (buffer.size() % SIM_BLOCK_SIZE);
+            commit(buffer.data(), whole);
+            buffer.erase(buffer.begin(), buffer.begin() + whole);
+        }
+    }
+
+    void flush()
+    {
+        if (!buffer.empty())
+        {
+            commit(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+    }
+};
+
+static void makeRecord(int i, send_data_t *data, struct tm *t)
+{
+    memset(data, 0, sizeof(*data));
+    memset(t, 0, sizeof(*t));
+    t->tm_year = 125;
+    t->tm_mon = 8;
+    t->tm_mday = 12;
+    t->tm_hour = (i / 60) % 24;
+    t->tm_min = i % 60;
+    data->temp = 20.0f + (float)(i % 13) * 0.37f;
+    data->hum = 40.0f + (float)(i % 7);
+    data->pre = 1000.0f + (float)i * 0.1f;
+    data->VOC = 12.3f;
+    data->PM1 = i % 9;
+    data->PM25 = 10 + (i % 11);
+    data->PM10 = 20 + (i % 5);
+    data->MICS_CO = 400.0f;
+    data->MICS_NO2 = 15.5f;
+    data->MICS_NH3 = 3.2f;
+    data->ozone = 55.1f;
+    data->MSP = (int8_t)(i % 5);
+}
+
+// Bytes of record i as the writer hands them to sdlog
+static std::vector<uint8_t> recordBytes(int i, bool binary)
+{
+    send_data_t data;
+    struct tm t;
+    uint8_t flags = LOG_BIN_FLAG_DATETIME | LOG_BIN_FLAG_BME680 | LOG_BIN_FLAG_PMS5003 | LOG_BIN_FLAG_MICS6814 | LOG_BIN_FLAG_O3;
+    makeRecord(i, &data, &t);
+
+    if (binary)
+    {
+        log_bin_record_t rec;
+        vLogCodec_encodeBin(&t, flags, &data, &rec);
+        return std::vector<uint8_t>((uint8_t *)&rec, (uint8_t *)&rec + sizeof(rec));
+    }
+    char line[LOG_CSV_LINE_MAX_LEN];
+    int len = iLogCodec_formatCsvLine(&t, flags, &data, line, sizeof(line));
+    std::vector<uint8_t> out(line, line + len);
+    out.insert(out.end(), SIM_LINE_END, SIM_LINE_END + strlen(SIM_LINE_END));
+    return out;
+}
+
+static void writeRecords(SimWriter &w, int from, int count)
+{
+    for (int i = from; i < (from + count); i++)
+    {
+        std::vector<uint8_t> rec = recordBytes(i, w.binary);
+        w.append(rec.data(), rec.size());
+        if (((i + 1) % SIM_FLUSH_EVERY) == 0)
+        {
+            w.flush();
+        }
+    }
+}
+
+/****************************************************
+ * @brief checks a day file after recovery and the
+ *        post-reboot appends
+ *
+ * @param f         file bytes
+ * @param binary    record format
+ * @param mustKeep  bytes covered by a completed
+ *                  journal record before the cut
+ * @param why       failure description
+ * @return true if consistent
+ ****************************************************/
+static bool verifyDay(const std::vector<uint8_t> &f, bool binary, size_t mustKeep, std::string *why)
+{
+    // Expected: header, records 0..n-1, then the post-reboot records
+    std::vector<uint8_t> expect;
+    if (binary)
+    {
+        uint8_t header[LOG_BIN_HEADER_LEN];
+        struct tm day = {};
+        day.tm_year = 125;
+        day.tm_mon = 8;
+        day.tm_mday = 12;
+        uLogCodec_formatBinHeader(&day, header, sizeof(header));
+        expect.assign(header, header + sizeof(header));
+    }
+    else
+    {
+        std::string header = std::string(CSV_HEADER) + SIM_LINE_END;
+        expect.assign(header.begin(), header.end());
+    }
+
+    std::vector<uint8_t> after;
+    for (int i = 0; i < SIM_RECORDS_AFTER; i++)
+    {
+        std::vector<uint8_t> rec = recordBytes(1000 + i, binary);
+        after.insert(after.end(), rec.begin(), rec.end());
+    }
+
+    for (int n = 0; n <= SIM_RECORDS_BEFORE; n++)
+    {
+        std::vector<uint8_t> candidate = expect;
+        candidate.insert(candidate.end(), after.begin(), after.end());
+        std::vector<uint8_t> rec = recordBytes(n, binary);
+        if (candidate == f)
+        {
+            // mustKeep may end mid-record: every whole record before it has to survive
+            if ((n < SIM_RECORDS_BEFORE) && ((expect.size() + rec.size()) <= mustKeep))
+            {
+                *why = "journaled record lost";
+                return false;
+            }
+            return true;
+        }
+        expect.insert(expect.end(), rec.begin(), rec.end());
+    }
+    *why = "day file is not header + whole records in order";
+    return false;
+}
+
+static log_journal_recovery_t recover(SimCard &card)
+{
+    static uint8_t scratch[LOG_JOURNAL_RECORD_MAX];
+    log_journal_io_t io = {&card, simSize, simRead, simWriteAt, simTruncate, simRemove};
+    return tLogJournal_recover(&io, SIM_JOURNAL_PATH, scratch, sizeof(scratch));
+}
+
+/****************************************************
+ * @brief one scenario: cut the write sequence at op
+ *        @p cutAt, optionally cut recovery at op
+ *        @p recoveryCutAt, reboot, append, verify
+ ****************************************************/
+static bool runScenario(bool binary, long cutAt, sim_cut_t variant, long recoveryCutAt, sim_cut_t recoveryVariant,
+                        bool *cutHappened, long *recoveryOps, std::string *why)
+{
+    SimCard card;
+    const char *path = binary ? SIM_BIN_PATH : SIM_CSV_PATH;
+    size_t mustKeep = 0;
+
+    card.cutAt = cutAt;
+    card.variant = variant;
+    *cutHappened = false;
+    {
+        SimWriter w(card, path, binary);
+        try
+        {
+            writeRecords(w, 0, SIM_RECORDS_BEFORE);
+            w.flush();
+        }
+        catch (const PowerCut &)
+        {
+            *cutHappened = true;
+        }
+        mustKeep = w.journaledBytes; // only set once the journal record is complete
+    }
+    if (!*cutHappened)
+    {
+        return true;
+    }
+
+    // Reboot: recovery, possibly cut itself, then a clean one
+    card.ops = 0;
+    card.cutAt = recoveryCutAt;
+    card.variant = recoveryVariant;
+    try
+    {
+        recover(card);
+    }
+    catch (const PowerCut &)
+    {
+        card.ops = 0;
+        card.cutAt = -1;
+        recover(card);
+    }
+    *recoveryOps = card.ops;
+    card.cutAt = -1;
+
+    if (card.files.count(SIM_JOURNAL_PATH) > 0)
+    {
+        *why = "journal left after recovery";
+        return false;
+    }
+
+    SimWriter w(card, path, binary);
+    writeRecords(w, 1000, SIM_RECORDS_AFTER);
+    w.flush();
+    card.files.erase(SIM_JOURNAL_PATH);
+    return verifyDay(card.files[path], binary, mustKeep, why);
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = (argc > 1) && (strcmp(argv[1], "-v") == 0);
+    unsigned long scenarios = 0;
+    unsigned long failures = 0;
+    long maxRecoveryOps = 0;
+
+    for (int format = 0; format < 2; format++)
+    {
+        bool binary = (format == 1);
+        unsigned long formatScenarios = 0;
+
+        for (long cutAt = 0;; cutAt++)
+        {
+            bool anyCut = false;
+            for (int v = 0; v < SIM_CUT_VARIANTS; v++)
+            {
+                for (long rc = -1; rc < SIM_RECOVERY_OPS_MAX; rc++)
+                {
+                    for (int rv = 0; rv < ((rc < 0) ? 1 : SIM_CUT_VARIANTS); rv++)
+                    {
+                        bool cut;
+                        long recoveryOps = 0;
+                        std::string why;
+                        bool ok = runScenario(binary, cutAt, (sim_cut_t)v, rc, (sim_cut_t)rv, &cut, &recoveryOps, &why);
+                        if (!cut)
+                        {
+                            continue;
+                        }
+                        anyCut = true;
+                        scenarios++;
+                        formatScenarios++;
+                        if (recoveryOps > maxRecoveryOps)
+                        {
+                            maxRecoveryOps = recoveryOps;
+                        }
+                        if (!ok)
+                        {
+                            failures++;
+                            if (verbose || (failures <= 10))
+                            {
+                                printf("FAIL %s: cut at op %ld (%s), recovery cut %ld (%s): %s\n",
+                                       binary ? "bin" : "csv", cutAt, cutNames[v], rc, cutNames[rv], why.c_str());
+                            }
+                        }
+                    }
+                }
+            }
+            if (!anyCut)
+            {
+                printf("%s: %ld write ops, %lu power-cut scenarios\n", binary ? "bin" : "csv", cutAt, formatScenarios);
+                break;
+            }
+        }
+    }
+
+    printf("%lu scenarios, %lu failures, recovery took at most %ld card ops\n", scenarios, failures, maxRecoveryOps);
+    return (failures > 0) ? 1 : 0;
+}
@@ -0,0 +1,585 @@
+/****************************************************
+ * @file    sdlog_prealloc.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Day file preallocation benchmark of the SD log writer for the Milano Smart Park project
+ * @details Replays days of the sdlog.cpp write pattern (journaled sector
+ *          writes to the day file and its index, CSV and/or binary) on a
+ *          FatFs-like allocation model: cluster chains grown by
+ *          create_chain() from the file's last cluster, a one-sector FAT
+ *          window mirrored to both FATs, FSINFO and directory entries
+ *          written on sync. Runs the plain append writer and the
+ *          preallocating one side by side and reports the metadata writes,
+ *          the block writes that had to grow a chain and the fragments of
+ *          the closed day files.
+ *
+ *          Build: make sdlog-prealloc   (see tools/sdlog-prealloc/README.md)
+ * @version 0.1
+ * @date    2025-09-15
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log_codec.h"
+#include "log_journal.h"
+
+// Mirrors of the firmware constants this benchmark models (sdlog.h / sdlog.cpp)
+#define SIM_SECTOR_SIZE 512
+#define SIM_BUFFER_SIZE (2 * SIM_SECTOR_SIZE)
+#define SIM_FLUSH_INTERVAL_SEC (10 * 60)
+#define SIM_INDEX_STRIDE 16
+#define SIM_INDEX_PENDING 4
+#define SIM_INDEX_ENTRY_LEN 8
+#define SIM_PREALLOC_CSV_BYTES (64 * 1024)
+#define SIM_PREALLOC_BIN_BYTES (16 * 1024)
+#define SIM_PREALLOC_MAX_BYTES (512 * 1024)
+#define SIM_JOURNAL_PATH "/sdlog.jnl"
+#define SIM_PREALLOC_PATH "/sdlog.pre"
+#define SIM_LINE_END "\r\n"
+
+#define SIM_FAT_ENTRY_LEN 4 // FAT32
+#define SIM_FAT_COPIES 2
+#define SIM_EOC 0x0FFFFFFFu
+#define SIM_CARD_CLUSTERS (256 * 1024)
+#define SIM_SECONDS_PER_DAY (24 * 60 * 60)
+
+struct Counters
+{
+    unsigned long dataSectors = 0;    // data sectors written, zero fill included
+    unsigned long fillSectors = 0;    // of which preallocation zero fill
+    unsigned long fatSectors = 0;     // FAT sector writes, all copies
+    unsigned long fsinfoSectors = 0;  // FSINFO sector writes
+    unsigned long dirSectors = 0;     // directory sector writes
+    unsigned long blockWrites = 0;    // day file block writes
+    unsigned long growingWrites = 0;  // day file block writes that allocated clusters
+    unsigned long dayFiles = 0;
+    unsigned long fragments = 0;      // cluster runs over all closed day files
+    unsigned long maxFragments = 0;
+};
+
+// FAT32 volume: allocation only, file data is not kept
+struct FatVolume
+{
+    size_t clusterBytes;
+    std::vector<uint32_t> fat;
+    uint32_t lastClst = 2;
+    long window = -1;   // FAT sector in the window
+    bool windowDirty = false;
+    bool fsinfoDirty = false;
+    Counters *cnt = nullptr;
+
+    explicit FatVolume(size_t cluster) : clusterBytes(cluster), fat(SIM_CARD_CLUSTERS, 0) {}
+
+    void moveWindow(uint32_t clst)
+    {
+        long sector = (long)((clst * SIM_FAT_ENTRY_LEN) / SIM_SECTOR_SIZE);
+        if (sector != window)
+        {
+            flushWindow();
+            window = sector;
+        }
+    }
+
+    void flushWindow()
+    {
+        if (windowDirty)
+        {
+            cnt->fatSectors += SIM_FAT_COPIES;
+            windowDirty = false;
+        }
+    }
+
+    void setFat(uint32_t clst, uint32_t val)
+    {
+        moveWindow(clst);
+        fat[clst] = val;
+        windowDirty = true;
+        fsinfoDirty = true;
+    }
+
+    // FatFs create_chain(): the cluster after @p clst if free, else the next free one
+    uint32_t createChain(uint32_t clst)
+    {
+        uint32_t scl = (clst == 0) ? lastClst : clst;
+        uint32_t ncl = scl;
+        for (;;)
+        {
+            ncl = (ncl + 1 < fat.size()) ? (ncl + 1) : 2;
+            moveWindow(ncl);
+            if (fat[ncl] == 0)
+            {
+                break;
+            }
+            if (ncl == scl)
+            {
+                fprintf(stderr, "simulated card full\n");
+                exit(2);
+            }
+        }
+        setFat(ncl, SIM_EOC);
+        if (clst != 0)
+        {
+            setFat(clst, ncl);
+        }
+        lastClst = ncl;
+        return ncl;
+    }
+
+    // FatFs sync_fs(): window, then FSINFO
+    void syncFs()
+    {
+        flushWindow();
+        if (fsinfoDirty)
+        {
+            cnt->fsinfoSectors++;
+            fsinfoDirty = false;
+        }
+    }
+};
+
+struct SimFile
+{
+    std::vector<uint32_t> chain;
+    size_t size = 0;
+};
+
+// File layer: the calls sdlog.cpp makes through the SD library
+struct SimCard
+{
+    FatVolume vol;
+    std::map<std::string, SimFile> files;
+    Counters cnt;
+
+    explicit SimCard(size_t cluster) : vol(cluster)
+    {
+        vol.cnt = &cnt;
+    }
+
+    // Returns the number of clusters the write had to add
+    size_t write(const std::string &path, size_t offset, size_t len, bool fill = false)
+    {
+        SimFile &f = files[path];
+        size_t end = offset + len;
+        size_t grown = 0;
+        while ((f.chain.size() * vol.clusterBytes) < end)
+        {
+            f.chain.push_back(vol.createChain(f.chain.empty() ? 0 : f.chain.back()));
+            grown++;
+        }
+        size_t sectors = ((end + SIM_SECTOR_SIZE - 1) / SIM_SECTOR_SIZE) - (offset / SIM_SECTOR_SIZE);
+        cnt.dataSectors += sectors;
+        if (fill)
+        {
+            cnt.fillSectors += sectors;
+        }
+        if (end > f.size)
+        {
+            f.size = end;
+        }
+        return grown;
+    }
+
+    // f_sync(): directory entry, FAT window, FSINFO
+    void sync()
+    {
+        cnt.dirSectors++;
+        vol.syncFs();
+    }
+
+    void remove(const std::string &path)
+    {
+        auto it = files.find(path);
+        if (it == files.end())
+        {
+            return;
+        }
+        for (uint32_t clst : it->second.chain)
+        {
+            vol.setFat(clst, 0);
+        }
+        files.erase(it);
+        sync();
+    }
+
+    void truncate(const std::string &path, size_t len)
+    {
+        SimFile &f = files[path];
+        size_t keep = (len + vol.clusterBytes - 1) / vol.clusterBytes;
+        while (f.chain.size() > keep)
+        {
+            vol.setFat(f.chain.back(), 0);
+            f.chain.pop_back();
+        }
+        if (!f.chain.empty())
+        {
+            vol.setFat(f.chain.back(), SIM_EOC);
+        }
+        f.size = len;
+        sync();
+    }
+
+    unsigned long fragments(const std::string &path)
+    {
+        const SimFile &f = files[path];
+        unsigned long runs = f.chain.empty() ? 0 : 1;
+        for (size_t i = 1; i < f.chain.size(); i++)
+        {
+            runs += (f.chain[i] != (f.chain[i - 1] + 1)) ? 1 : 0;
+        }
+        return runs;
+    }
+};
+
+// One sdlog channel
+struct SimChannel
+{
+    bool binary = false;
+    bool prealloc = false;
+    std::string path;
+    size_t used = 0;
+    size_t fileBytes = 0;
+    size_t capacity = 0;
+    size_t lastDayBytes = 0;
+    size_t preallocDefault = 0;
+    long oldestSec = 0;
+    int sinceIndex = 0;
+    int pendingIndex = 0;
+    bool listed = false; // in SIM_PREALLOC_PATH
+};
+
+struct SimWriter
+{
+    SimCard &card;
+    SimChannel ch[2];
+    int channels;
+
+    SimWriter(SimCard &c, bool prealloc, bool csv, bool bin) : card(c), channels(0)
+    {
+        if (csv)
+        {
+            ch[channels].preallocDefault = SIM_PREALLOC_CSV_BYTES;
+            ch[channels++].prealloc = prealloc;
+        }
+        if (bin)
+        {
+            ch[channels].binary = true;
+            ch[channels].preallocDefault = SIM_PREALLOC_BIN_BYTES;
+            ch[channels++].prealloc = prealloc;
+        }
+    }
+
+    // uSdlog_commitWrite(): journal create/write/close, target write+flush, journal remove
+    size_t commitWrite(const std::string &path, size_t offset, size_t len)
+    {
+        card.write(SIM_JOURNAL_PATH, 0, LOG_JOURNAL_HEADER_LEN + path.size() + len);
+        card.sync();
+        size_t grown = card.write(path, offset, len);
+        card.sync();
+        card.remove(SIM_JOURNAL_PATH);
+        return grown;
+    }
+
+    void writeMarker()
+    {
+        bool any = false;
+        for (int i = 0; i < channels; i++)
+        {
+            any = any || ch[i].listed;
+        }
+        card.remove(SIM_PREALLOC_PATH);
+        if (any)
+        {
+            card.write(SIM_PREALLOC_PATH, 0, 2 * 20);
+            card.sync();
+        }
+    }
+
+    void preallocate(SimChannel &c, size_t target)
+    {
+        target = ((target + SIM_SECTOR_SIZE - 1) / SIM_SECTOR_SIZE) * SIM_SECTOR_SIZE;
+        if (target <= c.capacity)
+        {
+            return;
+        }
+        if (!c.listed)
+        {
+            c.listed = true;
+            writeMarker();
+        }
+        card.write(c.path, c.capacity, target - c.capacity, true);
+        card.sync();
+        c.capacity = target;
+        if (c.binary)
+        {
+            commitWrite(c.path, 0, LOG_BIN_HEADER_LEN); // data end checkpoint
+        }
+    }
+
+    void openDay(SimChannel &c, const std::string &path)
+    {
+        c.path = path;
+        size_t header = c.binary ? LOG_BIN_HEADER_LEN : (strlen(CSV_HEADER) + strlen(SIM_LINE_END));
+        card.sync(); // file created
+        commitWrite(c.path, 0, header);
+        c.fileBytes = header;
+        c.capacity = header;
+        card.cnt.dayFiles++;
+        if (c.prealloc)
+        {
+            size_t target = c.lastDayBytes + (c.lastDayBytes / 4);
+            target = (target < c.preallocDefault) ? c.preallocDefault : target;
+            target = (target > SIM_PREALLOC_MAX_BYTES) ? SIM_PREALLOC_MAX_BYTES : target;
+            preallocate(c, target);
+        }
+    }
+
+    void writeOut(SimChannel &c, size_t len)
+    {
+        if (len == 0)
+        {
+            return;
+        }
+        if (c.prealloc && ((c.fileBytes + len) > c.capacity))
+        {
+            preallocate(c, c.fileBytes + len + c.preallocDefault);
+        }
+        card.cnt.blockWrites++;
+        if (commitWrite(c.path, c.fileBytes, len) > 0)
+        {
+            card.cnt.growingWrites++;
+        }
+        c.fileBytes += len;
+        c.capacity = (c.fileBytes > c.capacity) ? c.fileBytes : c.capacity;
+        c.used -= len;
+    }
+
+    void writeIndex(SimChannel &c)
+    {
+        if (c.pendingIndex > 0)
+        {
+            std::string idx = c.path + ".idx";
+            commitWrite(idx, card.files[idx].size, (size_t)c.pendingIndex * SIM_INDEX_ENTRY_LEN);
+            card.sync(); // close
+            c.pendingIndex = 0;
+        }
+    }
+
+    void flush(SimChannel &c)
+    {
+        if (c.used > 0)
+        {
+            writeOut(c, c.used);
+            writeIndex(c);
+        }
+    }
+
+    void closeDay(SimChannel &c)
+    {
+        if (c.path.empty())
+        {
+            return;
+        }
+        flush(c);
+        if (c.binary && c.prealloc)
+        {
+            commitWrite(c.path, 0, LOG_BIN_HEADER_LEN);
+        }
+        card.sync();
+        if (c.listed)
+        {
+            if (c.capacity > c.fileBytes)
+            {
+                card.truncate(c.path, c.fileBytes);
+            }
+            c.listed = false;
+            writeMarker();
+            c.lastDayBytes = c.fileBytes;
+        }
+        unsigned long runs = card.fragments(c.path);
+        card.cnt.fragments += runs;
+        card.cnt.maxFragments = (runs > card.cnt.maxFragments) ? runs : card.cnt.maxFragments;
+    }
+
+    void append(SimChannel &c, const std::string &dayPath, long nowSec, size_t len)
+    {
+        if (dayPath != c.path)
+        {
+            closeDay(c);
+            c.used = 0;
+            c.sinceIndex = 0;
+            c.pendingIndex = 0;
+            openDay(c, dayPath);
+        }
+        if ((c.used + len) > SIM_BUFFER_SIZE)
+        {
+            writeOut(c, c.used);
+        }
+        if (c.used == 0)
+        {
+            c.oldestSec = nowSec;
+        }
+        if (c.sinceIndex == 0)
+        {
+            if (c.pendingIndex == SIM_INDEX_PENDING)
+            {
+                writeIndex(c);
+            }
+            c.pendingIndex++;
+        }
+        c.sinceIndex = (c.sinceIndex + 1) % SIM_INDEX_STRIDE;
+        c.used += len;
+        if (c.used >= SIM_SECTOR_SIZE)
+        {
+            writeOut(c, c.used - (c.used % SIM_SECTOR_SIZE));
+        }
+    }
+
+    void poll(long nowSec)
+    {
+        for (int i = 0; i < channels; i++)
+        {
+            if ((ch[i].used > 0) && ((nowSec - ch[i].oldestSec) >= SIM_FLUSH_INTERVAL_SEC))
+            {
+                flush(ch[i]);
+            }
+        }
+    }
+
+    void finish()
+    {
+        for (int i = 0; i < channels; i++)
+        {
+            closeDay(ch[i]);
+        }
+    }
+};
+
+static size_t csvLineLen(int minute)
+{
+    send_data_t data;
+    struct tm t;
+    memset(&data, 0, sizeof(data));
+    memset(&t, 0, sizeof(t));
+    t.tm_year = 125;
+    t.tm_mon = 8;
+    t.tm_mday = 15;
+    t.tm_hour = (minute / 60) % 24;
+    t.tm_min = minute % 60;
+    data.temp = 20.0f + (float)(minute % 13) * 0.37f;
+    data.hum = 40.0f + (float)(minute % 7);
+    data.pre = 1000.0f + (float)(minute % 100) * 0.1f;
+    data.VOC = 12.3f;
+    data.PM1 = minute % 9;
+    data.PM25 = 10 + (minute % 11);
+    data.PM10 = 20 + (minute % 5);
+    data.MICS_CO = 400.0f;
+    data.MICS_NO2 = 15.5f;
+    data.MICS_NH3 = 3.2f;
+    data.ozone = 55.1f;
+    uint8_t flags = LOG_BIN_FLAG_DATETIME | LOG_BIN_FLAG_BME680 | LOG_BIN_FLAG_PMS5003 | LOG_BIN_FLAG_MICS6814 | LOG_BIN_FLAG_O3;
+    char line[LOG_CSV_LINE_MAX_LEN];
+    int len = iLogCodec_formatCsvLine(&t, flags, &data, line, sizeof(line));
+    return (size_t)len + strlen(SIM_LINE_END);
+}
+
+static Counters runDays(bool prealloc, size_t clusterBytes, int days, int intervalSec, bool csv, bool bin)
+{
+    SimCard card(clusterBytes);
+    SimWriter w(card, prealloc, csv, bin);
+
+    for (long now = 0; now < ((long)days * SIM_SECONDS_PER_DAY); now += intervalSec)
+    {
+        int day = (int)(now / SIM_SECONDS_PER_DAY);
+        int minute = (int)((now % SIM_SECONDS_PER_DAY) / 60);
+        char base[32];
+        snprintf(base, sizeof(base), "/2025/09/%02d", 15 + day);
+        for (int i = 0; i < w.channels; i++)
+        {
+            size_t len = w.ch[i].binary ? sizeof(log_bin_record_t) : csvLineLen(minute);
+            w.append(w.ch[i], std::string(base) + (w.ch[i].binary ? ".bin" : ".csv"), now, len);
+        }
+        // Daily health row and other small writers also take clusters between the day files
+        if ((now % SIM_SECONDS_PER_DAY) == 0)
+        {
+            card.write("/sd_health.csv", card.files["/sd_health.csv"].size, 96);
+            card.sync();
+        }
+        w.poll(now);
+    }
+    w.finish();
+    return card.cnt;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-c cluster_bytes] [-d days] [-i interval_sec] [-f csv|bin|both]\n"
+            "  defaults: -c 32768 -d 7 -i 60 -f both\n",
+            prog);
+}
+
+static void printRow(const char *name, const Counters &c)
+{
+    printf("%-9s %9lu %8lu %7lu %7lu %7lu %9lu/%-7lu %6.1f %5lu\n", name, c.dataSectors, c.fillSectors, c.fatSectors,
+           c.fsinfoSectors, c.dirSectors, c.growingWrites, c.blockWrites,
+           (c.dayFiles > 0) ? ((double)c.fragments / c.dayFiles) : 0.0, c.maxFragments);
+}
+
+int main(int argc, char **argv)
+{
+    size_t clusterBytes = 32768;
+    int days = 7;
+    int intervalSec = 60;
+    bool csv = true;
+    bool bin = true;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc))
+        {
+            clusterBytes = strtoul(argv[++i], NULL, 10);
+        }
+        else if ((strcmp(argv[i], "-d") == 0) && ((i + 1) < argc))
+        {
+            days = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-i") == 0) && ((i + 1) < argc))
+        {
+            intervalSec = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc))
+        {
+            i++;
+            csv = (strcmp(argv[i], "bin") != 0);
+            bin = (strcmp(argv[i], "csv") != 0);
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if ((clusterBytes < SIM_SECTOR_SIZE) || ((clusterBytes % SIM_SECTOR_SIZE) != 0) || (days <= 0) || (intervalSec <= 0))
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%d days, a record every %d s, %s, %lu byte clusters\n\n", days, intervalSec,
+           (csv && bin) ? "csv+bin" : (csv ? "csv" : "bin"), (unsigned long)clusterBytes);
+    printf("%-9s %9s %8s %7s %7s %7s %17s %6s %5s\n", "writer", "data", "fill", "FAT", "FSINFO", "dir",
+           "growing/blocks", "frag", "max");
+    Counters append = runDays(false, clusterBytes, days, intervalSec, csv, bin);
+    Counters prealloc = runDays(true, clusterBytes, days, intervalSec, csv, bin);
+    printRow("append", append);
+    printRow("prealloc", prealloc);
+    return 0;
+}
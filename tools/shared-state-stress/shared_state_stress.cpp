@@ -0,0 +1,120 @@
+/****************************************************
+ * @file    shared_state_stress.cpp
+ * @author  AB-Engineering - https://ab-engineering.it
+ * @brief   Two-thread stress test of the shared state seqlock for the Milano Smart Park project
+ * @details Links the firmware's shared_state.cpp against the display
+ *          renderer's host stand-ins. A writer thread publishes a
+ *          256-byte state whose words all hold the write number, a
+ *          reader thread copies it as fast as it can: every copy must
+ *          hold one write number only (no torn read) and the numbers
+ *          must never go back.
+ *
+ *          Build: make shared-state-stress   (see tools/shared-state-stress/README.md)
+ * @version 0.1
+ * @date    2025-10-24
+ *
+ * @copyright Copyright (c) 2025
+ *
+ ****************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "shared_state.h"
+
+#define STRESS_WORDS 64
+#define STRESS_DEFAULT_WRITES 3000000UL
+
+typedef struct
+{
+  uint32_t word[STRESS_WORDS];
+} stressState_t;
+
+static stressState_t stressSlots[2];
+static sharedState_t stressState = SHARED_STATE_INITIALIZER("stress", stressSlots[0], stressSlots[1]);
+
+static const std::chrono::steady_clock::time_point hostStart = std::chrono::steady_clock::now();
+
+unsigned long millis(void)
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+unsigned long micros(void)
+{
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostStart).count();
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long writes = STRESS_DEFAULT_WRITES;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc))
+    {
+      writes = strtoul(argv[++i], NULL, 10);
+    }
+    else
+    {
+      fprintf(stderr,
+              "usage: %s [-n writes]\n"
+              "  -n writes  states the writer publishes (default %lu)\n",
+              argv[0], STRESS_DEFAULT_WRITES);
+      return 2;
+    }
+  }
+
+  std::atomic<bool> done(false);
+  unsigned long reads = 0;
+  unsigned long torn = 0;
+  unsigned long backwards = 0;
+  unsigned long changed = 0;
+
+  std::thread writer([&]() {
+    stressState_t state;
+    for (uint32_t n = 1; n <= writes; n++)
+    {
+      for (int w = 0; w < STRESS_WORDS; w++)
+      {
+        state.word[w] = n;
+      }
+      vSharedState_write(&stressState, &state);
+    }
+    done = true;
+  });
+
+  std::thread reader([&]() {
+    stressState_t copy;
+    uint32_t last = 0;
+    while (!done)
+    {
+      uSharedState_read(&stressState, &copy);
+      reads++;
+      for (int w = 1; w < STRESS_WORDS; w++)
+      {
+        if (copy.word[w] != copy.word[0])
+        {
+          torn++;
+          break;
+        }
+      }
+      backwards += (copy.word[0] < last) ? 1 : 0;
+      changed += (copy.word[0] != last) ? 1 : 0;
+      last = copy.word[0];
+    }
+  });
+
+  writer.join();
+  reader.join();
+
+  printf("%lu writes, %lu reads, %lu saw a new state, %lu retried\n", writes, reads, changed,
+         (unsigned long)stressState.retries);
+  printf("%lu torn reads, %lu went backwards\n", torn, backwards);
+  return ((torn == 0) && (backwards == 0)) ? 0 : 1;
+}